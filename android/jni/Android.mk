@@ -14,6 +14,7 @@ config/oor_config_confuse.c    \
 		  control/oor_ctrl_device.c      \
 		  control/oor_local_db.c         \
 		  control/oor_map_cache.c        \
+		  control/oor_map_cache_snapshot.c \
 		  control/lisp_xtr.c             \
 		  control/lisp_ms.c              \
 		  control/control-data-plane/control-data-plane.c    \
@@ -31,6 +32,7 @@ config/oor_config_confuse.c    \
 		  fwd_policies/fwd_policy.c	     \
 		  fwd_policies/flow_balancing/fb_addr_func.c         \
 		  fwd_policies/flow_balancing/flow_balancing.c       \
+		  fwd_policies/latency_balancing/latency_balancing.c \
 		  liblisp/liblisp.c              \
 		  liblisp/lisp_address.c         \
 		  liblisp/lisp_data.c            \
@@ -41,6 +43,8 @@ config/oor_config_confuse.c    \
 		  liblisp/lisp_messages.c        \
 		  liblisp/lisp_message_fields.c  \
 		  lib/cksum.c                    \
+		  lib/echo_nonce.c               \
+		  lib/flowlet.c                  \
 		  lib/generic_list.c             \
 		  lib/hmac.c                     \
 		  lib/iface_locators.c           \
@@ -52,16 +56,22 @@ config/oor_config_confuse.c    \
 		  lib/map_cache_entry.c          \
 		  lib/map_local_entry.c		     \
           lib/mem_util.c	    	     \
+          lib/mpsc_ring.c                \
           lib/nonces_table.c             \
           lib/packets.c                  \
+		  lib/pmtu.c                     \
           lib/pointers_table.c           \
 		  lib/prefixes.c                 \
+		  lib/reencap.c                  \
+		  lib/rloc_lsb.c                 \
 		  lib/routing_tables_lib.c       \
+		  lib/rtt_stats.c                \
 		  lib/sockets.c                  \
 		  lib/sockets-util.c             \
 		  lib/shash.c                    \
 		  lib/timers.c                   \
           lib/timers_utils.c             \
+          lib/token_bucket.c             \
 		  lib/ttable.c                   \
 		  lib/util.c                     \
 		  cmdline.c                      \
@@ -216,3 +216,34 @@ err:
     return (OOR_API_RES_ERR);
 
 }
+
+/* Read the state of a target. On success, *data points to the content
+ * returned by the daemon, to be freed by the caller, and its length is
+ * returned */
+int
+oor_api_read(oor_api_connection_t *conn, int dev, int trgt, uint8_t **data)
+{
+    oor_api_msg_hdr_t *hdr;
+    uint8_t *buffer;
+    int len;
+
+    buffer = xzalloc(MAX_API_PKT_LEN);
+    hdr = (oor_api_msg_hdr_t *) buffer;
+    oor_api_fill_hdr(hdr,dev,trgt,OOR_API_OPR_READ,OOR_API_TYPE_REQUEST,0);
+    oor_api_send(conn,buffer,sizeof(oor_api_msg_hdr_t),OOR_API_NOFLAGS);
+
+    //Blocks until reply
+    len = oor_api_recv(conn,buffer,OOR_API_NOFLAGS);
+    if (len < (int)sizeof(oor_api_msg_hdr_t) || hdr->type != OOR_API_TYPE_RESULT
+            || hdr->datalen != len - sizeof(oor_api_msg_hdr_t)
+            || hdr->datalen == sizeof(oor_api_msg_result_e)){
+        free(buffer);
+        return (OOR_API_ERROR);
+    }
+
+    *data = xzalloc(hdr->datalen + 1);
+    memcpy(*data, CO(buffer,sizeof(oor_api_msg_hdr_t)), hdr->datalen);
+    len = hdr->datalen;
+    free(buffer);
+    return (len);
+}
@@ -56,7 +56,8 @@ typedef enum oor_api_msg_target_e_ {
     OOR_API_TRGT_MSLIST,
     OOR_API_TRGT_PETRLIST,
     OOR_API_TRGT_MAPCACHE,
-    OOR_API_TRGT_MAPDB
+    OOR_API_TRGT_MAPDB,
+    OOR_API_TRGT_RLOC_PATHS
 
 } oor_api_msg_target_e; //Target of the operation
 
@@ -139,4 +140,6 @@ int oor_api_result_msg_new(uint8_t **buf,oor_api_msg_device_e  dev,
 int oor_api_apply_config(oor_api_connection_t *conn, int dev, int trgt, int opr,
         uint8_t *data, int dlen);
 
+int oor_api_read(oor_api_connection_t *conn, int dev, int trgt, uint8_t **data);
+
 #endif /*OOR_API_H_*/
@@ -558,6 +558,151 @@ oor_api_xtr_mr_delete(oor_api_connection_t *conn, oor_api_msg_hdr_t *hdr,
 	return (GOOD);
 }
 
+/* Reply with the Map-Resolvers and the statistics used to select them:
+ * <map-resolvers><map-resolver><map-resolver-address/><state/>... */
+int
+oor_api_xtr_mr_read(oor_api_connection_t *conn, oor_api_msg_hdr_t *hdr,
+        uint8_t *data)
+{
+    lisp_xtr_t *xtr;
+    uint8_t *result_msg, *ptr;
+    int result_msg_len;
+    xmlDocPtr doc;
+    xmlNodePtr mr_list_xml, mr_xml;
+    xmlChar *xml_buf;
+    int xml_len;
+    glist_entry_t *it;
+    map_resolver_state_t *mr;
+    oor_api_msg_hdr_t res_hdr;
+    char val[64];
+
+    xtr = CONTAINER_OF(ctrl_dev, lisp_xtr_t, super);
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    mr_list_xml = xmlNewNode(NULL, BAD_CAST "map-resolvers");
+    xmlDocSetRootElement(doc, mr_list_xml);
+    glist_for_each_entry(it, xtr->map_resolvers){
+        mr = tr_mr_state(xtr, (lisp_addr_t *)glist_entry_data(it));
+        mr_xml = xmlNewChild(mr_list_xml, NULL, BAD_CAST "map-resolver", NULL);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "map-resolver-address",
+                BAD_CAST lisp_addr_to_char(mr->addr));
+        xmlNewChild(mr_xml, NULL, BAD_CAST "state",
+                BAD_CAST (mr->demoted ? "demoted" : "up"));
+        snprintf(val, sizeof(val), "%"PRIu64, mr->requests);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "requests", BAD_CAST val);
+        snprintf(val, sizeof(val), "%"PRIu64, mr->hedged);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "hedged-requests", BAD_CAST val);
+        snprintf(val, sizeof(val), "%"PRIu64, mr->replies);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "replies", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", mr->rtt.srtt);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "rtt-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", mr->rtt.rttvar);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "rtt-var-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", rtt_stats_percentile(&mr->rtt, 95));
+        xmlNewChild(mr_xml, NULL, BAD_CAST "rtt-p95-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.3f", mr->rtt.loss);
+        xmlNewChild(mr_xml, NULL, BAD_CAST "loss", BAD_CAST val);
+    }
+    xmlDocDumpMemory(doc, &xml_buf, &xml_len);
+    xmlFreeDoc(doc);
+
+    if (xml_len > MAX_API_PKT_LEN - sizeof(oor_api_msg_hdr_t)){
+        OOR_LOG(LWRN, "OOR_API: Map Resolvers state doesn't fit in a message");
+        xmlFree(xml_buf);
+        result_msg_len = oor_api_result_msg_new(&result_msg,hdr->device,hdr->target,hdr->operation,OOR_API_RES_ERR);
+        oor_api_send(conn,result_msg,result_msg_len,OOR_API_NOFLAGS);
+        free(result_msg);
+        return (BAD);
+    }
+
+    oor_api_fill_hdr(&res_hdr, hdr->device, hdr->target, hdr->operation,
+            OOR_API_TYPE_RESULT, xml_len);
+    result_msg_len = sizeof(oor_api_msg_hdr_t) + xml_len;
+    result_msg = xzalloc(result_msg_len);
+    ptr = oor_api_hdr_push(result_msg, &res_hdr);
+    memcpy(ptr, xml_buf, xml_len);
+    xmlFree(xml_buf);
+    oor_api_send(conn,result_msg,result_msg_len,OOR_API_NOFLAGS);
+    free(result_msg);
+
+    return (GOOD);
+}
+
+/* Reply with the RTT and loss measured by RLOC probing to each remote RLOC:
+ * <rloc-paths><rloc-path><local-rloc/><remote-rloc/>... */
+int
+oor_api_xtr_rloc_paths_read(oor_api_connection_t *conn, oor_api_msg_hdr_t *hdr,
+        uint8_t *data)
+{
+    lisp_xtr_t *xtr;
+    uint8_t *result_msg, *ptr;
+    int result_msg_len;
+    xmlDocPtr doc;
+    xmlNodePtr path_list_xml, path_xml;
+    xmlChar *xml_buf;
+    int xml_len;
+    khiter_t k;
+    rloc_probe_t *rp;
+    oor_api_msg_hdr_t res_hdr;
+    char val[64];
+
+    xtr = CONTAINER_OF(ctrl_dev, lisp_xtr_t, super);
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    path_list_xml = xmlNewNode(NULL, BAD_CAST "rloc-paths");
+    xmlDocSetRootElement(doc, path_list_xml);
+    for (k = kh_begin(xtr->rloc_probes); k != kh_end(xtr->rloc_probes); ++k){
+        if (!kh_exist(xtr->rloc_probes, k)){
+            continue;
+        }
+        rp = kh_value(xtr->rloc_probes, k);
+        path_xml = xmlNewChild(path_list_xml, NULL, BAD_CAST "rloc-path", NULL);
+        if (!lisp_addr_is_no_addr(&rp->laddr)){
+            xmlNewChild(path_xml, NULL, BAD_CAST "local-rloc",
+                    BAD_CAST lisp_addr_to_char(&rp->laddr));
+        }
+        xmlNewChild(path_xml, NULL, BAD_CAST "remote-rloc",
+                BAD_CAST lisp_addr_to_char(&rp->addr));
+        snprintf(val, sizeof(val), "%u", kh_size(rp->mces));
+        xmlNewChild(path_xml, NULL, BAD_CAST "map-cache-entries", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", rp->rtt.srtt);
+        xmlNewChild(path_xml, NULL, BAD_CAST "rtt-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", rp->rtt.rttvar);
+        xmlNewChild(path_xml, NULL, BAD_CAST "rtt-var-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.1f", rtt_stats_percentile(&rp->rtt, 95));
+        xmlNewChild(path_xml, NULL, BAD_CAST "rtt-p95-ms", BAD_CAST val);
+        snprintf(val, sizeof(val), "%.3f", rp->rtt.loss);
+        xmlNewChild(path_xml, NULL, BAD_CAST "loss", BAD_CAST val);
+        snprintf(val, sizeof(val), "%"PRIu64, rp->rtt.samples);
+        xmlNewChild(path_xml, NULL, BAD_CAST "samples", BAD_CAST val);
+        snprintf(val, sizeof(val), "%"PRIu64, rp->rtt.losses);
+        xmlNewChild(path_xml, NULL, BAD_CAST "losses", BAD_CAST val);
+    }
+    xmlDocDumpMemory(doc, &xml_buf, &xml_len);
+    xmlFreeDoc(doc);
+
+    if (xml_len > MAX_API_PKT_LEN - sizeof(oor_api_msg_hdr_t)){
+        OOR_LOG(LWRN, "OOR_API: RLOC paths state doesn't fit in a message");
+        xmlFree(xml_buf);
+        result_msg_len = oor_api_result_msg_new(&result_msg,hdr->device,hdr->target,hdr->operation,OOR_API_RES_ERR);
+        oor_api_send(conn,result_msg,result_msg_len,OOR_API_NOFLAGS);
+        free(result_msg);
+        return (BAD);
+    }
+
+    oor_api_fill_hdr(&res_hdr, hdr->device, hdr->target, hdr->operation,
+            OOR_API_TYPE_RESULT, xml_len);
+    result_msg_len = sizeof(oor_api_msg_hdr_t) + xml_len;
+    result_msg = xzalloc(result_msg_len);
+    ptr = oor_api_hdr_push(result_msg, &res_hdr);
+    memcpy(ptr, xml_buf, xml_len);
+    xmlFree(xml_buf);
+    oor_api_send(conn,result_msg,result_msg_len,OOR_API_NOFLAGS);
+    free(result_msg);
+
+    return (GOOD);
+}
+
 int
 oor_api_xtr_ms_create(oor_api_connection_t *conn, oor_api_msg_hdr_t *hdr,
         uint8_t *data)
@@ -1013,6 +1158,10 @@ int
                     OOR_LOG(LDBG_2, "OOR_API call = (Device: xTR | Target: MR list | Operation: Delete)");
                 	process_func = oor_api_xtr_mr_delete;
                 	break;
+                case OOR_API_OPR_READ:
+                    OOR_LOG(LDBG_2, "OOR_API call = (Device: xTR | Target: MR list | Operation: Read)");
+                    process_func = oor_api_xtr_mr_read;
+                    break;
                 default:
                 	OOR_LOG(LWRN, "OOR_API call = (Device: xTR | Target: MR list | Operation: Unsupported)");
                     break;
@@ -1063,6 +1212,17 @@ int
                 break;
             }
             break;
+        case OOR_API_TRGT_RLOC_PATHS:
+            switch (operation){
+            case OOR_API_OPR_READ:
+                OOR_LOG(LDBG_2, "OOR_API call = (Device: xTR | Target: RLOC paths | Operation: Read)");
+                process_func = oor_api_xtr_rloc_paths_read;
+                break;
+            default:
+                OOR_LOG(LWRN, "OOR_API call = (Device: xTR | Target: RLOC paths | Operation: Unsupported)");
+                break;
+            }
+            break;
         default:
         	OOR_LOG(LWRN, "OOR_API call = (Device: xTR | Target: Unsupported)");
             break;
@@ -1084,6 +1244,10 @@ int
                 OOR_LOG(LDBG_2, "OOR_API call = (Device: RTR | Target: MR list | Operation: Delete)");
                 process_func = oor_api_xtr_mr_delete;
                 break;
+            case OOR_API_OPR_READ:
+                OOR_LOG(LDBG_2, "OOR_API call = (Device: RTR | Target: MR list | Operation: Read)");
+                process_func = oor_api_xtr_mr_read;
+                break;
             default:
                 OOR_LOG(LWRN, "OOR_API call = (Device: RTR | Target: MR list | Operation: Unsupported)");
                 break;
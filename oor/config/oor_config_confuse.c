@@ -33,6 +33,13 @@
 #include "../control/lisp_ms.h"
 #include "../control/lisp_xtr.h"
 #include "../data-plane/data-plane.h"
+#ifndef ANDROID
+#include "../data-plane/pcap/pcap.h"
+#endif
+#include "../lib/echo_nonce.h"
+#include "../lib/flowlet.h"
+#include "../lib/pmtu.h"
+#include "../lib/reencap.h"
 #include "../lib/oor_log.h"
 #include "../lib/shash.h"
 
@@ -345,12 +352,66 @@ configure_tunnel_router(cfg_t *cfg, lisp_xtr_t *xtr, shash_t *lcaf_ht)
 {
     int i,n,ret;
     char *map_resolver;
-    char *encap;
+    char *encap, *str;
     mapping_t *mapping;
+    lisp_addr_t *pref;
+    mcache_evict_policy_e evict;
+    fwd_policy_dev_parm *pol_dev;
+
+    /* PACKET BUFFERS */
+    pkt_buf_conf.mtu = cfg_getint(cfg, "tun-mtu");
+    if (pkt_buf_conf.mtu < 576
+            || pkt_buf_conf.mtu > 65535 - MAX_DATA_ENCAP_LEN){
+        OOR_LOG(LERR, "Configuration file: tun-mtu should be between 576 "
+                "and %d", 65535 - MAX_DATA_ENCAP_LEN);
+        return (BAD);
+    }
+    /* Encapsulated packets are received in the same buffers */
+    n = cfg_getint(cfg, "receive-buffer-size");
+    if (n == 0){
+        n = MAX(MAX_IP_PKT_LEN, pkt_buf_conf.mtu + MAX_DATA_ENCAP_LEN);
+    }else if (n < pkt_buf_conf.mtu + MAX_DATA_ENCAP_LEN){
+        OOR_LOG(LERR, "Configuration file: receive-buffer-size should be at "
+                "least tun-mtu plus %d bytes of encapsulation",
+                MAX_DATA_ENCAP_LEN);
+        return (BAD);
+    }
+    pkt_buf_conf.size = n;
+    pkt_buf_conf.headroom = cfg_getint(cfg, "buffer-headroom");
+    if (pkt_buf_conf.headroom < 0){
+        OOR_LOG(LERR, "Configuration file: buffer-headroom can't be negative");
+        return (BAD);
+    }
+    OOR_LOG(LDBG_1, "Packet buffers: tun MTU %d, receive buffers of %d bytes "
+            "with %d bytes of headroom", pkt_buf_conf.mtu, pkt_buf_conf.size,
+            pkt_buf_conf.headroom);
+
+    /* FLOWLETS */
+    n = cfg_getint(cfg, "flowlet-gap");
+    if (n < 0){
+        OOR_LOG(LERR, "Configuration file: flowlet-gap can't be negative");
+        return (BAD);
+    }
+    pol_dev = fwd_policy_dev_parm_new();
+    if (n > 0){
+        flowlets = flowlet_table_new(n / 1000.0);
+        shash_insert(pol_dev->paramiters, strdup("flowlets"), strdup("true"));
+    }
+
+    /* PATH MTU */
+    pmtus = pmtu_table_new(cfg_getbool(cfg, "stateless-fragmentation")
+            ? TRUE : FALSE);
 
     /* FWD POLICY STRUCTURES */
-    xtr->fwd_policy = fwd_policy_class_find("flow_balancing");
-    xtr->fwd_policy_dev_parm = xtr->fwd_policy->new_dev_policy_inf(ctrl_dev,NULL);
+    str = cfg_getstr(cfg, "forwarding-policy");
+    xtr->fwd_policy = fwd_policy_class_find(str);
+    if (xtr->fwd_policy == NULL){
+        OOR_LOG(LERR, "Configuration file: Unknown forwarding-policy: %s", str);
+        fwd_policy_dev_parm_del(pol_dev);
+        return (BAD);
+    }
+    xtr->fwd_policy_dev_parm = xtr->fwd_policy->new_dev_policy_inf(ctrl_dev,pol_dev);
+    fwd_policy_dev_parm_del(pol_dev);
 
     if ((encap = cfg_getstr(cfg, "encapsulation")) != NULL) {
         if (strcmp(encap, "LISP") == 0) {
@@ -367,6 +428,118 @@ configure_tunnel_router(cfg_t *cfg, lisp_xtr_t *xtr, shash_t *lcaf_ht)
     ret = cfg_getint(cfg, "map-request-retries");
     xtr->map_request_retries = (ret != 0) ? ret : DEFAULT_MAP_REQUEST_RETRIES;
 
+    /* PACKETS QUEUED DURING MAP CACHE MISSES */
+    xtr->miss_queue_len = cfg_getint(cfg, "miss-queue-length");
+    xtr->miss_queue_bytes = cfg_getint(cfg, "miss-queue-bytes");
+    if (xtr->miss_queue_len < 0 || xtr->miss_queue_bytes < 0){
+        OOR_LOG(LERR, "Configuration file: miss-queue-length and "
+                "miss-queue-bytes can not be negative");
+        return (BAD);
+    }
+
+    /* MAP-REQUEST RATE LIMITING AND COALESCING */
+    n = cfg_getint(cfg, "map-request-rate");
+    xtr->mreq_mr_rate = cfg_getint(cfg, "map-resolver-request-rate");
+    if (n < 1 || xtr->mreq_mr_rate < 1){
+        OOR_LOG(LERR, "Configuration file: map-request-rate and "
+                "map-resolver-request-rate should be at least 1");
+        return (BAD);
+    }
+    token_bucket_init(&xtr->mreq_rate, n, n);
+    xtr->mreq_coalesce_v4 = cfg_getint(cfg, "map-request-coalesce-v4");
+    xtr->mreq_coalesce_v6 = cfg_getint(cfg, "map-request-coalesce-v6");
+    if (xtr->mreq_coalesce_v4 < 0 || xtr->mreq_coalesce_v4 > 32
+            || xtr->mreq_coalesce_v6 < 0 || xtr->mreq_coalesce_v6 > 128){
+        OOR_LOG(LERR, "Configuration file: Wrong map-request-coalesce prefix "
+                "length");
+        return (BAD);
+    }
+    xtr->mr_hedging = cfg_getbool(cfg, "map-resolver-hedging") ? TRUE : FALSE;
+
+    /* MAP CACHE LIMITS */
+    if (cfg_getint(cfg, "map-cache-max-entries") < 0
+            || cfg_getint(cfg, "map-cache-max-bytes") < 0){
+        OOR_LOG(LERR, "Configuration file: map-cache-max-entries and "
+                "map-cache-max-bytes can not be negative");
+        return (BAD);
+    }
+    if ((str = cfg_getstr(cfg, "map-cache-eviction")) == NULL
+            || strcmp(str, "lru") == 0){
+        evict = MCACHE_EVICT_LRU;
+    }else if (strcmp(str, "lfu") == 0){
+        evict = MCACHE_EVICT_LFU;
+    }else if (strcmp(str, "ttl") == 0){
+        evict = MCACHE_EVICT_TTL;
+    }else{
+        OOR_LOG(LERR, "Configuration file: Unknown map-cache-eviction policy: "
+                "%s", str);
+        return (BAD);
+    }
+    mcache_set_limits(xtr->map_cache, cfg_getint(cfg, "map-cache-max-entries"),
+            cfg_getint(cfg, "map-cache-max-bytes"), evict);
+
+    /* MAP CACHE SNAPSHOT */
+    if ((str = cfg_getstr(cfg, "map-cache-snapshot")) != NULL){
+        xtr->mcache_snapshot_file = strdup(str);
+    }
+    xtr->mcache_snapshot_interval = cfg_getint(cfg, "map-cache-snapshot-interval");
+    xtr->mcache_refresh_window = cfg_getint(cfg, "map-cache-refresh-window");
+    if (xtr->mcache_snapshot_interval < 0 || xtr->mcache_refresh_window < 0){
+        OOR_LOG(LERR, "Configuration file: map-cache-snapshot-interval and "
+                "map-cache-refresh-window can not be negative");
+        return (BAD);
+    }
+    xtr->mreq_batch_records = cfg_getint(cfg, "map-request-batch");
+    if (xtr->mreq_batch_records < 1
+            || xtr->mreq_batch_records > MREQ_BATCH_MAX_RECORDS){
+        OOR_LOG(LERR, "Configuration file: map-request-batch should be "
+                "between 1 and %d", MREQ_BATCH_MAX_RECORDS);
+        return (BAD);
+    }
+
+    /* MAPPINGS GLEANED FROM DATA PACKETS */
+    xtr->glean = cfg_getbool(cfg, "glean-mappings") ? TRUE : FALSE;
+    xtr->glean_ttl = cfg_getint(cfg, "glean-ttl");
+    xtr->glean_max_entries = cfg_getint(cfg, "glean-max-entries");
+    n = cfg_getint(cfg, "glean-rate");
+    if (xtr->glean_ttl < 1 || xtr->glean_max_entries < 0 || n < 1){
+        OOR_LOG(LERR, "Configuration file: glean-ttl and glean-rate should be "
+                "at least 1 and glean-max-entries can not be negative");
+        return (BAD);
+    }
+    token_bucket_init(&xtr->glean_rate, n, n);
+    xtr->glean_mask_v4 = cfg_getint(cfg, "glean-mask-v4");
+    xtr->glean_mask_v6 = cfg_getint(cfg, "glean-mask-v6");
+    if (xtr->glean_mask_v4 < 1 || xtr->glean_mask_v4 > 32
+            || xtr->glean_mask_v6 < 1 || xtr->glean_mask_v6 > 128){
+        OOR_LOG(LERR, "Configuration file: Wrong glean-mask prefix length");
+        return (BAD);
+    }
+    n = cfg_size(cfg, "glean-prefixes");
+    for (i = 0; i < n; i++){
+        str = cfg_getnstr(cfg, "glean-prefixes", i);
+        pref = lisp_addr_new();
+        if (lisp_addr_ippref_from_char(str, pref) != GOOD){
+            OOR_LOG(LERR, "Configuration file: Wrong glean-prefixes prefix: "
+                    "%s", str);
+            lisp_addr_del(pref);
+            return (BAD);
+        }
+        glist_add(pref, xtr->glean_prefixes);
+    }
+
+    /* ECHO-NONCE */
+    if (cfg_getbool(cfg, "echo-nonce")){
+        n = cfg_getint(cfg, "echo-nonce-window");
+        ret = cfg_getint(cfg, "echo-nonce-interval");
+        if (n < 1 || ret < 1){
+            OOR_LOG(LERR, "Configuration file: echo-nonce-window and "
+                    "echo-nonce-interval should be at least 1");
+            return (BAD);
+        }
+        echo_nonces = echo_nonce_table_new(n, ret);
+    }
+
 
     /* RLOC PROBING CONFIG */
     cfg_t *dm = cfg_getnsec(cfg, "rloc-probing", 0);
@@ -454,6 +627,16 @@ configure_rtr(cfg_t *cfg)
         return (BAD);
     }
 
+    /* RE-ENCAPSULATION CACHE */
+    if (cfg_getbool(cfg, "rtr-reencap-cache")){
+        if (flowlets){
+            OOR_LOG(LWRN, "Configuration file: rtr-reencap-cache can't be "
+                    "used with flowlets. Ignoring it");
+        }else{
+            reencaps = reencap_table_new();
+        }
+    }
+
     /* INTERFACES CONFIG */
     n = cfg_size(cfg, "rtr-ifaces");
     if (n) {
@@ -618,6 +801,58 @@ configure_mn(cfg_t *cfg)
     return (GOOD);
 }
 
+#ifndef ANDROID
+static int
+configure_pcap_data_plane(cfg_t *cfg)
+{
+    pcap_dplane_conf_t conf;
+    char *str;
+
+    cfg_t *pdp = cfg_getnsec(cfg, "pcap-data-plane", 0);
+    if (pdp == NULL){
+        return (GOOD);
+    }
+
+    memset(&conf, 0, sizeof(pcap_dplane_conf_t));
+    if ((str = cfg_getstr(pdp, "inner-input")) != NULL){
+        conf.inner_input = strdup(str);
+    }
+    if ((str = cfg_getstr(pdp, "outer-input")) != NULL){
+        conf.outer_input = strdup(str);
+    }
+    if ((str = cfg_getstr(pdp, "encap-output")) != NULL){
+        conf.encap_output = strdup(str);
+    }
+    if ((str = cfg_getstr(pdp, "decap-output")) != NULL){
+        conf.decap_output = strdup(str);
+    }
+    if (!conf.inner_input && !conf.outer_input){
+        OOR_LOG(LERR, "Configuration file: pcap-data-plane requires at least "
+                "one of inner-input or outer-input");
+        return (BAD);
+    }
+    conf.speed = cfg_getint(pdp, "speed");
+    if (conf.speed < 0){
+        OOR_LOG(LERR, "Configuration file: pcap-data-plane speed should be "
+                "0 (virtual time) or a positive acceleration factor");
+        return (BAD);
+    }
+    conf.burst = cfg_getint(pdp, "burst");
+    if (conf.burst < 1 || conf.burst > PCAP_DPLANE_MAX_BURST){
+        OOR_LOG(LERR, "Configuration file: pcap-data-plane burst should be "
+                "between 1 and %d", PCAP_DPLANE_MAX_BURST);
+        return (BAD);
+    }
+    conf.exit_at_end = cfg_getbool(pdp, "exit-at-end") ? TRUE : FALSE;
+
+    pcap_dplane_set_conf(&conf);
+    data_plane = &dplane_pcap;
+    OOR_LOG(LINF, "Configuration file: Using the pcap data plane");
+
+    return (GOOD);
+}
+#endif
+
 int
 configure_ms(cfg_t *cfg)
 {
@@ -835,6 +1070,19 @@ handle_config_file()
             CFG_END()
     };
 
+#ifndef ANDROID
+    static cfg_opt_t pcap_dplane_opts[] = {
+            CFG_STR("inner-input",          0, CFGF_NONE),
+            CFG_STR("outer-input",          0, CFGF_NONE),
+            CFG_STR("encap-output",         0, CFGF_NONE),
+            CFG_STR("decap-output",         0, CFGF_NONE),
+            CFG_INT("speed",                0, CFGF_NONE),
+            CFG_INT("burst",                1, CFGF_NONE),
+            CFG_BOOL("exit-at-end",         cfg_true, CFGF_NONE),
+            CFG_END()
+    };
+#endif
+
     /* Map-Server specific */
     static cfg_opt_t lisp_site_opts[] = {
             CFG_STR("eid-prefix",               0, CFGF_NONE),
@@ -854,10 +1102,41 @@ handle_config_file()
             CFG_SEC("static-map-cache",     map_cache_mapping_opts, CFGF_MULTI),
             CFG_SEC("map-server",           map_server_opts,        CFGF_MULTI),
             CFG_SEC("rtr-ifaces",           rtr_ifaces_opts,        CFGF_MULTI),
+            CFG_BOOL("rtr-reencap-cache",   cfg_false,              CFGF_NONE),
             CFG_SEC("proxy-etr",            petr_mapping_opts,      CFGF_MULTI),
             CFG_STR("encapsulation",        0,                      CFGF_NONE),
+            CFG_STR("forwarding-policy",    "flow_balancing",       CFGF_NONE),
+            CFG_INT("flowlet-gap",          0,                      CFGF_NONE),
+            CFG_INT("tun-mtu",              DEFAULT_EID_MTU,        CFGF_NONE),
+            CFG_INT("receive-buffer-size",  0,                      CFGF_NONE),
+            CFG_INT("buffer-headroom",      0,                      CFGF_NONE),
+            CFG_BOOL("stateless-fragmentation", cfg_false,          CFGF_NONE),
             CFG_SEC("rloc-probing",         rloc_probing_opts,      CFGF_MULTI),
             CFG_INT("map-request-retries",  0, CFGF_NONE),
+            CFG_INT("miss-queue-length",    DEFAULT_MISS_QUEUE_LEN, CFGF_NONE),
+            CFG_INT("miss-queue-bytes",     DEFAULT_MISS_QUEUE_BYTES, CFGF_NONE),
+            CFG_INT("map-request-rate",     DEFAULT_MREQ_RATE, CFGF_NONE),
+            CFG_INT("map-resolver-request-rate", DEFAULT_MR_MREQ_RATE, CFGF_NONE),
+            CFG_INT("map-request-coalesce-v4", DEFAULT_MREQ_COALESCE_V4, CFGF_NONE),
+            CFG_INT("map-request-coalesce-v6", DEFAULT_MREQ_COALESCE_V6, CFGF_NONE),
+            CFG_BOOL("map-resolver-hedging", cfg_false, CFGF_NONE),
+            CFG_INT("map-cache-max-entries", DEFAULT_MCACHE_MAX_ENTRIES, CFGF_NONE),
+            CFG_INT("map-cache-max-bytes",  0, CFGF_NONE),
+            CFG_STR("map-cache-eviction",   "lru", CFGF_NONE),
+            CFG_STR("map-cache-snapshot",   0, CFGF_NONE),
+            CFG_INT("map-cache-snapshot-interval", DEFAULT_MCACHE_SNAPSHOT_INTERVAL, CFGF_NONE),
+            CFG_INT("map-cache-refresh-window", DEFAULT_MCACHE_REFRESH_WINDOW, CFGF_NONE),
+            CFG_INT("map-request-batch",    DEFAULT_MREQ_BATCH_RECORDS, CFGF_NONE),
+            CFG_BOOL("glean-mappings",      cfg_false, CFGF_NONE),
+            CFG_INT("glean-ttl",            DEFAULT_GLEAN_TTL, CFGF_NONE),
+            CFG_INT("glean-mask-v4",        32, CFGF_NONE),
+            CFG_INT("glean-mask-v6",        128, CFGF_NONE),
+            CFG_INT("glean-max-entries",    DEFAULT_GLEAN_MAX_ENTRIES, CFGF_NONE),
+            CFG_INT("glean-rate",           DEFAULT_GLEAN_RATE, CFGF_NONE),
+            CFG_STR_LIST("glean-prefixes",  0, CFGF_NONE),
+            CFG_BOOL("echo-nonce",          cfg_false, CFGF_NONE),
+            CFG_INT("echo-nonce-window",    DEFAULT_ECHO_NONCE_WINDOW, CFGF_NONE),
+            CFG_INT("echo-nonce-interval",  DEFAULT_ECHO_NONCE_INTERVAL, CFGF_NONE),
             CFG_INT("control-port",         0, CFGF_NONE),
             CFG_INT("debug",                0, CFGF_NONE),
             CFG_STR("log-file",             0, CFGF_NONE),
@@ -877,6 +1156,9 @@ handle_config_file()
             CFG_SEC("explicit-locator-path", elp_opts,              CFGF_MULTI),
             CFG_SEC("replication-list",     rle_opts,               CFGF_MULTI),
             CFG_SEC("multicast-info",       mc_info_opts,           CFGF_MULTI),
+#ifndef ANDROID
+            CFG_SEC("pcap-data-plane",      pcap_dplane_opts,       CFGF_MULTI),
+#endif
             CFG_END()
     };
 
@@ -932,6 +1214,14 @@ handle_config_file()
     if (daemonize == TRUE){
         open_log_file(log_file);
     }
+#ifndef ANDROID
+    /* The data plane should be selected before configuring the interfaces */
+    if (configure_pcap_data_plane(cfg) != GOOD){
+        cfg_free(cfg);
+        return (BAD);
+    }
+#endif
+
     mode = cfg_getstr(cfg, "operating-mode");
     if (mode) {
         if (strcmp(mode, "xTR") == 0) {
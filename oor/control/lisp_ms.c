@@ -86,14 +86,13 @@ get_etr_from_lcaf(lisp_addr_t *laddr, lisp_addr_t **dst)
     return (GOOD);
 }
 
-/* forward encapsulated Map-Request to ETR */
-static int
-forward_mreq(lisp_ms_t *ms, lbuf_t *b, mapping_t *m)
+/* RLOC of the ETR of mapping m to forward Map-Requests to */
+static lisp_addr_t *
+ms_etr_rloc(lisp_ms_t *ms, mapping_t *m)
 {
 	oor_ctrl_t *ctrl = NULL;
     lisp_addr_t *drloc = NULL;
     locator_t *loct = NULL;
-    uconn_t fwd_uc;
 
     ctrl = ctrl_dev_ctrl(&(ms->super));
 
@@ -106,7 +105,7 @@ forward_mreq(lisp_ms_t *ms, lbuf_t *b, mapping_t *m)
     if (loct == NULL){
     	OOR_LOG(LDBG_1, "Can't find valid RLOC to forward Map-Request to "
     	                "ETR. Discarding!");
-    	return(BAD);
+    	return(NULL);
     }
 
     drloc = lisp_addr_get_ip_addr(locator_addr(loct));
@@ -117,6 +116,14 @@ forward_mreq(lisp_ms_t *ms, lbuf_t *b, mapping_t *m)
 
     OOR_LOG(LDBG_3, "Found xTR with locator %s to forward Encap Map-Request",
             lisp_addr_to_char(drloc));
+    return(drloc);
+}
+
+/* forward encapsulated Map-Request to ETR */
+static int
+forward_mreq(lisp_ms_t *ms, lbuf_t *b, lisp_addr_t *drloc)
+{
+    uconn_t fwd_uc;
 
     /* Set buffer to forward the encapsulated message*/
     lbuf_point_to_lisp_hdr(b);
@@ -190,16 +197,42 @@ lsite_entry_update_expiration_timer(lisp_ms_t *ms, lisp_reg_site_t *rsite)
             MS_SITE_EXPIRATION);
 }
 
+/* Send the Map-Reply with the records answered by the Map Server to the
+ * ITR */
+static void
+ms_send_map_reply(lisp_ms_t *ms, lbuf_t *mrep, uint64_t nonce,
+        glist_t *itr_rlocs, uconn_t *uc)
+{
+    void *mrep_hdr = lisp_msg_hdr(mrep);
+
+    MREP_RLOC_PROBE(mrep_hdr) = 0;
+    MREP_NONCE(mrep_hdr) = nonce;
+
+    laddr_list_get_addr(itr_rlocs, lisp_addr_ip_afi(&uc->la), &uc->ra);
+    OOR_LOG(LDBG_2, "%s", lisp_msg_hdr_to_char(mrep));
+    if (send_msg(&ms->super, mrep, uc) != GOOD) {
+        OOR_LOG(LDBG_1, "Couldn't send Map-Reply!");
+    }
+}
+
+/*
+ * Records of a Map-Request can be answered in different ways. The ones
+ * answered by the Map Server (negative and proxy replies) are sent together
+ * in Map-Replies with the nonce of the request. The request is forwarded
+ * only once to each ETR, that answers all the records it is authoritative
+ * for.
+ */
 static int
 ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf, uconn_t *uc)
 {
 
     lisp_addr_t *   seid        = NULL;
     lisp_addr_t *   deid        = NULL;
+    lisp_addr_t *   drloc       = NULL;
     mapping_t *     map         = NULL;
     glist_t *       itr_rlocs   = NULL;
+    glist_t *       etrs        = NULL;
     void *          mreq_hdr    = NULL;
-    void *          mrep_hdr    = NULL;
     mapping_record_hdr_t *  rec            = NULL;
     int             i           = 0;
     lbuf_t *        mrep        = NULL;
@@ -223,11 +256,13 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf, uconn_t *uc)
     OOR_LOG(LDBG_1, " src-eid: %s", lisp_addr_to_char(seid));
     if (MREQ_RLOC_PROBE(mreq_hdr)) {
         OOR_LOG(LDBG_2, "Probe bit set. Discarding!");
+        lisp_addr_del(seid);
         return(BAD);
     }
 
     if (MREQ_SMR(mreq_hdr)) {
         OOR_LOG(LDBG_2, "SMR bit set. Discarding!");
+        lisp_addr_del(seid);
         return(BAD);
     }
 
@@ -235,99 +270,94 @@ ms_recv_map_request(lisp_ms_t *ms, lbuf_t *buf, uconn_t *uc)
     itr_rlocs = laddr_list_new();
     lisp_msg_parse_itr_rlocs(&b, itr_rlocs);
 
+    /* ETRs the request has already been forwarded to */
+    etrs = glist_new_complete((glist_cmp_fct)lisp_addr_cmp,
+            (glist_del_fct)lisp_addr_del);
+
     for (i = 0; i < MREQ_REC_COUNT(mreq_hdr); i++) {
+        /* PROCESS EID REC. A new address for each record, as parsing an
+         * LCAF over the previous one would leak its data */
+        lisp_addr_del(deid);
         deid = lisp_addr_new();
-
-        /* PROCESS EID REC */
         if (lisp_msg_parse_eid_rec(&b, deid) != GOOD) {
             goto err;
         }
 
+        if (mrep == NULL) {
+            mrep = lisp_msg_create(LISP_MAP_REPLY);
+        }
+
         /* CHECK IF WE NEED TO PROXY REPLY */
         site = mdb_lookup_entry(ms->lisp_sites_db, deid);
         rsite = mdb_lookup_entry(ms->reg_sites_db, deid);
         /* Static entries will have null site and not null rsite */
         if (!site && !rsite) {
-            /* send negative map-reply with TTL 15 min */
+            /* negative map-reply with TTL 15 min */
 
             if (lisp_addr_is_iid(deid)){
                 act_flag = ACT_NO_ACTION;
             }else{
                 act_flag = ACT_NATIVE_FWD;
             }
-            mrep = lisp_msg_neg_mrep_create(deid, 15, act_flag,A_AUTHORITATIVE,
-                    MREQ_NONCE(mreq_hdr));
+            lisp_msg_put_neg_mapping(mrep, deid, 15, act_flag, A_AUTHORITATIVE);
             OOR_LOG(LDBG_1,"The requested EID %s doesn't belong to this Map Server",
                     lisp_addr_to_char(deid));
-            OOR_LOG(LDBG_2, "%s, EID: %s, NEGATIVE", lisp_msg_hdr_to_char(mrep),
-                    lisp_addr_to_char(deid));
-            send_msg(&ms->super, mrep, uc);
-            lisp_msg_destroy(mrep);
-            lisp_addr_del(deid);
-
-            continue;
-        }
-
-        /* Find if the site actually registered */
-        if (!rsite) {
-            /* send negative map-reply with TTL 1 min */
-            mrep = lisp_msg_neg_mrep_create(deid, 1, ACT_NATIVE_FWD,A_AUTHORITATIVE,
-                    MREQ_NONCE(mreq_hdr));
+            OOR_LOG(LDBG_2, "EID: %s, NEGATIVE", lisp_addr_to_char(deid));
+        } else if (!rsite) {
+            /* Site not registered: negative map-reply with TTL 1 min */
+            lisp_msg_put_neg_mapping(mrep, deid, 1, ACT_NATIVE_FWD, A_AUTHORITATIVE);
             OOR_LOG(LDBG_1,"The requested EID %s is not registered",
                                 lisp_addr_to_char(deid));
-            OOR_LOG(LDBG_2, "%s, EID: %s, NEGATIVE", lisp_msg_hdr_to_char(mrep),
-                    lisp_addr_to_char(deid));
-            send_msg(&ms->super, mrep, uc);
-            lisp_msg_destroy(mrep);
-            lisp_addr_del(deid);
+            OOR_LOG(LDBG_2, "EID: %s, NEGATIVE", lisp_addr_to_char(deid));
+        } else if (site != NULL && site->proxy_reply == FALSE) {
+            /* IF *NOT* PROXY REPLY: forward the message to an xTR. If site
+             * is null, the request is for a static entry */
+            map = rsite->site_map;
+            /* FIXME: once locs become one object, send that instead of mapping */
+            drloc = ms_etr_rloc(ms, map);
+            if (drloc != NULL && !glist_contain_using_cmp_fct(drloc, etrs,
+                    (glist_cmp_fct)lisp_addr_cmp)) {
+                forward_mreq(ms, buf, drloc);
+                glist_add(lisp_addr_clone(drloc), etrs);
+            }
             continue;
+        } else {
+            map = rsite->site_map;
+            OOR_LOG(LDBG_1,"The requested EID %s belongs to the registered prefix %s. Send Map Reply",
+                    lisp_addr_to_char(deid), lisp_addr_to_char(mapping_eid(map)));
+
+            /* IF PROXY REPLY: add the mapping to the Map-Reply */
+            rec = lisp_msg_put_mapping(mrep, map, NULL);
+            /* Set the authoritative bit of the record to false*/
+            MAP_REC_AUTH(rec) = A_NO_AUTHORITATIVE;
         }
 
-        map = rsite->site_map;
-        /* If site is null, the request is for a static entry */
-
-        /* IF *NOT* PROXY REPLY: forward the message to an xTR */
-        if (site != NULL && site->proxy_reply == FALSE) {
-            /* FIXME: once locs become one object, send that instead of mapping */
-            forward_mreq(ms, buf, map);
+        /* SEND MAP-REPLY when it is full */
+        if (lbuf_size(mrep) >= MS_MAP_REPLY_MAX_LEN) {
+            ms_send_map_reply(ms, mrep, MREQ_NONCE(mreq_hdr), itr_rlocs, uc);
             lisp_msg_destroy(mrep);
-            lisp_addr_del(deid);
-            continue;
+            mrep = NULL;
         }
+    }
 
-        OOR_LOG(LDBG_1,"The requested EID %s belongs to the registered prefix %s. Send Map Reply",
-                lisp_addr_to_char(deid), lisp_addr_to_char(mapping_eid(map)));
-
-        /* IF PROXY REPLY: build Map-Reply */
-        mrep = lisp_msg_create(LISP_MAP_REPLY);
-        rec = lisp_msg_put_mapping(mrep, map, NULL);
-        /* Set the authoritative bit of the record to false*/
-        MAP_REC_AUTH(rec) = A_NO_AUTHORITATIVE;
-
-        mrep_hdr = lisp_msg_hdr(mrep);
-        MREP_RLOC_PROBE(mrep_hdr) = 0;
-        MREP_NONCE(mrep_hdr) = MREQ_NONCE(mreq_hdr);
-
-        /* SEND MAP-REPLY */
-        laddr_list_get_addr(itr_rlocs, lisp_addr_ip_afi(&uc->la), &uc->ra);
-        if (send_msg(&ms->super, mrep, uc) != GOOD) {
-            OOR_LOG(LDBG_1, "Couldn't send Map-Reply!");
-        }
-        lisp_msg_destroy(mrep);
-        lisp_addr_del(deid);
+    if (mrep != NULL && MREP_REC_COUNT(lisp_msg_hdr(mrep)) > 0) {
+        ms_send_map_reply(ms, mrep, MREQ_NONCE(mreq_hdr), itr_rlocs, uc);
     }
 
+    lisp_msg_destroy(mrep);
+    glist_destroy(etrs);
     glist_destroy(itr_rlocs);
+    lisp_addr_del(deid);
     lisp_addr_del(seid);
 
     return(GOOD);
 err:
+    glist_destroy(etrs);
     glist_destroy(itr_rlocs);
     lisp_msg_destroy(mrep);
     lisp_addr_del(deid);
     lisp_addr_del(seid);
     return(BAD);
-
 }
 
 static int
@@ -17,19 +17,30 @@
  *
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "../lib/echo_nonce.h"
 #include "../lib/iface_locators.h"
 #include "../lib/sockets.h"
 #include "../lib/mem_util.h"
 #include "../lib/oor_log.h"
+#include "../lib/prefixes.h"
+#include "../lib/rloc_lsb.h"
 #include "../lib/timers_utils.h"
 #include "../lib/util.h"
+#include "../data-plane/data-plane.h"
+#include "../oor_external.h"
 #include "lisp_xtr.h"
+#include "oor_map_cache_snapshot.h"
 
-static int mc_entry_expiration_timer_cb(oor_timer_t *t);
-static void mc_entry_start_expiration_timer(lisp_xtr_t *, mcache_entry_t *);
-static int handle_locator_probe_reply(lisp_xtr_t *, mcache_entry_t *, lisp_addr_t *);
+static void mc_entry_expiration(lisp_xtr_t *, mcache_entry_t *, time_t);
+static int mc_expiry_sweep_cb(oor_timer_t *t);
+static void mc_entry_schedule_expiration(lisp_xtr_t *, mcache_entry_t *, int);
 static int update_mcache_entry(lisp_xtr_t *, mapping_t *);
 static int tr_recv_map_reply(lisp_xtr_t *, lbuf_t *, uconn_t *);
 static int tr_reply_to_smr(lisp_xtr_t *xtr, lisp_addr_t *src_eid, lisp_addr_t *req_eid);
@@ -54,16 +65,23 @@ static int send_smr_invoked_map_request(lisp_xtr_t *xtr, lisp_addr_t *src_eid,
 static int program_smr(lisp_xtr_t *, int time);
 static int send_map_request_retry_cb(oor_timer_t *timer);
 static int build_and_send_encap_map_request(lisp_xtr_t *xtr, lisp_addr_t *src_eid,
-        mcache_entry_t *mce, uint64_t nonce);
+        mcache_entry_t *mce, uint64_t nonce, lisp_addr_t *drloc);
 static int build_and_send_map_reg(lisp_xtr_t *, mapping_t *, map_server_elt *,
         uint64_t);
 int program_map_register_for_mapping(lisp_xtr_t *xtr, map_local_entry_t *mle);
 static int encap_map_register_cb(oor_timer_t *timer);
 int program_encap_map_reg_of_loct_for_map(lisp_xtr_t *xtr, map_local_entry_t *mle,
         locator_t *src_loct);
-static int rloc_probing(lisp_xtr_t *, mapping_t *, locator_t *loc, uint64_t nonce);
-static void program_rloc_probing(lisp_xtr_t *, mcache_entry_t *, locator_t *, int);
+static int rloc_probing(lisp_xtr_t *, rloc_probe_t *, uint64_t nonce);
+static void rloc_probing_reply(lisp_xtr_t *, rloc_probe_t *);
+static int rloc_probing_trigger(lisp_xtr_t *, locator_t *);
+static void rloc_probing_msgs_reset(lisp_xtr_t *);
+static void rloc_probing_del(lisp_xtr_t *, rloc_probe_t *);
+static void program_rloc_probing(lisp_xtr_t *, mcache_entry_t *, locator_t *);
 static void program_mce_rloc_probing(lisp_xtr_t *, mcache_entry_t *);
+static void unprogram_mce_rloc_probing(lisp_xtr_t *, mcache_entry_t *);
+static void rloc_probes_del(lisp_xtr_t *);
+static void tr_flush_rloc_flows(lisp_addr_t *rloc);
 static inline lisp_xtr_t *lisp_xtr_cast(oor_ctrl_dev_t *);
 int map_reply_fill_uconn(lisp_xtr_t *xtr, glist_t *itr_rlocs, uconn_t *uc);
 
@@ -71,17 +89,74 @@ static void proxy_etrs_dump(lisp_xtr_t *, int log_level);
 
 static fwd_info_t *tr_get_forwarding_entry(oor_ctrl_dev_t *,
         packet_tuple_t *);
+static int tr_queue_pending_pkt(oor_ctrl_dev_t *, packet_tuple_t *, lbuf_t *);
+static int tr_glean_mapping(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *,
+        uint32_t);
+static int tr_lsb_changed(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *,
+        uint32_t, uint32_t);
+static void tr_mcache_lsb_reset(mapping_t *map);
+static glist_t *tr_mcache_detach_pending_pkts(lisp_xtr_t *xtr,
+        mcache_entry_t *mce);
+static void tr_pending_pkts_flush(lisp_xtr_t *xtr, glist_t *pending,
+        lisp_addr_t *eid);
+static void miss_queue_stats_dump(lisp_xtr_t *xtr, int log_level);
+static uint32_t tr_mcache_entry_size(lisp_xtr_t *xtr, mcache_entry_t *mce);
+static int tr_mcache_make_room(lisp_xtr_t *xtr, uint32_t size);
+static int tr_mcache_revalidate(lisp_xtr_t *xtr, mcache_entry_t *mce, int delay);
+static int tr_mcache_restore_mapping(void *arg, mapping_t *m, uint32_t ttl);
+static int tr_mcache_snapshot_cb(oor_timer_t *timer);
+static void tr_mcache_snapshot_init(lisp_xtr_t *xtr);
+static int tr_miss_ring_init(lisp_xtr_t *xtr);
+static void tr_miss_ring_uninit(lisp_xtr_t *xtr);
+static int tr_miss_ring_post(lisp_xtr_t *xtr, lisp_addr_t *eid,
+        lisp_addr_t *src_eid, lbuf_t *pkt, uint32_t iid);
+static void mcache_miss_del(mcache_miss_t *miss);
+static miss_pending_t *tr_miss_pending_slot(lisp_xtr_t *xtr, lisp_addr_t *eid,
+        uint32_t *hash);
+static int tr_miss_install(lisp_xtr_t *xtr, mcache_miss_t *miss);
+static mcache_entry_t *tr_mcache_add_placeholder(lisp_xtr_t *xtr,
+        lisp_addr_t *eid, lisp_addr_t *src_eid);
+static int tr_mcache_queue_pkt(lisp_xtr_t *xtr, mcache_entry_t *mce,
+        lbuf_t *b, uint32_t iid);
+static int tr_miss_ring_recv(sock_t *sl);
+static int tr_miss_ring_timer_cb(oor_timer_t *timer);
+static void tr_miss_ring_process(lisp_xtr_t *xtr);
+static int tr_mreq_rate_take(lisp_xtr_t *xtr, map_resolver_state_t *mr);
+static int tr_mreq_backoff(int sent);
+static lisp_addr_t *tr_mreq_aggregate(lisp_xtr_t *xtr, lisp_addr_t *eid);
+static mreq_pending_t *tr_mreq_pending_take(lisp_xtr_t *xtr, lisp_addr_t *eid);
+static void tr_mreq_pending_complete(lisp_xtr_t *xtr, mreq_pending_t *p,
+        glist_t *eids);
+static void mreq_pending_del(mreq_pending_t *p);
 
 glist_t *get_local_locators_with_address(local_map_db_t *local_db, lisp_addr_t *addr);
 map_local_entry_t *get_map_loc_ent_containing_loct_ptr(local_map_db_t *local_db,
         locator_t *locator);
 glist_t *get_map_local_entry_to_smr(lisp_xtr_t *xtr);
 static lisp_addr_t * get_map_resolver(lisp_xtr_t *xtr);
+static map_resolver_state_t *tr_mr_select(lisp_xtr_t *xtr,
+        map_resolver_state_t *exclude);
+static map_resolver_state_t *tr_mr_reprobe_select(lisp_xtr_t *xtr,
+        map_resolver_state_t *exclude);
+static void tr_mreq_sent_add(lisp_xtr_t *xtr, glist_t *sent,
+        uint64_t nonce, map_resolver_state_t *mr);
+static void tr_mreq_sent_expire(lisp_xtr_t *xtr, glist_t *sent);
+static void tr_mreq_sent_reply(glist_t *sent, uint64_t nonce);
+static void tr_mr_hedge_schedule(lisp_xtr_t *xtr, lisp_addr_t *eid,
+        uint64_t nonce, map_resolver_state_t *mr);
+static int tr_mr_init(lisp_xtr_t *xtr);
+static void tr_mr_uninit(lisp_xtr_t *xtr);
+static int build_and_send_encap_mreq_batch(lisp_xtr_t *xtr,
+        mreq_batch_t *batch, uint64_t nonce, lisp_addr_t *drloc);
+static void tr_mreq_batch_add(lisp_xtr_t *xtr, lisp_addr_t *eid,
+        lisp_addr_t *src_eid, int delay, uint8_t smr_invoked);
+static int tr_recv_batch_map_reply(lisp_xtr_t *xtr, lbuf_t *b, uint64_t nonce,
+        int records, oor_timer_t *timer);
+static void tr_mreq_batch_init(lisp_xtr_t *xtr);
+static void tr_mreq_batch_uninit(lisp_xtr_t *xtr);
+static int tr_eid_covers(lisp_addr_t *pref, lisp_addr_t *eid);
 
 static int mapping_has_elp_with_l_bit(mapping_t *map);
-/* Funtions related to timer_rloc_probe_argument */
-timer_rloc_probe_argument *timer_rloc_probe_argument_new_init(mcache_entry_t *mce,
-        locator_t *locator);
 int xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status);
 int xtr_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name,
         lisp_addr_t *old_addr, lisp_addr_t *new_addr, uint8_t status);
@@ -89,7 +164,6 @@ int xtr_route_update(oor_ctrl_dev_t *dev, int command, char *iface_name ,
         lisp_addr_t *src_pref, lisp_addr_t *dst_pref, lisp_addr_t *gateway);
 int xtr_iface_event_signaling(lisp_xtr_t * xtr, iface_locators * if_loct);
 
-void timer_rloc_probe_argument_free(timer_rloc_probe_argument *timer_arg);
 /* Funtions related to timer_map_req_argument */
 timer_map_req_argument *timer_map_req_arg_new_init(mcache_entry_t *mce,
         lisp_addr_t *src_eid);
@@ -113,77 +187,76 @@ inline oor_encap_t tr_get_encap_type(lisp_xtr_t *tr)
     return (tr->encap_type);
 }
 
-/* Called when the timer associated with an EID entry expires. */
-static int
-mc_entry_expiration_timer_cb(oor_timer_t *timer)
+/*
+ * Called when the expiration of an EID entry is due. It is first checked a
+ * bit before the TTL ends: entries used recently are requested again and
+ * kept until the reply arrives or the grace period ends, so busy
+ * destinations don't go through a miss every TTL. Idle entries are removed
+ * when the TTL ends.
+ */
+static void
+mc_entry_expiration(lisp_xtr_t *xtr, mcache_entry_t *mce, time_t now)
 {
-    mcache_entry_t *mce = oor_timer_cb_argument(timer);
     mapping_t *map = mcache_entry_mapping(mce);
     lisp_addr_t *addr = mapping_eid(map);
-    lisp_xtr_t *xtr = oor_timer_owner(timer);
+
+    if (now < mce->expires){
+        if (mce->stale == FALSE && xtr->mcache_refresh_window > 0
+                && now - mce->last_used <= xtr->mcache_refresh_window){
+            OOR_LOG(LDBG_1,"Refreshing mapping of EID %s in use",
+                    lisp_addr_to_char(addr));
+            mce->stale = TRUE;
+            xtr->map_cache->stats.refreshed++;
+            mcache_expiry_schedule(xtr->map_cache, mce,
+                    mce->expires + MCACHE_REFRESH_GRACE);
+            tr_mcache_revalidate(xtr, mce, 0);
+        }else{
+            mcache_expiry_schedule(xtr->map_cache, mce, mce->expires);
+        }
+        return;
+    }
 
     OOR_LOG(LDBG_1,"Got expiration for EID %s", lisp_addr_to_char(addr));
+    xtr->map_cache->stats.expired++;
     tr_mcache_remove_entry(xtr, mce);
-    return(GOOD);
-}
-
-static void
-mc_entry_start_expiration_timer(lisp_xtr_t *xtr, mcache_entry_t *mce)
-{
-    /* Expiration cache timer */
-    oor_timer_t *timer;
-
-    timer = oor_timer_create(EXPIRE_MAP_CACHE_TIMER);
-    oor_timer_init(timer,xtr,mc_entry_expiration_timer_cb,mce,NULL,NULL);
-    htable_ptrs_timers_add(ptrs_to_timers_ht, mce, timer);
-
-    oor_timer_start(timer, mapping_ttl(mcache_entry_mapping(mce))*60);
-
-    OOR_LOG(LDBG_1,"The map cache entry of EID %s will expire in %d minutes.",
-            lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))),
-            mapping_ttl(mcache_entry_mapping(mce)));
 }
 
-/* Process a record from map-reply probe message */
+/* Process the entries whose expiration is due. At most
+ * MCACHE_EXPIRY_BUDGET per second, the rest wait for the next tick */
 static int
-handle_locator_probe_reply(lisp_xtr_t *xtr, mcache_entry_t *mce,
-        lisp_addr_t *probed_addr)
+mc_expiry_sweep_cb(oor_timer_t *timer)
 {
-    locator_t * loct = NULL;
-    mapping_t * map = NULL;
-
-    map = mcache_entry_mapping(mce);
-    loct = mapping_get_loct_with_addr(map, probed_addr);
-
+    lisp_xtr_t *xtr = oor_timer_owner(timer);
+    mcache_entry_t *mce;
+    time_t now = time(NULL);
+    int n = 0;
 
-    if (!loct){
-        OOR_LOG(LDBG_2,"Probed locator %s not part of the the mapping %s",
-                lisp_addr_to_char(probed_addr),
-                lisp_addr_to_char(mapping_eid(map)));
-        return (ERR_NO_EXIST);
+    while (n < MCACHE_EXPIRY_BUDGET
+            && (mce = mcache_expiry_next(xtr->map_cache, now)) != NULL){
+        mc_entry_expiration(xtr, mce, now);
+        n++;
     }
+    oor_timer_start(timer, 1);
+    return (GOOD);
+}
 
+/* Program the expiration of the entry in secs seconds, replacing the
+ * previous one. It is checked first at the refresh point */
+static void
+mc_entry_schedule_expiration(lisp_xtr_t *xtr, mcache_entry_t *mce, int secs)
+{
+    time_t now = time(NULL);
 
-    OOR_LOG(LDBG_1," Successfully probed RLOC %s of cache entry with EID %s",
-                lisp_addr_to_char(locator_addr(loct)),
-                lisp_addr_to_char(mapping_eid(map)));
-
-
-    if (loct->state == DOWN) {
-        loct->state = UP;
-
-        OOR_LOG(LDBG_1," Locator %s state changed to UP",
-                lisp_addr_to_char(locator_addr(loct)));
-
-        /* [re]Calculate forwarding info if status changed*/
-        xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm,mce);
+    mce->expires = now + secs;
+    if (secs >= MCACHE_REFRESH_MIN_TTL){
+        mcache_expiry_schedule(xtr->map_cache, mce,
+                now + secs * MCACHE_REFRESH_POINT / 100);
+    }else{
+        mcache_expiry_schedule(xtr->map_cache, mce, mce->expires);
     }
 
-    /* Reprogramming timers of rloc probing */
-    program_rloc_probing(xtr, mce, loct, xtr->probe_interval);
-
-    return (GOOD);
-
+    OOR_LOG(LDBG_1,"The map cache entry of EID %s will expire in %d seconds.",
+            lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))), secs);
 }
 
 static int
@@ -210,12 +283,24 @@ update_mcache_entry(lisp_xtr_t *xtr, mapping_t *recv_map)
 
     /* DISCARD all locator state */
     mapping_update_locators(map, mapping_locators_lists(recv_map));
+    mapping_set_ttl(map, mapping_ttl(recv_map));
 
     /* Update forwarding info */
     xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm,mce);
+    mcache_update_entry_size(xtr->map_cache, mce, tr_mcache_entry_size(xtr, mce));
 
     /* Reprogramming timers */
-    mc_entry_start_expiration_timer(xtr, mce);
+    mc_entry_schedule_expiration(xtr, mce,
+            mapping_ttl(mcache_entry_mapping(mce))*60);
+    if (mce->stale){
+        OOR_LOG(LDBG_1, "Mapping of EID %s confirmed", lisp_addr_to_char(eid));
+        mce->stale = FALSE;
+    }
+    if (mce->gleaned){
+        mce->gleaned = FALSE;
+        xtr->glean_entries--;
+    }
+    tr_mcache_lsb_reset(map);
 
     /* RLOC probing timer */
     program_mce_rloc_probing(xtr, mce);
@@ -223,18 +308,41 @@ update_mcache_entry(lisp_xtr_t *xtr, mapping_t *recv_map)
     return (GOOD);
 }
 
+/* The gleaned entry mce is removed when the mapping received for it has a
+ * wider EID prefix, rec_eid. Returns TRUE if it was removed */
+static int
+tr_mcache_unglean(lisp_xtr_t *xtr, mcache_entry_t *mce, lisp_addr_t *rec_eid)
+{
+    lisp_addr_t *eid;
+
+    if (!mce || !mce->gleaned){
+        return (FALSE);
+    }
+    eid = mapping_eid(mcache_entry_mapping(mce));
+    if (lisp_addr_cmp(eid, rec_eid) == 0 || !tr_eid_covers(rec_eid, eid)){
+        return (FALSE);
+    }
+    OOR_LOG(LDBG_1, "Gleaned mapping of EID %s replaced by the mapping of %s",
+            lisp_addr_to_char(eid), lisp_addr_to_char(rec_eid));
+    tr_mcache_remove_entry(xtr, mce);
+    return (TRUE);
+}
+
 static int
 tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
 {
     void *mrep_hdr;
     locator_t *probed;
-    lisp_addr_t *probed_addr;
-    mapping_t *m, *aux_m;
+    mapping_t *m;
     lbuf_t b;
     mcache_entry_t *mce;
     nonces_list_t *nonces_lst;
     oor_timer_t *timer;
     timer_map_req_argument *t_mr_arg;
+    glist_t *pending = NULL;
+    lisp_addr_t *pending_eid = NULL;
+    mreq_pending_t *mreq_p = NULL;
+    glist_t *reply_eids = NULL;
     int records,active_entry,i;
 
     /* local copy */
@@ -252,7 +360,12 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
     timer = nonces_list_timer(nonces_lst);
     /* If it is not a Map Reply Probe */
     if (!MREP_RLOC_PROBE(mrep_hdr)){
+        if (oor_timer_type(timer) == MAP_REQUEST_BATCH_TIMER){
+            return (tr_recv_batch_map_reply(xtr, &b, MREP_NONCE(mrep_hdr),
+                    MREP_REC_COUNT(mrep_hdr), timer));
+        }
         t_mr_arg = (timer_map_req_argument *)oor_timer_cb_argument(timer);
+        tr_mreq_sent_reply(t_mr_arg->sent, MREP_NONCE(mrep_hdr));
         /* We only accept one record except when the nonce is generated by a not active entry */
         mce = t_mr_arg->mce;
 
@@ -260,15 +373,23 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
         active_entry = mcache_entry_active(mce);
         if (!active_entry){
             records = MREP_REC_COUNT(mrep_hdr);
+            /* Packets waiting for the reply are sent once the new mapping
+             * is installed */
+            pending = tr_mcache_detach_pending_pkts(xtr, mce);
+            if (pending){
+                pending_eid = lisp_addr_clone(mapping_eid(mcache_entry_mapping(mce)));
+            }
+            /* Requests of close EIDs waiting for this reply are resolved
+             * once the new mappings are installed */
+            mreq_p = tr_mreq_pending_take(xtr, mapping_eid(mcache_entry_mapping(mce)));
+            reply_eids = glist_new_managed((glist_del_fct)lisp_addr_del);
             /* delete placeholder/dummy mapping inorder to install the new one */
             tr_mcache_remove_entry(xtr, mce);
             /* Timers are removed during the process of deleting the mce*/
             timer = NULL;
         }else{
-            if (MREP_REC_COUNT(mrep_hdr) >1){
-                OOR_LOG(LINF,"Received Map Reply with multiple records. Only first one will be processed");
-            }
-            records = 1;
+            /* Each record updates the entry of its EID */
+            records = MREP_REC_COUNT(mrep_hdr);
         }
 
         for (i = 0; i < records; i++) {
@@ -285,9 +406,22 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
             /* Mapping is NOT ACTIVE */
             if (!active_entry) {
                 /* DO NOT free mapping in this case */
-                tr_mcache_add_mapping(xtr, m);
+                if (tr_mcache_add_mapping(xtr, m) == GOOD){
+                    /* Copy: the entry may be evicted by the next records */
+                    glist_add(lisp_addr_clone(mapping_eid(m)), reply_eids);
+                }
                 /* Mapping is ACTIVE */
             } else {
+                /* A gleaned entry is replaced by the mapping that covers it */
+                if (tr_mcache_unglean(xtr, mce, mapping_eid(m))){
+                    /* Timers are removed during the process of deleting the mce*/
+                    mce = NULL;
+                    timer = NULL;
+                    if (mcache_lookup_exact(xtr->map_cache, mapping_eid(m)) == NULL){
+                        tr_mcache_add_mapping(xtr, m);
+                        continue;
+                    }
+                }
                 /* the reply might be for an active mapping (SMR)*/
                 update_mcache_entry(xtr, m);
                 mapping_del(m);
@@ -295,6 +429,14 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
 
             mcache_dump_db(xtr->map_cache, LDBG_3);
         }
+        if (pending){
+            tr_pending_pkts_flush(xtr, pending, pending_eid);
+            lisp_addr_del(pending_eid);
+        }
+        if (mreq_p){
+            tr_mreq_pending_complete(xtr, mreq_p, reply_eids);
+        }
+        glist_destroy(reply_eids);
     }else{
         if (MREP_REC_COUNT(mrep_hdr) >1){
             OOR_LOG(LDBG_1,"Received Map Reply Probe with multiple records. Only first one will be processed");
@@ -311,24 +453,17 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
                 goto err;
             }
 
-            if (probed != NULL){
-                probed_addr = locator_addr(probed);
-            }else{
-                probed_addr = &(udp_con->ra);
-            }
-
-            mce = mcache_lookup_exact(xtr->map_cache, mapping_eid(m));
-            if (!mce){
-                /* Check if the map reply probe is from a proxy */
-                mce = xtr->petrs;
-                aux_m = mcache_entry_mapping(mce);
-                if (lisp_addr_cmp(mapping_eid(m),mapping_eid(aux_m)) != 0){
-                    OOR_LOG(LDBG_2,"Received a non requested Map Reply probe");
-                    return (BAD);
-                }
+            if (oor_timer_type(timer) != RLOC_PROBING_TIMER){
+                OOR_LOG(LDBG_2,"Received a non requested Map Reply probe");
+                mapping_del(m);
+                return (BAD);
             }
 
-            handle_locator_probe_reply(xtr, mce, probed_addr);
+            /* Probes are per RLOC: the reply is valid for all the map cache
+             * entries that have it as locator, whatever the EID of the
+             * record. The timer is kept for the next probes */
+            rloc_probing_reply(xtr, oor_timer_cb_argument(timer));
+            timer = NULL;
 
             /* No need to free 'probed' since it's a pointer to a locator in
              * of m's */
@@ -344,6 +479,14 @@ tr_recv_map_reply(lisp_xtr_t *xtr, lbuf_t *buf, uconn_t *udp_con)
 err:
     locator_del(probed);
     mapping_del(m);
+    if (pending){
+        tr_pending_pkts_flush(xtr, pending, pending_eid);
+        lisp_addr_del(pending_eid);
+    }
+    if (mreq_p){
+        tr_mreq_pending_complete(xtr, mreq_p, reply_eids);
+    }
+    glist_destroy(reply_eids);
     return(BAD);
 }
 
@@ -362,6 +505,12 @@ tr_reply_to_smr(lisp_xtr_t *xtr, lisp_addr_t *src_eid, lisp_addr_t *req_eid)
         return(BAD);
     }
 
+    if (xtr->mreq_batch_records > 1){
+        tr_mreq_batch_add(xtr, mapping_eid(mcache_entry_mapping(mce)), src_eid,
+                0, TRUE);
+        return(GOOD);
+    }
+
     /* Creat timer responsible of retries */
     timer_arg = timer_map_req_arg_new_init(mce,src_eid);
     timer = oor_timer_with_nonce_new(SMR_INV_RETRY_TIMER, xtr, smr_invoked_map_request_cb,
@@ -811,39 +960,469 @@ tr_recv_map_notify(lisp_xtr_t *xtr, lbuf_t *buf)
 }
 
 
+/* Called from the data path, that may have several threads. Only the
+ * miss is posted: the placeholder entry, its timer and the Map-Request are
+ * created from the control loop. Until its placeholder is installed, the
+ * miss of an EID is posted once */
 int
 handle_map_cache_miss(lisp_xtr_t *xtr, lisp_addr_t *requested_eid,
         lisp_addr_t *src_eid)
+{
+    miss_pending_t *slot;
+    uint32_t hash;
+
+    slot = tr_miss_pending_slot(xtr, requested_eid, &hash);
+    if (__atomic_exchange_n(&slot->hash, hash, __ATOMIC_ACQ_REL) == hash){
+        return (GOOD);
+    }
+    __atomic_store_n(&slot->pkts, 0, __ATOMIC_RELAXED);
+
+    if (tr_miss_ring_post(xtr, requested_eid, src_eid, NULL, 0) != GOOD){
+        OOR_LOG(LDBG_1, "handle_map_cache_miss: Too many pending map cache "
+                "misses. Discarding miss of %s", lisp_addr_to_char(requested_eid));
+        __atomic_compare_exchange_n(&slot->hash, &hash, 0, FALSE,
+                __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        return (BAD);
+    }
+    return(GOOD);
+}
+
+/* Slot of the filter of pending misses for eid and the hash that
+ * identifies eid in it */
+static miss_pending_t *
+tr_miss_pending_slot(lisp_xtr_t *xtr, lisp_addr_t *eid, uint32_t *hash)
+{
+    lisp_addr_t *ip = lisp_addr_get_ip_addr(eid);
+    uint32_t h = 0;
+
+    if (ip){
+        h = ip_addr_hash(lisp_addr_ip(ip));
+    }
+    if (lisp_addr_is_iid(eid)){
+        h ^= lcaf_iid_get_iid(lisp_addr_get_lcaf(eid)) * 0x9E3779B1;
+    }
+    h *= 0x9E3779B1;
+    /* 0 is a free slot */
+    *hash = h ? h : 1;
+    return (&xtr->miss_pending[(h >> 16) % MISS_PENDING_SLOTS]);
+}
+
+/* Install a temporary, NOT active, map cache entry for eid with the timer
+ * of its Map-Requests */
+static mcache_entry_t *
+tr_mcache_add_placeholder(lisp_xtr_t *xtr, lisp_addr_t *eid,
+        lisp_addr_t *src_eid)
 {
     mcache_entry_t *mce = mcache_entry_new();
     mapping_t *m = NULL;
     oor_timer_t *timer;
     timer_map_req_argument *timer_arg;
 
-    /* Install temporary, NOT active, mapping in map_cache */
-    m = mapping_new_init(requested_eid);
+    m = mapping_new_init(eid);
     mcache_entry_init(mce, m);
     /* Precalculate routing information */
     if (xtr->fwd_policy->init_map_cache_policy_inf(xtr->fwd_policy_dev_parm,mce,
             xtr->fwd_policy->del_map_cache_policy_inf) != GOOD){
-        OOR_LOG(LWRN, "handle_map_cache_miss: Couldn't initiate routing info for map cache entry %s!. Discarding it.",
-                lisp_addr_to_char(requested_eid));
+        OOR_LOG(LWRN, "tr_mcache_add_placeholder: Couldn't initiate routing info for map cache entry %s!. Discarding it.",
+                lisp_addr_to_char(eid));
         mcache_entry_del(mce);
-        return(BAD);
+        return(NULL);
     }
 
-    if (mcache_add_entry(xtr->map_cache, requested_eid, mce) != GOOD) {
+    if (tr_mcache_make_room(xtr, tr_mcache_entry_size(xtr, mce)) != GOOD
+            || mcache_add_entry(xtr->map_cache, eid, mce) != GOOD) {
         OOR_LOG(LWRN, "Couln't install temporary map cache entry for %s!",
-                lisp_addr_to_char(requested_eid));
+                lisp_addr_to_char(eid));
         mcache_entry_del(mce);
-        return(BAD);
+        return(NULL);
     }
+    mcache_update_entry_size(xtr->map_cache, mce, tr_mcache_entry_size(xtr, mce));
     timer_arg = timer_map_req_arg_new_init(mce,src_eid);
     timer = oor_timer_with_nonce_new(MAP_REQUEST_RETRY_TIMER,xtr,send_map_request_retry_cb,
             timer_arg,(oor_timer_del_cb_arg_fn)timer_map_req_arg_free);
     htable_ptrs_timers_add(ptrs_to_timers_ht,mce,timer);
+    return (mce);
+}
+
+static void
+mcache_miss_del(mcache_miss_t *miss)
+{
+    lisp_addr_del(miss->eid);
+    if (miss->src_eid){
+        lisp_addr_del(miss->src_eid);
+    }
+    if (miss->pkt){
+        lbuf_del(miss->pkt);
+    }
+    free(miss);
+}
+
+/* Queue a map cache miss, or a packet waiting for it, to be resolved from
+ * the control loop. May be called concurrently by several data path
+ * threads */
+static int
+tr_miss_ring_post(lisp_xtr_t *xtr, lisp_addr_t *eid, lisp_addr_t *src_eid,
+        lbuf_t *pkt, uint32_t iid)
+{
+    mcache_miss_t *miss = xzalloc(sizeof(mcache_miss_t));
+
+    miss->eid = lisp_addr_clone(eid);
+    miss->src_eid = src_eid ? lisp_addr_clone(src_eid) : NULL;
+    miss->pkt = pkt ? lbuf_clone(pkt) : NULL;
+    miss->iid = iid;
+    if (mpsc_ring_enqueue(xtr->miss_ring, miss) != GOOD){
+        mcache_miss_del(miss);
+        __atomic_fetch_add(&xtr->miss_ring_stats.ring_full, 1, __ATOMIC_RELAXED);
+        return (BAD);
+    }
+    __atomic_fetch_add(&xtr->miss_ring_stats.posted, 1, __ATOMIC_RELAXED);
+
+    /* Wake up the control loop only if it has not been done since the last
+     * time it read the ring */
+    if (__atomic_exchange_n(&xtr->miss_doorbell, 1, __ATOMIC_ACQ_REL) == 0){
+        if (write(xtr->miss_fd[1], "", 1) != 1){
+            OOR_LOG(LDBG_1, "tr_miss_ring_post: Couldn't wake up the control "
+                    "loop: %s", strerror(errno));
+        }
+    }
+    return (GOOD);
+}
+
+/* Install the placeholder of a miss posted by the data path, unless the
+ * map cache already has an entry for its EID. Afterwards the data path
+ * finds the placeholder and may post the miss of the EID again */
+static int
+tr_miss_install(lisp_xtr_t *xtr, mcache_miss_t *miss)
+{
+    miss_pending_t *slot;
+    mcache_entry_t *mce;
+    uint32_t hash;
+
+    mce = mcache_lookup(xtr->map_cache, miss->eid);
+    if (!mce && miss->src_eid){
+        mce = tr_mcache_add_placeholder(xtr, miss->eid, miss->src_eid);
+    }
+    slot = tr_miss_pending_slot(xtr, miss->eid, &hash);
+    __atomic_compare_exchange_n(&slot->hash, &hash, 0, FALSE,
+            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    return (mce ? GOOD : BAD);
+}
+
+/* Send the Map-Request of a miss posted by the data path. Misses of EIDs
+ * without placeholder or that have already been requested are discarded
+ * (BAD). If a request for an EID of the same aggregate is in
+ * flight, the miss waits for its reply (ERR_EXIST) */
+static int
+tr_miss_send_map_request(lisp_xtr_t *xtr, lisp_addr_t *eid)
+{
+    mcache_entry_t *mce;
+    glist_t *timers;
+    oor_timer_t *timer;
+    mreq_pending_t *p;
+    lisp_addr_t *aggr;
+
+    mce = mcache_lookup_exact(xtr->map_cache, eid);
+    if (!mce || mcache_entry_active(mce) == ACTIVE){
+        return (BAD);
+    }
+    timers = htable_ptrs_timers_get_timers_of_type_from_obj(ptrs_to_timers_ht,
+            mce, MAP_REQUEST_RETRY_TIMER);
+    timer = glist_size(timers) > 0 ? glist_first_data(timers) : NULL;
+    glist_destroy(timers);
+    if (!timer || nonces_list_size(oor_timer_nonces(timer)) > 0){
+        return (BAD);
+    }
+
+    eid = mapping_eid(mcache_entry_mapping(mce));
+    aggr = tr_mreq_aggregate(xtr, eid);
+    if (aggr){
+        p = mdb_lookup_entry_exact(xtr->pending_mreqs, aggr);
+        if (p){
+            /* Wait for the reply of the request of a close EID */
+            OOR_LOG(LDBG_2, "Map-Request for %s waits for the one of %s",
+                    lisp_addr_to_char(eid), lisp_addr_to_char(p->eid));
+            glist_add_tail(lisp_addr_clone(eid), p->waiting);
+            lisp_addr_del(aggr);
+            return (ERR_EXIST);
+        }
+        p = xzalloc(sizeof(mreq_pending_t));
+        p->aggr = aggr;
+        p->eid = lisp_addr_clone(eid);
+        p->waiting = glist_new_managed((glist_del_fct)lisp_addr_del);
+        if (mdb_add_entry(xtr->pending_mreqs, p->aggr, p) != GOOD){
+            mreq_pending_del(p);
+        }
+    }
+    return (send_map_request_retry_cb(timer));
+}
+
+/* Resolve a batch of the misses posted by the data path. Remaining misses
+ * are processed in the next wake up or when the Map-Request rate allows
+ * it */
+static void
+tr_miss_ring_process(lisp_xtr_t *xtr)
+{
+    mcache_miss_t *miss;
+    mcache_entry_t *mce;
+    int n;
+
+    for (n = 0; n < MISS_RING_BATCH; n++){
+        if (token_bucket_available(&xtr->mreq_rate) == FALSE){
+            break;
+        }
+        miss = mpsc_ring_dequeue(xtr->miss_ring);
+        if (!miss){
+            return;
+        }
+        if (miss->pkt){
+            /* Packet that arrived before the placeholder was installed */
+            mce = mcache_lookup(xtr->map_cache, miss->eid);
+            if (mce && mcache_entry_active(mce) == NOT_ACTIVE){
+                tr_mcache_queue_pkt(xtr, mce, miss->pkt, miss->iid);
+            }
+        }else if (tr_miss_install(xtr, miss) != GOOD
+                || tr_miss_send_map_request(xtr, miss->eid) == BAD){
+            xtr->miss_ring_stats.duplicated++;
+        }
+        mcache_miss_del(miss);
+    }
+
+    if (mpsc_ring_count(xtr->miss_ring) == 0){
+        return;
+    }
+    if (n < MISS_RING_BATCH){
+        /* Wait until the rate allows more Map-Requests */
+        xtr->miss_ring_stats.deferred++;
+        oor_timer_start(xtr->miss_timer, 1);
+    }else if (__atomic_exchange_n(&xtr->miss_doorbell, 1, __ATOMIC_ACQ_REL) == 0){
+        /* Batch full: let other events be processed before the next one */
+        if (write(xtr->miss_fd[1], "", 1) != 1){
+            oor_timer_start(xtr->miss_timer, 1);
+        }
+    }
+}
+
+/* Consume a token of the global and of the Map-Resolver rate limiters.
+ * FALSE if any of them doesn't allow a new Map-Request */
+static int
+tr_mreq_rate_take(lisp_xtr_t *xtr, map_resolver_state_t *mr)
+{
+    if (token_bucket_available(&xtr->mreq_rate) == FALSE
+            || (mr && token_bucket_available(&mr->rate) == FALSE)){
+        return (FALSE);
+    }
+    token_bucket_take(&xtr->mreq_rate);
+    if (mr){
+        token_bucket_take(&mr->rate);
+    }
+    return (TRUE);
+}
+
+/* Seconds to wait for the reply of a Map-Request when 'sent' requests have
+ * already been sent for the same EID: exponential backoff plus up to 50%
+ * of random jitter so that retries of different EIDs don't synchronize */
+static int
+tr_mreq_backoff(int sent)
+{
+    int timeout = OOR_INITIAL_MRQ_TIMEOUT;
+
+    while (sent-- > 0 && timeout < OOR_MAX_MRQ_TIMEOUT){
+        timeout <<= 1;
+    }
+    if (timeout > OOR_MAX_MRQ_TIMEOUT){
+        timeout = OOR_MAX_MRQ_TIMEOUT;
+    }
+    return (timeout + random() % (timeout / 2 + 1));
+}
+
+/* Aggregate prefix used to coalesce the Map-Request of eid. NULL if
+ * coalescing is disabled for its AFI */
+static lisp_addr_t *
+tr_mreq_aggregate(lisp_xtr_t *xtr, lisp_addr_t *eid)
+{
+    lisp_addr_t *ip_pref, *aggr;
+    int plen;
+
+    ip_pref = lisp_addr_get_ip_pref_addr(eid);
+    if (!ip_pref){
+        return (NULL);
+    }
+    plen = (lisp_addr_ip_afi(ip_pref) == AF_INET) ? xtr->mreq_coalesce_v4
+            : xtr->mreq_coalesce_v6;
+    if (plen == 0 || plen >= lisp_addr_get_plen(ip_pref)){
+        return (NULL);
+    }
+    aggr = lisp_addr_clone(eid);
+    lisp_addr_set_plen(aggr, plen);
+    pref_conv_to_netw_pref(aggr);
+    return (aggr);
+}
+
+static void
+mreq_pending_del(mreq_pending_t *p)
+{
+    lisp_addr_del(p->aggr);
+    lisp_addr_del(p->eid);
+    glist_destroy(p->waiting);
+    free(p);
+}
+
+/* Take out of the pending requests trie the request in flight of eid */
+static mreq_pending_t *
+tr_mreq_pending_take(lisp_xtr_t *xtr, lisp_addr_t *eid)
+{
+    mreq_pending_t *p;
+    lisp_addr_t *aggr;
+
+    aggr = tr_mreq_aggregate(xtr, eid);
+    if (!aggr){
+        return (NULL);
+    }
+    p = mdb_lookup_entry_exact(xtr->pending_mreqs, aggr);
+    if (p && lisp_addr_cmp(p->eid, eid) == 0){
+        mdb_remove_entry(xtr->pending_mreqs, aggr);
+    }else{
+        p = NULL;
+    }
+    lisp_addr_del(aggr);
+    return (p);
+}
+
+/* TRUE if eid is included in the EID prefix pref */
+static int
+tr_eid_covers(lisp_addr_t *pref, lisp_addr_t *eid)
+{
+    lisp_addr_t *pref_ip, *eid_ip;
+
+    if (lisp_addr_is_iid(pref) != lisp_addr_is_iid(eid)){
+        return (FALSE);
+    }
+    if (lisp_addr_is_iid(pref) && lcaf_iid_get_iid(lisp_addr_get_lcaf(pref))
+            != lcaf_iid_get_iid(lisp_addr_get_lcaf(eid))){
+        return (FALSE);
+    }
+    pref_ip = lisp_addr_get_ip_pref_addr(pref);
+    eid_ip = lisp_addr_get_ip_pref_addr(eid);
+    if (!pref_ip || !eid_ip){
+        return (FALSE);
+    }
+    return (pref_is_prefix_b_part_of_a(pref_ip, eid_ip));
+}
+
+/* The request p is finished. Misses waiting for it whose EID is covered by
+ * one of the mappings received (eids) use that mapping without sending a
+ * Map-Request. The rest are posted again to send their own */
+static void
+tr_mreq_pending_complete(lisp_xtr_t *xtr, mreq_pending_t *p, glist_t *eids)
+{
+    glist_entry_t *it, *eid_it;
+    lisp_addr_t *eid;
+    mcache_entry_t *mce;
+    glist_t *pending;
+    int covered;
+
+    glist_for_each_entry(it, p->waiting){
+        eid = (lisp_addr_t *)glist_entry_data(it);
+        mce = mcache_lookup_exact(xtr->map_cache, eid);
+        if (!mce || mcache_entry_active(mce) == ACTIVE){
+            continue;
+        }
+        covered = FALSE;
+        if (eids){
+            glist_for_each_entry(eid_it, eids){
+                if (tr_eid_covers(glist_entry_data(eid_it), eid)){
+                    covered = TRUE;
+                    break;
+                }
+            }
+        }
+        if (covered){
+            OOR_LOG(LDBG_2, "Map-Request for %s not needed: covered by the "
+                    "reply for %s", lisp_addr_to_char(eid),
+                    lisp_addr_to_char(p->eid));
+            xtr->mreq_stats.coalesced++;
+            pending = tr_mcache_detach_pending_pkts(xtr, mce);
+            tr_mcache_remove_entry(xtr, mce);
+            if (pending){
+                tr_pending_pkts_flush(xtr, pending, eid);
+            }
+        }else if (tr_miss_ring_post(xtr, eid, NULL, NULL, 0) != GOOD){
+            tr_mcache_remove_entry(xtr, mce);
+        }
+    }
+    mreq_pending_del(p);
+}
+
+static int
+tr_miss_ring_recv(sock_t *sl)
+{
+    lisp_xtr_t *xtr = sl->arg;
+    char buf[16];
+
+    if (read(sl->fd, buf, sizeof(buf)) < 0){
+        OOR_LOG(LDBG_1, "tr_miss_ring_recv: Couldn't read wake up: %s",
+                strerror(errno));
+    }
+    /* Misses posted from now on ring again */
+    __atomic_store_n(&xtr->miss_doorbell, 0, __ATOMIC_RELEASE);
+    tr_miss_ring_process(xtr);
+    return (GOOD);
+}
+
+static int
+tr_miss_ring_timer_cb(oor_timer_t *timer)
+{
+    tr_miss_ring_process(oor_timer_owner(timer));
+    return (GOOD);
+}
+
+static int
+tr_miss_ring_init(lisp_xtr_t *xtr)
+{
+    xtr->miss_ring = mpsc_ring_new(MISS_RING_SIZE);
+    if (pipe(xtr->miss_fd) != 0){
+        OOR_LOG(LERR, "tr_miss_ring_init: Couldn't create pipe: %s",
+                strerror(errno));
+        xtr->miss_fd[0] = xtr->miss_fd[1] = -1;
+        return (BAD);
+    }
+    /* The data path never blocks when waking up the control loop */
+    fcntl(xtr->miss_fd[1], F_SETFL, fcntl(xtr->miss_fd[1], F_GETFL) | O_NONBLOCK);
+    fcntl(xtr->miss_fd[0], F_SETFL, fcntl(xtr->miss_fd[0], F_GETFL) | O_NONBLOCK);
+    xtr->miss_sock = sockmstr_register_read_listener(smaster, tr_miss_ring_recv,
+            xtr, xtr->miss_fd[0]);
+    xtr->miss_timer = oor_timer_create(MAP_CACHE_MISS_TIMER);
+    oor_timer_init(xtr->miss_timer, xtr, tr_miss_ring_timer_cb, xtr, NULL, NULL);
+    return (GOOD);
+}
 
-    return(send_map_request_retry_cb(timer));
+static void
+tr_miss_ring_uninit(lisp_xtr_t *xtr)
+{
+    miss_ring_stats_t *st = &xtr->miss_ring_stats;
+    mreq_stats_t *mst = &xtr->mreq_stats;
+
+    if (st->posted > 0 || st->ring_full > 0){
+        OOR_LOG(LDBG_1, "Map cache misses: %"PRIu64" posted, %"PRIu64
+                " discarded (ring full), %"PRIu64" already requested, %"PRIu64
+                " times deferred", st->posted, st->ring_full, st->duplicated,
+                st->deferred);
+        OOR_LOG(LDBG_1, "Map-Requests: %"PRIu64" sent, %"PRIu64
+                " retransmissions, %"PRIu64" suppressed by rate limit, %"PRIu64
+                " coalesced, %"PRIu64" records in multi-record requests",
+                mst->sent, mst->retransmitted, mst->suppressed, mst->coalesced,
+                mst->batched);
+    }
+    oor_timer_stop(xtr->miss_timer);
+    if (xtr->miss_sock){
+        sockmstr_unregister_read_listenedr(smaster, xtr->miss_sock);
+    }else if (xtr->miss_fd[0] != -1){
+        close(xtr->miss_fd[0]);
+    }
+    if (xtr->miss_fd[1] != -1){
+        close(xtr->miss_fd[1]);
+    }
+    mpsc_ring_del(xtr->miss_ring, (void (*)(void *))mcache_miss_del);
 }
 
 static glist_t *
@@ -1122,24 +1701,72 @@ send_map_request_retry_cb(oor_timer_t *timer)
     timer_map_req_argument *timer_arg = (timer_map_req_argument *)oor_timer_cb_argument(timer);
     nonces_list_t *nonces_list = oor_timer_nonces(timer);
     lisp_xtr_t *xtr = oor_timer_owner(timer);
+    map_resolver_state_t *mr, *rmr;
     uint64_t nonce;
     lisp_addr_t *deid;
-    int retries = nonces_list_size(nonces_list);
+    /* Hedged requests don't count as retries */
+    int retries = nonces_list_size(nonces_list) - timer_arg->hedged;
 
     deid = mapping_eid (mcache_entry_mapping(timer_arg->mce));
+    /* Requests not answered in time are losses of their Map-Resolver */
+    tr_mreq_sent_expire(xtr, timer_arg->sent);
     if (retries - 1 < xtr->map_request_retries) {
+        mr = tr_mr_select(xtr, NULL);
+        /* Try again later without consuming a retry */
+        if (tr_mreq_rate_take(xtr, mr) == FALSE){
+            OOR_LOG(LDBG_2, "Map-Request rate exceeded. Delaying Map-Request "
+                    "for EID %s", lisp_addr_to_char(deid));
+            xtr->mreq_stats.suppressed++;
+            oor_timer_start(timer, 1);
+            return (GOOD);
+        }
 
         if (retries > 0) {
             OOR_LOG(LDBG_1, "Retransmitting Map Request for EID: %s (%d retries)",
                     lisp_addr_to_char(deid), retries);
+            xtr->mreq_stats.retransmitted++;
         }
         nonce = nonce_new();
-        if (build_and_send_encap_map_request(xtr, timer_arg->src_eid, timer_arg->mce, nonce) != GOOD){
-            return (BAD);
+        if (!mr || build_and_send_encap_map_request(xtr, timer_arg->src_eid,
+                timer_arg->mce, nonce, mr->addr) != GOOD){
+            /* Counted as a retry so the entry is removed if the problem
+             * persists */
+            OOR_LOG(LDBG_1, "Couldn't send Map Request for EID: %s",
+                    lisp_addr_to_char(deid));
+        }else{
+            xtr->mreq_stats.sent++;
+            tr_mreq_sent_add(xtr, timer_arg->sent, nonce, mr);
+            /* Only the first request of a miss is hedged. Retries go to
+             * the best Map-Resolver at that time */
+            if (xtr->mr_hedging && retries == 0
+                    && mcache_entry_active(timer_arg->mce) == NOT_ACTIVE){
+                tr_mr_hedge_schedule(xtr, deid, nonce, mr);
+            }
         }
         htable_nonces_insert(nonces_ht, nonce, nonces_list);
-        oor_timer_start(timer, OOR_INITIAL_MRQ_TIMEOUT);
+
+        /* A copy to a demoted Map-Resolver checks if it has recovered */
+        rmr = mr ? tr_mr_reprobe_select(xtr, mr) : NULL;
+        if (rmr && tr_mreq_rate_take(xtr, rmr) == TRUE){
+            nonce = nonce_new();
+            if (build_and_send_encap_map_request(xtr, timer_arg->src_eid,
+                    timer_arg->mce, nonce, rmr->addr) == GOOD){
+                htable_nonces_insert(nonces_ht, nonce, nonces_list);
+                timer_arg->hedged++;
+                rmr->hedged++;
+                xtr->mreq_stats.sent++;
+                tr_mreq_sent_add(xtr, timer_arg->sent, nonce, rmr);
+            }
+        }
+        oor_timer_start(timer, tr_mreq_backoff(retries));
         return (GOOD);
+    } else if (timer_arg->mce->stale){
+        /* Restored and refreshed mappings are still used until they expire */
+        OOR_LOG(LDBG_1, "No Map-Reply for EID %s after %d retries. Keeping "
+                "its mapping until it expires", lisp_addr_to_char(deid),
+                retries -1 );
+        stop_timer_from_obj(timer_arg->mce, timer, ptrs_to_timers_ht, nonces_ht);
+        return (BAD);
     } else {
         OOR_LOG(LDBG_1, "No Map-Reply for EID %s after %d retries. Aborting!",
                 lisp_addr_to_char(deid), retries -1 );
@@ -1151,15 +1778,15 @@ send_map_request_retry_cb(oor_timer_t *timer)
 }
 
 
-/* Sends Encap Map-Request for EID in 'mce' and sets-up a retry timer */
+/* Sends Encap Map-Request for EID in 'mce' to the Map-Resolver drloc */
 static int
 build_and_send_encap_map_request(lisp_xtr_t *xtr, lisp_addr_t *seid,
-        mcache_entry_t *mce, uint64_t nonce)
+        mcache_entry_t *mce, uint64_t nonce, lisp_addr_t *drloc)
 {
     uconn_t uc;
     mapping_t *m = NULL;
     lisp_addr_t *deid = NULL;
-    lisp_addr_t *drloc, *srloc;
+    lisp_addr_t *srloc;
     glist_t *rlocs = NULL;
     lbuf_t *b = NULL;
     void *mr_hdr = NULL;
@@ -1197,12 +1824,6 @@ build_and_send_encap_map_request(lisp_xtr_t *xtr, lisp_addr_t *seid,
     lisp_msg_encap(b, LISP_CONTROL_PORT, LISP_CONTROL_PORT, seid, deid);
 
     srloc = NULL;
-    drloc = get_map_resolver(xtr);
-    if (!drloc){
-        lisp_msg_destroy(b);
-        return (BAD);
-    }
-
     uconn_init(&uc, LISP_CONTROL_PORT, LISP_CONTROL_PORT, srloc, drloc);
     send_msg(&xtr->super, b, &uc);
 
@@ -1211,6 +1832,59 @@ build_and_send_encap_map_request(lisp_xtr_t *xtr, lisp_addr_t *seid,
     return(GOOD);
 }
 
+/* Sends an Encap Map-Request with one record for each EID of the batch */
+static int
+build_and_send_encap_mreq_batch(lisp_xtr_t *xtr, mreq_batch_t *batch,
+        uint64_t nonce, lisp_addr_t *drloc)
+{
+    uconn_t uc;
+    lisp_addr_t *deid, *s_in_addr;
+    glist_t *rlocs;
+    lbuf_t *b;
+    void *mr_hdr;
+
+    deid = (lisp_addr_t *)glist_first_data(batch->eids);
+    rlocs = ctrl_default_rlocs(xtr->super.ctrl);
+    b = lisp_msg_mreq_create_multi(batch->src_eid, rlocs, batch->eids);
+    if (b == NULL) {
+        OOR_LOG(LDBG_1, "build_and_send_encap_mreq_batch: Couldn't create map request message");
+        glist_destroy(rlocs);
+        return(BAD);
+    }
+
+    mr_hdr = lisp_msg_hdr(b);
+    MREQ_SMR_INVOKED(mr_hdr) = batch->smr_invoked;
+    MREQ_NONCE(mr_hdr) = nonce;
+    OOR_LOG(LDBG_1, "%s, itr-rlocs:%s, src-eid: %s, req-eids: %s and %d more",
+            lisp_msg_hdr_to_char(b), laddr_list_to_char(rlocs),
+            lisp_addr_to_char(batch->src_eid), lisp_addr_to_char(deid),
+            glist_size(batch->eids) - 1);
+    glist_destroy(rlocs);
+
+    /* The source EID of SMR-invoked requests is the one of the SMR */
+    s_in_addr = batch->src_eid;
+    if (batch->smr_invoked){
+        s_in_addr = local_map_db_get_main_eid(xtr->local_mdb,
+                lisp_addr_ip_afi(deid));
+        if (s_in_addr == NULL){
+            s_in_addr = ctrl_default_rloc(lisp_ctrl_dev_get_ctrl_t(&(xtr->super)),
+                    lisp_addr_ip_afi(deid));
+        }
+        if (s_in_addr == NULL){
+            lisp_msg_destroy(b);
+            return(BAD);
+        }
+    }
+    lisp_msg_encap(b, LISP_CONTROL_PORT, LISP_CONTROL_PORT, s_in_addr, deid);
+
+    uconn_init(&uc, LISP_CONTROL_PORT, LISP_CONTROL_PORT, NULL, drloc);
+    send_msg(&xtr->super, b, &uc);
+
+    lisp_msg_destroy(b);
+
+    return(GOOD);
+}
+
 /* build and send generic map-register with one record
  * for each map server */
 static int
@@ -1634,34 +2308,196 @@ program_initial_info_request_process(lisp_xtr_t *xtr)
     return(GOOD);
 }
 
+/* Probing interval of an RLOC with a random jitter of up to
+ * RLOC_PROBING_JITTER percent, so the probes of RLOCs programmed at the same
+ * time don't stay synchronized */
+static int
+rloc_probing_interval(lisp_xtr_t *xtr)
+{
+    int jitter = xtr->probe_interval * RLOC_PROBING_JITTER / 100;
+
+    if (jitter == 0){
+        return (xtr->probe_interval);
+    }
+    return (xtr->probe_interval - jitter + random() % (2 * jitter + 1));
+}
+
+/* Set the state of the locators probed by rp in all the map cache entries
+ * that have them and [re]calculate the forwarding info of the ones that
+ * changed. Returns the number of entries changed */
+static int
+rloc_probing_set_state(lisp_xtr_t *xtr, rloc_probe_t *rp, int state)
+{
+    mcache_entry_t *mce;
+    mapping_t *map;
+    locator_t *loct;
+    lisp_addr_t *drloc;
+    khiter_t k;
+    int changed, count = 0;
+
+    for (k = kh_begin(rp->mces); k != kh_end(rp->mces); ++k){
+        if (!kh_exist(rp->mces, k)){
+            continue;
+        }
+        mce = kh_key(rp->mces, k);
+        map = mcache_entry_mapping(mce);
+        changed = FALSE;
+        mapping_foreach_active_locator(map, loct){
+            if (locator_state(loct) == state){
+                continue;
+            }
+            drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loct),
+                    ctrl_rlocs(xtr->super.ctrl));
+            if (drloc && lisp_addr_cmp(drloc, &rp->addr) == 0){
+                locator_set_state(loct, state);
+                changed = TRUE;
+            }
+        }mapping_foreach_active_locator_end;
+        if (changed){
+            xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm, mce);
+            count++;
+        }
+    }
+    if (count > 0 && state == DOWN){
+        tr_flush_rloc_flows(&rp->addr);
+    }
+    return (count);
+}
+
+/* Pass the RTT and loss of the path to the RLOC of rp to the forwarding
+ * policy. The entries using it are recalculated if the policy asks for it */
+static void
+rloc_probing_metrics(lisp_xtr_t *xtr, rloc_probe_t *rp)
+{
+    khiter_t k;
+
+    if (xtr->fwd_policy->updated_rloc_metrics == NULL
+            || !xtr->fwd_policy->updated_rloc_metrics(xtr->fwd_policy_dev_parm,
+                    &rp->addr, &rp->rtt)){
+        return;
+    }
+    for (k = kh_begin(rp->mces); k != kh_end(rp->mces); ++k){
+        if (kh_exist(rp->mces, k)){
+            xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm,
+                    kh_key(rp->mces, k));
+        }
+    }
+}
+
+/* Map-Request probe for rp. It is encoded once, with the EID of one of the
+ * entries that have the RLOC, and copied for each probe */
+static lbuf_t *
+rloc_probing_msg(lisp_xtr_t *xtr, rloc_probe_t *rp, uint64_t nonce)
+{
+    lisp_addr_t empty;
+    glist_t *rlocs;
+    lbuf_t *b;
+    khiter_t k;
+
+    if (!rp->tmpl){
+        for (k = kh_begin(rp->mces); k != kh_end(rp->mces); ++k){
+            if (kh_exist(rp->mces, k)){
+                break;
+            }
+        }
+        if (k == kh_end(rp->mces)){
+            return (NULL);
+        }
+        rp->tmpl_eid = lisp_addr_clone(
+                mapping_eid(mcache_entry_mapping(kh_key(rp->mces, k))));
+        lisp_addr_set_lafi(&empty, LM_AFI_NO_ADDR);
+        rlocs = ctrl_default_rlocs(xtr->super.ctrl);
+        rp->tmpl = lisp_msg_mreq_create(&empty, rlocs, rp->tmpl_eid);
+        glist_destroy(rlocs);
+        if (rp->tmpl == NULL){
+            lisp_addr_del(rp->tmpl_eid);
+            rp->tmpl_eid = NULL;
+            return (NULL);
+        }
+        MREQ_RLOC_PROBE(lisp_msg_hdr(rp->tmpl)) = 1;
+    }
+
+    b = lisp_msg_create_buf();
+    lbuf_put(b, lbuf_data(rp->tmpl), lbuf_size(rp->tmpl));
+    MREQ_NONCE(lisp_msg_hdr(b)) = nonce;
+    return (b);
+}
+
+/* Drop the probe template of rp. It is encoded again for the next probe */
+static void
+rloc_probing_msg_reset(rloc_probe_t *rp)
+{
+    if (!rp->tmpl){
+        return;
+    }
+    lisp_msg_destroy(rp->tmpl);
+    lisp_addr_del(rp->tmpl_eid);
+    rp->tmpl = NULL;
+    rp->tmpl_eid = NULL;
+}
+
 static int
 rloc_probing_cb(oor_timer_t *timer)
 {
-    timer_rloc_probe_argument *rparg = oor_timer_cb_argument(timer);
+    rloc_probe_t *rp = oor_timer_cb_argument(timer);
     nonces_list_t *nonces_lst = oor_timer_nonces(timer);
     lisp_xtr_t *xtr = oor_timer_owner(timer);
-    mapping_t *map = mcache_entry_mapping(rparg->mce);
-    locator_t *loct = rparg->locator;
-    lisp_addr_t * drloc;
+    lisp_addr_t *drloc = &rp->addr;
     uint64_t nonce;
-    mcache_entry_t * mce;
+    echo_nonce_state_e en_state;
+    int count;
 
-    // XXX alopez -> What we have to do with ELP and probe bit
-    drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loct), ctrl_rlocs(xtr->super.ctrl));
+    /* The previous probe was not answered */
+    if (nonces_list_size(nonces_lst) > 0){
+        rtt_stats_add_loss(&rp->rtt);
+        rloc_probing_metrics(xtr, rp);
+    }
+
+    /* Before starting a new round of probes, check what the data packets
+     * exchanged with the locator since the last one say about it */
+    if (echo_nonces && nonces_list_size(nonces_lst) == 0){
+        en_state = echo_nonce_rloc_state(echo_nonces, lisp_addr_ip(drloc),
+                time(NULL) - xtr->probe_interval);
+        if (en_state == ECHO_NONCE_UP){
+            count = rloc_probing_set_state(xtr, rp, UP);
+            if (count > 0) {
+                OOR_LOG(LDBG_1,"rloc_probing: Nonce echoed by locator %s -> "
+                        "Locator state changes to UP in %d map cache entries",
+                        lisp_addr_to_char(drloc), count);
+            }
+            oor_timer_start(timer, rloc_probing_interval(xtr));
+            OOR_LOG(LDBG_2,"rloc_probing: Locator %s echoes nonces. Probe "
+                    "skipped", lisp_addr_to_char(drloc));
+            return (GOOD);
+        }
+        /* Only locators that have echoed nonces before are reported DOWN.
+         * The ones that never echo are left to the probes */
+        if (en_state == ECHO_NONCE_DOWN){
+            rtt_stats_add_loss(&rp->rtt);
+            rloc_probing_metrics(xtr, rp);
+            /* Stop using it now. The probes decide if it comes back */
+            count = rloc_probing_set_state(xtr, rp, DOWN);
+            if (count > 0) {
+                OOR_LOG(LDBG_1,"rloc_probing: Nonce not echoed by locator %s "
+                        "-> Locator state changes to DOWN in %d map cache "
+                        "entries", lisp_addr_to_char(drloc), count);
+            }
+        }
+    }
 
     if ((nonces_list_size(nonces_lst) -1) < xtr->probe_retries){
         nonce = nonce_new();
-        if (rloc_probing(xtr, map,loct,nonce) != GOOD){
-                   return (BAD);
+        if (rloc_probing(xtr, rp, nonce) != GOOD){
+            oor_timer_start(timer, rloc_probing_interval(xtr));
+            return (BAD);
         }
         if (nonces_list_size(nonces_lst) > 0) {
-            OOR_LOG(LDBG_1,"Retry Map-Request Probe for locator %s and "
-                    "EID: %s (%d retries)", lisp_addr_to_char(drloc),
-                    lisp_addr_to_char(mapping_eid(map)), nonces_list_size(nonces_lst));
+            OOR_LOG(LDBG_1,"Retry Map-Request Probe for locator %s (%d "
+                    "retries)", lisp_addr_to_char(drloc),
+                    nonces_list_size(nonces_lst));
         } else {
-            OOR_LOG(LDBG_1,"Map-Request Probe for locator %s and "
-                    "EID: %s", lisp_addr_to_char(drloc),
-                    lisp_addr_to_char(mapping_eid(map)));
+            OOR_LOG(LDBG_1,"Map-Request Probe for locator %s (%d map cache "
+                    "entries)", lisp_addr_to_char(drloc), kh_size(rp->mces));
         }
         htable_nonces_insert(nonces_ht, nonce,nonces_lst);
         oor_timer_start(timer, xtr->probe_retries_interval);
@@ -1669,95 +2505,242 @@ rloc_probing_cb(oor_timer_t *timer)
     }else{
         /* If we have reached maximum number of retransmissions, change remote
          *  locator status */
-        if (locator_state(loct) == UP) {
-            locator_set_state(loct, DOWN);
-            OOR_LOG(LDBG_1,"rloc_probing: No Map-Reply Probe received for locator"
-                    " %s and EID: %s -> Locator state changes to DOWN",
-                    lisp_addr_to_char(drloc), lisp_addr_to_char(mapping_eid(map)));
-
-            /* [re]Calculate forwarding info  if it has been a change
-             * of status*/
-            mce = mcache_lookup_exact(xtr->map_cache,mapping_eid(map));
-            if (mce == NULL){
-                /* It is a PeTR RLOC */
-                if ( mcache_entry_mapping(xtr->petrs) != map ){
-                    OOR_LOG(LERR,"rloc_probing: No map cache entry for EID %s. It should never happend",
-                            lisp_addr_to_char(mapping_eid(map)));
-                    return (BAD);
-                }
-                mce = xtr->petrs;
-            }
-
-            xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm,mce);
+        count = rloc_probing_set_state(xtr, rp, DOWN);
+        if (count > 0) {
+            OOR_LOG(LDBG_1,"rloc_probing: No Map-Reply Probe received for "
+                    "locator %s -> Locator state changes to DOWN in %d map "
+                    "cache entries", lisp_addr_to_char(drloc), count);
         }
 
         /* Reprogram time for next probe interval */
         htable_nonces_reset_nonces_lst(nonces_ht,nonces_lst);
-        oor_timer_start(timer, xtr->probe_interval);
-        OOR_LOG(LDBG_2,"Reprogramed RLOC probing of the locator %s of the EID %s "
-                "in %d seconds", lisp_addr_to_char(drloc),
-                lisp_addr_to_char(mapping_eid(map)), xtr->probe_interval);
+        oor_timer_start(timer, rloc_probing_interval(xtr));
+        OOR_LOG(LDBG_2,"Reprogramed RLOC probing of the locator %s in %d "
+                "seconds", lisp_addr_to_char(drloc), xtr->probe_interval);
 
         return (BAD);
     }
 }
 
-/* Send a Map-Request probe to check status of 'loc'. If the number of
- * retries without answer is higher than rloc_probe_retries. Change the status
- * of the 'loc' to down */
+/* Send a Map-Request probe to check the status of the RLOC of rp. If the
+ * number of retries without answer is higher than rloc_probe_retries, the
+ * status of the locators is changed to down */
 static int
-rloc_probing(lisp_xtr_t *xtr, mapping_t *map, locator_t *loc, uint64_t nonce)
+rloc_probing(lisp_xtr_t *xtr, rloc_probe_t *rp, uint64_t nonce)
 {
     uconn_t uc;
-    lisp_addr_t * deid = NULL;
-    lisp_addr_t * drloc = NULL;
-    lisp_addr_t empty;
     lbuf_t * b = NULL;
-    glist_t * rlocs = NULL;
-    void * hdr = NULL;
     int ret;
 
-    deid = mapping_eid(map);
-
-    // XXX alopez -> What we have to do with ELP and probe bit
-    drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loc), ctrl_rlocs(xtr->super.ctrl));
-    lisp_addr_set_lafi(&empty, LM_AFI_NO_ADDR);
-
-    rlocs = ctrl_default_rlocs(xtr->super.ctrl);
-    b = lisp_msg_mreq_create(&empty, rlocs, deid);
-    glist_destroy(rlocs);
+    b = rloc_probing_msg(xtr, rp, nonce);
     if (b == NULL){
         return (BAD);
     }
 
-    hdr = lisp_msg_hdr(b);
-    MREQ_NONCE(hdr) = nonce;
-    MREQ_RLOC_PROBE(hdr) = 1;
-
-    uconn_init(&uc, LISP_CONTROL_PORT, LISP_CONTROL_PORT, NULL, drloc);
+    uconn_init(&uc, LISP_CONTROL_PORT, LISP_CONTROL_PORT, NULL, &rp->addr);
     ret = send_msg(&xtr->super, b, &uc);
     lisp_msg_destroy(b);
+    clock_gettime(CLOCK_MONOTONIC, &rp->sent);
 
     return (ret);
 }
 
+/* The probe of rp was answered: its locators are up in all the entries */
 static void
-program_rloc_probing(lisp_xtr_t *xtr, mcache_entry_t *mce, locator_t *loc, int time)
+rloc_probing_reply(lisp_xtr_t *xtr, rloc_probe_t *rp)
 {
-    oor_timer_t *timer;
-    timer_rloc_probe_argument *arg;
+    lisp_addr_t *laddr;
+    int count;
 
+    OOR_LOG(LDBG_1," Successfully probed RLOC %s (%d map cache entries)",
+            lisp_addr_to_char(&rp->addr), kh_size(rp->mces));
 
-    arg = timer_rloc_probe_argument_new_init(mce,loc);
-    timer = oor_timer_with_nonce_new(RLOC_PROBING_TIMER,xtr,rloc_probing_cb,
-            arg,(oor_timer_del_cb_arg_fn)timer_rloc_probe_argument_free);
-    htable_ptrs_timers_add(ptrs_to_timers_ht, mce, timer);
+    /* A failed echo of a nonce is no longer relevant */
+    if (echo_nonces){
+        echo_nonce_rloc_reset(echo_nonces, lisp_addr_ip(&rp->addr));
+    }
+
+    count = rloc_probing_set_state(xtr, rp, UP);
+    if (count > 0){
+        OOR_LOG(LDBG_1," Locator %s state changed to UP in %d map cache "
+                "entries", lisp_addr_to_char(&rp->addr), count);
+    }
+
+    /* The RTT is measured from the last probe sent. If the probes now leave
+     * from another local RLOC, it is a different path */
+    laddr = ctrl_default_rloc(xtr->super.ctrl, lisp_addr_ip_afi(&rp->addr));
+    if (laddr && lisp_addr_cmp(laddr, &rp->laddr) != 0){
+        rtt_stats_init(&rp->rtt);
+        lisp_addr_copy(&rp->laddr, laddr);
+    }
+    rtt_stats_add_sample(&rp->rtt, rtt_elapsed_ms(&rp->sent));
+    rloc_probing_metrics(xtr, rp);
+
+    /* Reprogramming timers of rloc probing */
+    htable_nonces_reset_nonces_lst(nonces_ht, oor_timer_nonces(rp->timer));
+    oor_timer_start(rp->timer, rloc_probing_interval(xtr));
+}
+
+static rloc_probe_t *
+rloc_probing_lookup(lisp_xtr_t *xtr, lisp_addr_t *drloc)
+{
+    khiter_t k;
+
+    k = kh_get(rloc_probe, xtr->rloc_probes, lisp_addr_ip(drloc));
+    if (k == kh_end(xtr->rloc_probes)){
+        return (NULL);
+    }
+    return (kh_value(xtr->rloc_probes, k));
+}
+
+static void
+rloc_probing_del(lisp_xtr_t *xtr, rloc_probe_t *rp)
+{
+    khiter_t k;
+
+    k = kh_get(rloc_probe, xtr->rloc_probes, lisp_addr_ip(&rp->addr));
+    if (k != kh_end(xtr->rloc_probes)){
+        kh_del(rloc_probe, xtr->rloc_probes, k);
+    }
+    stop_timers_from_obj(rp, ptrs_to_timers_ht, nonces_ht);
+    rloc_probing_msg_reset(rp);
+    if (xtr->fwd_policy->updated_rloc_metrics){
+        xtr->fwd_policy->updated_rloc_metrics(xtr->fwd_policy_dev_parm,
+                &rp->addr, NULL);
+    }
+    kh_destroy(mce_set, rp->mces);
+    free(rp);
+}
+
+/* Add mce to the entries covered by the probes of the RLOC of its locator
+ * loc. The probes of a new RLOC start after a random part of the interval */
+static void
+program_rloc_probing(lisp_xtr_t *xtr, mcache_entry_t *mce, locator_t *loc)
+{
+    rloc_probe_t *rp;
+    lisp_addr_t *drloc;
+    khiter_t k;
+    int ret;
+
+    // XXX alopez -> What we have to do with ELP and probe bit
+    drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loc), ctrl_rlocs(xtr->super.ctrl));
+    if (!drloc || lisp_addr_lafi(drloc) != LM_AFI_IP){
+        return;
+    }
+
+    rp = rloc_probing_lookup(xtr, drloc);
+    if (!rp){
+        rp = xzalloc(sizeof(rloc_probe_t));
+        lisp_addr_copy(&rp->addr, drloc);
+        rp->mces = kh_init(mce_set);
+        rp->timer = oor_timer_with_nonce_new(RLOC_PROBING_TIMER, xtr,
+                rloc_probing_cb, rp, NULL);
+        htable_ptrs_timers_add(ptrs_to_timers_ht, rp, rp->timer);
+        k = kh_put(rloc_probe, xtr->rloc_probes, lisp_addr_ip(&rp->addr), &ret);
+        kh_value(xtr->rloc_probes, k) = rp;
+        oor_timer_start(rp->timer, 1 + random() % xtr->probe_interval);
+        OOR_LOG(LDBG_2,"Programming probing of locator %s",
+                lisp_addr_to_char(drloc));
+    }
+
+    kh_put(mce_set, rp->mces, mce, &ret);
+    if (!mce->probed_rlocs){
+        mce->probed_rlocs = glist_new();
+    }
+    /* It may be already covered through another locator */
+    if (!glist_contain(rp, mce->probed_rlocs)){
+        glist_add(rp, mce->probed_rlocs);
+    }
+}
+
+/* Remove mce from the probes of the RLOCs in probed_rlocs except the ones
+ * in keep. The probes of the RLOCs no other entry has are stopped */
+static void
+rloc_probing_unregister(lisp_xtr_t *xtr, mcache_entry_t *mce,
+        glist_t *probed_rlocs, glist_t *keep)
+{
+    glist_entry_t *it;
+    rloc_probe_t *rp;
+    khiter_t k;
+
+    glist_for_each_entry(it, probed_rlocs){
+        rp = (rloc_probe_t *)glist_entry_data(it);
+        if (keep && glist_contain(rp, keep)){
+            continue;
+        }
+        k = kh_get(mce_set, rp->mces, mce);
+        if (k != kh_end(rp->mces)){
+            kh_del(mce_set, rp->mces, k);
+        }
+        if (kh_size(rp->mces) == 0){
+            OOR_LOG(LDBG_2,"Stopping probing of locator %s",
+                    lisp_addr_to_char(&rp->addr));
+            rloc_probing_del(xtr, rp);
+        }else if (rp->tmpl_eid && lisp_addr_cmp(rp->tmpl_eid,
+                mapping_eid(mcache_entry_mapping(mce))) == 0){
+            rloc_probing_msg_reset(rp);
+        }
+    }
+}
+
+/* Remove mce from the probes of its RLOCs */
+static void
+unprogram_mce_rloc_probing(lisp_xtr_t *xtr, mcache_entry_t *mce)
+{
+    if (!mce->probed_rlocs){
+        return;
+    }
+    rloc_probing_unregister(xtr, mce, mce->probed_rlocs, NULL);
+    glist_destroy(mce->probed_rlocs);
+    mce->probed_rlocs = NULL;
+}
+
+/* Probe now the RLOC of the locator loc unless it is already being probed.
+ * BAD if RLOC probing is not used */
+static int
+rloc_probing_trigger(lisp_xtr_t *xtr, locator_t *loc)
+{
+    rloc_probe_t *rp;
+    lisp_addr_t *drloc;
+
+    drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loc), ctrl_rlocs(xtr->super.ctrl));
+    if (!drloc || lisp_addr_lafi(drloc) != LM_AFI_IP){
+        return (BAD);
+    }
+    rp = rloc_probing_lookup(xtr, drloc);
+    if (!rp){
+        return (BAD);
+    }
+    if (nonces_list_size(oor_timer_nonces(rp->timer)) == 0){
+        oor_timer_start(rp->timer, 1);
+    }
+    return (GOOD);
+}
+
+/* The probe templates are encoded again with the current local RLOCs */
+static void
+rloc_probing_msgs_reset(lisp_xtr_t *xtr)
+{
+    khiter_t k;
 
-    oor_timer_start(timer, time);
-    OOR_LOG(LDBG_2,"Programming probing of EID's %s locator %s (%d seconds)",
-            lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))),
-            lisp_addr_to_char(locator_addr(loc)), time);
+    for (k = kh_begin(xtr->rloc_probes); k != kh_end(xtr->rloc_probes); ++k){
+        if (kh_exist(xtr->rloc_probes, k)){
+            rloc_probing_msg_reset(kh_value(xtr->rloc_probes, k));
+        }
+    }
+}
+
+static void
+rloc_probes_del(lisp_xtr_t *xtr)
+{
+    khiter_t k;
 
+    for (k = kh_begin(xtr->rloc_probes); k != kh_end(xtr->rloc_probes); ++k){
+        if (kh_exist(xtr->rloc_probes, k)){
+            rloc_probing_del(xtr, kh_value(xtr->rloc_probes, k));
+        }
+    }
+    kh_destroy(rloc_probe, xtr->rloc_probes);
 }
 
 /* Program RLOC probing for each locator of the mapping */
@@ -1766,19 +2749,27 @@ program_mce_rloc_probing(lisp_xtr_t *xtr, mcache_entry_t *mce)
 {
 	mapping_t *map;
     locator_t *locator;
+    glist_t *prev_rlocs;
 
     if (xtr->probe_interval == 0) {
         return;
     }
-    /* Cancel previous RLOCs Probing associated to this mce */
-    stop_timers_of_type_from_obj(mce,RLOC_PROBING_TIMER,ptrs_to_timers_ht, nonces_ht);
+    /* Locators may have changed. The probes of the RLOCs that remain go on
+     * as they were */
+    prev_rlocs = mce->probed_rlocs;
+    mce->probed_rlocs = NULL;
 
     map = mcache_entry_mapping(mce);
-    /* Start rloc probing for each locator of the mapping */
+    /* Add the entry to the probing of each locator of the mapping */
     mapping_foreach_active_locator(map,locator){
     		// XXX alopez: Check if RLOB probing available for all LCAF. ELP RLOC Probing bit
-    		program_rloc_probing(xtr, mce, locator, xtr->probe_interval);
+    		program_rloc_probing(xtr, mce, locator);
     }mapping_foreach_active_locator_end;
+
+    if (prev_rlocs){
+        rloc_probing_unregister(xtr, mce, prev_rlocs, mce->probed_rlocs);
+        glist_destroy(prev_rlocs);
+    }
 }
 
 
@@ -1803,17 +2794,21 @@ tr_mcache_add_mapping(lisp_xtr_t *xtr, mapping_t *m)
         return(BAD);
     }
 
-    if (mcache_add_entry(xtr->map_cache, mapping_eid(m), mce) != GOOD) {
+    if (tr_mcache_make_room(xtr, tr_mcache_entry_size(xtr, mce)) != GOOD
+            || mcache_add_entry(xtr->map_cache, mapping_eid(m), mce) != GOOD) {
         OOR_LOG(LDBG_1, "tr_mcache_add_mapping: Couldn't add map cache entry %s to data base!. Discarding it.",
                 lisp_addr_to_char(mapping_eid(m)));
         mcache_entry_del(mce);
         return(BAD);
     }
+    mcache_update_entry_size(xtr->map_cache, mce, tr_mcache_entry_size(xtr, mce));
 
     mcache_entry_set_active(mce, ACTIVE);
 
     /* Reprogramming timers */
-    mc_entry_start_expiration_timer(xtr, mce);
+    mc_entry_schedule_expiration(xtr, mce,
+            mapping_ttl(mcache_entry_mapping(mce))*60);
+    tr_mcache_lsb_reset(m);
 
     /* RLOC probing timer */
     program_mce_rloc_probing(xtr, mce);
@@ -1852,11 +2847,107 @@ tr_mcache_add_static_mapping(lisp_xtr_t *xtr, mapping_t *m)
     return(GOOD);
 }
 
+/* Take the packets waiting for the Map-Reply of mce out of the entry and
+ * release the space they were using from the global budget */
+static glist_t *
+tr_mcache_detach_pending_pkts(lisp_xtr_t *xtr, mcache_entry_t *mce)
+{
+    xtr->miss_queue_used_bytes -= mce->pending_bytes;
+    return (mcache_entry_detach_pending_pkts(mce));
+}
+
+/* Send the packets that were waiting for the mapping of eid. They are
+ * dropped if the Map-Reply didn't provide locators for it */
+static void
+tr_pending_pkts_flush(lisp_xtr_t *xtr, glist_t *pending, lisp_addr_t *eid)
+{
+    mcache_entry_t *mce;
+    mce_pending_pkt_t *pkt;
+    glist_entry_t *it;
+
+    mce = mcache_lookup(xtr->map_cache, eid);
+    if (!mce || mcache_entry_active(mce) == NOT_ACTIVE
+            || mcache_has_locators(mce) == FALSE
+            || data_plane->datap_send_pending_packet == NULL){
+        OOR_LOG(LDBG_2, "No locators for EID %s. Dropping %d packets waiting "
+                "for its mapping", lisp_addr_to_char(eid), glist_size(pending));
+        xtr->miss_queue_stats.dropped_negative += glist_size(pending);
+        glist_destroy(pending);
+        return;
+    }
+
+    OOR_LOG(LDBG_2, "Sending %d packets that were waiting for the mapping of "
+            "EID %s", glist_size(pending), lisp_addr_to_char(eid));
+    glist_for_each_entry(it, pending){
+        pkt = (mce_pending_pkt_t *)glist_entry_data(it);
+        data_plane->datap_send_pending_packet(pkt->b, pkt->iid);
+        xtr->miss_queue_stats.flushed++;
+    }
+    glist_destroy(pending);
+}
+
+/* Memory accounted for a map cache entry, including its routing info */
+static uint32_t
+tr_mcache_entry_size(lisp_xtr_t *xtr, mcache_entry_t *mce)
+{
+    uint32_t size = mcache_entry_mem_size(mce);
+
+    if (mce->routing_info != NULL && xtr->fwd_policy->map_cache_policy_inf_size){
+        size += xtr->fwd_policy->map_cache_policy_inf_size(mce->routing_info);
+    }
+    return (size);
+}
+
+/* Evict dynamic entries until a new one of size bytes fits in the limits of
+ * the map cache. Evicted entries follow the same path as expired ones */
+static int
+tr_mcache_make_room(lisp_xtr_t *xtr, uint32_t size)
+{
+    mcache_entry_t *mce;
+
+    while (mcache_is_full(xtr->map_cache, size)){
+        mce = mcache_evict_candidate(xtr->map_cache);
+        if (!mce){
+            /* The new entry alone exceeds the memory limit */
+            return (BAD);
+        }
+        OOR_LOG(LDBG_1, "Map cache full. Evicting entry of EID %s (%u hits)",
+                lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))),
+                mce->hits);
+        xtr->map_cache->stats.evicted++;
+        tr_mcache_remove_entry(xtr, mce);
+    }
+    return (GOOD);
+}
+
 int
 tr_mcache_remove_entry(lisp_xtr_t *xtr, mcache_entry_t *mce)
 {
     void *data = NULL;
     lisp_addr_t *eid = mapping_eid(mcache_entry_mapping(mce));
+    glist_t *pending;
+    mreq_pending_t *mreq_p;
+
+    /* Entry removed before receiving a Map-Reply */
+    pending = tr_mcache_detach_pending_pkts(xtr, mce);
+    if (pending){
+        OOR_LOG(LDBG_2, "Dropping %d packets waiting for the mapping of EID %s",
+                glist_size(pending), lisp_addr_to_char(eid));
+        xtr->miss_queue_stats.dropped_timeout += glist_size(pending);
+        glist_destroy(pending);
+    }
+    /* Requests of close EIDs waiting for this one send their own */
+    if (mcache_entry_active(mce) == NOT_ACTIVE){
+        mreq_p = tr_mreq_pending_take(xtr, eid);
+        if (mreq_p){
+            tr_mreq_pending_complete(xtr, mreq_p, NULL);
+        }
+    }
+
+    if (mce->gleaned){
+        xtr->glean_entries--;
+    }
+    unprogram_mce_rloc_probing(xtr, mce);
 
     data = mcache_remove_entry(xtr->map_cache, eid);
     mcache_entry_del(data);
@@ -1893,39 +2984,142 @@ tr_mcache_lookup_mapping_exact(lisp_xtr_t *xtr, lisp_addr_t *laddr)
         return (mcache_entry_mapping(mce));
     }
 }
-int
-xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
+
+/* Send a Map-Request for an active entry in delay seconds, or right away
+ * with 0. The reply updates the entry. With batching, the request is
+ * grouped with the ones of other entries due in the same second */
+static int
+tr_mcache_revalidate(lisp_xtr_t *xtr, mcache_entry_t *mce, int delay)
 {
-    lisp_xtr_t * xtr = lisp_xtr_cast(dev);
-    iface_locators * if_loct = NULL;
-    locator_t * locator = NULL;
-    map_local_entry_t * map_loc_e = NULL;
-    glist_entry_t * it = NULL;
-    glist_entry_t * it_m = NULL;
+    lisp_addr_t *eid = mapping_eid(mcache_entry_mapping(mce));
+    lisp_addr_t *src_eid;
+    oor_timer_t *timer;
+    timer_map_req_argument *timer_arg;
+    int afi = lisp_addr_ip_afi(eid);
 
-    if_loct = (iface_locators *)shash_lookup(xtr->iface_locators_table,iface_name);
-    if (if_loct  == NULL){
-        OOR_LOG(LDBG_2, "xtr_if_status_change: Iface %s not found in the list of ifaces for xTR device",
-                iface_name);
-        return (BAD);
-    }
-    /* Change the status of the affected locators */
-    glist_for_each_entry(it,if_loct->ipv4_locators){
-        locator = (locator_t *)glist_entry_data(it);
-        locator_set_state(locator,status);
+    src_eid = local_map_db_get_main_eid(xtr->local_mdb, afi);
+    if (src_eid == NULL){
+        src_eid = ctrl_default_rloc(lisp_ctrl_dev_get_ctrl_t(&(xtr->super)), afi);
+        if (src_eid == NULL){
+            return (BAD);
+        }
     }
-    glist_for_each_entry(it,if_loct->ipv6_locators){
-        locator = (locator_t *)glist_entry_data(it);
-        locator_set_state(locator,status);
+
+    if (xtr->mreq_batch_records > 1){
+        tr_mreq_batch_add(xtr, eid, src_eid, delay, FALSE);
+        return (GOOD);
     }
 
-    /* Transition check */
-    if (if_loct->status_changed == TRUE){
-        if_loct->status_changed = FALSE;
+    timer_arg = timer_map_req_arg_new_init(mce, src_eid);
+    timer = oor_timer_with_nonce_new(MAP_REQUEST_RETRY_TIMER, xtr,
+            send_map_request_retry_cb, timer_arg,
+            (oor_timer_del_cb_arg_fn)timer_map_req_arg_free);
+    htable_ptrs_timers_add(ptrs_to_timers_ht, mce, timer);
+    if (delay == 0){
+        send_map_request_retry_cb(timer);
     }else{
-        if_loct->status_changed = TRUE;
+        oor_timer_start(timer, delay);
     }
-    /* Recalculate forwarding info of the affected mappings */
+    return (GOOD);
+}
+
+/*
+ * Install a mapping read from the map cache snapshot. It is used right away
+ * but marked as stale: it is kept for a short time unless the Map-Request
+ * sent to revalidate it gets a reply. Requests are spread over time to avoid
+ * a burst towards the Map-Resolvers.
+ */
+static int
+tr_mcache_restore_mapping(void *arg, mapping_t *m, uint32_t ttl)
+{
+    lisp_xtr_t *xtr = arg;
+    lisp_addr_t *eid = mapping_eid(m);
+    mcache_entry_t *mce;
+    int delay;
+
+    /* Configured static entries have preference */
+    if (mcache_lookup_exact(xtr->map_cache, eid) != NULL){
+        mapping_del(m);
+        return (BAD);
+    }
+    if (tr_mcache_add_mapping(xtr, m) != GOOD){
+        return (BAD);
+    }
+    mce = mcache_lookup_exact(xtr->map_cache, eid);
+    mce->stale = TRUE;
+
+    delay = 1 + xtr->map_cache->entries / MCACHE_REVALIDATE_RATE;
+    mc_entry_schedule_expiration(xtr, mce, MIN(ttl, delay + MCACHE_STALE_TTL));
+    if (tr_mcache_revalidate(xtr, mce, delay) != GOOD){
+        OOR_LOG(LDBG_1, "Couldn't program the Map-Request to revalidate the "
+                "mapping of EID %s", lisp_addr_to_char(eid));
+    }
+    return (GOOD);
+}
+
+static int
+tr_mcache_snapshot_cb(oor_timer_t *timer)
+{
+    lisp_xtr_t *xtr = oor_timer_owner(timer);
+
+    mcache_snapshot_save(xtr->map_cache, xtr->mcache_snapshot_file);
+    oor_timer_start(timer, xtr->mcache_snapshot_interval);
+    return (GOOD);
+}
+
+/* Restore the map cache from the last snapshot and save it periodically */
+static void
+tr_mcache_snapshot_init(lisp_xtr_t *xtr)
+{
+    if (xtr->mcache_snapshot_file == NULL){
+        return;
+    }
+    if (xtr->nat_aware == FALSE){
+        mcache_snapshot_load(xtr->mcache_snapshot_file,
+                tr_mcache_restore_mapping, xtr);
+    }
+    if (xtr->mcache_snapshot_interval > 0){
+        xtr->mcache_snapshot_timer = oor_timer_create(MAP_CACHE_SNAPSHOT_TIMER);
+        oor_timer_init(xtr->mcache_snapshot_timer, xtr, tr_mcache_snapshot_cb,
+                xtr, NULL, NULL);
+        oor_timer_start(xtr->mcache_snapshot_timer,
+                xtr->mcache_snapshot_interval);
+    }
+}
+
+int
+xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
+{
+    lisp_xtr_t * xtr = lisp_xtr_cast(dev);
+    iface_locators * if_loct = NULL;
+    locator_t * locator = NULL;
+    map_local_entry_t * map_loc_e = NULL;
+    glist_entry_t * it = NULL;
+    glist_entry_t * it_m = NULL;
+
+    if_loct = (iface_locators *)shash_lookup(xtr->iface_locators_table,iface_name);
+    if (if_loct  == NULL){
+        OOR_LOG(LDBG_2, "xtr_if_status_change: Iface %s not found in the list of ifaces for xTR device",
+                iface_name);
+        return (BAD);
+    }
+    /* Change the status of the affected locators */
+    glist_for_each_entry(it,if_loct->ipv4_locators){
+        locator = (locator_t *)glist_entry_data(it);
+        locator_set_state(locator,status);
+    }
+    glist_for_each_entry(it,if_loct->ipv6_locators){
+        locator = (locator_t *)glist_entry_data(it);
+        locator_set_state(locator,status);
+    }
+
+    /* Transition check */
+    if (if_loct->status_changed == TRUE){
+        if_loct->status_changed = FALSE;
+    }else{
+        if_loct->status_changed = TRUE;
+    }
+    /* Recalculate forwarding info of the affected mappings */
     glist_for_each_entry(it_m, if_loct->map_loc_entries){
         map_loc_e = (map_local_entry_t *)glist_entry_data(it_m);
         xtr->fwd_policy->updated_map_loc_inf(xtr->fwd_policy_dev_parm,map_loc_e);
@@ -1935,6 +3129,19 @@ xtr_if_link_update(oor_ctrl_dev_t *dev, char *iface_name, uint8_t status)
         xtr->fwd_policy->updated_map_loc_inf(xtr->fwd_policy_dev_parm,xtr->all_locs_map);
     }
 
+    /* Move now the flows of the locators of the interface to the remaining
+     * ones. When it comes back, flows use it again as they time out */
+    if (status == DOWN){
+        glist_for_each_entry(it,if_loct->ipv4_locators){
+            locator = (locator_t *)glist_entry_data(it);
+            tr_flush_rloc_flows(locator_addr(locator));
+        }
+        glist_for_each_entry(it,if_loct->ipv6_locators){
+            locator = (locator_t *)glist_entry_data(it);
+            tr_flush_rloc_flows(locator_addr(locator));
+        }
+    }
+
     xtr_iface_event_signaling(xtr, if_loct);
 
     return (GOOD);
@@ -2038,6 +3245,11 @@ xtr_if_addr_update(oor_ctrl_dev_t *dev, char *iface_name, lisp_addr_t *old_addr,
         xtr->fwd_policy->updated_map_loc_inf(xtr->fwd_policy_dev_parm,xtr->all_locs_map);
     }
 
+    /* The flows encapsulated with the old address can't be sent anymore */
+    if (old_addr != NULL){
+        tr_flush_rloc_flows(old_addr);
+    }
+
     xtr_iface_event_signaling(xtr, if_loct);
 
     return (GOOD);
@@ -2066,6 +3278,8 @@ xtr_iface_event_signaling(lisp_xtr_t * xtr, iface_locators * if_loct)
     mapping_t *map;
     oor_timer_t *timer;
 
+    /* The ITR-RLOCs of the RLOC probes may have changed */
+    rloc_probing_msgs_reset(xtr);
 
     if(xtr->nat_aware == TRUE){
         if (glist_size(if_loct->ipv4_locators) == 0){
@@ -2220,6 +3434,30 @@ xtr_ctrl_construct(oor_ctrl_dev_t *dev)
     xtr->petrs = mcache_entry_new();
     xtr->rtrs = mcache_entry_new();
     xtr->iface_locators_table = shash_new_managed((free_value_fn_t)iface_locators_del);
+    xtr->miss_queue_len = DEFAULT_MISS_QUEUE_LEN;
+    xtr->miss_queue_bytes = DEFAULT_MISS_QUEUE_BYTES;
+    token_bucket_init(&xtr->mreq_rate, DEFAULT_MREQ_RATE, DEFAULT_MREQ_RATE);
+    xtr->mreq_mr_rate = DEFAULT_MR_MREQ_RATE;
+    xtr->mreq_coalesce_v4 = DEFAULT_MREQ_COALESCE_V4;
+    xtr->mreq_coalesce_v6 = DEFAULT_MREQ_COALESCE_V6;
+    xtr->pending_mreqs = mdb_new();
+    xtr->mcache_snapshot_interval = DEFAULT_MCACHE_SNAPSHOT_INTERVAL;
+    xtr->mcache_refresh_window = DEFAULT_MCACHE_REFRESH_WINDOW;
+    xtr->mcache_expiry_timer = oor_timer_create(EXPIRE_MAP_CACHE_TIMER);
+    oor_timer_init(xtr->mcache_expiry_timer, xtr, mc_expiry_sweep_cb, xtr,
+            NULL, NULL);
+    oor_timer_start(xtr->mcache_expiry_timer, 1);
+    tr_mreq_batch_init(xtr);
+    xtr->glean_ttl = DEFAULT_GLEAN_TTL;
+    xtr->glean_mask_v4 = 32;
+    xtr->glean_mask_v6 = 128;
+    xtr->glean_max_entries = DEFAULT_GLEAN_MAX_ENTRIES;
+    token_bucket_init(&xtr->glean_rate, DEFAULT_GLEAN_RATE, DEFAULT_GLEAN_RATE);
+    xtr->glean_prefixes = glist_new_managed((glist_del_fct)lisp_addr_del);
+    xtr->rloc_probes = kh_init(rloc_probe);
+    if (tr_miss_ring_init(xtr) != GOOD || tr_mr_init(xtr) != GOOD){
+        return(BAD);
+    }
 
     if (!xtr->local_mdb || !xtr->map_cache || !xtr->map_servers ||
             !xtr->map_resolvers || !xtr->pitrs || !xtr->petrs ||
@@ -2250,15 +3488,32 @@ xtr_ctrl_destruct(oor_ctrl_dev_t *dev)
         ctrl_unregister_eid_prefix(dev,map_local_entry_eid(map_loc_e));
     } local_map_db_foreach_end;
 
+    /* Before the map cache, the probes point to its entries, and before the
+     * forwarding policy, it is told about the RLOCs not probed anymore */
+    rloc_probes_del(xtr);
     if (xtr->fwd_policy_dev_parm != NULL){
         xtr->fwd_policy->del_dev_policy_inf(xtr->fwd_policy_dev_parm);
     }
 
+    miss_queue_stats_dump(xtr, LDBG_1);
+    mcache_stats_dump(xtr->map_cache, LDBG_1);
+    if (xtr->mcache_snapshot_file != NULL){
+        oor_timer_stop(xtr->mcache_snapshot_timer);
+        mcache_snapshot_save(xtr->map_cache, xtr->mcache_snapshot_file);
+        free(xtr->mcache_snapshot_file);
+    }
+    tr_miss_ring_uninit(xtr);
+    tr_mreq_batch_uninit(xtr);
+    oor_timer_stop(xtr->mcache_expiry_timer);
+    glist_destroy(xtr->glean_prefixes);
+    mdb_del(xtr->pending_mreqs, (mdb_del_fct)mreq_pending_del);
     shash_destroy(xtr->iface_locators_table);
     mcache_del(xtr->map_cache);
     mcache_entry_del(xtr->petrs);
     mcache_entry_del(xtr->rtrs);
     local_map_db_del(xtr->local_mdb);
+    /* After the map cache: Map-Requests in flight point to the states */
+    tr_mr_uninit(xtr);
     glist_destroy(xtr->map_resolvers);
     glist_destroy(xtr->pitrs);
     glist_destroy(xtr->map_servers);
@@ -2439,6 +3694,7 @@ xtr_ctrl_run(oor_ctrl_dev_t *dev)
     } else if (xtr->super.mode == RTR_MODE) {
         rtr_run(xtr);
     }
+    tr_mcache_snapshot_init(xtr);
 
 }
 
@@ -2453,7 +3709,10 @@ ctrl_dev_class_t xtr_ctrl_class = {
         .if_link_update = xtr_if_link_update,
         .if_addr_update = xtr_if_addr_update,
         .route_update = xtr_route_update,
-        .get_fwd_entry = tr_get_forwarding_entry
+        .get_fwd_entry = tr_get_forwarding_entry,
+        .queue_pending_pkt = tr_queue_pending_pkt,
+        .glean_mapping = tr_glean_mapping,
+        .lsb_changed = tr_lsb_changed
 };
 
 
@@ -2538,6 +3797,24 @@ map_servers_dump(lisp_xtr_t *xtr, int log_level)
 //    }
 //
 
+/* Locator-Status-Bits of map: bit i is set if its i-th locator, in the
+ * order of its Map-Replies, is up */
+static uint32_t
+tr_mapping_lsb(mapping_t *map)
+{
+    locator_t *loct;
+    uint32_t lsb = 0;
+    int i = 0;
+
+    mapping_foreach_active_locator(map, loct){
+        if (i < 32 && locator_state(loct) == UP){
+            lsb |= (1u << i);
+        }
+        i++;
+    }mapping_foreach_active_locator_end;
+    return (lsb);
+}
+
 static fwd_info_t *
 tr_get_fwd_entry(lisp_xtr_t *xtr, packet_tuple_t *tuple)
 {
@@ -2586,6 +3863,9 @@ tr_get_fwd_entry(lisp_xtr_t *xtr, packet_tuple_t *tuple)
         mce = xtr->rtrs;
     }else{
         mce = mcache_lookup(xtr->map_cache, dst_eid);
+        if (mce){
+            mcache_touch_entry(xtr->map_cache, mce);
+        }
     }
     if (!mce) {
         /* No map cache entry, initiate map cache miss process */
@@ -2708,6 +3988,11 @@ tr_get_fwd_entry(lisp_xtr_t *xtr, packet_tuple_t *tuple)
     }
     /* Assign encapsulated that should be used */
     fwd_info->encap = xtr->encap_type;
+    if (fwd_info->fwd_info && fwd_info->encap == ENCP_LISP
+            && (xtr->super.mode == xTR_MODE || xtr->super.mode == MN_MODE)){
+        fwd_info->lsb_set = TRUE;
+        fwd_info->lsb = tr_mapping_lsb(map_local_entry_mapping(map_loc_e));
+    }
     lisp_addr_del(src_eid);
     lisp_addr_del(dst_eid);
     return (fwd_info);
@@ -2724,6 +4009,285 @@ tr_get_forwarding_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
     return(tr_get_fwd_entry(xtr, tuple));
 }
 
+/* Hold a copy of a packet of a flow whose temporal forwarding entry was
+ * obtained while the Map-Request of its destination is outstanding. If
+ * the placeholder of the miss is not installed yet, the packet follows the
+ * miss through the ring */
+static int
+tr_queue_pending_pkt(oor_ctrl_dev_t *dev, packet_tuple_t *tuple, lbuf_t *b)
+{
+    lisp_xtr_t *xtr;
+    map_local_entry_t *map_loc_e;
+    mcache_entry_t *mce;
+    miss_pending_t *slot;
+    lisp_addr_t *eid, *dst_eid;
+    uint32_t iid, hash;
+    int iidmlen, ret;
+
+    xtr = lisp_xtr_cast(dev);
+    if (xtr->miss_queue_len == 0 || xtr->nat_aware){
+        return (BAD);
+    }
+
+    /* Obtain the destination EID as in tr_get_fwd_entry */
+    iid = tuple->iid;
+    if (xtr->super.mode == xTR_MODE || xtr->super.mode == MN_MODE) {
+        map_loc_e = local_map_db_lookup_eid(xtr->local_mdb, &tuple->src_addr, FALSE);
+        if (map_loc_e == NULL){
+            return (BAD);
+        }
+        eid = map_local_entry_eid(map_loc_e);
+        iid = lisp_addr_is_iid(eid) ? lcaf_iid_get_iid(lisp_addr_get_lcaf(eid)) : 0;
+    }
+    if (iid > 0){
+        iidmlen = (lisp_addr_ip_afi(&tuple->dst_addr) == AF_INET) ? 32: 128;
+        dst_eid = lisp_addr_new_init_iid(iid, &tuple->dst_addr, iidmlen);
+    }else{
+        dst_eid = lisp_addr_clone(&tuple->dst_addr);
+    }
+    mce = mcache_lookup(xtr->map_cache, dst_eid);
+    if (!mce){
+        slot = tr_miss_pending_slot(xtr, dst_eid, &hash);
+        ret = BAD;
+        if (__atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE) == hash
+                && __atomic_fetch_add(&slot->pkts, 1, __ATOMIC_RELAXED)
+                        < (uint32_t)xtr->miss_queue_len){
+            ret = tr_miss_ring_post(xtr, dst_eid, NULL, b, tuple->iid);
+        }
+        lisp_addr_del(dst_eid);
+        return (ret);
+    }
+    lisp_addr_del(dst_eid);
+
+    if (mcache_entry_active(mce) == ACTIVE){
+        return (BAD);
+    }
+    return (tr_mcache_queue_pkt(xtr, mce, b, tuple->iid));
+}
+
+/* Keep a copy of b in the placeholder mce within the limits of the queue
+ * of packets waiting for a Map-Reply */
+static int
+tr_mcache_queue_pkt(lisp_xtr_t *xtr, mcache_entry_t *mce, lbuf_t *b,
+        uint32_t iid)
+{
+    if (mcache_entry_pending_pkts_count(mce) >= xtr->miss_queue_len
+            || xtr->miss_queue_used_bytes + lbuf_size(b) > xtr->miss_queue_bytes){
+        OOR_LOG(LDBG_3, "tr_queue_pending_pkt: No room to queue more packets "
+                "for %s", lisp_addr_to_char(mapping_eid(mcache_entry_mapping(mce))));
+        xtr->miss_queue_stats.dropped_full++;
+        return (BAD);
+    }
+
+    mcache_entry_add_pending_pkt(mce, b, iid);
+    xtr->miss_queue_used_bytes += lbuf_size(b);
+    xtr->miss_queue_stats.queued++;
+    return (GOOD);
+}
+
+/* TRUE if EIDs of prefix pref can be gleaned */
+static int
+tr_glean_allowed(lisp_xtr_t *xtr, lisp_addr_t *pref)
+{
+    glist_entry_t *it;
+    lisp_addr_t *ip_pref = lisp_addr_get_ip_pref_addr(pref);
+
+    if (glist_size(xtr->glean_prefixes) == 0){
+        return (TRUE);
+    }
+    glist_for_each_entry(it, xtr->glean_prefixes){
+        if (pref_is_prefix_b_part_of_a(glist_entry_data(it), ip_pref)){
+            return (TRUE);
+        }
+    }
+    return (FALSE);
+}
+
+/*
+ * The source EID eid of a decapsulated packet was received from rloc. If
+ * the map cache has nothing for it, the reverse traffic uses rloc right away
+ * instead of waiting for a Map-Request. The gleaned entry lasts glean_ttl
+ * seconds unless the Map-Request sent to confirm it gets a reply.
+ */
+static int
+tr_glean_mapping(oor_ctrl_dev_t *dev, lisp_addr_t *eid, lisp_addr_t *rloc,
+        uint32_t iid)
+{
+    lisp_xtr_t *xtr;
+    mcache_entry_t *mce;
+    mapping_t *m;
+    lisp_addr_t *pref;
+    int afi, plen;
+
+    xtr = lisp_xtr_cast(dev);
+    if (!xtr->glean || xtr->nat_aware
+            || xtr->glean_entries >= xtr->glean_max_entries){
+        return (BAD);
+    }
+
+    afi = lisp_addr_ip_afi(eid);
+    if (iid > 0){
+        pref = lisp_addr_new_init_iid(iid, eid, (afi == AF_INET) ? 32: 128);
+    }else{
+        pref = lisp_addr_clone(eid);
+    }
+    if (mcache_lookup(xtr->map_cache, pref) != NULL
+            || local_map_db_lookup_eid(xtr->local_mdb, eid, FALSE) != NULL){
+        lisp_addr_del(pref);
+        return (BAD);
+    }
+
+    plen = (afi == AF_INET) ? xtr->glean_mask_v4 : xtr->glean_mask_v6;
+    lisp_addr_set_plen(pref, plen);
+    pref_conv_to_netw_pref(pref);
+    if (!tr_glean_allowed(xtr, pref)
+            || token_bucket_available(&xtr->glean_rate) == FALSE){
+        lisp_addr_del(pref);
+        return (BAD);
+    }
+    token_bucket_take(&xtr->glean_rate);
+
+    m = mapping_new_init(pref);
+    lisp_addr_del(pref);
+    if (!m){
+        return (BAD);
+    }
+    mapping_add_locator(m, locator_new_init(rloc, UP, 0, 1, 1, 100, 255, 0));
+    mapping_set_ttl(m, 1);
+    if (tr_mcache_add_mapping(xtr, m) != GOOD){
+        return (BAD);
+    }
+    mce = mcache_lookup_exact(xtr->map_cache, mapping_eid(m));
+    mce->gleaned = TRUE;
+    mce->stale = TRUE;
+    xtr->glean_entries++;
+
+    OOR_LOG(LDBG_1, "Gleaned mapping of EID %s with RLOC %s",
+            lisp_addr_to_char(mapping_eid(m)), lisp_addr_to_char(rloc));
+    mc_entry_schedule_expiration(xtr, mce, xtr->glean_ttl);
+    if (tr_mcache_revalidate(xtr, mce, 0) != GOOD){
+        OOR_LOG(LDBG_1, "Couldn't program the Map-Request to confirm the "
+                "mapping of EID %s", lisp_addr_to_char(mapping_eid(m)));
+    }
+    return (GOOD);
+}
+
+/*
+ * The Locator-Status-Bits of the packets of the source EID eid received from
+ * rloc changed to lsb. Only the bits of the mapping rloc belongs to are
+ * trusted. The locators they report down stop being used. Those whose state
+ * changed are probed, or the mapping requested again without RLOC probing,
+ * so a wrong report doesn't last.
+ */
+static int
+tr_lsb_changed(oor_ctrl_dev_t *dev, lisp_addr_t *eid, lisp_addr_t *rloc,
+        uint32_t iid, uint32_t lsb)
+{
+    lisp_xtr_t *xtr;
+    mcache_entry_t *mce;
+    mapping_t *map;
+    locator_t *loct;
+    lisp_addr_t *src_eid, *drloc;
+    int i = 0, nbits, state, changed = FALSE, probed = TRUE;
+
+    xtr = lisp_xtr_cast(dev);
+    if (iid > 0){
+        src_eid = lisp_addr_new_init_iid(iid, eid,
+                (lisp_addr_ip_afi(eid) == AF_INET) ? 32: 128);
+    }else{
+        src_eid = lisp_addr_clone(eid);
+    }
+    mce = mcache_lookup(xtr->map_cache, src_eid);
+    lisp_addr_del(src_eid);
+    if (!mce || mcache_entry_active(mce) == NOT_ACTIVE || mce->gleaned){
+        return (BAD);
+    }
+    map = mcache_entry_mapping(mce);
+    if (!mapping_get_loct_with_addr(map, rloc)){
+        return (BAD);
+    }
+
+    /* With an instance ID only 8 bits are available */
+    nbits = (iid > 0) ? 8 : 32;
+    mapping_foreach_active_locator(map, loct){
+        if (i >= nbits){
+            break;
+        }
+        state = (lsb & (1u << i)) ? UP : DOWN;
+        i++;
+        if (locator_state(loct) == state){
+            continue;
+        }
+        OOR_LOG(LDBG_1, "Locator-Status-Bits from %s: locator %s of EID %s "
+                "is %s", lisp_addr_to_char(rloc),
+                lisp_addr_to_char(locator_addr(loct)),
+                lisp_addr_to_char(mapping_eid(map)),
+                state == UP ? "up" : "down");
+        locator_set_state(loct, state);
+        changed = TRUE;
+        if (state == DOWN){
+            drloc = xtr->fwd_policy->get_fwd_ip_addr(locator_addr(loct),
+                    ctrl_rlocs(xtr->super.ctrl));
+            if (drloc){
+                tr_flush_rloc_flows(drloc);
+            }
+        }
+        if (rloc_probing_trigger(xtr, loct) != GOOD){
+            probed = FALSE;
+        }
+    }mapping_foreach_active_locator_end;
+
+    if (!changed){
+        return (GOOD);
+    }
+    xtr->fwd_policy->updated_map_cache_inf(xtr->fwd_policy_dev_parm, mce);
+    if (!probed && mce != xtr->petrs){
+        tr_mcache_revalidate(xtr, mce, 0);
+    }
+    return (GOOD);
+}
+
+/* The flows cached by the data plane that use rloc get their forwarding info
+ * again with their next packet instead of when they time out */
+static void
+tr_flush_rloc_flows(lisp_addr_t *rloc)
+{
+    if (data_plane->datap_flush_flows == NULL
+            || lisp_addr_lafi(rloc) != LM_AFI_IP){
+        return;
+    }
+    data_plane->datap_flush_flows(rloc);
+}
+
+/* The Locator-Status-Bits next received from the locators of map are
+ * applied to it even if they didn't change */
+static void
+tr_mcache_lsb_reset(mapping_t *map)
+{
+    locator_t *loct;
+
+    mapping_foreach_active_locator(map, loct){
+        if (lisp_addr_lafi(locator_addr(loct)) == LM_AFI_IP){
+            rloc_lsb_forget(rloc_lsbs, lisp_addr_ip(locator_addr(loct)));
+        }
+    }mapping_foreach_active_locator_end;
+}
+
+static void
+miss_queue_stats_dump(lisp_xtr_t *xtr, int log_level)
+{
+    miss_queue_stats_t *st = &xtr->miss_queue_stats;
+
+    if (st->queued == 0 && st->dropped_full == 0){
+        return;
+    }
+    OOR_LOG(log_level, "Map cache miss queue: %"PRIu64" packets queued, %"PRIu64
+            " sent, %"PRIu64" dropped (full: %"PRIu64", no Map-Reply: %"PRIu64
+            ", negative Map-Reply: %"PRIu64")", st->queued, st->flushed,
+            st->dropped_full + st->dropped_timeout + st->dropped_negative,
+            st->dropped_full, st->dropped_timeout, st->dropped_negative);
+}
+
 /*
  * Return the list of locators from the local mappings containing addr
  * @param local_db Database where to search locators
@@ -2841,34 +4405,693 @@ get_map_local_entry_to_smr(lisp_xtr_t *xtr)
 static lisp_addr_t *
 get_map_resolver(lisp_xtr_t *xtr)
 {
-    glist_entry_t * it = NULL;
-    lisp_addr_t * addr = NULL;
-    oor_ctrl_t * ctrl = NULL;
-    int supported_afis;
+    map_resolver_state_t *mr;
+
+    mr = tr_mr_select(xtr, NULL);
+    return (mr ? mr->addr : NULL);
+}
+
+static void
+map_resolver_state_del(map_resolver_state_t *mr)
+{
+    lisp_addr_del(mr->addr);
+    free(mr);
+}
+
+/* State of a Map-Resolver. It is created the first time it is used and
+ * kept while the xTR exists, even if the Map-Resolver is removed from
+ * the configuration */
+map_resolver_state_t *
+tr_mr_state(lisp_xtr_t *xtr, lisp_addr_t *addr)
+{
+    map_resolver_state_t *mr;
+
+    mr = shash_lookup(xtr->mr_states, lisp_addr_to_char(addr));
+    if (!mr){
+        mr = xzalloc(sizeof(map_resolver_state_t));
+        mr->addr = lisp_addr_clone(addr);
+        token_bucket_init(&mr->rate, xtr->mreq_mr_rate, xtr->mreq_mr_rate);
+        rtt_stats_init(&mr->rtt);
+        shash_insert(xtr->mr_states, strdup(lisp_addr_to_char(addr)), mr);
+    }
+    return (mr);
+}
+
+/* Expected time in ms to get a reply from the Map-Resolver: RTT plus the
+ * timeout paid each time a request is lost. Not measured Map-Resolvers
+ * score 0 so they are tried */
+static double
+tr_mr_score(map_resolver_state_t *mr)
+{
+    return (mr->rtt.srtt + 4 * mr->rtt.rttvar
+            + mr->rtt.loss * OOR_INITIAL_MRQ_TIMEOUT * 1000);
+}
+
+/* Map-Resolver to send the next Map-Request: the one with the best score
+ * among the not demoted ones. IPv6 Map-Resolvers win ties. A demoted
+ * Map-Resolver is only selected if all of them are demoted. They are
+ * checked again with tr_mr_reprobe_select */
+static map_resolver_state_t *
+tr_mr_select(lisp_xtr_t *xtr, map_resolver_state_t *exclude)
+{
+    map_resolver_state_t *mr, *best = NULL, *best_demoted = NULL;
+    glist_entry_t *it;
+    lisp_addr_t *addr;
+    int supported_afis, afi, i;
+    int afis[2] = {AF_INET6, AF_INET};
 
-    ctrl = xtr->super.ctrl;
-    supported_afis = ctrl_supported_afis(ctrl);
+    supported_afis = ctrl_supported_afis(xtr->super.ctrl);
 
-    if ((supported_afis & IPv6_SUPPORT) != 0){
+    for (i = 0; i < 2; i++){
+        afi = afis[i];
+        if ((afi == AF_INET6 && (supported_afis & IPv6_SUPPORT) == 0)
+                || (afi == AF_INET && (supported_afis & IPv4_SUPPORT) == 0)){
+            continue;
+        }
         glist_for_each_entry(it,xtr->map_resolvers){
             addr = (lisp_addr_t *)glist_entry_data(it);
-            if (lisp_addr_ip_afi(addr) == AF_INET6){
-                return (addr);
+            if (lisp_addr_ip_afi(addr) != afi){
+                continue;
+            }
+            mr = tr_mr_state(xtr, addr);
+            if (mr == exclude){
+                continue;
+            }
+            if (mr->demoted){
+                if (!best_demoted || tr_mr_score(mr) < tr_mr_score(best_demoted)){
+                    best_demoted = mr;
+                }
+                continue;
+            }
+            if (!best || tr_mr_score(mr) < tr_mr_score(best)){
+                best = mr;
             }
         }
     }
 
-    if ((supported_afis & IPv4_SUPPORT) != 0){
-        glist_for_each_entry(it,xtr->map_resolvers){
-            addr = (lisp_addr_t *)glist_entry_data(it);
-            if (lisp_addr_ip_afi(addr) == AF_INET){
-                return (addr);
+    if (best){
+        return (best);
+    }
+    if (!best_demoted && !exclude){
+        OOR_LOG (LDBG_1,"get_map_resolver: No map resolver reachable");
+    }
+    return (best_demoted);
+}
+
+/* Demoted Map-Resolver to be checked again, other than exclude. Its next
+ * check is scheduled when it is returned, so a failure to send to it
+ * doesn't make it selected at every request. The caller sends it a copy
+ * of a request already sent to a healthy Map-Resolver */
+static map_resolver_state_t *
+tr_mr_reprobe_select(lisp_xtr_t *xtr, map_resolver_state_t *exclude)
+{
+    map_resolver_state_t *mr;
+    glist_entry_t *it;
+    lisp_addr_t *addr;
+    struct timespec now;
+    int supported_afis, afi;
+
+    supported_afis = ctrl_supported_afis(xtr->super.ctrl);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    glist_for_each_entry(it,xtr->map_resolvers){
+        addr = (lisp_addr_t *)glist_entry_data(it);
+        afi = lisp_addr_ip_afi(addr);
+        if ((afi == AF_INET6 && (supported_afis & IPv6_SUPPORT) == 0)
+                || (afi == AF_INET && (supported_afis & IPv4_SUPPORT) == 0)){
+            continue;
+        }
+        mr = tr_mr_state(xtr, addr);
+        if (mr == exclude || !mr->demoted || now.tv_sec < mr->reprobe_ts){
+            continue;
+        }
+        mr->reprobe_ts = now.tv_sec + MR_REPROBE_INTERVAL;
+        OOR_LOG(LDBG_1, "Checking if Map-Resolver %s has recovered",
+                lisp_addr_to_char(mr->addr));
+        return (mr);
+    }
+    return (NULL);
+}
+
+static void
+tr_mr_lost(map_resolver_state_t *mr)
+{
+    struct timespec now;
+
+    rtt_stats_add_loss(&mr->rtt);
+    if (++mr->consecutive_losses < MR_DEMOTE_LOSSES || mr->demoted){
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    mr->demoted = TRUE;
+    mr->reprobe_ts = now.tv_sec + MR_REPROBE_INTERVAL;
+    OOR_LOG(LDBG_1, "Map-Resolver %s didn't answer %d Map-Requests. Using "
+            "other Map-Resolvers", lisp_addr_to_char(mr->addr),
+            mr->consecutive_losses);
+}
+
+static void
+tr_mr_answered(map_resolver_state_t *mr, double rtt_ms)
+{
+    rtt_stats_add_sample(&mr->rtt, rtt_ms);
+    mr->replies++;
+    mr->consecutive_losses = 0;
+    if (mr->demoted){
+        mr->demoted = FALSE;
+        OOR_LOG(LDBG_1, "Map-Resolver %s answers again",
+                lisp_addr_to_char(mr->addr));
+    }
+}
+
+static void
+tr_mreq_sent_add(lisp_xtr_t *xtr, glist_t *sent_lst,
+        uint64_t nonce, map_resolver_state_t *mr)
+{
+    mreq_sent_t *sent;
+
+    sent = xzalloc(sizeof(mreq_sent_t));
+    sent->nonce = nonce;
+    sent->mr = mr;
+    clock_gettime(CLOCK_MONOTONIC, &sent->ts);
+    glist_add_tail(sent, sent_lst);
+    mr->requests++;
+}
+
+/* The requests not answered yet are considered lost */
+static void
+tr_mreq_sent_expire(lisp_xtr_t *xtr, glist_t *sent_lst)
+{
+    glist_entry_t *it;
+
+    glist_for_each_entry(it, sent_lst){
+        tr_mr_lost(((mreq_sent_t *)glist_entry_data(it))->mr);
+    }
+    glist_remove_all(sent_lst);
+}
+
+/* Map-Reply for the request with the nonce. As each request uses its own
+ * nonce, the RTT is measured even for retransmissions. Only the
+ * Map-Resolver that answered gets a sample: the requests to the others
+ * are forgotten, as a late reply says nothing about their RTT */
+static void
+tr_mreq_sent_reply(glist_t *sent_lst, uint64_t nonce)
+{
+    glist_entry_t *it;
+    mreq_sent_t *sent, *answered = NULL;
+    double rtt = 0;
+
+    glist_for_each_entry(it, sent_lst){
+        sent = (mreq_sent_t *)glist_entry_data(it);
+        if (sent->nonce == nonce){
+            answered = sent;
+            rtt = rtt_elapsed_ms(&sent->ts);
+            break;
+        }
+    }
+    if (!answered){
+        return;
+    }
+    tr_mr_answered(answered->mr, rtt);
+    glist_remove_all(sent_lst);
+}
+
+static void
+mreq_hedge_del(mreq_hedge_t *h)
+{
+    lisp_addr_del(h->eid);
+    free(h);
+}
+
+/* glist order: 1 if a expires after b, 2 if before and 0 if at the same
+ * time */
+static int
+tr_mr_hedge_cmp(mreq_hedge_t *a, mreq_hedge_t *b)
+{
+    if (a->deadline.tv_sec != b->deadline.tv_sec){
+        return (a->deadline.tv_sec < b->deadline.tv_sec ? 2 : 1);
+    }
+    if (a->deadline.tv_nsec != b->deadline.tv_nsec){
+        return (a->deadline.tv_nsec < b->deadline.tv_nsec ? 2 : 1);
+    }
+    return (0);
+}
+
+/* Program the timer of the hedged requests with the earliest deadline */
+static void
+tr_mr_hedge_arm(lisp_xtr_t *xtr)
+{
+    struct itimerspec its;
+    mreq_hedge_t *h;
+
+    memset(&its, 0, sizeof(struct itimerspec));
+    if (glist_size(xtr->mr_hedges) > 0){
+        h = (mreq_hedge_t *)glist_first_data(xtr->mr_hedges);
+        its.it_value = h->deadline;
+    }
+    timerfd_settime(xtr->mr_hedge_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* If the Map-Resolver mr doesn't answer the request with the nonce in its
+ * usual time, send the same request to a second one */
+static void
+tr_mr_hedge_schedule(lisp_xtr_t *xtr, lisp_addr_t *eid, uint64_t nonce,
+        map_resolver_state_t *mr)
+{
+    mreq_hedge_t *h;
+    double delay = MR_HEDGE_DEFAULT_DELAY;
+
+    if (xtr->mr_hedge_fd == -1 || glist_size(xtr->map_resolvers) < 2){
+        return;
+    }
+    if (mr->rtt.samples >= MR_HEDGE_MIN_SAMPLES){
+        delay = rtt_stats_percentile(&mr->rtt, MR_HEDGE_PERCENTILE);
+        if (delay < MR_HEDGE_MIN_DELAY){
+            delay = MR_HEDGE_MIN_DELAY;
+        }
+    }
+
+    h = xzalloc(sizeof(mreq_hedge_t));
+    h->eid = lisp_addr_clone(eid);
+    h->nonce = nonce;
+    h->mr = mr;
+    clock_gettime(CLOCK_MONOTONIC, &h->deadline);
+    h->deadline.tv_sec += (time_t)(delay / 1000);
+    h->deadline.tv_nsec += (long)((delay - 1000 * (time_t)(delay / 1000)) * 1.0e6);
+    if (h->deadline.tv_nsec >= 1000000000){
+        h->deadline.tv_sec++;
+        h->deadline.tv_nsec -= 1000000000;
+    }
+    glist_add(h, xtr->mr_hedges);
+    tr_mr_hedge_arm(xtr);
+}
+
+/* Send the hedged request of h if the first one is still unanswered */
+static void
+tr_mr_hedge_send(lisp_xtr_t *xtr, mreq_hedge_t *h)
+{
+    mcache_entry_t *mce;
+    glist_t *timers;
+    oor_timer_t *timer;
+    timer_map_req_argument *arg;
+    map_resolver_state_t *mr;
+    glist_entry_t *it;
+    uint64_t nonce;
+    int pending = FALSE;
+
+    mce = mcache_lookup_exact(xtr->map_cache, h->eid);
+    if (!mce || mcache_entry_active(mce) == ACTIVE){
+        return;
+    }
+    timers = htable_ptrs_timers_get_timers_of_type_from_obj(ptrs_to_timers_ht,
+            mce, MAP_REQUEST_RETRY_TIMER);
+    timer = glist_size(timers) > 0 ? glist_first_data(timers) : NULL;
+    glist_destroy(timers);
+    if (!timer){
+        return;
+    }
+    arg = (timer_map_req_argument *)oor_timer_cb_argument(timer);
+    glist_for_each_entry(it, arg->sent){
+        if (((mreq_sent_t *)glist_entry_data(it))->nonce == h->nonce){
+            pending = TRUE;
+            break;
+        }
+    }
+    if (!pending){
+        return;
+    }
+
+    mr = tr_mr_select(xtr, h->mr);
+    if (!mr || tr_mreq_rate_take(xtr, mr) == FALSE){
+        return;
+    }
+    OOR_LOG(LDBG_1, "No Map-Reply from %s for EID %s yet. Sending Map-Request "
+            "also to %s", lisp_addr_to_char(h->mr->addr),
+            lisp_addr_to_char(h->eid), lisp_addr_to_char(mr->addr));
+    nonce = nonce_new();
+    if (build_and_send_encap_map_request(xtr, arg->src_eid, mce, nonce,
+            mr->addr) != GOOD){
+        return;
+    }
+    htable_nonces_insert(nonces_ht, nonce, oor_timer_nonces(timer));
+    arg->hedged++;
+    mr->hedged++;
+    xtr->mreq_stats.sent++;
+    tr_mreq_sent_add(xtr, arg->sent, nonce, mr);
+}
+
+static int
+tr_mr_hedge_recv(sock_t *sl)
+{
+    lisp_xtr_t *xtr = (lisp_xtr_t *)sl->arg;
+    mreq_hedge_t *h;
+    struct timespec now;
+    uint64_t expirations;
+
+    if (read(sl->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN){
+        OOR_LOG(LDBG_1, "tr_mr_hedge_recv: Error reading timer: %s",
+                strerror(errno));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (glist_size(xtr->mr_hedges) > 0){
+        h = (mreq_hedge_t *)glist_first_data(xtr->mr_hedges);
+        if (h->deadline.tv_sec > now.tv_sec || (h->deadline.tv_sec == now.tv_sec
+                && h->deadline.tv_nsec > now.tv_nsec)){
+            break;
+        }
+        tr_mr_hedge_send(xtr, h);
+        glist_remove(glist_first(xtr->mr_hedges), xtr->mr_hedges);
+    }
+    tr_mr_hedge_arm(xtr);
+    return (GOOD);
+}
+
+static int
+tr_mr_init(lisp_xtr_t *xtr)
+{
+    xtr->mr_states = shash_new_managed((free_value_fn_t)map_resolver_state_del);
+    xtr->mr_hedges = glist_new_complete((glist_cmp_fct)tr_mr_hedge_cmp,
+            (glist_del_fct)mreq_hedge_del);
+    /* Hedged requests wait a fraction of a second. Timers of the wheel
+     * have a resolution of one second */
+    xtr->mr_hedge_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (xtr->mr_hedge_fd == -1){
+        OOR_LOG(LWRN, "tr_mr_init: Couldn't create timer: %s. Map-Requests "
+                "will not be hedged", strerror(errno));
+        return (GOOD);
+    }
+    xtr->mr_hedge_sock = sockmstr_register_read_listener(smaster,
+            tr_mr_hedge_recv, xtr, xtr->mr_hedge_fd);
+    return (GOOD);
+}
+
+void
+map_resolvers_stats_dump(lisp_xtr_t *xtr, int log_level)
+{
+    glist_entry_t *it;
+    map_resolver_state_t *mr;
+
+    if (is_loggable(log_level) == FALSE){
+        return;
+    }
+    OOR_LOG(log_level, "************* %13s ***************", "Map Resolvers");
+    glist_for_each_entry(it, xtr->map_resolvers){
+        mr = tr_mr_state(xtr, (lisp_addr_t *)glist_entry_data(it));
+        OOR_LOG(log_level, "%s: %s, %"PRIu64" requests (%"PRIu64" hedged), "
+                "%"PRIu64" replies, rtt %.1f ms (var %.1f, p95 %.1f), loss %.2f",
+                lisp_addr_to_char(mr->addr), mr->demoted ? "demoted" : "up",
+                mr->requests, mr->hedged, mr->replies, mr->rtt.srtt,
+                mr->rtt.rttvar, rtt_stats_percentile(&mr->rtt, 95),
+                mr->rtt.loss);
+    }
+}
+
+static void
+tr_mr_uninit(lisp_xtr_t *xtr)
+{
+    map_resolvers_stats_dump(xtr, LDBG_1);
+    if (xtr->mr_hedge_sock){
+        sockmstr_unregister_read_listenedr(smaster, xtr->mr_hedge_sock);
+    }else if (xtr->mr_hedge_fd != -1){
+        close(xtr->mr_hedge_fd);
+    }
+    glist_destroy(xtr->mr_hedges);
+    shash_destroy(xtr->mr_states);
+}
+
+static void
+mreq_batch_item_del(mreq_batch_item_t *item)
+{
+    lisp_addr_del(item->eid);
+    lisp_addr_del(item->src_eid);
+    free(item);
+}
+
+static mreq_batch_t *
+mreq_batch_new(lisp_addr_t *src_eid, uint8_t smr_invoked)
+{
+    mreq_batch_t *batch = xzalloc(sizeof(mreq_batch_t));
+
+    batch->eids = glist_new_managed((glist_del_fct)lisp_addr_del);
+    batch->src_eid = lisp_addr_clone(src_eid);
+    batch->smr_invoked = smr_invoked;
+    batch->sent = glist_new_managed((glist_del_fct)free);
+    return (batch);
+}
+
+static void
+mreq_batch_del(mreq_batch_t *batch)
+{
+    glist_destroy(batch->eids);
+    lisp_addr_del(batch->src_eid);
+    glist_destroy(batch->sent);
+    free(batch);
+}
+
+/* Request again the mapping of eid in delay seconds. Entries due in the
+ * same second with the same source EID share the Map-Request */
+static void
+tr_mreq_batch_add(lisp_xtr_t *xtr, lisp_addr_t *eid, lisp_addr_t *src_eid,
+        int delay, uint8_t smr_invoked)
+{
+    mreq_batch_item_t *item = xzalloc(sizeof(mreq_batch_item_t));
+
+    item->eid = lisp_addr_clone(eid);
+    item->src_eid = lisp_addr_clone(src_eid);
+    item->due = time(NULL) + delay;
+    item->smr_invoked = smr_invoked;
+    glist_add_tail(item, xtr->mreq_batch_queue);
+    /* Entries due now are sent on the next tick of the timers */
+    oor_timer_start(xtr->mreq_batch_timer, 1);
+}
+
+/* The batch is answered or given up */
+static void
+tr_mreq_batch_finish(lisp_xtr_t *xtr, oor_timer_t *timer)
+{
+    mreq_batch_t *batch = oor_timer_cb_argument(timer);
+
+    glist_remove_obj_with_ptr(batch, xtr->mreq_batches);
+    /* The batch is freed with its timer */
+    stop_timer_from_obj(batch, timer, ptrs_to_timers_ht, nonces_ht);
+}
+
+static int
+tr_mreq_batch_cb(oor_timer_t *timer)
+{
+    mreq_batch_t *batch = oor_timer_cb_argument(timer);
+    nonces_list_t *nonces_list = oor_timer_nonces(timer);
+    lisp_xtr_t *xtr = oor_timer_owner(timer);
+    map_resolver_state_t *mr, *rmr;
+    glist_entry_t *it;
+    lisp_addr_t *eid;
+    mcache_entry_t *mce;
+    uint64_t nonce;
+    int retries = nonces_list_size(nonces_list) - batch->hedged;
+
+    tr_mreq_sent_expire(xtr, batch->sent);
+    if (retries - 1 < xtr->map_request_retries){
+        mr = tr_mr_select(xtr, NULL);
+        if (tr_mreq_rate_take(xtr, mr) == FALSE){
+            xtr->mreq_stats.suppressed++;
+            oor_timer_start(timer, 1);
+            return (GOOD);
+        }
+        if (retries > 0){
+            OOR_LOG(LDBG_1, "Retransmitting Map-Request with %d records "
+                    "(%d retries)", glist_size(batch->eids), retries);
+            xtr->mreq_stats.retransmitted++;
+        }
+        nonce = nonce_new();
+        if (!mr || build_and_send_encap_mreq_batch(xtr, batch, nonce,
+                mr->addr) != GOOD){
+            OOR_LOG(LDBG_1, "Couldn't send Map-Request with %d records",
+                    glist_size(batch->eids));
+        }else{
+            xtr->mreq_stats.sent++;
+            xtr->mreq_stats.batched += glist_size(batch->eids);
+            tr_mreq_sent_add(xtr, batch->sent, nonce, mr);
+        }
+        htable_nonces_insert(nonces_ht, nonce, nonces_list);
+
+        rmr = mr ? tr_mr_reprobe_select(xtr, mr) : NULL;
+        if (rmr && tr_mreq_rate_take(xtr, rmr) == TRUE){
+            nonce = nonce_new();
+            if (build_and_send_encap_mreq_batch(xtr, batch, nonce,
+                    rmr->addr) == GOOD){
+                htable_nonces_insert(nonces_ht, nonce, nonces_list);
+                batch->hedged++;
+                rmr->hedged++;
+                xtr->mreq_stats.sent++;
+                tr_mreq_sent_add(xtr, batch->sent, nonce, rmr);
             }
         }
+        oor_timer_start(timer, tr_mreq_backoff(retries));
+        return (GOOD);
     }
 
-    OOR_LOG (LDBG_1,"get_map_resolver: No map resolver reachable");
-    return (NULL);
+    /* Same as for the requests of a single entry */
+    glist_for_each_entry(it, batch->eids){
+        eid = (lisp_addr_t *)glist_entry_data(it);
+        mce = mcache_lookup_exact(xtr->map_cache, eid);
+        if (mce == NULL){
+            continue;
+        }
+        if (mce->stale){
+            OOR_LOG(LDBG_1, "No Map-Reply for EID %s after %d retries. Keeping "
+                    "its mapping until it expires", lisp_addr_to_char(eid),
+                    retries - 1);
+        }else{
+            OOR_LOG(LDBG_1, "No Map-Reply for EID %s after %d retries. "
+                    "Removing entry ...", lisp_addr_to_char(eid), retries - 1);
+            tr_mcache_remove_entry(xtr, mce);
+        }
+    }
+    tr_mreq_batch_finish(xtr, timer);
+    return (BAD);
+}
+
+static void
+tr_mreq_batch_start(lisp_xtr_t *xtr, mreq_batch_t *batch)
+{
+    oor_timer_t *timer;
+
+    timer = oor_timer_with_nonce_new(MAP_REQUEST_BATCH_TIMER, xtr,
+            tr_mreq_batch_cb, batch, (oor_timer_del_cb_arg_fn)mreq_batch_del);
+    htable_ptrs_timers_add(ptrs_to_timers_ht, batch, timer);
+    glist_add_tail(batch, xtr->mreq_batches);
+    tr_mreq_batch_cb(timer);
+}
+
+/* Group the entries that are due in Map-Requests of up to
+ * mreq_batch_records records */
+static int
+tr_mreq_batch_flush_cb(oor_timer_t *timer)
+{
+    lisp_xtr_t *xtr = oor_timer_owner(timer);
+    glist_entry_t *it, *it_aux;
+    mreq_batch_item_t *item;
+    mreq_batch_t *batch;
+    mcache_entry_t *mce;
+    time_t now = time(NULL);
+
+    do {
+        batch = NULL;
+        glist_for_each_entry_safe(it, it_aux, xtr->mreq_batch_queue){
+            item = (mreq_batch_item_t *)glist_entry_data(it);
+            if (item->due > now){
+                continue;
+            }
+            if (batch != NULL && (batch->smr_invoked != item->smr_invoked
+                    || lisp_addr_cmp(batch->src_eid, item->src_eid) != 0)){
+                continue;
+            }
+            /* The entry may have been removed meanwhile */
+            mce = mcache_lookup_exact(xtr->map_cache, item->eid);
+            if (mce != NULL && mcache_entry_active(mce) == ACTIVE){
+                if (batch == NULL){
+                    batch = mreq_batch_new(item->src_eid, item->smr_invoked);
+                }
+                glist_add_tail(lisp_addr_clone(item->eid), batch->eids);
+            }
+            glist_remove(it, xtr->mreq_batch_queue);
+            if (batch != NULL
+                    && glist_size(batch->eids) == xtr->mreq_batch_records){
+                break;
+            }
+        }
+        if (batch != NULL){
+            tr_mreq_batch_start(xtr, batch);
+        }
+    } while (batch != NULL);
+
+    if (glist_size(xtr->mreq_batch_queue) > 0){
+        oor_timer_start(timer, 1);
+    }
+    return (GOOD);
+}
+
+/* Map-Reply to a request with several records. Each record confirms the
+ * entry of its EID. The batch ends when all of them have been answered */
+static int
+tr_recv_batch_map_reply(lisp_xtr_t *xtr, lbuf_t *b, uint64_t nonce,
+        int records, oor_timer_t *timer)
+{
+    mreq_batch_t *batch = oor_timer_cb_argument(timer);
+    glist_entry_t *it, *aux_it;
+    lisp_addr_t *eid;
+    mapping_t *m;
+    int i, requested, replaced;
+
+    tr_mreq_sent_reply(batch->sent, nonce);
+    for (i = 0; i < records; i++){
+        m = mapping_new();
+        if (lisp_msg_parse_mapping_record(b, m, NULL) != GOOD){
+            mapping_del(m);
+            return (BAD);
+        }
+        if (mapping_has_elp_with_l_bit(m)){
+            OOR_LOG(LDBG_1,"Received a Map Reply with an ELP with the L bit set. "
+                    "Not supported -> Discarding record");
+            mapping_del(m);
+            continue;
+        }
+        /* The record may also cover gleaned entries of more specific
+         * prefixes, which are replaced by it */
+        requested = FALSE;
+        replaced = FALSE;
+        glist_for_each_entry_safe(it, aux_it, batch->eids){
+            eid = (lisp_addr_t *)glist_entry_data(it);
+            if (lisp_addr_cmp(eid, mapping_eid(m)) == 0){
+                requested = TRUE;
+            }else if (tr_mcache_unglean(xtr,
+                    mcache_lookup_exact(xtr->map_cache, eid), mapping_eid(m))){
+                replaced = TRUE;
+            }else{
+                continue;
+            }
+            glist_remove(it, batch->eids);
+        }
+        if (replaced && mcache_lookup_exact(xtr->map_cache, mapping_eid(m)) == NULL){
+            tr_mcache_add_mapping(xtr, m);
+            continue;
+        }
+        if (requested || replaced){
+            update_mcache_entry(xtr, m);
+        }else{
+            OOR_LOG(LDBG_2, "Received a non requested record for EID %s",
+                    lisp_addr_to_char(mapping_eid(m)));
+        }
+        mapping_del(m);
+    }
+
+    if (glist_size(batch->eids) == 0){
+        tr_mreq_batch_finish(xtr, timer);
+    }
+    return (GOOD);
+}
+
+static void
+tr_mreq_batch_init(lisp_xtr_t *xtr)
+{
+    xtr->mreq_batch_records = DEFAULT_MREQ_BATCH_RECORDS;
+    xtr->mreq_batch_queue = glist_new_managed((glist_del_fct)mreq_batch_item_del);
+    xtr->mreq_batches = glist_new();
+    xtr->mreq_batch_timer = oor_timer_create(MAP_REQUEST_BATCH_TIMER);
+    oor_timer_init(xtr->mreq_batch_timer, xtr, tr_mreq_batch_flush_cb, xtr,
+            NULL, NULL);
+}
+
+static void
+tr_mreq_batch_uninit(lisp_xtr_t *xtr)
+{
+    glist_entry_t *it;
+
+    oor_timer_stop(xtr->mreq_batch_timer);
+    glist_for_each_entry(it, xtr->mreq_batches){
+        stop_timers_from_obj(glist_entry_data(it), ptrs_to_timers_ht, nonces_ht);
+    }
+    glist_destroy(xtr->mreq_batches);
+    glist_destroy(xtr->mreq_batch_queue);
 }
 
 // XXX This function is only used while we don't have support of L bit of ELPs
@@ -2902,26 +5125,14 @@ mapping_has_elp_with_l_bit(mapping_t *map)
     return (FALSE);
 }
 
-timer_rloc_probe_argument *
-timer_rloc_probe_argument_new_init(mcache_entry_t *mce,locator_t *locator)
-{
-    timer_rloc_probe_argument *timer_arg = xmalloc(sizeof(timer_rloc_probe_argument));
-    timer_arg->mce = mce;
-    timer_arg->locator = locator;
-    return (timer_arg);
-}
-
-void
-timer_rloc_probe_argument_free(timer_rloc_probe_argument *timer_arg){
-    free (timer_arg);
-}
-
 timer_map_req_argument *
 timer_map_req_arg_new_init(mcache_entry_t *mce,lisp_addr_t *src_eid)
 {
     timer_map_req_argument *timer_arg = xmalloc(sizeof(timer_map_req_argument));
     timer_arg->mce = mce;
     timer_arg->src_eid = lisp_addr_clone(src_eid);
+    timer_arg->sent = glist_new_managed((glist_del_fct)free);
+    timer_arg->hedged = 0;
 
     return(timer_arg);
 }
@@ -2930,6 +5141,7 @@ void
 timer_map_req_arg_free(timer_map_req_argument * timer_arg)
 {
     lisp_addr_del(timer_arg->src_eid);
+    glist_destroy(timer_arg->sent);
     free(timer_arg);
 }
 
@@ -22,9 +22,14 @@
 #define LISP_XTR_H_
 
 #include "oor_ctrl_device.h"
+#include "../elibs/khash/khash.h"
 #include "../defs.h"
 #include "../fwd_policies/fwd_policy.h"
 #include "../lib/shash.h"
+#include "../lib/mpsc_ring.h"
+#include "../lib/token_bucket.h"
+#include "../lib/rtt_stats.h"
+#include "../lib/mapping_db.h"
 
 
 typedef enum tr_type {
@@ -39,6 +44,128 @@ typedef enum {
     AFTER_DRAFT_VER_4
 }nat_version;
 
+/* Counters of the packets queued during map cache misses */
+typedef struct miss_queue_stats_ {
+    uint64_t queued;
+    uint64_t flushed;
+    uint64_t dropped_full;
+    uint64_t dropped_timeout;
+    uint64_t dropped_negative;
+} miss_queue_stats_t;
+
+/* Map cache miss posted by the data path to the control loop: the EID to
+ * request, or a packet to keep until it is resolved (pkt not NULL) */
+typedef struct mcache_miss_ {
+    lisp_addr_t *eid;
+    lisp_addr_t *src_eid;
+    lbuf_t *pkt;
+    uint32_t iid;
+} mcache_miss_t;
+
+/* Miss posted and whose placeholder is not installed yet, with the number
+ * of its packets posted. Keeps the data path from posting it again */
+typedef struct miss_pending_ {
+    uint32_t hash;
+    uint32_t pkts;
+} miss_pending_t;
+
+/* Counters of the map cache misses posted by the data path */
+typedef struct miss_ring_stats_ {
+    uint64_t posted;
+    uint64_t ring_full;
+    uint64_t duplicated;
+    uint64_t deferred;
+} miss_ring_stats_t;
+
+/* Map-Request in flight. Misses of EIDs of the same aggregate prefix wait
+ * for its reply, which may cover them too, before sending their own */
+typedef struct mreq_pending_ {
+    lisp_addr_t *aggr;
+    lisp_addr_t *eid;
+    glist_t *waiting; // <lisp_addr_t *>
+} mreq_pending_t;
+
+/* Counters of the Map-Requests sent to resolve map cache misses */
+typedef struct mreq_stats_ {
+    uint64_t sent;
+    uint64_t retransmitted;
+    uint64_t suppressed;
+    uint64_t coalesced;
+    uint64_t batched;
+} mreq_stats_t;
+
+/* Entry waiting to be requested again together with others */
+typedef struct mreq_batch_item_ {
+    lisp_addr_t *eid;
+    lisp_addr_t *src_eid;
+    time_t due;
+    uint8_t smr_invoked;
+} mreq_batch_item_t;
+
+/* Map-Request with several EID records. Its nonce identifies the
+ * Map-Replies, that may answer only some of the records each */
+typedef struct mreq_batch_ {
+    glist_t *eids; // <lisp_addr_t *> not answered yet
+    lisp_addr_t *src_eid;
+    uint8_t smr_invoked;
+    glist_t *sent; // <mreq_sent_t *>
+    int hedged;
+} mreq_batch_t;
+
+/* Health of a Map-Resolver, used to choose where Map-Requests are sent */
+typedef struct map_resolver_state_ {
+    lisp_addr_t *addr;
+    token_bucket_t rate;
+    rtt_stats_t rtt;
+    uint64_t requests;
+    uint64_t replies;
+    uint64_t hedged;
+    int consecutive_losses;
+    uint8_t demoted;
+    time_t reprobe_ts;
+} map_resolver_state_t;
+
+/* Map-Request sent and not answered yet */
+typedef struct mreq_sent_ {
+    uint64_t nonce;
+    map_resolver_state_t *mr;
+    struct timespec ts;
+} mreq_sent_t;
+
+/* Map-Request to be sent to a second Map-Resolver if the first one has
+ * not answered before the deadline */
+typedef struct mreq_hedge_ {
+    lisp_addr_t *eid;
+    uint64_t nonce;
+    map_resolver_state_t *mr;
+    struct timespec deadline;
+} mreq_hedge_t;
+
+/* Set of map cache entries */
+#define mce_set_hash_func(key) kh_int64_hash_func((khint64_t)(uintptr_t)(key))
+KHASH_INIT(mce_set, mcache_entry_t *, char, 0, mce_set_hash_func,
+        kh_int64_hash_equal)
+
+/* RLOC probing of a remote RLOC. It is shared by all the map cache entries
+ * that have the RLOC as locator: one probe per interval covers them all */
+typedef struct rloc_probe_ {
+    lisp_addr_t addr;
+    khash_t(mce_set) *mces;
+    /* Map-Request probe encoded for tmpl_eid, one of the EIDs of mces.
+     * Only the nonce changes between probes */
+    lbuf_t *tmpl;
+    lisp_addr_t *tmpl_eid;
+    oor_timer_t *timer;
+    /* RTT and loss of the path from laddr, the local RLOC the probes are
+     * sent from */
+    lisp_addr_t laddr;
+    rtt_stats_t rtt;
+    struct timespec sent;
+} rloc_probe_t;
+
+KHASH_INIT(rloc_probe, ip_addr_t *, rloc_probe_t *, 1, ip_addr_hash,
+        ip_addr_equal)
+
 typedef struct lisp_xtr {
     oor_ctrl_dev_t super; /* base "class" */
 
@@ -51,9 +178,32 @@ typedef struct lisp_xtr {
     int (*add_mapping_to_local_map_db)(mapping_t *mapping);
 
     int map_request_retries;
+    /* Packets waiting for a Map-Reply: per entry limit and global budget */
+    int miss_queue_len;
+    int miss_queue_bytes;
+    int miss_queue_used_bytes;
+    miss_queue_stats_t miss_queue_stats;
+    /* Map cache misses: posted by the data path, Map-Requests sent later
+     * from the control loop in batches */
+    mpsc_ring_t *miss_ring; // <mcache_miss_t *>
+    miss_pending_t miss_pending[MISS_PENDING_SLOTS];
+    int miss_fd[2];
+    sock_t *miss_sock;
+    uint32_t miss_doorbell;
+    oor_timer_t *miss_timer;
+    miss_ring_stats_t miss_ring_stats;
+    /* Map-Requests: rate limits, in total and per Map-Resolver, and
+     * requests in flight indexed by aggregate prefix */
+    token_bucket_t mreq_rate;
+    int mreq_mr_rate;
+    int mreq_coalesce_v4;
+    int mreq_coalesce_v6;
+    mdb_t *pending_mreqs; /* Key: aggregate prefix, Value: mreq_pending_t */
+    mreq_stats_t mreq_stats;
     int probe_interval;
     int probe_retries;
     int probe_retries_interval;
+    khash_t(rloc_probe) *rloc_probes; /* Key: probed RLOC */
 
     mcache_entry_t *petrs;
     glist_t *pitrs; // <lisp_addr_t *>
@@ -61,6 +211,31 @@ typedef struct lisp_xtr {
     /* DATABASES */
     map_cache_db_t *map_cache;
     local_map_db_t *local_mdb;
+    /* Map cache saved periodically to be restored on restart */
+    char *mcache_snapshot_file;
+    int mcache_snapshot_interval;
+    oor_timer_t *mcache_snapshot_timer;
+    /* Entries used in the last mcache_refresh_window seconds are refreshed
+     * before they expire */
+    int mcache_refresh_window;
+    /* Checks the expiration of the map cache entries every second */
+    oor_timer_t *mcache_expiry_timer;
+    /* Refreshes and SMR-invoked requests are grouped in Map-Requests of up
+     * to mreq_batch_records records */
+    int mreq_batch_records;
+    glist_t *mreq_batch_queue; // <mreq_batch_item_t *>
+    oor_timer_t *mreq_batch_timer;
+    glist_t *mreq_batches; // <mreq_batch_t *> waiting for replies
+    /* Mappings gleaned from decapsulated packets until their Map-Reply
+     * arrives. Only for EIDs covered by glean_prefixes when not empty */
+    uint8_t glean;
+    int glean_ttl;
+    int glean_mask_v4;
+    int glean_mask_v6;
+    int glean_max_entries;
+    int glean_entries;
+    token_bucket_t glean_rate;
+    glist_t *glean_prefixes; // <lisp_addr_t *>
 
     /* FWD POLICY */
     fwd_policy_class *fwd_policy;
@@ -68,6 +243,11 @@ typedef struct lisp_xtr {
 
     /* MAP RESOLVERS */
     glist_t *map_resolvers; // <lisp_addr_t *>
+    shash_t *mr_states; /* Key: Map-Resolver, Value: map_resolver_state_t */
+    uint8_t mr_hedging;
+    glist_t *mr_hedges; // <mreq_hedge_t *> sorted by deadline
+    int mr_hedge_fd;
+    sock_t *mr_hedge_sock;
 
     /* MAP SERVERs */
     glist_t *map_servers; // <map_server_elt *>
@@ -99,14 +279,11 @@ typedef struct map_server_elt_t {
     uint8_t         proxy_reply;
 } map_server_elt;
 
-typedef struct _timer_rloc_prob_argument {
-    mcache_entry_t *mce;
-    locator_t      *locator;
-} timer_rloc_probe_argument;
-
 typedef struct _timer_map_req_argument {
     mcache_entry_t  *mce;
     lisp_addr_t     *src_eid;
+    glist_t         *sent; // <mreq_sent_t *>
+    int             hedged;
 } timer_map_req_argument;
 
 typedef struct _timer_map_reg_argument {
@@ -132,6 +309,7 @@ map_server_elt * map_server_elt_new_init(lisp_addr_t *address,uint8_t key_type,
         char *key, uint8_t proxy_reply);
 void map_server_elt_del (map_server_elt *map_server);
 void map_servers_dump(lisp_xtr_t *, int log_level);
+void map_resolvers_stats_dump(lisp_xtr_t *xtr, int log_level);
 
 int program_map_register(lisp_xtr_t *xtr);
 void send_smr_and_mreg_for_locl_mapping(lisp_xtr_t *xtr, map_local_entry_t *map_loc_e);
@@ -140,6 +318,7 @@ int tr_mcache_add_mapping(lisp_xtr_t *, mapping_t *);
 int tr_mcache_add_static_mapping(lisp_xtr_t *, mapping_t *);
 int tr_mcache_remove_entry(lisp_xtr_t *xtr, mcache_entry_t *mce);
 mapping_t *tr_mcache_lookup_mapping(lisp_xtr_t *, lisp_addr_t *);
+map_resolver_state_t *tr_mr_state(lisp_xtr_t *xtr, lisp_addr_t *mr);
 mapping_t *tr_mcache_lookup_mapping_exact(lisp_xtr_t *, lisp_addr_t *);
 
 
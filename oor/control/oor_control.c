@@ -245,6 +245,39 @@ ctrl_get_forwarding_info(packet_tuple_t *tuple)
     return (ctrl_dev_get_fwd_entry(dev, tuple));
 }
 
+/* Keep a copy of a packet without forwarding entry while the Map-Request of
+ * its destination is outstanding. Returns BAD if the packet should be
+ * dropped */
+int
+ctrl_queue_pending_packet(packet_tuple_t *tuple, lbuf_t *b)
+{
+    oor_ctrl_dev_t *dev;
+    dev = glist_first_data(lctrl->devices);
+    return (ctrl_dev_queue_pending_pkt(dev, tuple, b));
+}
+
+/* The source EID eid of a decapsulated packet was reached through rloc.
+ * The device may use it as a provisional mapping until its Map-Reply
+ * arrives */
+int
+ctrl_glean_mapping(lisp_addr_t *eid, lisp_addr_t *rloc, uint32_t iid)
+{
+    oor_ctrl_dev_t *dev;
+    dev = glist_first_data(lctrl->devices);
+    return (ctrl_dev_glean_mapping(dev, eid, rloc, iid));
+}
+
+/* The Locator-Status-Bits of the packets of the source EID eid received from
+ * rloc changed to lsb */
+int
+ctrl_lsb_changed(lisp_addr_t *eid, lisp_addr_t *rloc, uint32_t iid,
+        uint32_t lsb)
+{
+    oor_ctrl_dev_t *dev;
+    dev = glist_first_data(lctrl->devices);
+    return (ctrl_dev_lsb_changed(dev, eid, rloc, iid, lsb));
+}
+
 int
 ctrl_register_device(oor_ctrl_t *ctrl, oor_ctrl_dev_t *dev)
 {
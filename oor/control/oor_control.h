@@ -66,6 +66,10 @@ void ctrl_if_link_update(oor_ctrl_t *ctrl, iface_t *iface, int old_iface_index,
 void ctrl_route_update(oor_ctrl_t *ctrl, int command, iface_t *iface,lisp_addr_t *src_pref,
         lisp_addr_t *dst_pref, lisp_addr_t *gateway);
 fwd_info_t *ctrl_get_forwarding_info(packet_tuple_t *);
+int ctrl_queue_pending_packet(packet_tuple_t *tuple, lbuf_t *b);
+int ctrl_glean_mapping(lisp_addr_t *eid, lisp_addr_t *rloc, uint32_t iid);
+int ctrl_lsb_changed(lisp_addr_t *eid, lisp_addr_t *rloc, uint32_t iid,
+        uint32_t lsb);
 int ctrl_register_device(oor_ctrl_t *ctrl, oor_ctrl_dev_t *dev);
 
 int ctrl_register_eid_prefix(oor_ctrl_dev_t *dev, lisp_addr_t *eid_prefix);
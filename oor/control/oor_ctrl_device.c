@@ -121,6 +121,35 @@ ctrl_dev_get_fwd_entry(oor_ctrl_dev_t *dev, packet_tuple_t *tuple)
     return(dev->ctrl_class->get_fwd_entry(dev, tuple));
 }
 
+int
+ctrl_dev_queue_pending_pkt(oor_ctrl_dev_t *dev, packet_tuple_t *tuple, lbuf_t *b)
+{
+    if (!dev->ctrl_class->queue_pending_pkt){
+        return (BAD);
+    }
+    return(dev->ctrl_class->queue_pending_pkt(dev, tuple, b));
+}
+
+int
+ctrl_dev_glean_mapping(oor_ctrl_dev_t *dev, lisp_addr_t *eid,
+        lisp_addr_t *rloc, uint32_t iid)
+{
+    if (!dev->ctrl_class->glean_mapping){
+        return (BAD);
+    }
+    return(dev->ctrl_class->glean_mapping(dev, eid, rloc, iid));
+}
+
+int
+ctrl_dev_lsb_changed(oor_ctrl_dev_t *dev, lisp_addr_t *eid, lisp_addr_t *rloc,
+        uint32_t iid, uint32_t lsb)
+{
+    if (!dev->ctrl_class->lsb_changed){
+        return (BAD);
+    }
+    return(dev->ctrl_class->lsb_changed(dev, eid, rloc, iid, lsb));
+}
+
 inline oor_dev_type_e
 ctrl_dev_mode(oor_ctrl_dev_t *dev)
 {
@@ -46,6 +46,13 @@ typedef struct ctrl_dev_class_t {
             lisp_addr_t *, lisp_addr_t *);
 
     fwd_info_t *(*get_fwd_entry)(oor_ctrl_dev_t *, packet_tuple_t *);
+    /* Optional: hold a packet until the mapping of its destination is known */
+    int (*queue_pending_pkt)(oor_ctrl_dev_t *, packet_tuple_t *, lbuf_t *);
+    /* Optional: learn the mapping of the source of a decapsulated packet */
+    int (*glean_mapping)(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *, uint32_t);
+    /* Optional: process new Locator-Status-Bits of a remote RLOC */
+    int (*lsb_changed)(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *, uint32_t,
+            uint32_t);
 } ctrl_dev_class_t;
 
 
@@ -78,6 +85,11 @@ oor_dev_type_e ctrl_dev_mode(oor_ctrl_dev_t *dev);
 oor_ctrl_t * ctrl_dev_ctrl(oor_ctrl_dev_t *dev);
 int ctrl_dev_set_ctrl(oor_ctrl_dev_t *, oor_ctrl_t *);
 fwd_info_t *ctrl_dev_get_fwd_entry(oor_ctrl_dev_t *, packet_tuple_t *);
+int ctrl_dev_queue_pending_pkt(oor_ctrl_dev_t *, packet_tuple_t *, lbuf_t *);
+int ctrl_dev_glean_mapping(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *,
+        uint32_t);
+int ctrl_dev_lsb_changed(oor_ctrl_dev_t *, lisp_addr_t *, lisp_addr_t *,
+        uint32_t, uint32_t);
 
 
 /* PRIVATE functions, used by xtr and ms */
@@ -36,6 +36,7 @@ mcache_new()
         OOR_LOG(LCRIT, "Could create map cache db ");
         return(NULL);
     }
+    list_init(&mcdb->lru);
 
     return(mcdb);
 }
@@ -44,20 +45,137 @@ void
 mcache_del(map_cache_db_t *mcdb)
 {
     mdb_del(mcdb->db, (mdb_del_fct)mcache_entry_del);
+    free(mcdb->exp_heap);
     free(mcdb);
 }
 
 
+void
+mcache_set_limits(map_cache_db_t *mcdb, uint32_t max_entries,
+        uint64_t max_bytes, mcache_evict_policy_e policy)
+{
+    mcdb->max_entries = max_entries;
+    mcdb->max_bytes = max_bytes;
+    mcdb->evict_policy = policy;
+}
+
+char *
+mcache_evict_policy_to_char(mcache_evict_policy_e policy)
+{
+    switch (policy){
+    case MCACHE_EVICT_LRU:
+        return ("lru");
+    case MCACHE_EVICT_LFU:
+        return ("lfu");
+    case MCACHE_EVICT_TTL:
+        return ("ttl");
+    default:
+        return ("unknown");
+    }
+}
+
 int
 mcache_add_entry(map_cache_db_t *mcdb, lisp_addr_t *key, mcache_entry_t *mce)
 {
-    return(mdb_add_entry(mcdb->db, key, mce));
+    if (mdb_add_entry(mcdb->db, key, mce) != GOOD){
+        return (BAD);
+    }
+    if (mce->how_learned != MCE_DYNAMIC){
+        return (GOOD);
+    }
+
+    mce->last_used = time(NULL);
+    mce->mem_size = 0;
+    list_push_back(&mcdb->lru, &mce->lru_elt);
+    mcdb->entries++;
+    mcdb->stats.added++;
+    if (mcdb->entries > mcdb->stats.entries_hwm){
+        mcdb->stats.entries_hwm = mcdb->entries;
+    }
+    mcache_update_entry_size(mcdb, mce, mcache_entry_mem_size(mce));
+    return (GOOD);
 }
 
 void *
 mcache_remove_entry(map_cache_db_t *mcdb, lisp_addr_t *key)
 {
-    return(mdb_remove_entry(mcdb->db, key));
+    mcache_entry_t *mce;
+
+    mce = mdb_remove_entry(mcdb->db, key);
+    if (mce != NULL){
+        mcache_expiry_cancel(mcdb, mce);
+    }
+    if (mce != NULL && mce->how_learned == MCE_DYNAMIC){
+        list_remove(&mce->lru_elt);
+        mcdb->entries--;
+        mcdb->bytes -= mce->mem_size;
+    }
+    return (mce);
+}
+
+/* Account the new memory size of a dynamic entry */
+void
+mcache_update_entry_size(map_cache_db_t *mcdb, mcache_entry_t *mce,
+        uint32_t size)
+{
+    if (mce->how_learned != MCE_DYNAMIC){
+        return;
+    }
+    mcdb->bytes = mcdb->bytes - mce->mem_size + size;
+    mce->mem_size = size;
+    if (mcdb->bytes > mcdb->stats.bytes_hwm){
+        mcdb->stats.bytes_hwm = mcdb->bytes;
+    }
+}
+
+/* TRUE if a new dynamic entry of size bytes doesn't fit in the limits */
+uint8_t
+mcache_is_full(map_cache_db_t *mcdb, uint32_t size)
+{
+    if (mcdb->max_entries != 0 && mcdb->entries >= mcdb->max_entries){
+        return (TRUE);
+    }
+    if (mcdb->max_bytes != 0 && mcdb->bytes + size > mcdb->max_bytes){
+        return (TRUE);
+    }
+    return (FALSE);
+}
+
+/*
+ * Select the dynamic entry to be removed to make room for a new one. LFU and
+ * TTL only compare the least recently used entries that are active, so
+ * choosing the victim doesn't require walking the whole cache.
+ */
+mcache_entry_t *
+mcache_evict_candidate(map_cache_db_t *mcdb)
+{
+    mcache_entry_t *mce, *victim = NULL;
+    int samples = 0;
+
+    if (list_is_empty(&mcdb->lru)){
+        return (NULL);
+    }
+    if (mcdb->evict_policy == MCACHE_EVICT_LRU){
+        return (CONTAINER_OF(list_front(&mcdb->lru), mcache_entry_t, lru_elt));
+    }
+
+    LIST_FOR_EACH(mce, lru_elt, &mcdb->lru){
+        if (samples++ == MCACHE_EVICT_SAMPLES){
+            break;
+        }
+        if (mce->active == NOT_ACTIVE){
+            continue;
+        }
+        if (victim == NULL
+                || (mcdb->evict_policy == MCACHE_EVICT_LFU && mce->hits < victim->hits)
+                || (mcdb->evict_policy == MCACHE_EVICT_TTL && mce->expires < victim->expires)){
+            victim = mce;
+        }
+    }
+    if (victim == NULL){
+        victim = CONTAINER_OF(list_front(&mcdb->lru), mcache_entry_t, lru_elt);
+    }
+    return (victim);
 }
 
 
@@ -81,6 +199,131 @@ mcache_lookup_exact(map_cache_db_t *mcdb, lisp_addr_t *laddr)
 }
 
 
+void
+mcache_stats_dump(map_cache_db_t *mcdb, int log_level)
+{
+    if (is_loggable(log_level) == FALSE) {
+        return;
+    }
+
+    OOR_LOG(log_level, "Map cache: %u dynamic entries (max %u, high-water "
+            "mark %u), %"PRIu64" bytes (max %"PRIu64", high-water mark %"PRIu64
+            "), %"PRIu64" added, %"PRIu64" evicted (%s), %"PRIu64" expired, %"
+            PRIu64" refreshed", mcdb->entries, mcdb->max_entries,
+            mcdb->stats.entries_hwm, mcdb->bytes, mcdb->max_bytes,
+            mcdb->stats.bytes_hwm, mcdb->stats.added, mcdb->stats.evicted,
+            mcache_evict_policy_to_char(mcdb->evict_policy),
+            mcdb->stats.expired, mcdb->stats.refreshed);
+}
+
+static inline void
+mcache_expiry_set(map_cache_db_t *mcdb, uint32_t i, mcache_entry_t *mce)
+{
+    mcdb->exp_heap[i] = mce;
+    mce->exp_idx = i + 1;
+}
+
+/* Move up the entry at position i until its parent is due before it */
+static void
+mcache_expiry_up(map_cache_db_t *mcdb, uint32_t i)
+{
+    mcache_entry_t *mce = mcdb->exp_heap[i];
+    uint32_t parent;
+
+    while (i > 0){
+        parent = (i - 1) / 2;
+        if (mcdb->exp_heap[parent]->exp_due <= mce->exp_due){
+            break;
+        }
+        mcache_expiry_set(mcdb, i, mcdb->exp_heap[parent]);
+        i = parent;
+    }
+    mcache_expiry_set(mcdb, i, mce);
+}
+
+/* Move down the entry at position i until its children are due after it */
+static void
+mcache_expiry_down(map_cache_db_t *mcdb, uint32_t i)
+{
+    mcache_entry_t *mce = mcdb->exp_heap[i];
+    uint32_t child;
+
+    for (;;){
+        child = 2 * i + 1;
+        if (child >= mcdb->exp_size){
+            break;
+        }
+        if (child + 1 < mcdb->exp_size && mcdb->exp_heap[child + 1]->exp_due
+                < mcdb->exp_heap[child]->exp_due){
+            child++;
+        }
+        if (mce->exp_due <= mcdb->exp_heap[child]->exp_due){
+            break;
+        }
+        mcache_expiry_set(mcdb, i, mcdb->exp_heap[child]);
+        i = child;
+    }
+    mcache_expiry_set(mcdb, i, mce);
+}
+
+/* Check the expiration of the entry at due, replacing the previous time */
+void
+mcache_expiry_schedule(map_cache_db_t *mcdb, mcache_entry_t *mce, time_t due)
+{
+    uint32_t i;
+
+    if (mce->exp_idx != 0){
+        i = mce->exp_idx - 1;
+        mce->exp_due = due;
+        mcache_expiry_up(mcdb, i);
+        mcache_expiry_down(mcdb, mce->exp_idx - 1);
+        return;
+    }
+
+    if (mcdb->exp_size == mcdb->exp_cap){
+        mcdb->exp_cap = mcdb->exp_cap ? 2 * mcdb->exp_cap : 64;
+        mcdb->exp_heap = xrealloc(mcdb->exp_heap,
+                mcdb->exp_cap * sizeof(mcache_entry_t *));
+    }
+    mce->exp_due = due;
+    mcache_expiry_set(mcdb, mcdb->exp_size++, mce);
+    mcache_expiry_up(mcdb, mcdb->exp_size - 1);
+}
+
+void
+mcache_expiry_cancel(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    uint32_t i;
+    mcache_entry_t *last;
+
+    if (mce->exp_idx == 0){
+        return;
+    }
+    i = mce->exp_idx - 1;
+    mce->exp_idx = 0;
+    last = mcdb->exp_heap[--mcdb->exp_size];
+    if (last == mce){
+        return;
+    }
+    mcache_expiry_set(mcdb, i, last);
+    mcache_expiry_up(mcdb, i);
+    mcache_expiry_down(mcdb, last->exp_idx - 1);
+}
+
+/* Take out of the heap the next entry due at now, or NULL if there is none */
+mcache_entry_t *
+mcache_expiry_next(map_cache_db_t *mcdb, time_t now)
+{
+    mcache_entry_t *mce;
+
+    if (mcdb->exp_size == 0 || mcdb->exp_heap[0]->exp_due > now){
+        return (NULL);
+    }
+    mce = mcdb->exp_heap[0];
+    mcache_expiry_cancel(mcdb, mce);
+    return (mce);
+}
+
 void mcache_dump_db(map_cache_db_t *mcdb, int log_level)
 {
     if (is_loggable(log_level) == FALSE) {
@@ -20,17 +20,57 @@
 #ifndef OOR_MAP_CACAHE_DB_H_
 #define OOR_MAP_CACAHE_DB_H_
 
+#include <time.h>
+
 #include "../defs.h"
 #include "../lib/map_cache_entry.h"
 #include "../lib/mapping_db.h"
 #include "../liblisp/liblisp.h"
 
+/* Entries compared by LFU and TTL eviction, starting from the least
+ * recently used one */
+#define MCACHE_EVICT_SAMPLES    16
+
+/* Choice of the dynamic entry removed when the map cache is full */
+typedef enum mcache_evict_policy {
+    MCACHE_EVICT_LRU = 0,   /* Least recently used by the data plane */
+    MCACHE_EVICT_LFU,       /* Least frequently used */
+    MCACHE_EVICT_TTL        /* Closest to expire */
+} mcache_evict_policy_e;
+
+typedef struct mcache_stats_ {
+    uint64_t added;
+    uint64_t evicted;
+    uint64_t expired;
+    uint64_t refreshed;
+    uint32_t entries_hwm;
+    uint64_t bytes_hwm;
+} mcache_stats_t;
+
 typedef struct map_cache_db {
     mdb_t *db;
+    /* Dynamic entries from the least to the most recently used. Static
+     * entries are never evicted and are not accounted */
+    struct ovs_list lru;
+    uint32_t entries;
+    uint64_t bytes;
+    /* Limits of the dynamic entries. 0 means no limit */
+    uint32_t max_entries;
+    uint64_t max_bytes;
+    mcache_evict_policy_e evict_policy;
+    mcache_stats_t stats;
+    /* Min-heap of the entries ordered by exp_due. Expirations are processed
+     * by one periodic sweep instead of a timer per entry */
+    mcache_entry_t **exp_heap;
+    uint32_t exp_size;
+    uint32_t exp_cap;
 } map_cache_db_t;
 
 map_cache_db_t *mcache_new();
 void mcache_del(map_cache_db_t *mcdb);
+void mcache_set_limits(map_cache_db_t *mcdb, uint32_t max_entries,
+        uint64_t max_bytes, mcache_evict_policy_e policy);
+char *mcache_evict_policy_to_char(mcache_evict_policy_e policy);
 
 
 int mcache_add_entry(map_cache_db_t *, lisp_addr_t *key, mcache_entry_t *entry);
@@ -38,6 +78,14 @@ void *mcache_remove_entry(map_cache_db_t *, lisp_addr_t *key);
 void map_cache_del_entry(map_cache_db_t *, lisp_addr_t *laddr);
 mcache_entry_t *mcache_lookup_exact(map_cache_db_t *, lisp_addr_t *addr);
 mcache_entry_t *mcache_lookup(map_cache_db_t *, lisp_addr_t *addr);
+void mcache_update_entry_size(map_cache_db_t *, mcache_entry_t *mce,
+        uint32_t size);
+uint8_t mcache_is_full(map_cache_db_t *, uint32_t size);
+mcache_entry_t *mcache_evict_candidate(map_cache_db_t *);
+void mcache_stats_dump(map_cache_db_t *, int log_level);
+void mcache_expiry_schedule(map_cache_db_t *, mcache_entry_t *mce, time_t due);
+void mcache_expiry_cancel(map_cache_db_t *, mcache_entry_t *mce);
+mcache_entry_t *mcache_expiry_next(map_cache_db_t *, time_t now);
 
 void mcache_dump_db(map_cache_db_t *, int log_level);
 
@@ -56,6 +104,19 @@ void mcache_dump_db(map_cache_db_t *, int log_level);
         }                           \
     mdb_foreach_entry_end
 
+/* Data plane use of a dynamic entry */
+static inline void
+mcache_touch_entry(map_cache_db_t *mcdb, mcache_entry_t *mce)
+{
+    if (mce->how_learned != MCE_DYNAMIC){
+        return;
+    }
+    mce->last_used = time(NULL);
+    mce->hits++;
+    list_remove(&mce->lru_elt);
+    list_push_back(&mcdb->lru, &mce->lru_elt);
+}
+
 /* ugly .. */
 #define mcache_foreach_active_entry_in_ip_eid_db(_MC_, _EID_, _EIT_)  \
     mdb_foreach_entry_in_ip_eid_db((_MC_)->db, (_EID_), (_EIT_)){     \
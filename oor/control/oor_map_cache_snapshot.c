@@ -0,0 +1,233 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "oor_map_cache_snapshot.h"
+#include "../lib/mem_util.h"
+#include "../lib/oor_log.h"
+
+static int mcache_snapshot_put_entry(FILE *fp, mcache_entry_t *mce,
+        time_t now);
+
+
+/* Write an entry to the snapshot. Returns ERR_NO_EXIST if the entry has
+ * nothing worth keeping */
+static int
+mcache_snapshot_put_entry(FILE *fp, mcache_entry_t *mce, time_t now)
+{
+    mcache_snapshot_item_hdr_t ih;
+    void *rec;
+    lbuf_t *b;
+    int ret = GOOD;
+
+    if (mce->how_learned != MCE_DYNAMIC || mce->active == NOT_ACTIVE
+            || mce->gleaned || mce->expires <= now || mcache_has_locators(mce) == FALSE){
+        return (ERR_NO_EXIST);
+    }
+
+    b = lbuf_new(MAX_IP_PKT_LEN);
+    rec = lisp_msg_put_mapping(b, mcache_entry_mapping(mce), NULL);
+    /* Locators that are down are not stored */
+    if (rec == NULL || MAP_REC_LOC_COUNT(rec) == 0){
+        lbuf_del(b);
+        return (ERR_NO_EXIST);
+    }
+
+    ih.ttl = htonl(mce->expires - now);
+    ih.len = htons(lbuf_size(b));
+    if (fwrite(&ih, sizeof(mcache_snapshot_item_hdr_t), 1, fp) != 1
+            || fwrite(lbuf_data(b), lbuf_size(b), 1, fp) != 1){
+        ret = BAD;
+    }
+    lbuf_del(b);
+    return (ret);
+}
+
+/*
+ * Write the active dynamic entries of the map cache to file. The snapshot is
+ * written to a temporary file that replaces the previous one once complete,
+ * so a crash while writing never leaves a truncated snapshot.
+ */
+int
+mcache_snapshot_save(map_cache_db_t *mcdb, const char *file)
+{
+    mcache_snapshot_hdr_t hdr;
+    mcache_entry_t *mce;
+    char tmp[FILENAME_MAX];
+    time_t now = time(NULL);
+    uint32_t count = 0;
+    FILE *fp;
+    void *it;
+    int ret;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    fp = fopen(tmp, "wb");
+    if (fp == NULL){
+        OOR_LOG(LWRN, "mcache_snapshot_save: Couldn't open %s: %s", tmp,
+                strerror(errno));
+        return (BAD);
+    }
+
+    /* The number of entries is filled in at the end */
+    memset(&hdr, 0, sizeof(mcache_snapshot_hdr_t));
+    hdr.magic = htonl(MCACHE_SNAPSHOT_MAGIC);
+    hdr.version = htons(MCACHE_SNAPSHOT_VERSION);
+    hdr.timestamp = htonl(now);
+    if (fwrite(&hdr, sizeof(mcache_snapshot_hdr_t), 1, fp) != 1){
+        goto err;
+    }
+
+    mcache_foreach_entry(mcdb, it){
+        mce = (mcache_entry_t *)it;
+        ret = mcache_snapshot_put_entry(fp, mce, now);
+        if (ret == BAD){
+            goto err;
+        }
+        if (ret == GOOD){
+            count++;
+        }
+    } mcache_foreach_end;
+
+    hdr.count = htonl(count);
+    if (fseek(fp, 0, SEEK_SET) != 0
+            || fwrite(&hdr, sizeof(mcache_snapshot_hdr_t), 1, fp) != 1){
+        goto err;
+    }
+    if (fclose(fp) != 0){
+        fp = NULL;
+        goto err;
+    }
+    if (rename(tmp, file) != 0){
+        OOR_LOG(LWRN, "mcache_snapshot_save: Couldn't rename %s to %s: %s",
+                tmp, file, strerror(errno));
+        unlink(tmp);
+        return (BAD);
+    }
+
+    OOR_LOG(LDBG_1, "Map cache snapshot: %u entries saved to %s", count, file);
+    return (GOOD);
+err:
+    OOR_LOG(LWRN, "mcache_snapshot_save: Couldn't write %s: %s", tmp,
+            strerror(errno));
+    if (fp != NULL){
+        fclose(fp);
+    }
+    unlink(tmp);
+    return (BAD);
+}
+
+/*
+ * Read the snapshot in file and call fct for each of its mappings that has
+ * not expired yet, with the time it has left. Returns the number of mappings
+ * read or BAD if the file can't be used.
+ */
+int
+mcache_snapshot_load(const char *file, mcache_snapshot_restore_fct fct,
+        void *arg)
+{
+    mcache_snapshot_hdr_t hdr;
+    mcache_snapshot_item_hdr_t ih;
+    mapping_t *m;
+    lbuf_t b;
+    uint8_t *rec;
+    uint32_t count, ttl, i;
+    long age;
+    uint16_t len;
+    int restored = 0;
+    FILE *fp;
+
+    fp = fopen(file, "rb");
+    if (fp == NULL){
+        OOR_LOG(LDBG_1, "Map cache snapshot: Couldn't open %s: %s", file,
+                strerror(errno));
+        return (BAD);
+    }
+
+    if (fread(&hdr, sizeof(mcache_snapshot_hdr_t), 1, fp) != 1
+            || ntohl(hdr.magic) != MCACHE_SNAPSHOT_MAGIC){
+        OOR_LOG(LWRN, "Map cache snapshot: %s is not a map cache snapshot",
+                file);
+        fclose(fp);
+        return (BAD);
+    }
+    if (ntohs(hdr.version) != MCACHE_SNAPSHOT_VERSION){
+        OOR_LOG(LWRN, "Map cache snapshot: Unsupported version %u of %s",
+                ntohs(hdr.version), file);
+        fclose(fp);
+        return (BAD);
+    }
+
+    count = ntohl(hdr.count);
+    age = time(NULL) - (time_t)ntohl(hdr.timestamp);
+    if (age < 0){
+        age = 0;
+    }
+
+    for (i = 0; i < count; i++){
+        if (fread(&ih, sizeof(mcache_snapshot_item_hdr_t), 1, fp) != 1){
+            break;
+        }
+        len = ntohs(ih.len);
+        rec = xmalloc(len);
+        if (fread(rec, 1, len, fp) != len){
+            free(rec);
+            break;
+        }
+        ttl = ntohl(ih.ttl);
+        if (ttl <= age){
+            free(rec);
+            continue;
+        }
+
+        /* The buffer is released with the lbuf */
+        lbuf_use(&b, rec, len);
+        lbuf_set_size(&b, len);
+        m = mapping_new();
+        if (lisp_msg_parse_mapping_record(&b, m, NULL) != GOOD){
+            OOR_LOG(LDBG_1, "Map cache snapshot: Wrong record in %s", file);
+            mapping_del(m);
+            lbuf_uninit(&b);
+            continue;
+        }
+        lbuf_uninit(&b);
+        if (fct(arg, m, ttl - age) == GOOD){
+            restored++;
+        }
+    }
+    if (i < count){
+        OOR_LOG(LWRN, "Map cache snapshot: %s is truncated", file);
+    }
+    fclose(fp);
+
+    OOR_LOG(LDBG_1, "Map cache snapshot: %d of %u entries restored from %s "
+            "(taken %ld seconds ago)", restored, count, file, age);
+    return (restored);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,58 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OOR_MAP_CACHE_SNAPSHOT_H_
+#define OOR_MAP_CACHE_SNAPSHOT_H_
+
+#include "oor_map_cache.h"
+
+/*
+ * Snapshot of the map cache used to restart with the mappings that were in
+ * use. The file has a header followed by one item per active dynamic entry:
+ * the seconds left before it expires, the length of the record and the
+ * mapping encoded as a Map-Reply record (EID with its IID and locators).
+ * All the fields are in network byte order.
+ */
+
+#define MCACHE_SNAPSHOT_MAGIC       0x4f4f524d  /* "OORM" */
+#define MCACHE_SNAPSHOT_VERSION     1
+
+typedef struct mcache_snapshot_hdr_ {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t count;
+    uint32_t timestamp;     /* When the snapshot was taken */
+} __attribute__ ((__packed__)) mcache_snapshot_hdr_t;
+
+typedef struct mcache_snapshot_item_hdr_ {
+    uint32_t ttl;           /* Seconds left when the snapshot was taken */
+    uint16_t len;           /* Length of the record that follows */
+} __attribute__ ((__packed__)) mcache_snapshot_item_hdr_t;
+
+/* Called for each mapping read from the snapshot with its remaining time to
+ * live in seconds. It takes ownership of the mapping */
+typedef int (*mcache_snapshot_restore_fct)(void *arg, mapping_t *m,
+        uint32_t ttl);
+
+int mcache_snapshot_save(map_cache_db_t *mcdb, const char *file);
+int mcache_snapshot_load(const char *file, mcache_snapshot_restore_fct fct,
+        void *arg);
+
+#endif /* OOR_MAP_CACHE_SNAPSHOT_H_ */
@@ -38,6 +38,12 @@ typedef struct data_plane_struct {
             lisp_addr_t *dst_pref, lisp_addr_t *gw);
     int (*datap_updated_addr)(iface_t *iface,lisp_addr_t *old_addr,lisp_addr_t *new_addr);
     int (*datap_update_link)(iface_t *iface, int old_iface_index, int new_iface_index, int status);
+    /* Send a packet that was waiting for the mapping of its destination */
+    int (*datap_send_pending_packet)(lbuf_t *b, uint32_t iid);
+    /* Forget the forwarding info cached for the flows that use rloc, or for
+     * all the flows if rloc is NULL, so it is obtained again for their next
+     * packet */
+    int (*datap_flush_flows)(lisp_addr_t *rloc);
 
     void *datap_data;
 } data_plane_struct_t;
@@ -46,6 +52,7 @@ void data_plane_select();
 
 extern data_plane_struct_t dplane_tun;
 extern data_plane_struct_t dplane_vpnapi;
+extern data_plane_struct_t dplane_pcap;
 
 
 #endif /* DATA_PLANE_H_ */
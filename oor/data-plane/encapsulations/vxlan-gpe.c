@@ -50,11 +50,12 @@ vxlan_gpe_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra
     /* read ttl and tos */
     ip_hdr_ttl_and_tos(lbuf_data(b), &ttl, &tos);
 
-    switch (lisp_addr_ip_afi(la)){
-    case AF_INET:
+    /* The next protocol is the one of the encapsulated packet */
+    switch (((struct ip *)lbuf_data(b))->ip_v){
+    case IPVERSION:
         next_prot = NP_IPv4;
         break;
-    case AF_INET6:
+    case IP6VERSION:
         next_prot = NP_IPv6;
         break;
     default:
@@ -73,6 +74,45 @@ vxlan_gpe_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra
     return(lbuf_data(b));
 }
 
+/* Build in hdr the outer IP, UDP and VXLAN-GPE headers to encapsulate b.
+ * The packet to encapsulate is not modified */
+void *
+vxlan_gpe_data_encap_hdr(lbuf_t *hdr, lbuf_t *b, int lp, int rp,
+        lisp_addr_t *la, lisp_addr_t *ra, uint32_t vni)
+{
+    int ttl = 0, tos = 0;
+    vxlan_gpe_nprot_t next_prot;
+
+    /* read ttl and tos */
+    ip_hdr_ttl_and_tos(lbuf_data(b), &ttl, &tos);
+
+    /* The next protocol is the one of the encapsulated packet */
+    switch (((struct ip *)lbuf_data(b))->ip_v){
+    case IPVERSION:
+        next_prot = NP_IPv4;
+        break;
+    case IP6VERSION:
+        next_prot = NP_IPv6;
+        break;
+    default:
+        OOR_LOG(LDBG_1, "vxlan_gpe_data_encap_hdr: Next protocol not supported");
+        return (NULL);
+    }
+
+    /* push vxlan-gpe data hdr */
+    vxlan_gpe_data_push_hdr(hdr, vni, next_prot);
+
+    /* push outer UDP and IP */
+    if (pkt_push_udp_and_ip_sg(hdr, b, lp, rp, lisp_addr_ip(la),
+            lisp_addr_ip(ra)) != GOOD){
+        return (NULL);
+    }
+
+    ip_hdr_set_ttl_and_tos(lbuf_data(hdr), ttl, tos);
+
+    return(lbuf_data(hdr));
+}
+
 void *
 vxlan_gpe_data_pull_hdr(lbuf_t *b)
 {
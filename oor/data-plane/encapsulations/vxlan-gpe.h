@@ -69,9 +69,13 @@
      NP_MLS = 0x5
  }vxlan_gpe_nprot_t;
 
+void vxlan_gpe_data_hdr_init(vxlan_gpe_hdr_t *vhdr, uint32_t vni,
+        vxlan_gpe_nprot_t np);
 void * vxlan_gpe_data_push_hdr(lbuf_t *b, uint32_t vni, vxlan_gpe_nprot_t np);
 void * vxlan_gpe_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra,
         uint32_t vni);
+void * vxlan_gpe_data_encap_hdr(lbuf_t *hdr, lbuf_t *b, int lp, int rp,
+        lisp_addr_t *la, lisp_addr_t *ra, uint32_t vni);
 void * vxlan_gpe_data_pull_hdr(lbuf_t *b);
 
 uint32_t vxlan_gpe_hdr_get_vni(vxlan_gpe_hdr_t *hdr);
@@ -0,0 +1,668 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/timerfd.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+
+#include "pcap.h"
+#include "../tun/tun.h"
+#include "../tun/tun_input.h"
+#include "../tun/tun_output.h"
+#include "../../oor.h"
+#include "../../oor_external.h"
+#include "../../lib/packets.h"
+#include "../../lib/mem_util.h"
+#include "../../lib/oor_log.h"
+
+#define NSEC_PER_SEC    1000000000ULL
+
+int pcap_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...);
+void pcap_uninit_data_plane();
+int pcap_add_datap_iface_addr(iface_t *iface,int afi);
+int pcap_add_eid_prefix(oor_dev_type_e dev_type, lisp_addr_t *eid_prefix);
+int pcap_remove_eid_prefix(oor_dev_type_e dev_type, lisp_addr_t *eid_prefix);
+int pcap_updated_route(int command, iface_t *iface, lisp_addr_t *src_pref,
+        lisp_addr_t *dst_pref, lisp_addr_t *gw);
+int pcap_updated_addr(iface_t *iface,lisp_addr_t *old_addr,lisp_addr_t *new_addr);
+int pcap_updated_link(iface_t *iface, int old_iface_index, int new_iface_index, int status);
+int pcap_process_burst(sock_t *sl);
+
+static int pcap_input_open(pcap_dplane_input_t *in, char *name, int buf_len);
+static void pcap_input_close(pcap_dplane_input_t *in);
+static void pcap_input_next(pcap_dplane_input_t *in);
+static int pcap_send_packet(lbuf_t *hdr, lbuf_t *b, int sock, lisp_addr_t *dst);
+static int pcap_write_to_host(lbuf_t *b);
+static void pcap_process_inner(pcap_dplane_data_t *data, int *nburst);
+static void pcap_flush_inner(pcap_dplane_data_t *data, int *nburst);
+static void pcap_process_outer(pcap_dplane_data_t *data);
+static pcap_dplane_input_t *pcap_next_input(pcap_dplane_data_t *data);
+static uint64_t pcap_packet_due_ns(pcap_dplane_data_t *data, struct timespec *ts);
+static void pcap_trigger_arm(pcap_dplane_data_t *data, uint64_t due_ns);
+static void pcap_dump_stats(pcap_dplane_data_t *data, int log_level);
+static inline uint64_t timespec_to_ns(struct timespec *ts);
+static inline int timespec_cmp(struct timespec *a, struct timespec *b);
+
+data_plane_struct_t dplane_pcap = {
+        .datap_init = pcap_configure_data_plane,
+        .datap_uninit = pcap_uninit_data_plane,
+        .datap_add_iface_addr = pcap_add_datap_iface_addr,
+        .datap_add_eid_prefix = pcap_add_eid_prefix,
+        .datap_remove_eid_prefix = pcap_remove_eid_prefix,
+        .datap_input_packet = pcap_process_burst,
+        .datap_rtr_input_packet = pcap_process_burst,
+        .datap_output_packet = pcap_process_burst,
+        .datap_updated_route = pcap_updated_route,
+        .datap_updated_addr = pcap_updated_addr,
+        .datap_update_link = pcap_updated_link,
+        .datap_send_pending_packet = tun_output_pending,
+        .datap_flush_flows = tun_output_flush_flows,
+        .datap_data = NULL
+};
+
+static pcap_dplane_conf_t pcap_conf;
+/* buffers used to process packets. Same sizes as in the tun data plane */
+static uint8_t *inner_pkt_bufs;
+static lbuf_t inner_bufs[PCAP_DPLANE_MAX_BURST];
+static uint8_t *outer_pkt_buf;
+static lbuf_t pkt_buf;
+static int pkt_buf_len;
+
+
+static inline uint64_t
+timespec_to_ns(struct timespec *ts)
+{
+    return ((uint64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec);
+}
+
+static inline int
+timespec_cmp(struct timespec *a, struct timespec *b)
+{
+    if (a->tv_sec != b->tv_sec){
+        return (a->tv_sec < b->tv_sec ? -1 : 1);
+    }
+    if (a->tv_nsec != b->tv_nsec){
+        return (a->tv_nsec < b->tv_nsec ? -1 : 1);
+    }
+    return (0);
+}
+
+/* Store the configuration of the pcap data plane. Called while parsing the
+ * configuration file, before the data plane is initialized */
+void
+pcap_dplane_set_conf(pcap_dplane_conf_t *conf)
+{
+    pcap_conf = *conf;
+}
+
+int
+pcap_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
+{
+    pcap_dplane_data_t *data;
+
+    if (!pcap_conf.inner_input && !pcap_conf.outer_input){
+        OOR_LOG(LERR, "pcap data plane: No input pcap file configured");
+        return (BAD);
+    }
+
+    data = xzalloc(sizeof(pcap_dplane_data_t));
+    dplane_pcap.datap_data = (void *)data;
+    data->dev_type = dev_type;
+    data->encap_type = encap_type;
+    data->speed = pcap_conf.speed;
+    data->burst = pcap_conf.burst > 0 ? pcap_conf.burst : 1;
+    data->exit_at_end = pcap_conf.exit_at_end;
+    data->trigger_fd[0] = data->trigger_fd[1] = -1;
+
+    pkt_buf_len = pkt_buf_conf.headroom + pkt_buf_conf.size;
+    inner_pkt_bufs = xmalloc(PCAP_DPLANE_MAX_BURST * pkt_buf_len);
+    outer_pkt_buf = xmalloc(pkt_buf_len);
+
+    if (pcap_conf.inner_input && dev_type != RTR_MODE){
+        if (pcap_input_open(&data->inner, pcap_conf.inner_input,
+                pkt_buf_conf.size) != GOOD){
+            goto err;
+        }
+    }
+    if (pcap_conf.outer_input){
+        if (pcap_input_open(&data->outer, pcap_conf.outer_input,
+                pkt_buf_conf.size) != GOOD){
+            goto err;
+        }
+    }
+    if (pcap_conf.encap_output){
+        if ((data->encap_out = pcap_file_open_write(pcap_conf.encap_output)) == NULL){
+            goto err;
+        }
+    }
+    if (pcap_conf.decap_output && dev_type != RTR_MODE){
+        if ((data->decap_out = pcap_file_open_write(pcap_conf.decap_output)) == NULL){
+            goto err;
+        }
+    }
+
+    /* The packets are processed in bursts from the main loop, so control
+     * messages and timers are still attended between bursts. With virtual
+     * time, an always readable pipe makes the socket master call us on each
+     * iteration. With accelerated time, a timer calls us when the next
+     * packet is due */
+    if (data->speed > 0){
+        data->trigger_fd[0] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (data->trigger_fd[0] == -1){
+            OOR_LOG(LERR, "pcap data plane: Couldn't create trigger timer: %s",
+                    strerror(errno));
+            goto err;
+        }
+        pcap_trigger_arm(data, 0);
+    }else if (pipe(data->trigger_fd) != 0
+            || write(data->trigger_fd[1], "", 1) != 1){
+        OOR_LOG(LERR, "pcap data plane: Couldn't create trigger pipe: %s",
+                strerror(errno));
+        goto err;
+    }
+    data->trigger_sock = sockmstr_register_read_listener(smaster,
+            pcap_process_burst, NULL, data->trigger_fd[0]);
+
+    tun_output_set_send_fct(pcap_send_packet);
+    tun_output_set_host_fct(dev_type == RTR_MODE ? tun_output_to_eid
+            : pcap_write_to_host);
+    tun_output_init();
+    clock_gettime(CLOCK_MONOTONIC, &data->start_wall);
+
+    OOR_LOG(LINF, "pcap data plane: inner input: %s, outer input: %s, "
+            "speed: %s, burst: %d", pcap_conf.inner_input ? pcap_conf.inner_input : "-",
+            pcap_conf.outer_input ? pcap_conf.outer_input : "-",
+            data->speed ? "accelerated" : "virtual", data->burst);
+
+    return (GOOD);
+err:
+    pcap_uninit_data_plane();
+    return (BAD);
+}
+
+void
+pcap_uninit_data_plane()
+{
+    pcap_dplane_data_t *data = (pcap_dplane_data_t *)dplane_pcap.datap_data;
+
+    if (!data){
+        return;
+    }
+    /* The output path is only initialized once the listener is registered.
+     * Unregistering the listener also closes its fd */
+    if (data->trigger_sock){
+        sockmstr_unregister_read_listenedr(smaster, data->trigger_sock);
+        tun_output_uninit();
+    }else if (data->trigger_fd[0] != -1){
+        close(data->trigger_fd[0]);
+    }
+    if (data->trigger_fd[1] != -1){
+        close(data->trigger_fd[1]);
+    }
+    pcap_input_close(&data->inner);
+    pcap_input_close(&data->outer);
+    pcap_file_close(data->encap_out);
+    pcap_file_close(data->decap_out);
+    free(data);
+    dplane_pcap.datap_data = NULL;
+    free(inner_pkt_bufs);
+    inner_pkt_bufs = NULL;
+    free(outer_pkt_buf);
+    outer_pkt_buf = NULL;
+}
+
+/* There is no system state to configure: interfaces, routes and EIDs only
+ * exist in the control plane */
+int
+pcap_add_datap_iface_addr(iface_t *iface, int afi)
+{
+    return (GOOD);
+}
+
+int
+pcap_add_eid_prefix(oor_dev_type_e dev_type, lisp_addr_t *eid_prefix)
+{
+    return (GOOD);
+}
+
+int
+pcap_remove_eid_prefix(oor_dev_type_e dev_type, lisp_addr_t *eid_prefix)
+{
+    return (GOOD);
+}
+
+int
+pcap_updated_route(int command, iface_t *iface, lisp_addr_t *src_pref,
+        lisp_addr_t *dst_pref, lisp_addr_t *gw)
+{
+    return (GOOD);
+}
+
+int
+pcap_updated_addr(iface_t *iface, lisp_addr_t *old_addr, lisp_addr_t *new_addr)
+{
+    return (GOOD);
+}
+
+int
+pcap_updated_link(iface_t *iface, int old_iface_index, int new_iface_index,
+        int status)
+{
+    return (GOOD);
+}
+
+static int
+pcap_input_open(pcap_dplane_input_t *in, char *name, int buf_len)
+{
+    in->pf = pcap_file_open_read(name);
+    if (in->pf == NULL){
+        return (BAD);
+    }
+    in->buf = xmalloc(buf_len);
+    in->len = buf_len;
+    pcap_input_next(in);
+    return (GOOD);
+}
+
+static void
+pcap_input_close(pcap_dplane_input_t *in)
+{
+    pcap_file_close(in->pf);
+    free(in->buf);
+    in->pf = NULL;
+    in->buf = NULL;
+    in->len = 0;
+}
+
+/* Read the next packet of the stream. in->len must contain the size of the
+ * buffer when not at the end of the file */
+static void
+pcap_input_next(pcap_dplane_input_t *in)
+{
+    int len;
+
+    if (in->pf == NULL){
+        in->len = 0;
+        return;
+    }
+    len = pcap_file_read_ip(in->pf, in->buf, in->len, &in->ts);
+    in->len = len > 0 ? len : 0;
+}
+
+static int
+pcap_send_packet(lbuf_t *hdr, lbuf_t *b, int sock, lisp_addr_t *dst)
+{
+    pcap_dplane_data_t *data = (pcap_dplane_data_t *)dplane_pcap.datap_data;
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    if (data->encap_out == NULL){
+        data->dropped_pkts++;
+        return (GOOD);
+    }
+    if (hdr){
+        iov[iovcnt].iov_base = lbuf_data(hdr);
+        iov[iovcnt++].iov_len = lbuf_size(hdr);
+    }
+    iov[iovcnt].iov_base = lbuf_data(b);
+    iov[iovcnt++].iov_len = lbuf_size(b);
+    return (pcap_file_writev(data->encap_out, iov, iovcnt, &data->now));
+}
+
+/* Packets generated for the host go where the decapsulated ones do */
+static int
+pcap_write_to_host(lbuf_t *b)
+{
+    pcap_dplane_data_t *data = (pcap_dplane_data_t *)dplane_pcap.datap_data;
+
+    if (data->decap_out == NULL){
+        data->dropped_pkts++;
+        return (GOOD);
+    }
+    return (pcap_file_write(data->decap_out, lbuf_data(b), lbuf_size(b),
+            &data->now));
+}
+
+/* Same processing as tun_output_recv. With bursts, the packet is queued and
+ * the queue processed once full */
+static void
+pcap_process_inner(pcap_dplane_data_t *data, int *nburst)
+{
+    pcap_dplane_input_t *in = &data->inner;
+    lbuf_t *b = &inner_bufs[*nburst];
+    packet_tuple_t tpl;
+
+    lbuf_use_stack(b, inner_pkt_bufs + *nburst * pkt_buf_len, pkt_buf_len);
+    lbuf_reserve(b, pkt_buf_conf.headroom);
+    memcpy(lbuf_put_uninit(b, in->len), in->buf, in->len);
+    data->inner_pkts++;
+
+    if (data->burst > 1){
+        if (++(*nburst) == data->burst){
+            pcap_flush_inner(data, nburst);
+        }
+        return;
+    }
+
+    lbuf_reset_ip(b);
+    if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+        data->dropped_pkts++;
+        return;
+    }
+    tpl.iid = 0;
+    tun_output(b, &tpl);
+}
+
+static void
+pcap_flush_inner(pcap_dplane_data_t *data, int *nburst)
+{
+    if (*nburst == 0){
+        return;
+    }
+    tun_output_burst(inner_bufs, NULL, *nburst);
+    *nburst = 0;
+}
+
+/* Same processing as tun_process_input_packet and tun_rtr_process_input_packet.
+ * The outer header is parsed here to obtain what the raw sockets provide */
+static void
+pcap_process_outer(pcap_dplane_data_t *data)
+{
+    pcap_dplane_input_t *in = &data->outer;
+    struct ip *iph;
+    struct ip6_hdr *ip6h;
+    struct udphdr *udph;
+    packet_tuple_t tpl;
+    lisp_addr_t src;
+    sock_data_info_t info;
+    uint8_t ttl, tos, handled;
+    uint32_t iid;
+    int afi, hlen;
+
+    lbuf_use_stack(&pkt_buf, outer_pkt_buf, pkt_buf_len);
+    lbuf_reserve(&pkt_buf, pkt_buf_conf.headroom);
+    memcpy(lbuf_put_uninit(&pkt_buf, in->len), in->buf, in->len);
+    data->outer_pkts++;
+
+    /* Captures may be truncated: check the length before reading a field */
+    if (in->len < sizeof(struct ip)){
+        data->dropped_pkts++;
+        return;
+    }
+
+    iph = lbuf_data(&pkt_buf);
+    switch (iph->ip_v){
+    case IPVERSION:
+        afi = AF_INET;
+        hlen = iph->ip_hl << 2;
+        if (hlen < sizeof(struct ip) || in->len < hlen){
+            data->dropped_pkts++;
+            return;
+        }
+        if (iph->ip_p == IPPROTO_ICMP){
+            tun_output_icmp_input((uint8_t *)iph + hlen, in->len - hlen,
+                    AF_INET);
+            return;
+        }
+        ttl = iph->ip_ttl;
+        tos = iph->ip_tos;
+        lisp_addr_ip_init(&src, &iph->ip_src, AF_INET);
+        break;
+    case IP6VERSION:
+        /* IPv6 raw sockets don't provide the IPv6 header */
+        if (in->len < sizeof(struct ip6_hdr)){
+            data->dropped_pkts++;
+            return;
+        }
+        ip6h = (struct ip6_hdr *)iph;
+        afi = AF_INET6;
+        hlen = sizeof(struct ip6_hdr);
+        ttl = ip6h->ip6_hlim;
+        tos = (ntohl(ip6h->ip6_flow) >> 20) & 0xff;
+        lisp_addr_ip_init(&src, &ip6h->ip6_src, AF_INET6);
+        lbuf_pull(&pkt_buf, sizeof(struct ip6_hdr));
+        if (ip6h->ip6_nxt == IPPROTO_ICMPV6){
+            tun_output_icmp_input(lbuf_data(&pkt_buf), lbuf_size(&pkt_buf),
+                    AF_INET6);
+            return;
+        }
+        break;
+    default:
+        data->dropped_pkts++;
+        return;
+    }
+
+    /* The whole UDP datagram has to be in the capture */
+    udph = (struct udphdr *)((uint8_t *)iph + hlen);
+    if (in->len < hlen + sizeof(struct udphdr)
+            || in->len - hlen < ntohs(udplen(udph))){
+        data->dropped_pkts++;
+        return;
+    }
+
+    if (data->dev_type == RTR_MODE && reencaps){
+        info.afi = afi;
+        info.ttl = ttl;
+        info.tos = tos;
+        info.src = src;
+        if (tun_output_reencap(&pkt_buf, &info, 1, &handled) == 0 && handled){
+            data->dropped_pkts++;
+        }
+        if (handled){
+            return;
+        }
+    }
+
+    switch (tun_decap_pkt(&pkt_buf, afi, ttl, tos, &iid)){
+    case GOOD:
+        break;
+    case ERR_NOT_ENCAP:
+        data->not_encap_pkts++;
+        return;
+    default:
+        data->dropped_pkts++;
+        return;
+    }
+
+    tun_input_lisp_hdr(&pkt_buf, &src, iid);
+    if (data->dev_type != RTR_MODE){
+        tun_input_glean(&pkt_buf, &src, iid);
+        if (data->decap_out){
+            pcap_file_write(data->decap_out, lbuf_l3(&pkt_buf),
+                    lbuf_size(&pkt_buf), &data->now);
+        }
+        return;
+    }
+
+    lbuf_point_to_l3(&pkt_buf);
+    lbuf_reset_ip(&pkt_buf);
+    if (pkt_parse_5_tuple(&pkt_buf, &tpl) != GOOD) {
+        data->dropped_pkts++;
+        return;
+    }
+    tpl.iid = iid;
+    tun_output(&pkt_buf, &tpl);
+    if (reencaps){
+        tun_output_reencap_learn(&pkt_buf, &src, iid);
+    }
+}
+
+/* Input with the next packet in timestamp order */
+static pcap_dplane_input_t *
+pcap_next_input(pcap_dplane_data_t *data)
+{
+    if (data->outer.len == 0 || (data->inner.len != 0
+            && timespec_cmp(&data->inner.ts, &data->outer.ts) <= 0)){
+        return (&data->inner);
+    }
+    return (&data->outer);
+}
+
+/* Monotonic time at which the packet is processed. With virtual time all
+ * the packets are due. Otherwise it is the accelerated capture time of the
+ * packet */
+static uint64_t
+pcap_packet_due_ns(pcap_dplane_data_t *data, struct timespec *ts)
+{
+    if (data->speed <= 0){
+        return (0);
+    }
+    return (timespec_to_ns(&data->start_wall)
+            + (timespec_to_ns(ts) - timespec_to_ns(&data->first_ts)) / data->speed);
+}
+
+/* Program the trigger timer to expire at due_ns. A time already passed
+ * makes it expire straight away */
+static void
+pcap_trigger_arm(pcap_dplane_data_t *data, uint64_t due_ns)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    /* A zero value would disarm the timer */
+    if (due_ns == 0){
+        due_ns = 1;
+    }
+    its.it_value.tv_sec = due_ns / NSEC_PER_SEC;
+    its.it_value.tv_nsec = due_ns % NSEC_PER_SEC;
+    if (timerfd_settime(data->trigger_fd[0], TFD_TIMER_ABSTIME, &its, NULL) != 0){
+        OOR_LOG(LERR, "pcap data plane: Couldn't program trigger timer: %s",
+                strerror(errno));
+    }
+}
+
+static void
+pcap_dump_stats(pcap_dplane_data_t *data, int log_level)
+{
+    uint64_t pkts = data->inner_pkts + data->outer_pkts;
+    double cpu_s = (double)data->cpu_ns / NSEC_PER_SEC;
+
+    OOR_LOG(log_level, "pcap data plane: %"PRIu64" packets processed (inner: %"
+            PRIu64", outer: %"PRIu64", not encapsulated: %"PRIu64
+            ", dropped: %"PRIu64")", pkts, data->inner_pkts, data->outer_pkts,
+            data->not_encap_pkts, data->dropped_pkts);
+    OOR_LOG(log_level, "pcap data plane: %.3f s of CPU, %.0f packets/s",
+            cpu_s, cpu_s > 0 ? pkts / cpu_s : 0);
+    tun_input_stats_dump(log_level);
+    if (data->encap_out){
+        OOR_LOG(log_level, "pcap data plane: %"PRIu64" packets written to %s",
+                data->encap_out->pkts, data->encap_out->name);
+    }
+    if (data->decap_out){
+        OOR_LOG(log_level, "pcap data plane: %"PRIu64" packets written to %s",
+                data->decap_out->pkts, data->decap_out->name);
+    }
+    tun_output_burst_stats_dump(log_level);
+}
+
+/*
+ * Process up to PCAP_DPLANE_BURST packets of the inputs in timestamp order
+ */
+int
+pcap_process_burst(sock_t *sl)
+{
+    pcap_dplane_data_t *data = (pcap_dplane_data_t *)dplane_pcap.datap_data;
+    pcap_dplane_input_t *in;
+    struct timespec cpu_start, cpu_end, wall;
+    uint64_t due_ns = 0, wall_ns = 0, expirations;
+    char trigger;
+    int i, nburst = 0;
+
+    if (!data){
+        return (BAD);
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    if (data->speed > 0){
+        /* Consume the expiration of the trigger timer */
+        if (read(data->trigger_fd[0], &expirations, sizeof(expirations)) == -1
+                && errno != EAGAIN){
+            OOR_LOG(LDBG_1, "pcap data plane: Couldn't read trigger timer");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &wall);
+        wall_ns = timespec_to_ns(&wall);
+    }
+    for (i = 0; i < PCAP_DPLANE_BURST; i++){
+        if (data->inner.len == 0 && data->outer.len == 0){
+            break;
+        }
+        in = pcap_next_input(data);
+        if (data->inner_pkts + data->outer_pkts == 0){
+            data->first_ts = in->ts;
+        }
+        due_ns = pcap_packet_due_ns(data, &in->ts);
+        if (due_ns > wall_ns){
+            break;
+        }
+
+        if (in == &data->inner){
+            data->now = in->ts;
+            pcap_process_inner(data, &nburst);
+            in->len = pkt_buf_conf.size;
+        }else{
+            /* Keep the order between the inputs */
+            pcap_flush_inner(data, &nburst);
+            data->now = in->ts;
+            pcap_process_outer(data);
+            in->len = pkt_buf_conf.size;
+        }
+        pcap_input_next(in);
+    }
+    pcap_flush_inner(data, &nburst);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    data->cpu_ns += timespec_to_ns(&cpu_end) - timespec_to_ns(&cpu_start);
+
+    if (data->inner.len != 0 || data->outer.len != 0){
+        /* Wait for the next packet, or continue straight away after a full
+         * burst */
+        if (data->speed > 0){
+            pcap_trigger_arm(data, i == PCAP_DPLANE_BURST ? 0 : due_ns);
+        }
+        return (GOOD);
+    }
+
+    /* End of the inputs. The listener can not be unregistered while the
+     * socket master is iterating the list: just stop being readable. The
+     * trigger timer is not armed again */
+    pcap_dump_stats(data, LINF);
+    if (data->speed <= 0 && read(data->trigger_fd[0], &trigger, 1) != 1){
+        OOR_LOG(LDBG_1, "pcap data plane: Couldn't drain trigger pipe");
+    }
+    if (data->encap_out){
+        fflush(data->encap_out->fp);
+    }
+    if (data->decap_out){
+        fflush(data->decap_out->fp);
+    }
+    if (data->exit_at_end){
+        exit_cleanup();
+    }
+    return (GOOD);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
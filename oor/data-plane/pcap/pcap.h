@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PCAP_H_
+#define PCAP_H_
+
+#include "pcap_file.h"
+#include "../data-plane.h"
+#include "../tun/tun_output.h"
+
+/*
+ * Offline data plane. Instead of a tun device and raw sockets, packets are
+ * read from pcap files and the resulting packets are written to pcap files.
+ * Packets follow exactly the same encapsulation and decapsulation code than
+ * with the tun data plane:
+ *  - inner-input: Packets that would be read from the tun (EID space). They
+ *    are processed by tun_output and the encapsulated packets are written to
+ *    encap-output.
+ *  - outer-input: Packets that would be received by the data sockets. They
+ *    are decapsulated and written to decap-output (xTR, MN) or
+ *    re-encapsulated and written to encap-output (RTR).
+ * Both inputs are merged according to their timestamps. With speed 0 the
+ * packets are processed as fast as possible and the outputs are stamped with
+ * the timestamp of the input packet that generated them (virtual time), so
+ * the outputs of two runs can be compared byte by byte. With speed N, the
+ * original inter-packet gaps are reproduced N times faster.
+ * With burst N > 1, up to N consecutive inner packets are processed together
+ * by the burst pipeline of the output path, as it happens when several
+ * packets are waiting in the tun. Outputs of a burst are stamped with the
+ * timestamp of its last packet.
+ */
+
+#define PCAP_DPLANE_BURST       64
+/* Maximum number of inner packets processed together by the output path */
+#define PCAP_DPLANE_MAX_BURST   TUN_OUTPUT_BURST
+
+typedef struct pcap_dplane_conf_ {
+    char *inner_input;
+    char *outer_input;
+    char *encap_output;
+    char *decap_output;
+    int speed;
+    int burst;
+    uint8_t exit_at_end;
+} pcap_dplane_conf_t;
+
+/* One of the two input streams with its next packet already read */
+typedef struct pcap_dplane_input_ {
+    pcap_file_t *pf;
+    uint8_t *buf;
+    int len;        /* Length of the pending packet. 0 at end of file */
+    struct timespec ts;
+} pcap_dplane_input_t;
+
+typedef struct pcap_dplane_data_ {
+    oor_dev_type_e dev_type;
+    oor_encap_t encap_type;
+    pcap_dplane_input_t inner;
+    pcap_dplane_input_t outer;
+    pcap_file_t *encap_out;
+    pcap_file_t *decap_out;
+    int speed;
+    int burst;
+    uint8_t exit_at_end;
+    /* Virtual time: timestamp of the packet being processed */
+    struct timespec now;
+    struct timespec first_ts;
+    struct timespec start_wall;
+    int trigger_fd[2];
+    sock_t *trigger_sock;
+    /* Statistics */
+    uint64_t inner_pkts;
+    uint64_t outer_pkts;
+    uint64_t not_encap_pkts;
+    uint64_t dropped_pkts;
+    uint64_t cpu_ns;
+} pcap_dplane_data_t;
+
+void pcap_dplane_set_conf(pcap_dplane_conf_t *conf);
+
+extern data_plane_struct_t dplane_pcap;
+
+#endif /* PCAP_H_ */
@@ -0,0 +1,302 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+
+#include "pcap_file.h"
+#include "../../defs.h"
+#include "../../lib/mem_util.h"
+#include "../../lib/oor_log.h"
+
+#define PCAP_SLL_HDR_LEN    16
+#define PCAP_NULL_HDR_LEN   4
+#define PCAP_VLAN_TAG_LEN   4
+
+static pcap_file_t *pcap_file_new(const char *name, const char *mode);
+static int pcap_link_hdr_len(pcap_file_t *pf, uint8_t *rec, int len);
+
+
+static pcap_file_t *
+pcap_file_new(const char *name, const char *mode)
+{
+    pcap_file_t *pf;
+    FILE *fp;
+
+    fp = fopen(name, mode);
+    if (fp == NULL){
+        OOR_LOG(LERR, "pcap_file: Couldn't open %s: %s", name, strerror(errno));
+        return (NULL);
+    }
+    pf = xzalloc(sizeof(pcap_file_t));
+    pf->fp = fp;
+    pf->name = strdup(name);
+    return (pf);
+}
+
+pcap_file_t *
+pcap_file_open_read(const char *name)
+{
+    pcap_file_t *pf;
+    pcap_file_hdr_t fh;
+
+    pf = pcap_file_new(name, "rb");
+    if (pf == NULL){
+        return (NULL);
+    }
+
+    if (fread(&fh, sizeof(pcap_file_hdr_t), 1, pf->fp) != 1){
+        OOR_LOG(LERR, "pcap_file: %s is too short to be a pcap file", name);
+        goto err;
+    }
+
+    switch (fh.magic){
+    case PCAP_MAGIC:
+        break;
+    case PCAP_MAGIC_NSEC:
+        pf->nsec = TRUE;
+        break;
+    default:
+        if (fh.magic == bswap_32(PCAP_MAGIC)){
+            pf->swapped = TRUE;
+        }else if (fh.magic == bswap_32(PCAP_MAGIC_NSEC)){
+            pf->swapped = TRUE;
+            pf->nsec = TRUE;
+        }else{
+            OOR_LOG(LERR, "pcap_file: %s is not a pcap file (magic 0x%08x)",
+                    name, fh.magic);
+            goto err;
+        }
+    }
+
+    pf->linktype = pf->swapped ? bswap_32(fh.linktype) : fh.linktype;
+    switch (pf->linktype){
+    case PCAP_LINKTYPE_NULL:
+    case PCAP_LINKTYPE_ETHERNET:
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_LINUX_SLL:
+    case PCAP_LINKTYPE_IPV4:
+    case PCAP_LINKTYPE_IPV6:
+        break;
+    default:
+        OOR_LOG(LERR, "pcap_file: %s uses unsupported link type %u", name,
+                pf->linktype);
+        goto err;
+    }
+
+    OOR_LOG(LDBG_1, "pcap_file: Opened %s for reading (link type %u)", name,
+            pf->linktype);
+    return (pf);
+err:
+    pcap_file_close(pf);
+    return (NULL);
+}
+
+pcap_file_t *
+pcap_file_open_write(const char *name)
+{
+    pcap_file_t *pf;
+    pcap_file_hdr_t fh;
+
+    pf = pcap_file_new(name, "wb");
+    if (pf == NULL){
+        return (NULL);
+    }
+
+    /* Outputs are always plain IP packets with nanosecond timestamps */
+    memset(&fh, 0, sizeof(pcap_file_hdr_t));
+    fh.magic = PCAP_MAGIC_NSEC;
+    fh.version_major = PCAP_VERSION_MAJOR;
+    fh.version_minor = PCAP_VERSION_MINOR;
+    fh.snaplen = PCAP_SNAPLEN;
+    fh.linktype = PCAP_LINKTYPE_RAW;
+    pf->linktype = PCAP_LINKTYPE_RAW;
+    pf->nsec = TRUE;
+
+    if (fwrite(&fh, sizeof(pcap_file_hdr_t), 1, pf->fp) != 1){
+        OOR_LOG(LERR, "pcap_file: Couldn't write header of %s: %s", name,
+                strerror(errno));
+        pcap_file_close(pf);
+        return (NULL);
+    }
+
+    OOR_LOG(LDBG_1, "pcap_file: Opened %s for writing", name);
+    return (pf);
+}
+
+void
+pcap_file_close(pcap_file_t *pf)
+{
+    if (pf == NULL){
+        return;
+    }
+    if (pf->fp != NULL){
+        fclose(pf->fp);
+    }
+    free(pf->name);
+    free(pf);
+}
+
+/* Length of the link layer header preceding the IP packet or -1 if the
+ * record doesn't carry an IP packet */
+static int
+pcap_link_hdr_len(pcap_file_t *pf, uint8_t *rec, int len)
+{
+    uint16_t ether_type;
+    int hlen;
+
+    switch (pf->linktype){
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_IPV4:
+    case PCAP_LINKTYPE_IPV6:
+        return (0);
+    case PCAP_LINKTYPE_NULL:
+        return (len > PCAP_NULL_HDR_LEN ? PCAP_NULL_HDR_LEN : -1);
+    case PCAP_LINKTYPE_LINUX_SLL:
+        hlen = PCAP_SLL_HDR_LEN;
+        if (len < hlen){
+            return (-1);
+        }
+        ether_type = (rec[hlen - 2] << 8) | rec[hlen - 1];
+        break;
+    case PCAP_LINKTYPE_ETHERNET:
+        hlen = ETHER_HDR_LEN;
+        if (len < hlen){
+            return (-1);
+        }
+        ether_type = (rec[hlen - 2] << 8) | rec[hlen - 1];
+        while (ether_type == ETHERTYPE_VLAN && len >= hlen + PCAP_VLAN_TAG_LEN){
+            hlen += PCAP_VLAN_TAG_LEN;
+            ether_type = (rec[hlen - 2] << 8) | rec[hlen - 1];
+        }
+        break;
+    default:
+        return (-1);
+    }
+
+    if (ether_type != ETHERTYPE_IP && ether_type != ETHERTYPE_IPV6){
+        return (-1);
+    }
+    return (hlen);
+}
+
+/*
+ * Read the next IP packet of the file into buf, skipping records that don't
+ * contain IP. Returns the length of the IP packet, 0 at the end of the file
+ * and -1 on error.
+ */
+int
+pcap_file_read_ip(pcap_file_t *pf, uint8_t *buf, int buf_len,
+        struct timespec *ts)
+{
+    static uint8_t rec[PCAP_SNAPLEN];
+    pcap_rec_hdr_t rh;
+    uint32_t incl_len, ts_frac;
+    int hlen, len;
+
+    for (;;){
+        if (fread(&rh, sizeof(pcap_rec_hdr_t), 1, pf->fp) != 1){
+            return (0);
+        }
+        incl_len = pf->swapped ? bswap_32(rh.incl_len) : rh.incl_len;
+        if (incl_len > PCAP_SNAPLEN){
+            OOR_LOG(LERR, "pcap_file: %s: record of %u bytes exceeds snaplen",
+                    pf->name, incl_len);
+            return (-1);
+        }
+        if (fread(rec, 1, incl_len, pf->fp) != incl_len){
+            OOR_LOG(LDBG_1, "pcap_file: %s: truncated last record", pf->name);
+            return (0);
+        }
+
+        hlen = pcap_link_hdr_len(pf, rec, incl_len);
+        if (hlen < 0){
+            continue;
+        }
+        len = incl_len - hlen;
+        if (len > buf_len){
+            OOR_LOG(LDBG_1, "pcap_file: %s: packet of %d bytes doesn't fit "
+                    "in the buffer. Discarded", pf->name, len);
+            continue;
+        }
+        memcpy(buf, rec + hlen, len);
+
+        ts_frac = pf->swapped ? bswap_32(rh.ts_frac) : rh.ts_frac;
+        ts->tv_sec = pf->swapped ? bswap_32(rh.ts_sec) : rh.ts_sec;
+        ts->tv_nsec = pf->nsec ? ts_frac : ts_frac * 1000;
+
+        pf->pkts++;
+        pf->bytes += len;
+        return (len);
+    }
+}
+
+int
+pcap_file_write(pcap_file_t *pf, const void *pkt, int len, struct timespec *ts)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)pkt;
+    iov.iov_len = len;
+    return (pcap_file_writev(pf, &iov, 1, ts));
+}
+
+/* Write a packet split in several buffers as a single record */
+int
+pcap_file_writev(pcap_file_t *pf, struct iovec *iov, int iovcnt,
+        struct timespec *ts)
+{
+    pcap_rec_hdr_t rh;
+    int i, len = 0;
+
+    for (i = 0; i < iovcnt; i++){
+        len += iov[i].iov_len;
+    }
+
+    rh.ts_sec = ts->tv_sec;
+    rh.ts_frac = ts->tv_nsec;
+    rh.incl_len = len;
+    rh.orig_len = len;
+
+    if (fwrite(&rh, sizeof(pcap_rec_hdr_t), 1, pf->fp) != 1){
+        goto err;
+    }
+    for (i = 0; i < iovcnt; i++){
+        if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, pf->fp) != iov[i].iov_len){
+            goto err;
+        }
+    }
+    pf->pkts++;
+    pf->bytes += len;
+    return (GOOD);
+err:
+    OOR_LOG(LDBG_1, "pcap_file: Error writing to %s: %s", pf->name,
+            strerror(errno));
+    return (BAD);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
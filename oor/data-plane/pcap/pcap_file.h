@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PCAP_FILE_H_
+#define PCAP_FILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/uio.h>
+
+/*
+ * Minimal reader/writer of the classic pcap file format. Only what the pcap
+ * data plane needs is implemented: IP packets, optionally behind an Ethernet,
+ * Linux cooked or null/loopback link header. No dependency on libpcap.
+ */
+
+#define PCAP_MAGIC              0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAP_VERSION_MAJOR      2
+#define PCAP_VERSION_MINOR      4
+#define PCAP_SNAPLEN            65535
+
+#define PCAP_LINKTYPE_NULL      0
+#define PCAP_LINKTYPE_ETHERNET  1
+#define PCAP_LINKTYPE_RAW       101
+#define PCAP_LINKTYPE_LINUX_SLL 113
+#define PCAP_LINKTYPE_IPV4      228
+#define PCAP_LINKTYPE_IPV6      229
+
+typedef struct pcap_file_hdr_ {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_hdr_t;
+
+typedef struct pcap_rec_hdr_ {
+    uint32_t ts_sec;
+    uint32_t ts_frac;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_rec_hdr_t;
+
+typedef struct pcap_file_ {
+    FILE *fp;
+    char *name;
+    uint32_t linktype;
+    uint8_t swapped;
+    uint8_t nsec;
+    uint64_t pkts;
+    uint64_t bytes;
+} pcap_file_t;
+
+pcap_file_t *pcap_file_open_read(const char *name);
+pcap_file_t *pcap_file_open_write(const char *name);
+void pcap_file_close(pcap_file_t *pf);
+
+int pcap_file_read_ip(pcap_file_t *pf, uint8_t *buf, int buf_len,
+        struct timespec *ts);
+int pcap_file_write(pcap_file_t *pf, const void *pkt, int len,
+        struct timespec *ts);
+int pcap_file_writev(pcap_file_t *pf, struct iovec *iov, int iovcnt,
+        struct timespec *ts);
+
+#endif /* PCAP_FILE_H_ */
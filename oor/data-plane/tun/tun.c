@@ -58,6 +58,7 @@ void tun_process_rm_gateway(iface_t *iface,lisp_addr_t *gateway);
 
 void tun_set_default_output_ifaces();
 void tun_iface_remove_routing_rules(iface_t *iface);
+static void tun_check_ifaces_mtu();
 
 
 data_plane_struct_t dplane_tun = {
@@ -72,6 +73,8 @@ data_plane_struct_t dplane_tun = {
         .datap_updated_route = tun_updated_route,
         .datap_updated_addr = tun_updated_addr,
         .datap_update_link = tun_updated_link,
+        .datap_send_pending_packet = tun_output_pending,
+        .datap_flush_flows = tun_output_flush_flows,
         .datap_data = NULL
 };
 
@@ -85,6 +88,7 @@ tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
     int (*cb_func)(sock_t *) = NULL;
     int ipv4_data_input_fd = -1;
     int ipv6_data_input_fd = -1;
+    int icmp_fd;
     int data_port;
     tun_dplane_data_t *data;
 
@@ -108,6 +112,7 @@ tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
         break;
     case RTR_MODE:
         cb_func = tun_rtr_process_input_packet;
+        tun_output_set_host_fct(tun_output_to_eid);
         break;
     default:
         return (BAD);
@@ -134,10 +139,24 @@ tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
         sockmstr_register_read_listener(smaster, cb_func, NULL,
                 ipv6_data_input_fd);
     }
+
+    /* ICMP errors that report the path MTU to the remote RLOCs */
+    if (default_rloc_afi != AF_INET6
+            && (icmp_fd = open_icmp_too_big_socket(AF_INET)) != ERR_SOCKET) {
+        sockmstr_register_read_listener(smaster, tun_output_icmp_recv, NULL,
+                icmp_fd);
+    }
+    if (default_rloc_afi != AF_INET
+            && (icmp_fd = open_icmp_too_big_socket(AF_INET6)) != ERR_SOCKET) {
+        sockmstr_register_read_listener(smaster, tun_output_icmp_recv, NULL,
+                icmp_fd);
+    }
     data = xmalloc(sizeof(tun_dplane_data_t));
     data->encap_type = encap_type;
     dplane_tun.datap_data = (void *)data;
+    tun_input_init();
     tun_output_init();
+    tun_check_ifaces_mtu();
 
     /* Select the default rlocs for output data packets and output control
      * packets */
@@ -147,6 +166,49 @@ tun_configure_data_plane(oor_dev_type_e dev_type, oor_encap_t encap_type, ...)
 
 }
 
+/* Warn about the RLOC interfaces whose MTU can't carry a packet of the size
+ * of the tun MTU once encapsulated. Those packets are handled as too big for
+ * the path */
+static void
+tun_check_ifaces_mtu()
+{
+    glist_entry_t *iface_it;
+    iface_t *iface;
+    struct ifreq ifr;
+    int sock, overhead;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0){
+        return;
+    }
+    glist_for_each_entry(iface_it, interface_list){
+        iface = (iface_t *)glist_entry_data(iface_it);
+        memset(&ifr, 0, sizeof(ifr));
+        strncpy(ifr.ifr_name, iface->iface_name, IFNAMSIZ - 1);
+        if (ioctl(sock, SIOCGIFMTU, &ifr) < 0){
+            continue;
+        }
+        /* Outer IP, UDP and LISP or VXLAN-GPE headers */
+        if (iface->ipv6_address && !lisp_addr_is_no_addr(iface->ipv6_address)){
+            overhead = sizeof(struct ip6_hdr) + UDP_HDR_LEN
+                    + sizeof(lisp_data_hdr_t);
+        }else if (iface->ipv4_address
+                && !lisp_addr_is_no_addr(iface->ipv4_address)){
+            overhead = sizeof(struct ip) + UDP_HDR_LEN
+                    + sizeof(lisp_data_hdr_t);
+        }else{
+            continue;
+        }
+        if (pkt_buf_conf.mtu + overhead > ifr.ifr_mtu){
+            OOR_LOG(LWRN, "The MTU of the RLOC interface %s (%d) is lower than "
+                    "the tun MTU plus the encapsulation overhead (%d + %d). "
+                    "Reduce tun-mtu or raise the MTU of %s", iface->iface_name,
+                    ifr.ifr_mtu, pkt_buf_conf.mtu, overhead, iface->iface_name);
+        }
+    }
+    close(sock);
+}
+
 void
 tun_uninit_data_plane()
 {
@@ -162,6 +224,7 @@ tun_uninit_data_plane()
         }
 
         tun_output_uninit();
+        tun_input_uninit();
         free(data);
     }
 }
@@ -333,20 +396,27 @@ create_tun()
         tun_ifindex = ifr.ifr_ifindex;
 
         // Set the MTU to the configured MTU
-        ifr.ifr_ifru.ifru_mtu = TUN_MTU;
+        ifr.ifr_ifru.ifru_mtu = pkt_buf_conf.mtu;
         if ((err = ioctl(tmpsocket, SIOCSIFMTU, &ifr)) < 0) {
             close(tmpsocket);
-            OOR_LOG(LCRIT, "TUN/TAP: unable to set interface MTU to %d, errno: %d.", TUN_MTU, errno);
+            OOR_LOG(LCRIT, "TUN/TAP: unable to set interface MTU to %d, errno: %d.", pkt_buf_conf.mtu, errno);
             return(BAD);
         } else {
-            OOR_LOG(LDBG_1, "TUN/TAP mtu set to %d", TUN_MTU);
+            OOR_LOG(LDBG_1, "TUN/TAP mtu set to %d", pkt_buf_conf.mtu);
         }
     }
 
 
     close(tmpsocket);
 
-    tun_receive_buf = (uint8_t *)malloc(TUN_RECEIVE_SIZE);
+    /* The output path reads bursts of packets until the tun is empty */
+    if (fcntl(tun_receive_fd, F_SETFL, fcntl(tun_receive_fd, F_GETFL) | O_NONBLOCK) < 0){
+        OOR_LOG(LCRIT, "TUN/TAP: unable to set the tun non blocking: %s", strerror(errno));
+        close(tun_receive_fd);
+        return(BAD);
+    }
+
+    tun_receive_buf = (uint8_t *)malloc(pkt_buf_conf.size);
 
     if (tun_receive_buf == NULL){
         OOR_LOG(LWRN, "create_tun: Unable to allocate memory for tun_receive_buf: %s", strerror(errno));
@@ -1117,6 +1187,9 @@ tun_get_default_output_socket(int afi)
     int out_socket = ERR_SOCKET;
     tun_dplane_data_t *data;
     data = (tun_dplane_data_t *)dplane_tun.datap_data;
+    if (data == NULL){
+        return (ERR_SOCKET);
+    }
 
     switch (afi) {
     case AF_INET:
@@ -23,29 +23,96 @@
 #include "tun.h"
 #include "tun_input.h"
 #include "tun_output.h"
+#include "../../control/oor_control.h"
+#include "../../lib/echo_nonce.h"
+#include "../../lib/ecn.h"
+#include "../../lib/rloc_lsb.h"
 #include "../../lib/packets.h"
 #include "../../lib/mem_util.h"
 #include "../../liblisp/liblisp.h"
 #include "../../lib/oor_log.h"
+#include "../../oor_external.h"
 
-/* static buffer to receive packets */
-static uint8_t pkt_recv_buf[MAX_IP_PKT_LEN+1];
-static lbuf_t pkt_buf;
+/* buffers to receive a burst of packets, sized from pkt_buf_conf */
+static uint8_t *pkt_recv_bufs;
+static int pkt_recv_buf_len;
+static lbuf_t pkt_bufs[TUN_INPUT_BURST];
+static ecn_stats_t ecn_stats;
+
+static void tun_input_bufs_reset();
+
+void
+tun_input_init()
+{
+    pkt_recv_buf_len = pkt_buf_conf.headroom + pkt_buf_conf.size;
+    pkt_recv_bufs = xmalloc(TUN_INPUT_BURST * pkt_recv_buf_len);
+}
+
+void
+tun_input_uninit()
+{
+    tun_input_stats_dump(LDBG_1);
+    free(pkt_recv_bufs);
+    pkt_recv_bufs = NULL;
+}
+
+void
+tun_input_stats_dump(int log_level)
+{
+    OOR_LOG(log_level, "INPUT: ECN: %"PRIu64" CE marks propagated to the "
+            "inner header, %"PRIu64" packets dropped with CE outer and Not-ECT "
+            "inner headers, %"PRIu64" unexpected combinations",
+            ecn_stats.ce_propagated, ecn_stats.invalid_dropped,
+            ecn_stats.unexpected);
+}
+
+/* ECN field of a packet decapsulated from an outer header with outer_tos
+ * (RFC 6040) or -1 if the packet has to be dropped */
+int
+tun_input_ecn(uint8_t inner_tos, uint8_t outer_tos)
+{
+    return (ecn_decap(inner_tos, outer_tos, &ecn_stats));
+}
+
+static void
+tun_input_bufs_reset()
+{
+    int i;
+
+    for (i = 0; i < TUN_INPUT_BURST; i++){
+        lbuf_use_stack(&pkt_bufs[i], pkt_recv_bufs + i * pkt_recv_buf_len,
+                pkt_recv_buf_len);
+        lbuf_reserve(&pkt_bufs[i], pkt_buf_conf.headroom);
+    }
+}
 
 int
 tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
 {
     uint8_t ttl = 0, tos = 0;
     int afi;
-    struct udphdr *udph;
-    lisp_data_hdr_t *lisph;
-    vxlan_gpe_hdr_t *vxlanh;
-    int port;
 
     if (sock_data_recv(sock, b, &afi, &ttl, &tos) != GOOD) {
         return(BAD);
     }
 
+    return (tun_decap_pkt(b, afi, ttl, tos, iid));
+}
+
+/*
+ * Decapsulate a packet as it is received from the raw data sockets: for IPv4
+ * the buffer points to the outer IP header and for IPv6 to the outer UDP
+ * header. ttl and tos are the ones of the outer IP header. Packets whose
+ * ECN fields can't be combined are dropped returning ERR_INVALID_ECN.
+ */
+int
+tun_decap_pkt(lbuf_t *b, int afi, uint8_t ttl, uint8_t tos, uint32_t *iid)
+{
+    struct udphdr *udph;
+    lisp_data_hdr_t *lisph;
+    vxlan_gpe_hdr_t *vxlanh;
+    int port, inner_ttl, inner_tos, ecn;
+
     if (afi == AF_INET){
         /* With input RAW UDP sockets in IPv4, we get the whole external
          * IPv4 packet */
@@ -91,9 +158,20 @@ tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
     /* RESET L3: prepare for output */
     lbuf_reset_l3(b);
 
-    /* UPDATE IP TOS and TTL. Checksum is also updated for IPv4
+    /* UPDATE IP TOS and TTL. The DSCP is copied from the outer header and
+     * the ECN field combined with it (RFC 6040). Checksum is also updated
+     * for IPv4
      * NOTE: we always assume an IP payload*/
-    ip_hdr_set_ttl_and_tos(lbuf_data(b), ttl, tos);
+    if (ip_hdr_ttl_and_tos(lbuf_data(b), &inner_ttl, &inner_tos) != GOOD){
+        return (ERR_NOT_ENCAP);
+    }
+    ecn = tun_input_ecn(inner_tos, tos);
+    if (ecn < 0){
+        OOR_LOG(LDBG_3, "INPUT (%d): CE outer header with a Not-ECT inner "
+                "packet. Discarding", port);
+        return (ERR_INVALID_ECN);
+    }
+    ip_hdr_set_ttl_and_tos(lbuf_data(b), ttl, (tos & ~ECN_MASK) | ecn);
 
     OOR_LOG(LDBG_3, "INPUT (%d): %s",port, ip_src_and_dst_to_char(lbuf_l3(b),
             "Inner IP: %s -> %s"));
@@ -101,19 +179,91 @@ tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
     return(GOOD);
 }
 
+/* Inner source EID of the decapsulated packet b */
+static inline int
+tun_input_src_eid(lbuf_t *b, lisp_addr_t *eid)
+{
+    struct iphdr *iph = lbuf_l3(b);
+
+    switch (iph->version){
+    case 4:
+        lisp_addr_ip_init(eid, &iph->saddr, AF_INET);
+        return (GOOD);
+    case 6:
+        lisp_addr_ip_init(eid, &((struct ip6_hdr *)iph)->ip6_src, AF_INET6);
+        return (GOOD);
+    default:
+        return (BAD);
+    }
+}
+
+/* Process the nonce and the Locator-Status-Bits of the LISP header of the
+ * decapsulated packet b received from rloc. The control is only involved
+ * when the bits of rloc change */
+void
+tun_input_lisp_hdr(lbuf_t *b, lisp_addr_t *rloc, uint32_t iid)
+{
+    struct udphdr *udph;
+    lisp_data_hdr_t *lhdr;
+    lisp_addr_t eid;
+    uint32_t lsb;
+
+    udph = lbuf_udp(b);
+    if (ntohs(udpdport(udph)) != LISP_DATA_PORT){
+        return;
+    }
+    lhdr = (lisp_data_hdr_t *)(udph + 1);
+    if (echo_nonces){
+        echo_nonce_input(echo_nonces, lisp_addr_ip(rloc), lhdr, time(NULL));
+    }
+    if (!LDHDR_L_BIT(lhdr)){
+        return;
+    }
+    lsb = lisp_data_hdr_get_lsb(lhdr);
+    if (rloc_lsb_update(rloc_lsbs, lisp_addr_ip(rloc), lsb) == FALSE
+            || tun_input_src_eid(b, &eid) != GOOD){
+        return;
+    }
+    ctrl_lsb_changed(&eid, rloc, iid, lsb);
+}
+
+/* Let the control learn the inner source EID of the decapsulated packet b
+ * and the outer source RLOC, rloc, it was received from */
+void
+tun_input_glean(lbuf_t *b, lisp_addr_t *rloc, uint32_t iid)
+{
+    lisp_addr_t eid;
+
+    if (tun_input_src_eid(b, &eid) != GOOD){
+        return;
+    }
+    ctrl_glean_mapping(&eid, rloc, iid);
+}
+
 int
 tun_process_input_packet(sock_t *sl)
 {
+    sock_data_info_t info[TUN_INPUT_BURST];
     uint32_t iid;
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, MAX_IP_PKT_LEN);
+    int i, n;
 
-    if (tun_read_and_decap_pkt(sl->fd, &pkt_buf, &iid) != GOOD) {
+    tun_input_bufs_reset();
+    n = sock_data_recv_burst(sl->fd, pkt_bufs, info, TUN_INPUT_BURST);
+    if (n == 0) {
         return (BAD);
     }
 
-    /* XXX Destination packet should be checked it belongs to this xTR */
-    if ((write(tun_receive_fd, lbuf_l3(&pkt_buf), lbuf_size(&pkt_buf))) < 0) {
-        OOR_LOG(LDBG_2, "lisp_input: write error: %s\n ", strerror(errno));
+    for (i = 0; i < n; i++){
+        if (tun_decap_pkt(&pkt_bufs[i], info[i].afi, info[i].ttl, info[i].tos,
+                &iid) != GOOD) {
+            continue;
+        }
+        tun_input_lisp_hdr(&pkt_bufs[i], &info[i].src, iid);
+        tun_input_glean(&pkt_bufs[i], &info[i].src, iid);
+        /* XXX Destination packet should be checked it belongs to this xTR */
+        if ((write(tun_receive_fd, lbuf_l3(&pkt_bufs[i]), lbuf_size(&pkt_bufs[i]))) < 0) {
+            OOR_LOG(LDBG_2, "lisp_input: write error: %s\n ", strerror(errno));
+        }
     }
 
     return (GOOD);
@@ -122,26 +272,55 @@ tun_process_input_packet(sock_t *sl)
 int
 tun_rtr_process_input_packet(struct sock *sl)
 {
-    packet_tuple_t tpl;
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, MAX_IP_PKT_LEN);
-    /* Reserve space in case the received packet was IPv6. In this case the IPv6 header is
-     * not provided */
-    lbuf_reserve(&pkt_buf,LBUF_STACK_OFFSET);
+    sock_data_info_t info[TUN_INPUT_BURST];
+    uint32_t iids[TUN_INPUT_BURST];
+    lisp_addr_t *srcs[TUN_INPUT_BURST];
+    uint8_t handled[TUN_INPUT_BURST];
+    lbuf_t tmp;
+    int i, n, ndecap;
 
-    if (tun_read_and_decap_pkt(sl->fd, &pkt_buf, &(tpl.iid)) != GOOD) {
+    /* Decapsulated packets are re-encapsulated without being moved: no
+     * headroom is required for the new outer headers */
+    tun_input_bufs_reset();
+    n = sock_data_recv_burst(sl->fd, pkt_bufs, info, TUN_INPUT_BURST);
+    if (n == 0) {
         return (BAD);
     }
 
-    OOR_LOG(LDBG_3, "Forwarding packet to OUPUT for re-encapsulation");
+    /* Packets in the re-encapsulation cache are re-encapsulated in place */
+    memset(handled, 0, sizeof(handled));
+    if (reencaps){
+        tun_output_reencap(pkt_bufs, info, n, handled);
+    }
+
+    /* Decapsulate and move the packets to re-encapsulate to the beginning
+     * of the burst */
+    ndecap = 0;
+    for (i = 0; i < n; i++){
+        if (handled[i] || tun_decap_pkt(&pkt_bufs[i], info[i].afi, info[i].ttl,
+                info[i].tos, &iids[ndecap]) != GOOD) {
+            continue;
+        }
+        tun_input_lisp_hdr(&pkt_bufs[i], &info[i].src, iids[ndecap]);
+        srcs[ndecap] = &info[i].src;
+        lbuf_point_to_l3(&pkt_bufs[i]);
+        if (i != ndecap){
+            tmp = pkt_bufs[ndecap];
+            pkt_bufs[ndecap] = pkt_bufs[i];
+            pkt_bufs[i] = tmp;
+        }
+        ndecap++;
+    }
+
+    OOR_LOG(LDBG_3, "Forwarding %d packets to OUPUT for re-encapsulation", ndecap);
 
-    lbuf_point_to_l3(&pkt_buf);
-    lbuf_reset_ip(&pkt_buf);
+    tun_output_burst(pkt_bufs, iids, ndecap);
 
-    if (pkt_parse_5_tuple(&pkt_buf, &tpl) != GOOD) {
-        return (BAD);
+    if (reencaps){
+        for (i = 0; i < ndecap; i++){
+            tun_output_reencap_learn(&pkt_bufs[i], srcs[i], iids[i]);
+        }
     }
-    tun_output(&pkt_buf, &tpl);
 
     return(GOOD);
 }
-
@@ -31,7 +31,19 @@
 #include "../../lib/sockets.h"
 #include "../../lib/cksum.h"
 
+/* Maximum number of packets read from a data socket at once. Decapsulated
+ * packets of the RTR are re-encapsulated as a single output burst */
+#define TUN_INPUT_BURST     TUN_OUTPUT_BURST
+
+void tun_input_init();
+void tun_input_uninit();
+void tun_input_stats_dump(int log_level);
+int tun_input_ecn(uint8_t inner_tos, uint8_t outer_tos);
+int tun_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid);
+int tun_decap_pkt(lbuf_t *b, int afi, uint8_t ttl, uint8_t tos, uint32_t *iid);
 int tun_process_input_packet(struct sock *sl);
+void tun_input_lisp_hdr(lbuf_t *b, lisp_addr_t *rloc, uint32_t iid);
+void tun_input_glean(lbuf_t *b, lisp_addr_t *rloc, uint32_t iid);
 int tun_rtr_process_input_packet(struct sock *sl);
 
 #endif /*TUN_IFACE_LIST_H_*/
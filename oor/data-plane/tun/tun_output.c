@@ -19,8 +19,11 @@
 
 
 #include <errno.h>
+#include <inttypes.h>
+#include <netinet/ip6.h>
 
 #include "tun_output.h"
+#include "tun_input.h"
 #include "tun.h"
 #include "../encapsulations/vxlan-gpe.h"
 #include "../../fwd_policies/fwd_policy.h"
@@ -29,51 +32,168 @@
 #include "../../lib/sockets.h"
 #include "../../control/oor_control.h"
 #include "../../lib/ttable.h"
+#include "../../lib/echo_nonce.h"
+#include "../../lib/ecn.h"
+#include "../../lib/flowlet.h"
+#include "../../lib/pmtu.h"
+#include "../../lib/reencap.h"
+#include "../../oor_external.h"
 #include "../../lib/oor_log.h"
 #include "../../lib/sockets-util.h"
 
 
-/* static buffer to receive packets */
-static uint8_t pkt_recv_buf[TUN_RECEIVE_SIZE];
-static lbuf_t pkt_buf;
+/* buffers to receive a burst of packets, sized from pkt_buf_conf */
+static uint8_t *pkt_recv_bufs;
+static int pkt_recv_buf_len;
+static lbuf_t pkt_bufs[TUN_OUTPUT_BURST];
 ttable_t ttable;
+/* Function used to put on the wire the packets generated by the output path */
+static tun_output_send_fct tun_send_fct;
+/* Function used to deliver to the host the packets generated for it */
+static tun_output_host_fct tun_host_fct;
+/* Buffer of the ICMP errors sent to the sources of too big packets */
+static uint8_t icmp_buf[PKT_ICMP_TOO_BIG_MAX];
+/* Cycles spent by each stage of the burst pipeline */
+static tun_burst_stats_t burst_stats;
+static const char *burst_stage_names[TUN_STAGE_MAX] = {
+        "parse", "hash", "lookup", "group", "encap", "send"
+};
 
 
+static int tun_send_raw_packet(lbuf_t *hdr, lbuf_t *b, int sock,
+        lisp_addr_t *dst);
+static int tun_write_to_host(lbuf_t *b);
 static int tun_output_multicast(lbuf_t *b, packet_tuple_t *tuple);
 static int tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple);
 static int tun_forward_native(lbuf_t *b, lisp_addr_t *dst);
 static inline int is_lisp_packet(packet_tuple_t *tpl);
+static fwd_info_t *tun_get_fwd_info(packet_tuple_t *tuple);
+static int tun_output_no_fwd_entry(lbuf_t *b, packet_tuple_t *tuple,
+        fwd_info_t *fi);
+static inline int tun_encap(lbuf_t *hdr, void *hdr_buf, lbuf_t *b,
+        fwd_info_t *fi);
 
 void
 tun_output_init()
 {
+    pkt_recv_buf_len = pkt_buf_conf.headroom + pkt_buf_conf.size;
+    pkt_recv_bufs = xmalloc(TUN_OUTPUT_BURST * pkt_recv_buf_len);
     ttable_init(&ttable);
+    if (tun_send_fct == NULL){
+        tun_send_fct = tun_send_raw_packet;
+    }
+    if (tun_host_fct == NULL){
+        tun_host_fct = tun_write_to_host;
+    }
+}
+
+/* Replace the function used to send the packets generated by the output
+ * path. Used by data planes that don't write to the network (pcap) */
+void
+tun_output_set_send_fct(tun_output_send_fct send_fct)
+{
+    tun_send_fct = send_fct;
+}
+
+/* Replace the function used to deliver packets to the host */
+void
+tun_output_set_host_fct(tun_output_host_fct host_fct)
+{
+    tun_host_fct = host_fct;
+}
+
+static int
+tun_write_to_host(lbuf_t *b)
+{
+    if (write(tun_receive_fd, lbuf_data(b), lbuf_size(b)) < 0) {
+        OOR_LOG(LDBG_2, "tun_write_to_host: write error: %s", strerror(errno));
+        return (BAD);
+    }
+    return (GOOD);
+}
+
+/* hdr contains the outer headers of the packet or is NULL when the packet is
+ * sent natively */
+static int
+tun_send_raw_packet(lbuf_t *hdr, lbuf_t *b, int sock, lisp_addr_t *dst)
+{
+    struct iovec iov[2];
+    int iovcnt = 0;
+
+    if (sock == ERR_SOCKET) {
+        OOR_LOG(LDBG_2, "tun_send_raw_packet: No output socket to reach %s",
+                lisp_addr_to_char(dst));
+        return (BAD);
+    }
+    if (hdr){
+        iov[iovcnt].iov_base = lbuf_data(hdr);
+        iov[iovcnt++].iov_len = lbuf_size(hdr);
+    }
+    iov[iovcnt].iov_base = lbuf_data(b);
+    iov[iovcnt++].iov_len = lbuf_size(b);
+
+    return (send_raw_packet_iov(sock, iov, iovcnt, lisp_addr_ip(dst)));
 }
 
 void
 tun_output_uninit()
 {
+    tun_output_burst_stats_dump(LDBG_1);
     ttable_uninit(&ttable);
+    free(pkt_recv_bufs);
+    pkt_recv_bufs = NULL;
+}
+
+/* Time stamp used to account the cost of each stage of the burst pipeline */
+static inline uint64_t
+tun_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (__builtin_ia32_rdtsc());
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+void
+tun_output_burst_stats_dump(int log_level)
+{
+    char buf[256];
+    int i, len = 0;
+
+    if (burst_stats.pkts == 0){
+        return;
+    }
+
+    for (i = 0; i < TUN_STAGE_MAX; i++){
+        len += snprintf(buf + len, sizeof(buf) - len, " %s: %.1f",
+                burst_stage_names[i],
+                (double)burst_stats.cycles[i] / burst_stats.pkts);
+    }
+    OOR_LOG(log_level, "OUTPUT: %"PRIu64" packets processed in %"PRIu64
+            " bursts (%.1f packets per burst)", burst_stats.pkts,
+            burst_stats.bursts, (double)burst_stats.pkts / burst_stats.bursts);
+    OOR_LOG(log_level, "OUTPUT: Cycles per packet ->%s", buf);
+    if (burst_stats.send_drops != 0){
+        OOR_LOG(log_level, "OUTPUT: %"PRIu64" packets failed to be sent",
+                burst_stats.send_drops);
+    }
 }
 
 static int
 tun_forward_native(lbuf_t *b, lisp_addr_t *dst)
 {
-    int ret, sock, afi;
+    int sock;
 
     OOR_LOG(LDBG_3, "Forwarding native to destination %s",
             lisp_addr_to_char(dst));
 
-    afi = lisp_addr_ip_afi(dst);
-    sock = tun_get_default_output_socket(afi);
+    sock = tun_get_default_output_socket(lisp_addr_ip_afi(dst));
 
-    if (sock == ERR_SOCKET) {
-        OOR_LOG(LDBG_2, "tun_forward_native: No output interface for afi %d", afi);
-        return (BAD);
-    }
-
-    ret = send_raw_packet(sock, lbuf_data(b), lbuf_size(b), lisp_addr_ip(dst));
-    return (ret);
+    return (tun_send_fct(NULL, b, sock, dst));
 }
 
 
@@ -177,65 +297,293 @@ tun_output_multicast(lbuf_t *b, packet_tuple_t *tuple)
     return (GOOD);
 }
 
-static int
-tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
+/* Get the forwarding information of the tuple from the flow table or, on a
+ * miss, from the control plane. The hash of the tuple should be already set.
+ * With flowlets, the destination RLOC is selected by the data plane each time
+ * a flowlet starts */
+static fwd_info_t *
+tun_get_fwd_info(packet_tuple_t *tuple)
 {
-    fwd_info_t *fi;
+    fwd_info_t *fi, *old_fi = NULL;
     fwd_entry_t *fe;
+    lisp_addr_t prev_drloc;
     uint32_t iid = tuple->iid;
 
-    /* XXX Since OOR doesn't support same local prefixes with different IIDs when
-     * operating as a XTR or MN, we use IID = 0 to calculate the hash of the ttable.
-     * The actual IID to be used on the encapsulation processed is already stored
-     * in the forwarding entry, which is obtained on a ttable miss.*/
+    if (flowlets){
+        fi = ttable_lookup_flowlet(&ttable, tuple, flowlets->gap, &old_fi);
+    }else{
+        fi = ttable_lookup_hashed(&ttable, tuple);
+    }
+    if (fi) {
+        return (fi);
+    }
 
-    fi = ttable_lookup(&ttable, tuple);
-    if (!fi) {
-        fi = (fwd_info_t *)ctrl_get_forwarding_info(tuple);
-        if (fi == NULL){
-            return (BAD);
+    /* Active flowlet whose forwarding info timed out */
+    lisp_addr_set_lafi(&prev_drloc, LM_AFI_NO_ADDR);
+    if (old_fi){
+        fe = old_fi->fwd_info;
+        if (fe && fe->drloc){
+            lisp_addr_copy(&prev_drloc, fe->drloc);
         }
-        fe = fi->fwd_info;
-        if (fe && fe->srloc && fe->drloc)  {
-            fe->out_sock = get_out_socket_ptr_from_address(fe->srloc);
+    }
+
+    fi = (fwd_info_t *)ctrl_get_forwarding_info(tuple);
+    if (fi == NULL){
+        return (NULL);
+    }
+    fe = fi->fwd_info;
+    if (fe && fe->srloc && fe->drloc)  {
+        fe->out_sock = get_out_socket_ptr_from_address(fe->srloc);
+        if (flowlets){
+            flowlet_select(flowlets, fe, lisp_addr_is_no_addr(&prev_drloc)
+                    ? NULL : &prev_drloc);
         }
-        tuple->iid = iid;
-        ttable_insert(&ttable, pkt_tuple_clone(tuple), fi);
+        if (pmtus){
+            fe->mtu = pmtu_get(pmtus, lisp_addr_ip(fe->srloc),
+                    lisp_addr_ip(fe->drloc));
+        }
+    }
+    tuple->iid = iid;
+    if (old_fi){
+        ttable_renew(&ttable, tuple, fi);
     }else{
-        fe = fi->fwd_info;
+        ttable_insert(&ttable, pkt_tuple_clone(tuple), fi);
     }
+    return (fi);
+}
 
-    /* Packets with no/negative map cache entry AND no PETR
-     * OR packets with missing src or dst RLOCs*/
-    if (!fe || !fe->srloc || !fe->drloc) {
-        switch (fi->neg_map_reply_act){
-        case ACT_NO_ACTION:
-        case ACT_SEND_MREQ:
-        case ACT_DROP:
-            OOR_LOG(LDBG_3, "tun_output_unicast: Packet droped");
+/* Packets with no/negative map cache entry AND no PETR
+ * OR packets with missing src or dst RLOCs*/
+static int
+tun_output_no_fwd_entry(lbuf_t *b, packet_tuple_t *tuple, fwd_info_t *fi)
+{
+    switch (fi->neg_map_reply_act){
+    case ACT_NO_ACTION:
+        /* Map-Request outstanding: keep the packet until the Map-Reply */
+        if (fi->temporal && ctrl_queue_pending_packet(tuple, b) == GOOD){
+            OOR_LOG(LDBG_3, "tun_output_unicast: Packet queued waiting for "
+                    "the mapping of %s", lisp_addr_to_char(&tuple->dst_addr));
             return (GOOD);
-        case ACT_NATIVE_FWD:
-            return(tun_forward_native(b, &tuple->dst_addr));
         }
+        /* fallthrough */
+    case ACT_SEND_MREQ:
+    case ACT_DROP:
+        OOR_LOG(LDBG_3, "tun_output_unicast: Packet droped");
+        return (GOOD);
+    case ACT_NATIVE_FWD:
+        return(tun_forward_native(b, &tuple->dst_addr));
     }
+    return (GOOD);
+}
 
-    OOR_LOG(LDBG_3,"OUTPUT: Sending encapsulated packet: RLOC %s -> %s\n",
-            lisp_addr_to_char(fe->srloc),
-            lisp_addr_to_char(fe->drloc));
+/* Fill in the Locator-Status-Bits, if lsb_set, and the nonce of the LISP
+ * header lhdr of a packet sent to drloc */
+static inline void
+tun_lisp_hdr_fields(lisp_data_hdr_t *lhdr, uint8_t lsb_set, uint32_t lsb,
+        lisp_addr_t *drloc)
+{
+    echo_nonce_t *en;
+
+    if (lsb_set){
+        lisp_data_hdr_set_lsb(lhdr, lsb);
+    }
+    if (!echo_nonces){
+        return;
+    }
+    en = echo_nonce_lookup(echo_nonces, lisp_addr_ip(drloc), TRUE);
+    if (en){
+        echo_nonce_output(echo_nonces, en, lhdr, time(NULL));
+    }
+}
+
+/* Build in hdr, using hdr_buf as storage, the outer headers of b. The inner
+ * packet stays where it was received and both are sent with scatter-gather */
+static inline int
+tun_encap(lbuf_t *hdr, void *hdr_buf, lbuf_t *b, fwd_info_t *fi)
+{
+    fwd_entry_t *fe = fi->fwd_info;
+    void *outer = NULL;
+
+    lbuf_use_stack(hdr, hdr_buf, TUN_ENCAP_HDR_LEN);
+    lbuf_reserve(hdr, TUN_ENCAP_HDR_LEN);
 
     switch (fi->encap){
     case ENCP_LISP:
-        lisp_data_encap(b, LISP_DATA_PORT, LISP_DATA_PORT, fe->srloc, fe->drloc, fe->iid);
+        outer = lisp_data_encap_hdr(hdr, b, LISP_DATA_PORT, LISP_DATA_PORT, fe->srloc, fe->drloc, fe->iid);
+        if (outer){
+            /* The LISP header is the last one of hdr */
+            tun_lisp_hdr_fields((lisp_data_hdr_t *)((uint8_t *)lbuf_data(hdr)
+                    + lbuf_size(hdr) - sizeof(lisp_data_hdr_t)), fi->lsb_set,
+                    fi->lsb, fe->drloc);
+        }
         break;
     case ENCP_VXLAN_GPE:
-        vxlan_gpe_data_encap(b, VXLAN_GPE_DATA_PORT, VXLAN_GPE_DATA_PORT, fe->srloc, fe->drloc, fe->iid);
+        outer = vxlan_gpe_data_encap_hdr(hdr, b, VXLAN_GPE_DATA_PORT, VXLAN_GPE_DATA_PORT, fe->srloc, fe->drloc, fe->iid);
         break;
     }
+    return (outer ? GOOD : BAD);
+}
+
+static inline int
+tun_fwd_entry_sock(fwd_entry_t *fe)
+{
+    return (fe->out_sock ? *(fe->out_sock) : ERR_SOCKET);
+}
+
+static inline int
+tun_too_big(lbuf_t *hdr, lbuf_t *b, fwd_entry_t *fe)
+{
+    return (fe->mtu && lbuf_size(hdr) + lbuf_size(b) > fe->mtu);
+}
+
+/* Send the encapsulated packet hdr + b to drloc in fragments of the outer IP
+ * header of at most mtu bytes. The rest of the outer headers go in the first
+ * fragment */
+static int
+tun_send_fragments(lbuf_t *hdr, lbuf_t *b, int sock, lisp_addr_t *drloc,
+        int mtu)
+{
+    static uint32_t frag_id;
+    uint8_t fbuf[TUN_ENCAP_HDR_LEN + sizeof(struct ip6_frag)];
+    struct ip *iph = lbuf_data(hdr), *fiph;
+    struct ip6_hdr *fip6h;
+    struct ip6_frag *fragh;
+    lbuf_t fhdr, fpl;
+    int ip_len, l4_len, max, off, len, pos, n, more;
+
+    if (iph->ip_v == IPVERSION){
+        ip_len = iph->ip_hl << 2;
+        max = (mtu - ip_len) & ~7;
+    }else{
+        ip_len = sizeof(struct ip6_hdr);
+        max = (mtu - ip_len - sizeof(struct ip6_frag)) & ~7;
+    }
+    l4_len = lbuf_size(hdr) - ip_len;
+    if (max < l4_len + 8){
+        return (BAD);
+    }
+    frag_id++;
+
+    for (off = 0, pos = 0; pos < lbuf_size(b); off += len, pos += n){
+        /* Bytes of b in the fragment */
+        n = max - (off == 0 ? l4_len : 0);
+        more = (pos + n < lbuf_size(b));
+        if (!more){
+            n = lbuf_size(b) - pos;
+        }
+        len = n + (off == 0 ? l4_len : 0);
+
+        lbuf_use_stack(&fhdr, fbuf, sizeof(fbuf));
+        if (iph->ip_v == IPVERSION){
+            fiph = lbuf_put(&fhdr, iph, ip_len);
+            fiph->ip_len = htons(ip_len + len);
+            fiph->ip_off = htons((off >> 3) | (more ? IP_MF : 0));
+            fiph->ip_sum = 0;
+            fiph->ip_sum = ip_checksum((uint16_t *)fiph, ip_len);
+        }else{
+            fip6h = lbuf_put(&fhdr, iph, ip_len);
+            fip6h->ip6_plen = htons(sizeof(struct ip6_frag) + len);
+            fip6h->ip6_nxt = IPPROTO_FRAGMENT;
+            fragh = lbuf_put_uninit(&fhdr, sizeof(struct ip6_frag));
+            fragh->ip6f_nxt = ((struct ip6_hdr *)iph)->ip6_nxt;
+            fragh->ip6f_reserved = 0;
+            fragh->ip6f_offlg = htons(off) | (more ? IP6F_MORE_FRAG : 0);
+            fragh->ip6f_ident = htonl(frag_id);
+        }
+        if (off == 0){
+            lbuf_put(&fhdr, (uint8_t *)iph + ip_len, l4_len);
+        }
+
+        lbuf_use_stack(&fpl, (uint8_t *)lbuf_data(b) + pos, n);
+        lbuf_set_size(&fpl, n);
+        if (tun_send_fct(&fhdr, &fpl, sock, drloc) != GOOD){
+            return (BAD);
+        }
+    }
+    return (GOOD);
+}
+
+/*
+ * The encapsulated packet hdr + b doesn't fit in the path MTU to its remote
+ * RLOC. With stateless fragmentation it is sent in fragments of the outer
+ * header that the ETR reassembles (RFC 6830 section 5.4.1). Otherwise the
+ * source of the packet is asked to reduce its size (section 5.4.2) and the
+ * packet is dropped, unless it is an IPv4 packet that can be fragmented or an
+ * IPv6 packet that would need an MTU lower than the IPv6 minimum.
+ */
+static int
+tun_output_too_big(lbuf_t *hdr, lbuf_t *b, fwd_entry_t *fe)
+{
+    struct ip *iph = lbuf_data(b);
+    int mtu = fe->mtu - lbuf_size(hdr);
+    lbuf_t icmp;
+
+    if (pmtus->stateless_frag
+            || (iph->ip_v == IPVERSION && !(ntohs(iph->ip_off) & IP_DF))
+            || (iph->ip_v == IP6VERSION && mtu < PMTU_MIN_V6)){
+        if (tun_send_fragments(hdr, b, tun_fwd_entry_sock(fe), fe->drloc,
+                fe->mtu) != GOOD){
+            return (BAD);
+        }
+        pmtus->stats.fragmented++;
+        return (GOOD);
+    }
+
+    pmtus->stats.dropped++;
+    if (token_bucket_take(&pmtus->icmp_rate) == FALSE){
+        return (BAD);
+    }
+    lbuf_use_stack(&icmp, icmp_buf, sizeof(icmp_buf));
+    if (pkt_build_icmp_too_big(&icmp, lbuf_data(b), lbuf_size(b), mtu) != GOOD){
+        return (BAD);
+    }
+    OOR_LOG(LDBG_2, "OUTPUT: Packet of %d bytes too big for the path to %s. "
+            "Asking its source to use an MTU of %d", lbuf_size(b),
+            lisp_addr_to_char(fe->drloc), mtu);
+    pmtus->stats.icmp_sent++;
+    return (tun_host_fct(&icmp));
+}
+
+static int
+tun_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
+{
+    fwd_info_t *fi;
+    fwd_entry_t *fe;
+    uint8_t hdr_buf[TUN_ENCAP_HDR_LEN];
+    lbuf_t hdr;
+
+    /* XXX Since OOR doesn't support same local prefixes with different IIDs when
+     * operating as a XTR or MN, we use IID = 0 to calculate the hash of the ttable.
+     * The actual IID to be used on the encapsulation processed is already stored
+     * in the forwarding entry, which is obtained on a ttable miss.*/
+
+    ttable_tuple_set_hash(tuple);
+    fi = tun_get_fwd_info(tuple);
+    if (fi == NULL){
+        return (BAD);
+    }
+    fe = fi->fwd_info;
+
+    if (!fe || !fe->srloc || !fe->drloc) {
+        return (tun_output_no_fwd_entry(b, tuple, fi));
+    }
 
+    OOR_LOG(LDBG_3,"OUTPUT: Sending encapsulated packet: RLOC %s -> %s\n",
+            lisp_addr_to_char(fe->srloc),
+            lisp_addr_to_char(fe->drloc));
 
-    return(send_raw_packet(*(fe->out_sock), lbuf_data(b), lbuf_size(b),
-               lisp_addr_ip(fe->drloc)));
+    if (tun_encap(&hdr, hdr_buf, b, fi) != GOOD){
+        return (BAD);
+    }
+    if (flowlets){
+        flowlet_account(flowlets, lisp_addr_ip(fe->drloc),
+                lbuf_size(&hdr) + lbuf_size(b));
+    }
+    if (tun_too_big(&hdr, b, fe)){
+        return (tun_output_too_big(&hdr, b, fe));
+    }
 
+    return(tun_send_fct(&hdr, b, tun_fwd_entry_sock(fe), fe->drloc));
 }
 
 int
@@ -258,23 +606,578 @@ tun_output(lbuf_t *b, packet_tuple_t *tpl)
     return(GOOD);
 }
 
+/* Encapsulate a packet generated by the output path for a host. Used by the
+ * RTRs, that have no hosts behind them */
+int
+tun_output_to_eid(lbuf_t *b)
+{
+    packet_tuple_t tpl;
+
+    lbuf_reset_ip(b);
+    if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+        return (BAD);
+    }
+    tpl.iid = 0;
+    return (tun_output(b, &tpl));
+}
+
+/* Send a packet that was queued while the Map-Request of its destination was
+ * outstanding. The temporal entry of its flow is removed from the flow table
+ * so that the new mapping is used */
+int
+tun_output_pending(lbuf_t *b, uint32_t iid)
+{
+    packet_tuple_t tpl;
+
+    lbuf_reset_ip(b);
+    if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+        return (BAD);
+    }
+    tpl.iid = iid;
+    ttable_remove(&ttable, &tpl);
+
+    return (tun_output(b, &tpl));
+}
+
+/* Remove from the flow table the flows that use rloc, or all of them if rloc
+ * is NULL */
+int
+tun_output_flush_flows(lisp_addr_t *rloc)
+{
+    int removed;
+
+    removed = ttable_remove_with_rloc(&ttable, rloc);
+    if (reencaps){
+        removed += reencap_remove_with_rloc(reencaps, rloc);
+    }
+    OOR_LOG(LDBG_2, "tun_output_flush_flows: Removed %d flows using %s",
+            removed, rloc ? lisp_addr_to_char(rloc) : "any RLOC");
+    return (GOOD);
+}
+
+/* Process an ICMP message, starting at its ICMP header, received from the
+ * network. Too big errors for encapsulated packets lower the MTU of the path
+ * and the flows to its remote RLOC are flushed to use the new value */
+int
+tun_output_icmp_input(void *icmp, int len, int afi)
+{
+    ip_addr_t src, dst;
+    lisp_addr_t drloc;
+    int mtu;
+
+    if (!pmtus || pmtu_parse_icmp(icmp, len, afi, &src, &dst, &mtu) != GOOD){
+        return (BAD);
+    }
+    if (pmtu_update(pmtus, &src, &dst, mtu) != GOOD){
+        return (BAD);
+    }
+    lisp_addr_init_from_ip(&drloc, &dst);
+    return (tun_output_flush_flows(&drloc));
+}
+
+int
+tun_output_icmp_recv(sock_t *sl)
+{
+    static uint8_t buf[PKT_ICMP_TOO_BIG_MAX];
+    struct ip *iph = (struct ip *)buf;
+    int nread, afi, hlen = 0;
+    socklen_t len = sizeof(afi);
+
+    nread = read(sl->fd, buf, sizeof(buf));
+    if (nread <= 0
+            || getsockopt(sl->fd, SOL_SOCKET, SO_DOMAIN, &afi, &len) < 0){
+        return (BAD);
+    }
+    /* IPv4 raw sockets receive the IP header */
+    if (afi == AF_INET){
+        hlen = iph->ip_hl << 2;
+        if (nread < sizeof(struct ip) || hlen > nread){
+            return (BAD);
+        }
+    }
+    return (tun_output_icmp_input(buf + hlen, nread - hlen, afi));
+}
+
+/* Packets of the burst are ordered by output socket and, for the same socket,
+ * by forwarding entry. The relative order of the packets of a flow is kept */
+static inline int
+tun_burst_cmp(fwd_info_t *a, fwd_info_t *b)
+{
+    int sa = tun_fwd_entry_sock(a->fwd_info);
+    int sb = tun_fwd_entry_sock(b->fwd_info);
+
+    if (sa != sb){
+        return (sa < sb ? -1 : 1);
+    }
+    if (a != b){
+        return ((uintptr_t)a < (uintptr_t)b ? -1 : 1);
+    }
+    return (0);
+}
+
+#define tun_burst_stage_end(_stage_, _t_) do {          \
+        uint64_t __now = tun_cycles();                  \
+        burst_stats.cycles[_stage_] += __now - (_t_);   \
+        (_t_) = __now;                                  \
+} while (0)
+
+/*
+ * Process a burst of packets read from the tun. Each stage of the pipeline is
+ * applied to all the packets of the burst before moving to the next one:
+ *  - parse: extract the 5 tuple. LISP and multicast packets are handed to the
+ *    scalar path.
+ *  - hash: compute the hash of the tuples and prefetch the flow table buckets.
+ *  - lookup: obtain the forwarding info. Packets without a complete
+ *    forwarding entry are dropped or forwarded natively.
+ *  - group: order packets by output socket and forwarding entry.
+ *  - encap: add the outer headers.
+ *  - send: one system call per output socket.
+ * iids contains the IID of each packet or is NULL to use IID 0 for all of them.
+ * Returns the number of packets sent encapsulated
+ */
+int
+tun_output_burst(lbuf_t *bufs, uint32_t *iids, int n)
+{
+    packet_tuple_t tpls[TUN_OUTPUT_BURST];
+    fwd_info_t *fis[TUN_OUTPUT_BURST];
+    int order[TUN_OUTPUT_BURST];
+    uint8_t hdr_bufs[TUN_OUTPUT_BURST][TUN_ENCAP_HDR_LEN];
+    lbuf_t hdrs[TUN_OUTPUT_BURST];
+    struct iovec iovs[2 * TUN_OUTPUT_BURST];
+    ip_addr_t *dsts[TUN_OUTPUT_BURST];
+    fwd_entry_t *fe;
+    int i, j, k, start, nfwd, nenc, sock, big, sent = 0, dropped;
+    uint64_t t;
+
+    if (n > TUN_OUTPUT_BURST){
+        n = TUN_OUTPUT_BURST;
+    }
+    t = tun_cycles();
+
+    /* The forwarding info of the burst must survive the entries removed from
+     * the table by the lookups and insertions of the rest of the burst */
+    ttable_hold(&ttable);
+
+    nfwd = 0;
+    for (i = 0; i < n; i++){
+        lbuf_reset_ip(&bufs[i]);
+        if (pkt_parse_5_tuple(&bufs[i], &tpls[i]) != GOOD) {
+            continue;
+        }
+        tpls[i].iid = iids ? iids[i] : 0;
+        if (is_lisp_packet(&tpls[i])
+                || ip_addr_is_multicast(lisp_addr_ip(&tpls[i].dst_addr))) {
+            tun_output(&bufs[i], &tpls[i]);
+            continue;
+        }
+        order[nfwd++] = i;
+    }
+    tun_burst_stage_end(TUN_STAGE_PARSE, t);
+
+    for (k = 0; k < nfwd; k++){
+        i = order[k];
+        ttable_tuple_set_hash(&tpls[i]);
+        ttable_prefetch(&ttable, tpls[i].hash);
+    }
+    tun_burst_stage_end(TUN_STAGE_HASH, t);
+
+    nenc = 0;
+    for (k = 0; k < nfwd; k++){
+        i = order[k];
+        fis[i] = tun_get_fwd_info(&tpls[i]);
+        if (fis[i] == NULL){
+            continue;
+        }
+        fe = fis[i]->fwd_info;
+        if (!fe || !fe->srloc || !fe->drloc) {
+            tun_output_no_fwd_entry(&bufs[i], &tpls[i], fis[i]);
+            continue;
+        }
+        order[nenc++] = i;
+    }
+    tun_burst_stage_end(TUN_STAGE_LOOKUP, t);
+
+    /* Insertion sort: stable and cheap for the size of a burst */
+    for (k = 1; k < nenc; k++){
+        i = order[k];
+        for (j = k; j > 0 && tun_burst_cmp(fis[order[j-1]], fis[i]) > 0; j--){
+            order[j] = order[j-1];
+        }
+        order[j] = i;
+    }
+    tun_burst_stage_end(TUN_STAGE_GROUP, t);
+
+    for (j = 0, k = 0; k < nenc; k++){
+        i = order[k];
+        if (tun_encap(&hdrs[i], hdr_bufs[i], &bufs[i], fis[i]) != GOOD){
+            continue;
+        }
+        if (flowlets){
+            fe = fis[i]->fwd_info;
+            flowlet_account(flowlets, lisp_addr_ip(fe->drloc),
+                    lbuf_size(&hdrs[i]) + lbuf_size(&bufs[i]));
+        }
+        order[j++] = i;
+    }
+    nenc = j;
+    tun_burst_stage_end(TUN_STAGE_ENCAP, t);
+
+    for (start = 0; start < nenc; start = k){
+        sock = tun_fwd_entry_sock(fis[order[start]]->fwd_info);
+        big = FALSE;
+        for (k = start; k < nenc
+                && tun_fwd_entry_sock(fis[order[k]]->fwd_info) == sock; k++){
+            i = order[k];
+            fe = fis[i]->fwd_info;
+            iovs[2 * (k - start)].iov_base = lbuf_data(&hdrs[i]);
+            iovs[2 * (k - start)].iov_len = lbuf_size(&hdrs[i]);
+            iovs[2 * (k - start) + 1].iov_base = lbuf_data(&bufs[i]);
+            iovs[2 * (k - start) + 1].iov_len = lbuf_size(&bufs[i]);
+            dsts[k - start] = lisp_addr_ip(fe->drloc);
+            if (tun_too_big(&hdrs[i], &bufs[i], fe)){
+                big = TRUE;
+            }
+        }
+        /* Groups with packets that don't fit in the path MTU are sent one
+         * by one to keep the order of their flows */
+        if (!big && tun_send_fct == tun_send_raw_packet && sock != ERR_SOCKET){
+            sent += send_raw_packets(sock, iovs, 2, dsts, k - start, &dropped);
+            burst_stats.send_drops += dropped;
+        }else{
+            for (j = start; j < k; j++){
+                i = order[j];
+                fe = fis[i]->fwd_info;
+                if (tun_too_big(&hdrs[i], &bufs[i], fe)){
+                    tun_output_too_big(&hdrs[i], &bufs[i], fe);
+                    continue;
+                }
+                if (tun_send_fct(&hdrs[i], &bufs[i], sock, fe->drloc) == GOOD){
+                    sent++;
+                }
+            }
+        }
+    }
+    tun_burst_stage_end(TUN_STAGE_SEND, t);
+    ttable_release(&ttable);
+
+    burst_stats.bursts++;
+    burst_stats.pkts += n;
+
+    return (sent);
+}
+
+/* Update the UDP checksum after len bytes of the packet changed from old to
+ * new (RFC 1624). IPv4 packets sent without checksum are left without it */
+static inline void
+tun_udp_cksum_update(struct udphdr *udph, const void *old, const void *new,
+        int len)
+{
+    if (udph->check == 0){
+        return;
+    }
+    udph->check = cksum_update_buf(udph->check, old, new, len);
+    if (udph->check == 0){
+        udph->check = 0xFFFF;
+    }
+}
+
+/*
+ * Re-encapsulate in place the packet b received from src_rloc, that starts at
+ * its outer IPv4 header, if its (source RLOC, IID, destination EID) is in the
+ * re-encapsulation cache. The TTL and ECN of the inner header are set as
+ * tun_decap_pkt does. Then the outer IP addresses, the UDP source port and
+ * the LISP or VXLAN-GPE header are rewritten, updating the checksums
+ * incrementally, so the packet is the one tun_output would have built. On
+ * success, drloc and sock are where the packet should be sent. Returns BAD if
+ * the packet should take the regular path and ERR_INVALID_ECN if it has to be
+ * dropped
+ */
+static int
+tun_reencap_pkt(lbuf_t *b, lisp_addr_t *src_rloc, lisp_addr_t *drloc,
+        int *sock)
+{
+    struct ip *iph = lbuf_data(b), *in_iph;
+    struct ip6_hdr *in_ip6h;
+    struct udphdr *udph, *in_udph;
+    lisp_data_hdr_t *lhdr;
+    vxlan_gpe_hdr_t *vhdr;
+    uint8_t *encap_hdr, old[sizeof(struct ip)];
+    packet_tuple_t tpl;
+    reencap_key_t key;
+    reencap_t *entry, re;
+    int hdrs_len, in_len, l4_off, port, in_ttl, in_tos, ecn, tos;
+    uint16_t old_port;
+
+    hdrs_len = sizeof(struct ip) + sizeof(struct udphdr)
+            + sizeof(lisp_data_hdr_t);
+    if (lbuf_size(b) < hdrs_len + sizeof(struct ip) || iph->ip_v != IPVERSION
+            || iph->ip_hl != 5 || iph->ip_p != IPPROTO_UDP
+            || (ntohs(iph->ip_off) & (IP_MF | IP_OFFMASK)) != 0){
+        return (BAD);
+    }
+    udph = (struct udphdr *)(iph + 1);
+    encap_hdr = (uint8_t *)(udph + 1);
+    lhdr = (lisp_data_hdr_t *)encap_hdr;
+    vhdr = (vxlan_gpe_hdr_t *)encap_hdr;
+    in_iph = (struct ip *)(encap_hdr + sizeof(lisp_data_hdr_t));
+    in_len = lbuf_size(b) - hdrs_len;
+
+    /* Same IID as tun_decap_pkt */
+    port = ntohs(udpdport(udph));
+    switch (port){
+    case LISP_DATA_PORT:
+        if (LDHDR_LSB_BIT(lhdr)){
+            key.iid = lisp_data_hdr_get_iid(lhdr);
+        }else{
+            key.iid = 0;
+        }
+        break;
+    case VXLAN_GPE_DATA_PORT:
+        if (!VXLAN_HDR_VNI_BIT(vhdr)){
+            return (BAD);
+        }
+        key.iid = vxlan_gpe_hdr_get_vni(vhdr);
+        break;
+    default:
+        return (BAD);
+    }
+
+    /* LISP packets are not encapsulated again: leave them to tun_output */
+    switch (in_iph->ip_v){
+    case IPVERSION:
+        ip_addr_init(&key.dst_eid, &in_iph->ip_dst, AF_INET);
+        tpl.protocol = in_iph->ip_p;
+        l4_off = in_iph->ip_hl << 2;
+        break;
+    case IP6VERSION:
+        if (in_len < sizeof(struct ip6_hdr)){
+            return (BAD);
+        }
+        in_ip6h = (struct ip6_hdr *)in_iph;
+        ip_addr_init(&key.dst_eid, &in_ip6h->ip6_dst, AF_INET6);
+        tpl.protocol = in_ip6h->ip6_nxt;
+        l4_off = sizeof(struct ip6_hdr);
+        break;
+    default:
+        return (BAD);
+    }
+    if (tpl.protocol == IPPROTO_UDP){
+        if (in_len < l4_off + sizeof(struct udphdr)){
+            return (BAD);
+        }
+        in_udph = (struct udphdr *)((uint8_t *)in_iph + l4_off);
+        tpl.src_port = ntohs(udpsport(in_udph));
+        tpl.dst_port = ntohs(udpdport(in_udph));
+        if (is_lisp_packet(&tpl)){
+            return (BAD);
+        }
+    }
+
+    ip_addr_copy(&key.src_rloc, lisp_addr_ip(src_rloc));
+    entry = reencap_lookup(reencaps, &key);
+    if (entry == NULL || entry->out_sock == NULL
+            || entry->encap != (port == LISP_DATA_PORT ? ENCP_LISP : ENCP_VXLAN_GPE)
+            || (entry->mtu && lbuf_size(b) > entry->mtu)){
+        return (BAD);
+    }
+    /* tun_input_lisp_hdr may flush the cache */
+    re = *entry;
+
+    ip_hdr_ttl_and_tos((struct iphdr *)in_iph, &in_ttl, &in_tos);
+    ecn = tun_input_ecn(in_tos, iph->ip_tos);
+    if (ecn < 0){
+        return (ERR_INVALID_ECN);
+    }
+    tos = (iph->ip_tos & ~ECN_MASK) | ecn;
+
+    if (port == LISP_DATA_PORT){
+        lbuf_pull(b, sizeof(struct ip));
+        lbuf_reset_udp(b);
+        lbuf_pull(b, sizeof(struct udphdr) + sizeof(lisp_data_hdr_t));
+        lbuf_reset_l3(b);
+        tun_input_lisp_hdr(b, src_rloc, key.iid);
+        lbuf_push_uninit(b, hdrs_len);
+    }
+
+    /* Inner header */
+    memcpy(old, in_iph, sizeof(old));
+    ip_hdr_set_ttl_and_tos((struct iphdr *)in_iph, iph->ip_ttl, tos);
+    tun_udp_cksum_update(udph, old, in_iph, sizeof(old));
+
+    /* LISP or VXLAN-GPE header */
+    memcpy(old, encap_hdr, sizeof(lisp_data_hdr_t));
+    if (re.encap == ENCP_LISP){
+        lisp_data_hdr_init(lhdr, re.iid);
+        tun_lisp_hdr_fields(lhdr, re.lsb_set, re.lsb, &re.drloc);
+    }else{
+        vxlan_gpe_data_hdr_init(vhdr, re.iid,
+                in_iph->ip_v == IP6VERSION ? NP_IPv6 : NP_IPv4);
+    }
+    tun_udp_cksum_update(udph, old, encap_hdr, sizeof(lisp_data_hdr_t));
+
+    /* UDP and outer IP headers */
+    old_port = udph->source;
+    udph->source = htons(port);
+    tun_udp_cksum_update(udph, &old_port, &udph->source, sizeof(uint16_t));
+    memcpy(old, &iph->ip_src, 2 * sizeof(struct in_addr));
+    ip_addr_copy_to(&iph->ip_src, lisp_addr_ip(&re.srloc));
+    ip_addr_copy_to(&iph->ip_dst, lisp_addr_ip(&re.drloc));
+    tun_udp_cksum_update(udph, old, &iph->ip_src, 2 * sizeof(struct in_addr));
+    iph->ip_sum = cksum_update_buf(iph->ip_sum, old, &iph->ip_src,
+            2 * sizeof(struct in_addr));
+    pkt_ipv4_set_id_and_df(iph);
+    ip_hdr_set_ttl_and_tos((struct iphdr *)iph, iph->ip_ttl, tos);
+
+    lisp_addr_copy(drloc, &re.drloc);
+    *sock = *re.out_sock;
+    return (GOOD);
+}
+
+/*
+ * RTR fast path. Re-encapsulate in place, without decapsulating them, the
+ * packets of the burst received over IPv4 that are in the re-encapsulation
+ * cache, and send them with one system call per output socket. handled is set
+ * for the packets sent or dropped. The rest should take the regular path and
+ * be passed to tun_output_reencap_learn afterwards. Returns the number of
+ * packets sent
+ */
+int
+tun_output_reencap(lbuf_t *bufs, sock_data_info_t *info, int n,
+        uint8_t *handled)
+{
+    lisp_addr_t drlocs[TUN_OUTPUT_BURST];
+    int socks[TUN_OUTPUT_BURST];
+    int order[TUN_OUTPUT_BURST];
+    struct iovec iovs[TUN_OUTPUT_BURST];
+    ip_addr_t *dsts[TUN_OUTPUT_BURST];
+    int i, j, k, start, nre = 0, sent = 0, dropped;
+
+    if (n > TUN_OUTPUT_BURST){
+        n = TUN_OUTPUT_BURST;
+    }
+    for (i = 0; i < n; i++){
+        handled[i] = FALSE;
+        if (info[i].afi != AF_INET){
+            continue;
+        }
+        switch (tun_reencap_pkt(&bufs[i], &info[i].src, &drlocs[i], &socks[i])){
+        case GOOD:
+            order[nre++] = i;
+            handled[i] = TRUE;
+            break;
+        case ERR_INVALID_ECN:
+            handled[i] = TRUE;
+            break;
+        }
+    }
+
+    /* Group by output socket keeping the order of the packets */
+    for (k = 1; k < nre; k++){
+        i = order[k];
+        for (j = k; j > 0 && socks[order[j-1]] > socks[i]; j--){
+            order[j] = order[j-1];
+        }
+        order[j] = i;
+    }
+
+    for (start = 0; start < nre; start = k){
+        for (k = start; k < nre && socks[order[k]] == socks[order[start]]; k++){
+            i = order[k];
+            iovs[k - start].iov_base = lbuf_data(&bufs[i]);
+            iovs[k - start].iov_len = lbuf_size(&bufs[i]);
+            dsts[k - start] = lisp_addr_ip(&drlocs[i]);
+        }
+        if (tun_send_fct == tun_send_raw_packet
+                && socks[order[start]] != ERR_SOCKET){
+            sent += send_raw_packets(socks[order[start]], iovs, 1, dsts,
+                    k - start, &dropped);
+            burst_stats.send_drops += dropped;
+            continue;
+        }
+        for (j = start; j < k; j++){
+            i = order[j];
+            if (tun_send_fct(NULL, &bufs[i], socks[i], &drlocs[i]) == GOOD){
+                sent++;
+            }
+        }
+    }
+    return (sent);
+}
+
+/* Add to the re-encapsulation cache the forwarding info used by the regular
+ * path for the decapsulated packet b, received from src_rloc. Only IPv4
+ * RLOCs are cached */
+void
+tun_output_reencap_learn(lbuf_t *b, lisp_addr_t *src_rloc, uint32_t iid)
+{
+    packet_tuple_t tpl;
+    reencap_key_t key;
+    fwd_info_t *fi;
+    fwd_entry_t *fe;
+
+    if (lisp_addr_ip_afi(src_rloc) != AF_INET){
+        return;
+    }
+    lbuf_reset_ip(b);
+    if (pkt_parse_5_tuple(b, &tpl) != GOOD) {
+        return;
+    }
+    tpl.iid = iid;
+    fi = ttable_lookup(&ttable, &tpl);
+    if (fi == NULL){
+        return;
+    }
+    fe = fi->fwd_info;
+    if (!fe || !fe->srloc || !fe->drloc || !fe->out_sock
+            || !lisp_addr_is_ip(fe->srloc) || !lisp_addr_is_ip(fe->drloc)
+            || lisp_addr_ip_afi(fe->srloc) != AF_INET
+            || lisp_addr_ip_afi(fe->drloc) != AF_INET){
+        return;
+    }
+    ip_addr_copy(&key.src_rloc, lisp_addr_ip(src_rloc));
+    ip_addr_copy(&key.dst_eid, lisp_addr_ip(&tpl.dst_addr));
+    key.iid = iid;
+    reencap_insert(reencaps, &key, fi);
+}
+
 int
 tun_output_recv(sock_t *sl)
 {
     packet_tuple_t tpl;
+    int n, nread;
 
-    lbuf_use_stack(&pkt_buf, &pkt_recv_buf, TUN_RECEIVE_SIZE);
-    lbuf_reserve(&pkt_buf, LBUF_STACK_OFFSET);
+    /* Read until the tun is empty or the burst is full. The tun is non
+     * blocking */
+    for (n = 0; n < TUN_OUTPUT_BURST; n++){
+        /* Outer headers are built in their own buffer */
+        lbuf_use_stack(&pkt_bufs[n], pkt_recv_bufs + n * pkt_recv_buf_len,
+                pkt_recv_buf_len);
+        lbuf_reserve(&pkt_bufs[n], pkt_buf_conf.headroom);
+        nread = read(sl->fd, lbuf_data(&pkt_bufs[n]), lbuf_tailroom(&pkt_bufs[n]));
+        if (nread <= 0) {
+            if (nread < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+                OOR_LOG(LWRN, "OUTPUT: Error while reading from tun: %s",
+                        strerror(errno));
+            }
+            break;
+        }
+        lbuf_set_size(&pkt_bufs[n], nread);
+    }
 
-    if (sock_recv(sl->fd, &pkt_buf) != GOOD) {
-        OOR_LOG(LWRN, "OUTPUT: Error while reading from tun!");
+    if (n == 0){
         return (BAD);
     }
-    lbuf_reset_ip(&pkt_buf);
-    if (pkt_parse_5_tuple(&pkt_buf, &tpl) != GOOD) {
+
+    if (n > 1){
+        tun_output_burst(pkt_bufs, NULL, n);
+        return (GOOD);
+    }
+
+    lbuf_reset_ip(&pkt_bufs[0]);
+    if (pkt_parse_5_tuple(&pkt_bufs[0], &tpl) != GOOD) {
         return (BAD);
     }
     tpl.iid = 0;
-    tun_output(&pkt_buf, &tpl);
+    tun_output(&pkt_bufs[0], &tpl);
     return (GOOD);
 }
@@ -32,11 +32,54 @@
 #include "../../iface_list.h"
 #include "../../oor_external.h"
 #include "../../lib/cksum.h"
+#include "../../lib/packets.h"
 
+/* Maximum number of packets processed together by the output path */
+#define TUN_OUTPUT_BURST    32
+
+typedef enum {
+    TUN_STAGE_PARSE,
+    TUN_STAGE_HASH,
+    TUN_STAGE_LOOKUP,
+    TUN_STAGE_GROUP,
+    TUN_STAGE_ENCAP,
+    TUN_STAGE_SEND,
+    TUN_STAGE_MAX
+} tun_burst_stage_e;
+
+typedef struct tun_burst_stats_ {
+    uint64_t bursts;
+    uint64_t pkts;
+    /* Packets that the raw socket failed to send */
+    uint64_t send_drops;
+    uint64_t cycles[TUN_STAGE_MAX];
+} tun_burst_stats_t;
+
+/* Room for the outer headers of a packet */
+#define TUN_ENCAP_HDR_LEN   MAX_DATA_ENCAP_LEN
+
+/* Send the packet b to dst. hdr contains the outer headers to be sent in
+ * front of b or is NULL for packets forwarded natively */
+typedef int (*tun_output_send_fct)(lbuf_t *hdr, lbuf_t *b, int sock,
+        lisp_addr_t *dst);
+/* Deliver to the host a packet generated by the output path */
+typedef int (*tun_output_host_fct)(lbuf_t *b);
 
 int tun_output_recv(sock_t *sl);
 int tun_output(lbuf_t *, packet_tuple_t *);
+int tun_output_burst(lbuf_t *bufs, uint32_t *iids, int n);
+int tun_output_reencap(lbuf_t *bufs, sock_data_info_t *info, int n,
+        uint8_t *handled);
+void tun_output_reencap_learn(lbuf_t *b, lisp_addr_t *src_rloc, uint32_t iid);
+int tun_output_pending(lbuf_t *b, uint32_t iid);
+int tun_output_to_eid(lbuf_t *b);
+int tun_output_flush_flows(lisp_addr_t *rloc);
+int tun_output_icmp_input(void *icmp, int len, int afi);
+int tun_output_icmp_recv(sock_t *sl);
+void tun_output_burst_stats_dump(int log_level);
 void tun_output_init();
 void tun_output_uninit();
+void tun_output_set_send_fct(tun_output_send_fct send_fct);
+void tun_output_set_host_fct(tun_output_host_fct host_fct);
 
 #endif /*TUN_OUTPUT_H_*/
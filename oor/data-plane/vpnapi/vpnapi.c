@@ -54,6 +54,8 @@ data_plane_struct_t dplane_vpnapi = {
         .datap_updated_route = vpnapi_updated_route,
         .datap_updated_addr = vpnapi_updated_addr,
         .datap_update_link = vpnapi_update_link,
+        .datap_send_pending_packet = NULL,
+        .datap_flush_flows = vpnapi_output_flush_flows,
         .datap_data = NULL
 };
 
@@ -130,6 +132,7 @@ vpnapi_uninit_data_plane()
     if (data){
         free (data);
         vpnapi_output_uninit();
+        vpnapi_input_uninit();
     }
 }
 
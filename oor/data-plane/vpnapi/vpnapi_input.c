@@ -26,6 +26,7 @@
 #include "vpnapi_output.h"
 #include "../data-plane.h"
 #include "../encapsulations/vxlan-gpe.h"
+#include "../../lib/ecn.h"
 #include "../../lib/packets.h"
 #include "../../lib/mem_util.h"
 #include "../../liblisp/liblisp.h"
@@ -34,13 +35,30 @@
 /* static buffer to receive packets */
 static uint8_t pkt_recv_buf[MAX_IP_PKT_LEN+1];
 static lbuf_t pkt_buf;
+static ecn_stats_t ecn_stats;
 
 
+void
+vpnapi_input_uninit()
+{
+    vpnapi_input_stats_dump(LDBG_1);
+}
+
+void
+vpnapi_input_stats_dump(int log_level)
+{
+    OOR_LOG(log_level, "INPUT: ECN: %"PRIu64" CE marks propagated to the "
+            "inner header, %"PRIu64" packets dropped with CE outer and Not-ECT "
+            "inner headers, %"PRIu64" unexpected combinations",
+            ecn_stats.ce_propagated, ecn_stats.invalid_dropped,
+            ecn_stats.unexpected);
+}
+
 int
 vpnapi_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
 {
     uint8_t ttl = 0, tos = 0;
-    int afi, port;
+    int afi, port, inner_ttl, inner_tos, ecn;
     lisp_data_hdr_t *lisp_hdr;
     vxlan_gpe_hdr_t *vxlan_hdr;
     vpnapi_data_t *data;
@@ -80,9 +98,17 @@ vpnapi_read_and_decap_pkt(int sock, lbuf_t *b, uint32_t *iid)
     /* RESET L3: prepare for output */
     lbuf_reset_l3(b);
 
-    /* UPDATE IP TOS and TTL. Checksum is also updated for IPv4
+    /* UPDATE IP TOS and TTL. The ECN field is combined with the outer one
+     * (RFC 6040). Checksum is also updated for IPv4
      * NOTE: we always assume an IP payload*/
-    ip_hdr_set_ttl_and_tos(lbuf_data(b), ttl, tos);
+    if (ip_hdr_ttl_and_tos(lbuf_data(b), &inner_ttl, &inner_tos) != GOOD){
+        return (ERR_NOT_ENCAP);
+    }
+    ecn = ecn_decap(inner_tos, tos, &ecn_stats);
+    if (ecn < 0){
+        return (ERR_INVALID_ECN);
+    }
+    ip_hdr_set_ttl_and_tos(lbuf_data(b), ttl, (tos & ~ECN_MASK) | ecn);
 
     OOR_LOG(LDBG_3, "INPUT (%d): %s",port, ip_src_and_dst_to_char(lbuf_l3(b),
             "Inner IP: %s -> %s"));
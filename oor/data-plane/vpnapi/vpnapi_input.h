@@ -23,6 +23,8 @@
 
 #include "../../lib/sockets.h"
 
+void vpnapi_input_uninit();
+void vpnapi_input_stats_dump(int log_level);
 int vpnapi_process_input_packet(sock_t *sl);
 int vpnapi_rtr_process_input_packet(sock_t *sl);
 
@@ -51,6 +51,19 @@ vpnapi_output_uninit()
     ttable_uninit(&ttable);
 }
 
+/* Remove from the flow table the flows that use rloc, or all of them if rloc
+ * is NULL */
+int
+vpnapi_output_flush_flows(lisp_addr_t *rloc)
+{
+    int removed;
+
+    removed = ttable_remove_with_rloc(&ttable, rloc);
+    OOR_LOG(LDBG_2, "vpnapi_output_flush_flows: Removed %d flows using %s",
+            removed, rloc ? lisp_addr_to_char(rloc) : "any RLOC");
+    return (GOOD);
+}
+
 static int
 vpnapi_forward_native(lbuf_t *b, lisp_addr_t *dst)
 {
@@ -85,6 +98,7 @@ vpnapi_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
 {
     fwd_info_t *fi;
     fwd_entry_t *fe;
+    lisp_data_hdr_t *lhdr;
     uint32_t iid = tuple->iid;
 
     /* XXX Since OOR doesn't support same local prefixes with different IIDs when
@@ -136,7 +150,10 @@ vpnapi_output_unicast(lbuf_t *b, packet_tuple_t *tuple)
             lisp_addr_to_char(fe->drloc));
 
     /* push lisp data hdr */
-    lisp_data_push_hdr(b, fe->iid);
+    lhdr = lisp_data_push_hdr(b, fe->iid);
+    if (fi->lsb_set){
+        lisp_data_hdr_set_lsb(lhdr, fi->lsb);
+    }
 
     return(send_datagram_packet (*(fe->out_sock), lbuf_data(b), lbuf_size(b),
             fe->drloc, LISP_DATA_PORT));
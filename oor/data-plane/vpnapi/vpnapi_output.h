@@ -28,6 +28,7 @@ void vpnapi_output_init();
 void vpnapi_output_uninit();
 int vpnapi_output(lbuf_t *b, packet_tuple_t *tpl);
 int vpnapi_output_recv(struct sock *sl);
+int vpnapi_output_flush_flows(lisp_addr_t *rloc);
 int vpnapi_send_ctrl_msg(lbuf_t *buf, uconn_t *udp_conn);
 
 
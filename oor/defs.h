@@ -37,9 +37,11 @@ typedef enum {
 #ifdef __GNUC__
 #define likely(x)       __builtin_expect(!!(x), 1)
 #define unlikely(x)     __builtin_expect(!!(x), 0)
+#define prefetch(x)     __builtin_prefetch(x)
 #else
 #define likely(x)       (x)
 #define unlikely(x)     (x)
+#define prefetch(x)
 #endif
 
 typedef struct oor_ctrl_dev oor_ctrl_dev_t;
@@ -50,6 +52,11 @@ typedef struct sockmstr sockmstr_t;
 typedef struct htable_ptrs htable_ptrs_t;
 typedef struct data_plane_struct data_plane_struct_t;
 typedef struct htable_nonces_ htable_nonces_t;
+typedef struct echo_nonce_table_ echo_nonce_table_t;
+typedef struct rloc_lsb_table_ rloc_lsb_table_t;
+typedef struct flowlet_table_ flowlet_table_t;
+typedef struct pmtu_table_ pmtu_table_t;
+typedef struct reencap_table_ reencap_table_t;
 
 /* Protocols constants related with timeouts */
 #define OOR_INITIAL_MRQ_TIMEOUT       2  // Initial expiration timer for the first MRq
@@ -69,11 +76,77 @@ typedef struct htable_nonces_ htable_nonces_t;
 
 
 #define DEFAULT_MAP_REQUEST_RETRIES             3
+/* Packets queued per map cache entry while its Map-Request is outstanding */
+#define DEFAULT_MISS_QUEUE_LEN                  4
+/* Bytes used by all the packets waiting for a Map-Reply */
+#define DEFAULT_MISS_QUEUE_BYTES                262144
+/* Map cache misses posted by the data path and not yet processed */
+#define MISS_RING_SIZE                          1024
+/* Slots of the filter of the misses posted and not processed yet */
+#define MISS_PENDING_SLOTS                      256
+/* Misses processed each time the control plane is woken up */
+#define MISS_RING_BATCH                         64
+/* Map-Requests per second sent in total and to each Map-Resolver */
+#define DEFAULT_MREQ_RATE                       200
+#define DEFAULT_MR_MREQ_RATE                    100
+/* Prefix length used to coalesce the Map-Requests of close EIDs */
+#define DEFAULT_MREQ_COALESCE_V4                24
+#define DEFAULT_MREQ_COALESCE_V6                48
+/* Consecutive Map-Requests without reply after which a Map-Resolver is
+ * only used if there is no other one. It gets a request every
+ * MR_REPROBE_INTERVAL seconds to check if it has recovered */
+#define MR_DEMOTE_LOSSES                        3
+#define MR_REPROBE_INTERVAL                     30
+/* Delay of the hedged Map-Request: percentile of the RTT of the first
+ * Map-Resolver or a default (ms) while it has too few samples */
+#define MR_HEDGE_PERCENTILE                     95
+#define MR_HEDGE_MIN_SAMPLES                    8
+#define MR_HEDGE_DEFAULT_DELAY                  500
+#define MR_HEDGE_MIN_DELAY                      10
+/* Dynamic map cache entries kept before evicting the least used ones */
+#define DEFAULT_MCACHE_MAX_ENTRIES              65536
+/* Seconds between snapshots of the map cache */
+#define DEFAULT_MCACHE_SNAPSHOT_INTERVAL        300
+/* Entries restored from a snapshot are used for MCACHE_STALE_TTL seconds
+ * unless a Map-Reply confirms them. Their Map-Requests are spread at
+ * MCACHE_REVALIDATE_RATE per second */
+#define MCACHE_STALE_TTL                        60
+#define MCACHE_REVALIDATE_RATE                  50
+/* Map cache entries used in the last DEFAULT_MCACHE_REFRESH_WINDOW seconds
+ * are requested again at MCACHE_REFRESH_POINT percent of their TTL and kept
+ * up to MCACHE_REFRESH_GRACE seconds after it while waiting for the reply.
+ * Not done for TTLs shorter than MCACHE_REFRESH_MIN_TTL seconds */
+#define DEFAULT_MCACHE_REFRESH_WINDOW           60
+#define MCACHE_REFRESH_POINT                    90
+#define MCACHE_REFRESH_GRACE                    30
+#define MCACHE_REFRESH_MIN_TTL                  10
+/* Map cache entries whose expiration is processed per second */
+#define MCACHE_EXPIRY_BUDGET                    1000
+/* Map-Requests sent to refresh or confirm map cache entries carry up to
+ * DEFAULT_MREQ_BATCH_RECORDS EID records. Entries wait up to one second to
+ * be grouped */
+#define DEFAULT_MREQ_BATCH_RECORDS              16
+#define MREQ_BATCH_MAX_RECORDS                  64
+/* Map-Replies of the Map Server with several records are split to not
+ * exceed this length */
+#define MS_MAP_REPLY_MAX_LEN                    1200
+/* Mappings gleaned from received data packets: TTL in seconds until a
+ * Map-Reply confirms them, maximum number of gleaned entries and new
+ * entries per second */
+#define DEFAULT_GLEAN_TTL                       30
+#define DEFAULT_GLEAN_MAX_ENTRIES               1000
+#define DEFAULT_GLEAN_RATE                      50
+/* Echo-nonce: seconds waiting for the echo of a nonce and between
+ * requests to the same RLOC */
+#define DEFAULT_ECHO_NONCE_WINDOW               3
+#define DEFAULT_ECHO_NONCE_INTERVAL             10
 
 #define MAP_REGISTER_INTERVAL                   60
 #define MS_SITE_EXPIRATION                      180
 
 #define RLOC_PROBING_INTERVAL                   30
+/* Random variation, in percent, of the interval between probes of an RLOC */
+#define RLOC_PROBING_JITTER                     10
 #define DEFAULT_RLOC_PROBING_RETRIES            2
 #define DEFAULT_RLOC_PROBING_RETRIES_INTERVAL   5   /* Interval in seconds between RLOC probing retries  */
 
@@ -112,6 +185,7 @@ typedef struct htable_nonces_ htable_nonces_t;
 #define ERR_CTR_IFACE       -7
 #define ERR_NOT_ENCAP       -8
 #define ERR_SOCKET          -9
+#define ERR_INVALID_ECN     -10
 
 #define TRUE                1
 #define FALSE               0
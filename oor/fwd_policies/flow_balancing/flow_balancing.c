@@ -22,6 +22,18 @@
 #include "../../lib/oor_log.h"
 #include "../../liblisp/liblisp.h"
 
+/* Slots of the lookup tables per locator of the mapping with the same
+ * family. The size of a table is the first of fb_table_sizes, all of them
+ * primes, with at least FB_SLOTS_PER_LOCATOR slots per locator. It doesn't
+ * depend on the state of the locators, so the table keeps its size when one
+ * goes down */
+#define FB_SLOTS_PER_LOCATOR    128
+#define FB_EMPTY_SLOT           0xff
+
+static const int fb_table_sizes[] = {
+        131, 257, 521, 1031, 2053, 4099, 8209, 16411, 32771, 65537
+};
+
 fb_dev_parm *fb_dev_parm_new();
 void *fb_dev_parm_new_init(oor_ctrl_dev_t *ctrl_dev,
         fwd_policy_dev_parm *dev_parm_inf);
@@ -33,12 +45,14 @@ int mce_balancing_locators_vecs_new_init(void *dev_parm, mcache_entry_t *mce,
         routing_info_del_fct del_fct);
 static void *balancing_locators_vecs_new_init(void *dev_parm, mapping_t *map, uint8_t is_mce);
 void balancing_locators_vecs_del(void * bal_vec);
+size_t balancing_locators_vecs_size(void *bal_vec);
 void fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm,
         void *dst_map_parm, packet_tuple_t *tuple, fwd_info_t *fwd_info);
-static locator_t **set_balancing_vector(locator_t **, int, int, int *);
+static fb_lookup_table *fb_lookup_table_new(fb_dev_parm *, locator_t **, int,
+        uint8_t);
+static void fb_lookup_table_del(fb_lookup_table *);
+static int fb_lookup_table_moved(fb_lookup_table *, fb_lookup_table *);
 static int select_best_priority_locators(glist_t *, locator_t **, uint8_t);
-static inline void get_hcf_locators_weight(locator_t **, int *, int *);
-static int highest_common_factor(int a, int b);
 /* Initialize to 0 balancing_locators_vecs */
 static void balancing_locators_vecs_reset (balancing_locators_vecs *blv);
 static void balancing_locators_vec_dump(balancing_locators_vecs,
@@ -58,6 +72,7 @@ fwd_policy_class  fwd_policy_flow_balancing = {
         .del_map_loc_policy_inf = balancing_locators_vecs_del,
         .init_map_cache_policy_inf = mce_balancing_locators_vecs_new_init,
         .del_map_cache_policy_inf = balancing_locators_vecs_del,
+        .map_cache_policy_inf_size = balancing_locators_vecs_size,
         .updated_map_loc_inf = mle_balancing_vectors_calculate,
         .updated_map_cache_inf = mce_balancing_vectors_calculate,
         .policy_get_fwd_info = fb_get_fw_entry,
@@ -87,12 +102,28 @@ fb_dev_parm_new_init(oor_ctrl_dev_t *ctrl_dev,
     if(dev_parm == NULL){
         return (NULL);
     }
-    dev_parm->dev_type = ctrl_dev_mode(ctrl_dev);
-    dev_parm->loc_loct = ctrl_rlocs(ctrl_dev_ctrl(ctrl_dev));
+    fb_dev_parm_init(dev_parm, ctrl_dev, dev_parm_inf);
 
     return(dev_parm);
 }
 
+/* Fill in the fields of dev_parm from the device and the configuration
+ * parameters, that may be NULL */
+void
+fb_dev_parm_init(fb_dev_parm *dev_parm, oor_ctrl_dev_t *ctrl_dev,
+        fwd_policy_dev_parm *dev_parm_inf)
+{
+    char *val;
+
+    dev_parm->dev_type = ctrl_dev_mode(ctrl_dev);
+    dev_parm->loc_loct = ctrl_rlocs(ctrl_dev_ctrl(ctrl_dev));
+    if (dev_parm_inf == NULL){
+        return;
+    }
+    val = shash_lookup(dev_parm_inf->paramiters, "flowlets");
+    dev_parm->flowlets = (val != NULL && strcmp(val, "true") == 0);
+}
+
 inline void
 fb_dev_parm_del(void *dev_parm)
 {
@@ -161,6 +192,33 @@ balancing_locators_vecs_del(void * bal_vec)
     free((balancing_locators_vecs *)bal_vec);
 }
 
+size_t
+balancing_locators_vecs_size(void *bal_vec)
+{
+    balancing_locators_vecs *blv = (balancing_locators_vecs *)bal_vec;
+    fb_lookup_table *lts[3];
+    size_t size = sizeof(balancing_locators_vecs);
+    int i;
+
+    lts[0] = blv->v4_balancing_locators_vec;
+    lts[1] = blv->v6_balancing_locators_vec;
+    /* The mixed table may be one of the single family ones */
+    lts[2] = NULL;
+    if (blv->balancing_locators_vec != blv->v4_balancing_locators_vec
+            && blv->balancing_locators_vec != blv->v6_balancing_locators_vec){
+        lts[2] = blv->balancing_locators_vec;
+    }
+    for (i = 0; i < 3; i++){
+        if (lts[i]){
+            size += sizeof(fb_lookup_table) + lts[i]->size
+                    + lts[i]->nlocators * (sizeof(locator_t *)
+                            + sizeof(lisp_addr_t *) + sizeof(lisp_addr_t)
+                            + sizeof(int));
+        }
+    }
+    return (size);
+}
+
 /* Initialize to 0 balancing_locators_vecs */
 static void
 balancing_locators_vecs_reset(balancing_locators_vecs *blv)
@@ -172,21 +230,41 @@ balancing_locators_vecs_reset(balancing_locators_vecs *blv)
                     != blv->v4_balancing_locators_vec
             && blv->balancing_locators_vec
                     != blv->v6_balancing_locators_vec) {
-        free(blv->balancing_locators_vec);
+        fb_lookup_table_del(blv->balancing_locators_vec);
     }
     if (blv->v4_balancing_locators_vec != NULL) {
-        free(blv->v4_balancing_locators_vec);
+        fb_lookup_table_del(blv->v4_balancing_locators_vec);
     }
     if (blv->v6_balancing_locators_vec != NULL) {
-        free(blv->v6_balancing_locators_vec);
+        fb_lookup_table_del(blv->v6_balancing_locators_vec);
     }
 
     blv->v4_balancing_locators_vec = NULL;
-    blv->v4_locators_vec_length = 0;
     blv->v6_balancing_locators_vec = NULL;
-    blv->v6_locators_vec_length = 0;
     blv->balancing_locators_vec = NULL;
-    blv->locators_vec_length = 0;
+}
+
+/* Print the locators of a lookup table and the slots each one has */
+static void
+fb_lookup_table_dump(fb_lookup_table *lt, const char *name, int log_level)
+{
+    int ctr;
+    char str[3000];
+
+    if (lt == NULL){
+        OOR_LOG(log_level, "  %s locators vector (0 locators)", name);
+        return;
+    }
+    sprintf(str, "  %s locators vector (%d slots):  ", name, lt->size);
+    for (ctr = 0; ctr < lt->nlocators; ctr++) {
+        if (strlen(str) > 2850) {
+            sprintf(str + strlen(str), " ...");
+            break;
+        }
+        sprintf(str + strlen(str), " %s (%d)  ",
+                lisp_addr_to_char(lt->locators[ctr]->addr), lt->slots[ctr]);
+    }
+    OOR_LOG(log_level, "%s", str);
 }
 
 /* Print balancing locators vector information */
@@ -194,49 +272,15 @@ void
 balancing_locators_vec_dump(balancing_locators_vecs b_locators_vecs,
         mapping_t *mapping, int log_level)
 {
-    int ctr;
-    char str[3000];
-
     if (is_loggable(log_level)) {
         OOR_LOG(log_level, "Balancing locator vector for %s: ",
                 lisp_addr_to_char(mapping_eid(mapping)));
-
-        sprintf(str, "  IPv4 locators vector (%d locators):  ",
-                b_locators_vecs.v4_locators_vec_length);
-        for (ctr = 0; ctr < b_locators_vecs.v4_locators_vec_length; ctr++) {
-            if (strlen(str) > 2850) {
-                sprintf(str + strlen(str), " ...");
-                break;
-            }
-            sprintf(str + strlen(str), " %s  ",
-                    lisp_addr_to_char(
-                            b_locators_vecs.v4_balancing_locators_vec[ctr]->addr));
-        }
-        OOR_LOG(log_level, "%s", str);
-        sprintf(str, "  IPv6 locators vector (%d locators):  ",
-                b_locators_vecs.v6_locators_vec_length);
-        for (ctr = 0; ctr < b_locators_vecs.v6_locators_vec_length; ctr++) {
-            if (strlen(str) > 2900) {
-                sprintf(str + strlen(str), " ...");
-                break;
-            }
-            sprintf(str + strlen(str), " %s  ",
-                    lisp_addr_to_char(
-                            b_locators_vecs.v6_balancing_locators_vec[ctr]->addr));
-        }
-        OOR_LOG(log_level, "%s", str);
-        sprintf(str, "  IPv4 & IPv6 locators vector (%d locators):  ",
-                b_locators_vecs.locators_vec_length);
-        for (ctr = 0; ctr < b_locators_vecs.locators_vec_length; ctr++) {
-            if (strlen(str) > 2950) {
-                sprintf(str + strlen(str), " ...");
-                break;
-            }
-            sprintf(str + strlen(str), " %s  ",
-                    lisp_addr_to_char(
-                            b_locators_vecs.balancing_locators_vec[ctr]->addr));
-        }
-        OOR_LOG(log_level, "%s", str);
+        fb_lookup_table_dump(b_locators_vecs.v4_balancing_locators_vec,
+                "IPv4", log_level);
+        fb_lookup_table_dump(b_locators_vecs.v6_balancing_locators_vec,
+                "IPv6", log_level);
+        fb_lookup_table_dump(b_locators_vecs.balancing_locators_vec,
+                "IPv4 & IPv6", log_level);
     }
 }
 
@@ -286,51 +330,152 @@ select_best_priority_locators(glist_t *loct_list, locator_t **selected_locators,
     return (min_priority);
 }
 
-static locator_t **
-set_balancing_vector(locator_t **locators, int total_weight, int hcf,
-        int *locators_vec_length)
+static inline uint32_t
+fb_hash_mix(uint32_t h)
 {
-    locator_t **balancing_locators_vec;
-    int vector_length = 0;
-    int used_pos = 0;
-    int ctr = 0;
-    int ctr1 = 0;
-    int pos = 0;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return (h);
+}
 
-    if (total_weight != 0) {
-        /* Length of the dynamic vector */
-        vector_length = total_weight / hcf;
-    } else {
-        /* If all locators have weight equal to 0, we assign one position for
-         * each locator */
-        while (locators[ctr] != NULL) {
-            ctr++;
+/*
+ * Build the Maglev lookup table of the NULL terminated list of locators.
+ * mapping_locts is the number of locators of the mapping that could be part of
+ * the list. Each locator fills the free slots following its own permutation
+ * of the table, taking turns in proportion to its weight. If all the weights
+ * are 0, all the locators have the same share. The weights of remote
+ * locators may be adjusted by the policy built on top of this one.
+ */
+static fb_lookup_table *
+fb_lookup_table_new(fb_dev_parm *dev_parm, locator_t **locators,
+        int mapping_locts, uint8_t is_mce)
+{
+    fb_lookup_table *lt;
+    lisp_addr_t *ip_addr;
+    uint32_t pos[FB_MAX_LOCATORS], skip[FB_MAX_LOCATORS];
+    int weight[FB_MAX_LOCATORS], credit[FB_MAX_LOCATORS];
+    int n = 0, i, filled, max_weight = 0, total_weight = 0;
+    uint32_t h, slot;
+
+    while (locators[n] != NULL && n < FB_MAX_LOCATORS) {
+        total_weight += locator_weight(locators[n]);
+        n++;
+    }
+    if (n == 0){
+        return (NULL);
+    }
+
+    lt = xzalloc(sizeof(fb_lookup_table));
+    lt->nlocators = n;
+    lt->locators = xmalloc(n * sizeof(locator_t *));
+    memcpy(lt->locators, locators, n * sizeof(locator_t *));
+    lt->addrs = xmalloc(n * sizeof(lisp_addr_t *));
+    for (i = 0; i < n; i++){
+        lt->addrs[i] = lisp_addr_clone(locator_addr(locators[i]));
+    }
+    lt->slots = xzalloc(n * sizeof(int));
+
+    /* The single locator of the mapping takes all the flows */
+    if (mapping_locts <= 1){
+        lt->size = 1;
+        lt->table = xzalloc(1);
+        lt->slots[0] = 1;
+        return (lt);
+    }
+
+    for (i = 0; i < sizeof(fb_table_sizes)/sizeof(int) - 1; i++){
+        if (fb_table_sizes[i] >= FB_SLOTS_PER_LOCATOR * mapping_locts){
+            break;
         }
-        vector_length = ctr;
-        ctr = 0;
     }
+    lt->size = fb_table_sizes[i];
+    lt->table = xmalloc(lt->size);
+    memset(lt->table, FB_EMPTY_SLOT, lt->size);
 
-    /* Reserve memory for the dynamic vector */
-    balancing_locators_vec = xmalloc(vector_length * sizeof(locator_t *));
-    *locators_vec_length = vector_length;
+    for (i = 0; i < n; i++){
+        weight[i] = total_weight != 0 ? locator_weight(locators[i]) : 1;
+    }
+    if (is_mce && dev_parm->adjust_weights){
+        dev_parm->adjust_weights(dev_parm, locators, n, weight);
+    }
 
-    while (locators[ctr] != NULL) {
-        if (total_weight != 0) {
-            used_pos = locator_weight(locators[ctr]) / hcf;
-        } else {
-            /* If all locators has weight equal to 0, we assign one position
-             * for each locator. Simetric balancing */
-            used_pos = 1;
+    for (i = 0; i < n; i++){
+        ip_addr = fb_addr_get_fwd_ip_addr(locator_addr(locators[i]),
+                dev_parm->loc_loct);
+        h = ip_addr ? ip_addr_hash(lisp_addr_ip(ip_addr)) : i;
+        pos[i] = fb_hash_mix(h) % lt->size;
+        skip[i] = fb_hash_mix(h ^ 0x9e3779b9) % (lt->size - 1) + 1;
+        credit[i] = 0;
+        if (weight[i] > max_weight){
+            max_weight = weight[i];
         }
-        ctr1 = 0;
-        for (ctr1 = 0; ctr1 < used_pos; ctr1++) {
-            balancing_locators_vec[pos] = locators[ctr];
-            pos++;
+    }
+
+    filled = 0;
+    while (filled < lt->size){
+        for (i = 0; i < n && filled < lt->size; i++){
+            credit[i] += weight[i];
+            if (credit[i] < max_weight){
+                continue;
+            }
+            credit[i] -= max_weight;
+            /* The size is prime: the permutation goes through all the slots */
+            slot = pos[i];
+            while (lt->table[slot] != FB_EMPTY_SLOT){
+                slot = (slot + skip[i]) % lt->size;
+            }
+            lt->table[slot] = i;
+            lt->slots[i]++;
+            pos[i] = (slot + skip[i]) % lt->size;
+            filled++;
         }
-        ctr++;
     }
 
-    return (balancing_locators_vec);
+    return (lt);
+}
+
+static void
+fb_lookup_table_del(fb_lookup_table *lt)
+{
+    int i;
+
+    for (i = 0; i < lt->nlocators; i++){
+        lisp_addr_del(lt->addrs[i]);
+    }
+    free(lt->addrs);
+    free(lt->locators);
+    free(lt->table);
+    free(lt->slots);
+    free(lt);
+}
+
+static inline locator_t *
+fb_lookup_table_locator(fb_lookup_table *lt, uint32_t hash)
+{
+    return (lt->locators[lt->table[hash % lt->size]]);
+}
+
+/* Percentage of the flows that use a different locator in new than in old.
+ * -1 if the tables can't be compared. The locators of old may have been
+ * released: only the copies of their addresses are used */
+static int
+fb_lookup_table_moved(fb_lookup_table *old, fb_lookup_table *new)
+{
+    int i, moved = 0;
+
+    if (!old || !new || old->size != new->size){
+        return (-1);
+    }
+    for (i = 0; i < new->size; i++){
+        if (lisp_addr_cmp(old->addrs[old->table[i]],
+                new->addrs[new->table[i]]) != 0){
+            moved++;
+        }
+    }
+    return (moved * 100 / new->size);
 }
 
 int
@@ -358,10 +503,10 @@ balancing_vectors_calculate(void *dev_parm, balancing_locators_vecs *blv, mappin
     glist_t *ipv4_loct_list  = glist_new();
     glist_t *ipv6_loct_list  = glist_new();
     fb_dev_parm *fw_dev_parm = (fb_dev_parm *)dev_parm;
+    balancing_locators_vecs old_blv = *blv;
+    int moved[2];
 
     int min_priority[2] = { 255, 255 };
-    int total_weight[3] = { 0, 0, 0 };
-    int hcf[3]          = { 0, 0, 0 };
     int ctr             = 0;
     int ctr1            = 0;
     int pos             = 0;
@@ -369,7 +514,8 @@ balancing_vectors_calculate(void *dev_parm, balancing_locators_vecs *blv, mappin
     locators[0][0]      = NULL;
     locators[1][0]      = NULL;
 
-    balancing_locators_vecs_reset(blv);
+    /* The previous tables are kept to report the flows moved */
+    memset(blv, 0, sizeof(balancing_locators_vecs));
 
     fb_locators_classify_in_4_6(map,fw_dev_parm->loc_loct,ipv4_loct_list,ipv6_loct_list);
 
@@ -381,10 +527,8 @@ balancing_vectors_calculate(void *dev_parm, balancing_locators_vecs *blv, mappin
         min_priority[0] = select_best_priority_locators(
                 ipv4_loct_list, locators[0], is_mce);
         if (min_priority[0] != UNUSED_RLOC_PRIORITY) {
-            get_hcf_locators_weight(locators[0], &total_weight[0], &hcf[0]);
-            blv->v4_balancing_locators_vec = set_balancing_vector(
-                    locators[0], total_weight[0], hcf[0],
-                    &(blv->v4_locators_vec_length));
+            blv->v4_balancing_locators_vec = fb_lookup_table_new(fw_dev_parm,
+                    locators[0], glist_size(ipv4_loct_list), is_mce);
         }
     }
 
@@ -395,10 +539,8 @@ balancing_vectors_calculate(void *dev_parm, balancing_locators_vecs *blv, mappin
         min_priority[1] = select_best_priority_locators(
                 ipv6_loct_list, locators[1], is_mce);
         if (min_priority[1] != UNUSED_RLOC_PRIORITY) {
-            get_hcf_locators_weight(locators[1], &total_weight[1], &hcf[1]);
-            blv->v6_balancing_locators_vec = set_balancing_vector(
-                    locators[1], total_weight[1], hcf[1],
-                    &(blv->v6_locators_vec_length));
+            blv->v6_balancing_locators_vec = fb_lookup_table_new(fw_dev_parm,
+                    locators[1], glist_size(ipv6_loct_list), is_mce);
         }
     }
     /* Fill the locator balancing vec using IPv4 and IPv6 locators and according
@@ -407,89 +549,48 @@ balancing_vectors_calculate(void *dev_parm, balancing_locators_vecs *blv, mappin
             && blv->v6_balancing_locators_vec != NULL) {
         //Only IPv4 locators are involved (due to priority reasons)
         if (min_priority[0] < min_priority[1]) {
-            blv->balancing_locators_vec =
-                    blv->v4_balancing_locators_vec;
-            blv->locators_vec_length =
-                    blv->v4_locators_vec_length;
+            blv->balancing_locators_vec = blv->v4_balancing_locators_vec;
         } //Only IPv6 locators are involved (due to priority reasons)
         else if (min_priority[0] > min_priority[1]) {
-            blv->balancing_locators_vec =
-                    blv->v6_balancing_locators_vec;
-            blv->locators_vec_length =
-                    blv->v6_locators_vec_length;
+            blv->balancing_locators_vec = blv->v6_balancing_locators_vec;
         } //IPv4 and IPv6 locators are involved
         else {
-            hcf[2] = highest_common_factor(hcf[0], hcf[1]);
-            total_weight[2] = total_weight[0] + total_weight[1];
             for (ctr = 0; ctr < 2; ctr++) {
                 ctr1 = 0;
-                while (locators[ctr][ctr1] != NULL) {
+                while (locators[ctr][ctr1] != NULL && pos < 32) {
                     locators[2][pos] = locators[ctr][ctr1];
                     ctr1++;
                     pos++;
                 }
             }
             locators[2][pos] = NULL;
-            blv->balancing_locators_vec = set_balancing_vector(
-                    locators[2], total_weight[2], hcf[2],
-                    &(blv->locators_vec_length));
+            blv->balancing_locators_vec = fb_lookup_table_new(fw_dev_parm,
+                    locators[2],
+                    glist_size(ipv4_loct_list) + glist_size(ipv6_loct_list),
+                    is_mce);
         }
     }
 
     balancing_locators_vec_dump(*blv, map, LDBG_1);
 
+    moved[0] = fb_lookup_table_moved(old_blv.v4_balancing_locators_vec,
+            blv->v4_balancing_locators_vec);
+    moved[1] = fb_lookup_table_moved(old_blv.v6_balancing_locators_vec,
+            blv->v6_balancing_locators_vec);
+    if (moved[0] > 0 || moved[1] > 0){
+        OOR_LOG(LDBG_1, "Balancing of %s recalculated: %d%% of IPv4 and %d%% "
+                "of IPv6 flows change of locator",
+                lisp_addr_to_char(mapping_eid(map)),
+                moved[0] > 0 ? moved[0] : 0, moved[1] > 0 ? moved[1] : 0);
+    }
+    balancing_locators_vecs_reset(&old_blv);
+
     glist_destroy(ipv4_loct_list);
     glist_destroy(ipv6_loct_list);
 
     return (GOOD);
 }
 
-static inline void
-get_hcf_locators_weight(locator_t **locators, int *total_weight,
-        int *hcf)
-{
-    int ctr = 0;
-    int weight = 0;
-    int tmp_hcf = 0;
-
-    if (locators[0] != NULL) {
-        tmp_hcf = locator_weight(locators[0]);
-        while (locators[ctr] != NULL) {
-            weight = weight + locator_weight(locators[ctr]);
-            tmp_hcf = highest_common_factor(tmp_hcf, locator_weight(locators[ctr]));
-            ctr++;
-        }
-    }
-    *total_weight = weight;
-    *hcf = tmp_hcf;
-}
-
-static int
-highest_common_factor(int a, int b)
-{
-    int c;
-    if (b == 0) {
-        return a;
-    }
-    if (a == 0) {
-        return b;
-    }
-
-    if (a < b) {
-        c = a;
-        a = b;
-        a = c;
-    }
-    c = 1;
-    while (b != 0) {
-        c = a % b;
-        a = b;
-        b = c;
-    }
-
-    return (a);
-}
-
 void
 fb_locators_classify_in_4_6(mapping_t *mapping, glist_t *loc_loct_addr,
         glist_t *ipv4_loct_list, glist_t *ipv6_loct_list)
@@ -534,10 +635,9 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
     fb_dev_parm * dev_parm = (fb_dev_parm *)fwd_dev_parm;
     balancing_locators_vecs * src_blv = (balancing_locators_vecs *)src_map_parm;
     balancing_locators_vecs * dst_blv = (balancing_locators_vecs *)dst_map_parm;
-    int src_vec_len, dst_vec_len;
-    uint32_t pos, hash;
-    locator_t ** src_loc_vec;
-    locator_t ** dst_loc_vec;
+    uint32_t hash;
+    fb_lookup_table * src_lt;
+    fb_lookup_table * dst_lt;
     locator_t * src_loct;
     locator_t * dst_loct;
 
@@ -545,20 +645,17 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
     lisp_addr_t * dst_addr;
     lisp_addr_t * src_ip_addr;
     lisp_addr_t * dst_ip_addr;
-    int afi;
+    int afi, i;
 
     if (src_blv->balancing_locators_vec != NULL
             && dst_blv->balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->balancing_locators_vec;
-        src_vec_len = src_blv->locators_vec_length;
+        src_lt = src_blv->balancing_locators_vec;
     } else if (src_blv->v6_balancing_locators_vec != NULL
             && dst_blv->v6_balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->v6_balancing_locators_vec;
-        src_vec_len = src_blv->v6_locators_vec_length;
+        src_lt = src_blv->v6_balancing_locators_vec;
     } else if (src_blv->v4_balancing_locators_vec != NULL
             && dst_blv->v4_balancing_locators_vec != NULL) {
-        src_loc_vec = src_blv->v4_balancing_locators_vec;
-        src_vec_len = src_blv->v4_locators_vec_length;
+        src_lt = src_blv->v4_balancing_locators_vec;
     } else {
         if (src_blv->v4_balancing_locators_vec == NULL
                 && src_blv->v6_balancing_locators_vec == NULL) {
@@ -579,11 +676,10 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
     if (hash == 0) {
         OOR_LOG(LDBG_1, "fb_get_fw_entry: Couldn't get the hash of the tuple "
                 "to select the rloc. Using the default rloc");
-        //pos = hash%x_vec_len -> 0%x_vec_len = 0;
+        //slot = hash%size -> 0%size = 0;
     }
 
-    pos = hash % src_vec_len;
-    src_loct = src_loc_vec[pos];
+    src_loct = fb_lookup_table_locator(src_lt, hash);
     src_addr = locator_addr(src_loct);
 
     /* decide dst afi based on src afi*/
@@ -594,12 +690,10 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
 
     switch (afi) {
     case (AF_INET):
-        dst_loc_vec = dst_blv->v4_balancing_locators_vec;
-        dst_vec_len = dst_blv->v4_locators_vec_length;
+        dst_lt = dst_blv->v4_balancing_locators_vec;
         break;
     case (AF_INET6):
-        dst_loc_vec = dst_blv->v6_balancing_locators_vec;
-        dst_vec_len = dst_blv->v6_locators_vec_length;
+        dst_lt = dst_blv->v6_balancing_locators_vec;
         break;
     default:
         OOR_LOG(LDBG_2, "select_locs_from_maps: Unknown IP AFI %d",
@@ -607,8 +701,7 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
         return;
     }
 
-    pos = hash % dst_vec_len;
-    dst_loct = dst_loc_vec[pos];
+    dst_loct = fb_lookup_table_locator(dst_lt, hash);
     dst_addr = locator_addr(dst_loct);
     dst_ip_addr = fb_addr_get_fwd_ip_addr(dst_addr,dev_parm->loc_loct);
 
@@ -616,6 +709,19 @@ fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm, void *dst_map_parm,
     fwd_entry = fwd_entry_new_init(src_ip_addr, dst_ip_addr, tuple->iid, NULL);
     fwd_info->fwd_info = fwd_entry;
 
+    /* The data plane moves the flowlets among the locators with slots in
+     * proportion to their number of slots */
+    if (dev_parm->flowlets && dst_lt->nlocators > 1){
+        for (i = 0; i < dst_lt->nlocators; i++){
+            if (dst_lt->slots[i] == 0){
+                continue;
+            }
+            fwd_entry_add_alt_drloc(fwd_entry, fb_addr_get_fwd_ip_addr(
+                    locator_addr(dst_lt->locators[i]), dev_parm->loc_loct),
+                    dst_lt->slots[i]);
+        }
+    }
+
     OOR_LOG(LDBG_3, "select_locs_from_maps: EID: %s -> %s, protocol: %d, "
             "port: %d -> %d\n  --> RLOC: %s -> %s",
             lisp_addr_to_char(&(tuple->src_addr)),
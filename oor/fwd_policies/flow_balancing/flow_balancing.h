@@ -23,26 +23,71 @@
 #include "../../control/oor_ctrl_device.h"
 
 
-typedef struct fb_dev_parm_ {
+/* Maximum number of locators of the same priority used for balancing */
+#define FB_MAX_LOCATORS         32
+
+typedef struct fb_dev_parm_ fb_dev_parm;
+
+/* Change the weights used to balance the flows among the remote locators of
+ * the same priority. The weights of the n locators are the ones of the
+ * mapping, or 1 if all of them are 0 */
+typedef void (*fb_adjust_weights_fct)(fb_dev_parm *dev_parm,
+        locator_t **locators, int n, int *weights);
+
+struct fb_dev_parm_ {
     oor_dev_type_e     dev_type;
     glist_t *           loc_loct;
-}fb_dev_parm;
+    fb_adjust_weights_fct adjust_weights; /* NULL to use the mapping ones */
+    /* Give the data plane all the destination RLOCs of the same priority,
+     * so it can move the flowlets among them. Device parameter "flowlets" */
+    uint8_t             flowlets;
+};
+
+/*
+ * Maglev lookup table used to distribute the flows among a set of locators
+ * according to their weight. The locator of a flow is
+ * locators[table[hash % size]]. The slots taken by each locator only depend
+ * on its address and weight, so when a locator of the set changes, mainly
+ * the flows that were using it are moved.
+ */
+typedef struct fb_lookup_table_ {
+    locator_t **locators;
+    /* Copies of the addresses of the locators. The locators of a mapping are
+     * released before its tables are recalculated, and the previous table is
+     * compared with the new one by address */
+    lisp_addr_t **addrs;
+    int nlocators;
+    uint8_t *table;
+    int size;
+    int *slots;     /* Slots taken by each locator */
+} fb_lookup_table;
 
 /*
  * Used to select the locator to be used for an identifier according to locators' priority and weight.
  *  v4_balancing_locators_vec: If we just have IPv4 RLOCs
  *  v6_balancing_locators_vec: If we just hace IPv6 RLOCs
  *  balancing_locators_vec: If we have IPv4 & IPv6 RLOCs
- *  For each packet, a hash of its tuppla is calculaed. The result of this hash is one position of the array.
+ *  For each packet, a hash of its tuppla is calculaed. The result of this hash is one slot of the lookup table.
  */
 
 typedef struct balancing_locators_vecs_ {
-    locator_t **v4_balancing_locators_vec;
-    locator_t **v6_balancing_locators_vec;
-    locator_t **balancing_locators_vec;
-    int v4_locators_vec_length;
-    int v6_locators_vec_length;
-    int locators_vec_length;
+    fb_lookup_table *v4_balancing_locators_vec;
+    fb_lookup_table *v6_balancing_locators_vec;
+    fb_lookup_table *balancing_locators_vec;
 } balancing_locators_vecs;
 
+/* Used by the policies that extend flow balancing */
+void fb_dev_parm_init(fb_dev_parm *dev_parm, oor_ctrl_dev_t *ctrl_dev,
+        fwd_policy_dev_parm *dev_parm_inf);
+int mle_balancing_locators_vecs_new_init(void *dev_parm, map_local_entry_t *mle,
+        fwd_policy_map_parm *map_parm,fwd_info_del_fct fwd_del_fct);
+int mce_balancing_locators_vecs_new_init(void *dev_parm, mcache_entry_t *mce,
+        routing_info_del_fct del_fct);
+void balancing_locators_vecs_del(void * bal_vec);
+size_t balancing_locators_vecs_size(void *bal_vec);
+int mle_balancing_vectors_calculate(void *dev_parm, map_local_entry_t *mle);
+int mce_balancing_vectors_calculate(void *dev_parm, mcache_entry_t *mce);
+void fb_get_fw_entry(void *fwd_dev_parm, void *src_map_parm,
+        void *dst_map_parm, packet_tuple_t *tuple, fwd_info_t *fwd_info);
+
 #endif /* FLOW_BALANCING_H_ */
@@ -20,8 +20,9 @@
 #include "fwd_policy.h"
 #include "../lib/oor_log.h"
 
-static fwd_policy_class *fwd_policy_libs[1] = {
+static fwd_policy_class *fwd_policy_libs[2] = {
         &fwd_policy_flow_balancing,
+        &fwd_policy_latency_balancing,
 };
 
 void policy_loct_parm_del(fwd_policy_loct_parm *pol_loct);
@@ -32,6 +33,9 @@ fwd_policy_class_find(char *lib)
 	if (strcmp(lib,"flow_balancing") == 0){
 		return(fwd_policy_libs[0]);
 	}
+	if (strcmp(lib,"latency_balancing") == 0){
+		return(fwd_policy_libs[1]);
+	}
 	OOR_LOG(LERR, "The forward policy library \"%s\" has not been found",lib);
 	return (NULL);
 }
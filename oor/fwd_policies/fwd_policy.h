@@ -22,6 +22,7 @@
 
 #include "../lib/map_cache_entry.h"
 #include "../lib/map_local_entry.h"
+#include "../lib/rtt_stats.h"
 
 typedef struct packet_tuple packet_tuple_t;
 
@@ -61,6 +62,9 @@ typedef struct fwd_info_{
     uint8_t temporal;
     lisp_action_e neg_map_reply_act;
     oor_encap_t encap;
+    /* Locator-Status-Bits of the source mapping, used if lsb_set */
+    uint8_t lsb_set;
+    uint32_t lsb;
 }fwd_info_t;
 
 
@@ -73,8 +77,14 @@ typedef struct fwd_policy_class {
     void (*del_map_loc_policy_inf)(void *);
     int (*init_map_cache_policy_inf)(void *dev_parm, mcache_entry_t *mce, routing_info_del_fct rt_del_fct);
     void (*del_map_cache_policy_inf)(void *);
+    /* Memory used by the routing info of a map cache entry */
+    size_t (*map_cache_policy_inf_size)(void *);
     int (*updated_map_loc_inf)(void *dev_parm, map_local_entry_t *mle);
     int (*updated_map_cache_inf)(void *dev_parm, mcache_entry_t *mce);
+    /* Optional. The RTT and loss measured to the remote RLOC rloc changed. st
+     * is NULL when rloc is not probed anymore. Returns TRUE if the entries
+     * with rloc as locator should be recalculated */
+    int (*updated_rloc_metrics)(void *dev_parm, lisp_addr_t *rloc, rtt_stats_t *st);
     void (*policy_get_fwd_info)(void *dev_parm, void *src_map_parm, void *dst_map_parm,
             packet_tuple_t *tuple, fwd_info_t *fdw_info);
     lisp_addr_t *(*get_fwd_ip_addr)(lisp_addr_t *addr, glist_t *locl_rlocs_addr);
@@ -82,6 +92,7 @@ typedef struct fwd_policy_class {
 
 
 extern fwd_policy_class fwd_policy_flow_balancing;
+extern fwd_policy_class fwd_policy_latency_balancing;
 
 fwd_policy_dev_parm *fwd_policy_dev_parm_new();
 void fwd_policy_dev_parm_del(fwd_policy_dev_parm *pol_dev);
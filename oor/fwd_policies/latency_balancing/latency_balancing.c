@@ -0,0 +1,198 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <math.h>
+
+#include "latency_balancing.h"
+#include "../flow_balancing/fb_addr_func.h"
+#include "../../lib/oor_log.h"
+#include "../../lib/mem_util.h"
+
+
+static void *lb_dev_parm_new_init(oor_ctrl_dev_t *ctrl_dev,
+        fwd_policy_dev_parm *dev_parm_inf);
+static void lb_dev_parm_del(void *dev_parm);
+static double lb_path_cost(lb_dev_parm *dev_parm, lisp_addr_t *rloc);
+static void lb_adjust_weights(fb_dev_parm *dev_parm, locator_t **locators,
+        int n, int *weights);
+static int lb_updated_rloc_metrics(void *dev_parm, lisp_addr_t *rloc,
+        rtt_stats_t *st);
+
+fwd_policy_class  fwd_policy_latency_balancing = {
+        .new_dev_policy_inf = lb_dev_parm_new_init,
+        .del_dev_policy_inf = lb_dev_parm_del,
+        .init_map_loc_policy_inf = mle_balancing_locators_vecs_new_init,
+        .del_map_loc_policy_inf = balancing_locators_vecs_del,
+        .init_map_cache_policy_inf = mce_balancing_locators_vecs_new_init,
+        .del_map_cache_policy_inf = balancing_locators_vecs_del,
+        .map_cache_policy_inf_size = balancing_locators_vecs_size,
+        .updated_map_loc_inf = mle_balancing_vectors_calculate,
+        .updated_map_cache_inf = mce_balancing_vectors_calculate,
+        .updated_rloc_metrics = lb_updated_rloc_metrics,
+        .policy_get_fwd_info = fb_get_fw_entry,
+        .get_fwd_ip_addr = fb_addr_get_fwd_ip_addr
+};
+
+
+static void *
+lb_dev_parm_new_init(oor_ctrl_dev_t *ctrl_dev,
+        fwd_policy_dev_parm *dev_parm_inf)
+{
+    lb_dev_parm *dev_parm;
+
+    dev_parm = xzalloc(sizeof(lb_dev_parm));
+    fb_dev_parm_init(&dev_parm->fb, ctrl_dev, dev_parm_inf);
+    dev_parm->fb.adjust_weights = lb_adjust_weights;
+    dev_parm->paths = kh_init(lb_path);
+
+    return (dev_parm);
+}
+
+static void
+lb_dev_parm_del(void *dev_parm)
+{
+    lb_dev_parm *lb = (lb_dev_parm *)dev_parm;
+    khiter_t k;
+
+    for (k = kh_begin(lb->paths); k != kh_end(lb->paths); ++k){
+        if (kh_exist(lb->paths, k)){
+            free(kh_value(lb->paths, k));
+        }
+    }
+    kh_destroy(lb_path, lb->paths);
+    free(lb);
+}
+
+/* Cost in use of the path to rloc. 0 if it is not known yet */
+static double
+lb_path_cost(lb_dev_parm *dev_parm, lisp_addr_t *rloc)
+{
+    khiter_t k;
+
+    if (!rloc || lisp_addr_lafi(rloc) != LM_AFI_IP){
+        return (0);
+    }
+    k = kh_get(lb_path, dev_parm->paths, lisp_addr_ip(rloc));
+    if (k == kh_end(dev_parm->paths)){
+        return (0);
+    }
+    return (kh_value(dev_parm->paths, k)->cost);
+}
+
+/* Scale the weights by the cost of the best path of the set divided by the
+ * cost of the path of each locator. Paths with unknown cost are taken as
+ * good as the best one */
+static void
+lb_adjust_weights(fb_dev_parm *dev_parm, locator_t **locators, int n,
+        int *weights)
+{
+    lb_dev_parm *lb = (lb_dev_parm *)dev_parm;
+    double cost[FB_MAX_LOCATORS];
+    double best = 0, factor;
+    lisp_addr_t *ip_addr;
+    int i;
+
+    for (i = 0; i < n; i++){
+        ip_addr = fb_addr_get_fwd_ip_addr(locator_addr(locators[i]),
+                dev_parm->loc_loct);
+        cost[i] = lb_path_cost(lb, ip_addr);
+        if (cost[i] > 0 && (best == 0 || cost[i] < best)){
+            best = cost[i];
+        }
+    }
+    if (best == 0){
+        return;
+    }
+
+    for (i = 0; i < n; i++){
+        factor = (cost[i] > 0) ? best / cost[i] : 1;
+        if (factor < LB_MIN_WEIGHT_PCT / 100.0){
+            factor = LB_MIN_WEIGHT_PCT / 100.0;
+        }
+        if (weights[i] > 0){
+            weights[i] = (int)(weights[i] * LB_WEIGHT_SCALE * factor + 0.5);
+        }
+    }
+}
+
+/*
+ * Update the cost of the path to rloc from its RTT and loss. The new cost is
+ * only used if it is LB_COST_HYSTERESIS percent away from the current one
+ * and this one has been used at least LB_HOLD_TIME seconds, so the balancing
+ * doesn't follow every sample.
+ */
+static int
+lb_updated_rloc_metrics(void *dev_parm, lisp_addr_t *rloc, rtt_stats_t *st)
+{
+    lb_dev_parm *lb = (lb_dev_parm *)dev_parm;
+    lb_path_t *path = NULL;
+    double cost;
+    time_t now;
+    khiter_t k;
+    int ret;
+
+    if (lisp_addr_lafi(rloc) != LM_AFI_IP){
+        return (FALSE);
+    }
+    k = kh_get(lb_path, lb->paths, lisp_addr_ip(rloc));
+    if (k != kh_end(lb->paths)){
+        path = kh_value(lb->paths, k);
+    }
+
+    if (st == NULL){
+        if (path){
+            kh_del(lb_path, lb->paths, k);
+            free(path);
+        }
+        return (FALSE);
+    }
+    if (st->samples < LB_MIN_SAMPLES){
+        return (FALSE);
+    }
+
+    cost = st->srtt * (1 + LB_LOSS_PENALTY * st->loss);
+    if (cost < 1){
+        cost = 1;
+    }
+    now = time(NULL);
+    if (!path){
+        path = xzalloc(sizeof(lb_path_t));
+        ip_addr_copy(&path->addr, lisp_addr_ip(rloc));
+        k = kh_put(lb_path, lb->paths, &path->addr, &ret);
+        kh_value(lb->paths, k) = path;
+    }else if (now - path->changed < LB_HOLD_TIME
+            || fabs(cost - path->cost) * 100 < LB_COST_HYSTERESIS * path->cost){
+        return (FALSE);
+    }
+
+    OOR_LOG(LDBG_1, "latency_balancing: Cost of the path to %s: %.1f ms "
+            "(RTT %.1f ms, loss %.3f)", lisp_addr_to_char(rloc), cost,
+            st->srtt, st->loss);
+    path->cost = cost;
+    path->changed = now;
+    return (TRUE);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef LATENCY_BALANCING_H_
+#define LATENCY_BALANCING_H_
+
+#include "../flow_balancing/flow_balancing.h"
+#include "../../elibs/khash/khash.h"
+#include "../../lib/rtt_stats.h"
+
+/*
+ * Flow balancing where the weights of the remote locators of the same
+ * priority are scaled by the quality of the path to them, measured by RLOC
+ * probing. The cost of a path is its smoothed RTT increased by its loss:
+ * LB_LOSS_PENALTY times the loss ratio. The best path of the set keeps its
+ * weight and the others get it divided by their cost relative to the best.
+ */
+
+/* Loss ratio multiplier added to the cost of a path */
+#define LB_LOSS_PENALTY         10
+/* Replies needed before the RTT of a path is used */
+#define LB_MIN_SAMPLES          3
+/* Hysteresis: change of the cost of a path, in percent, needed to use it */
+#define LB_COST_HYSTERESIS      20
+/* Damping: seconds the cost of a path is kept before it can change again */
+#define LB_HOLD_TIME            30
+/* Scale of the weights so those of worse paths keep some resolution */
+#define LB_WEIGHT_SCALE         100
+/* Minimum part of its weight, in percent, kept by the worst paths */
+#define LB_MIN_WEIGHT_PCT       5
+
+typedef struct lb_path_ {
+    ip_addr_t addr;     /* Remote RLOC */
+    double cost;        /* ms */
+    time_t changed;
+} lb_path_t;
+
+KHASH_INIT(lb_path, ip_addr_t *, lb_path_t *, 1, ip_addr_hash, ip_addr_equal)
+
+typedef struct lb_dev_parm_ {
+    fb_dev_parm fb; /* base "class" */
+    khash_t(lb_path) *paths;
+} lb_dev_parm;
+
+#endif /* LATENCY_BALANCING_H_ */
@@ -18,33 +18,259 @@
  */
 
 #include "cksum.h"
+#include "mem_util.h"
 #include "oor_log.h"
 #include "../liblisp/lisp_messages.h"
 
+#include <string.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/ip6.h>
 #include <netinet/ip.h>
 
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define CKSUM_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CKSUM_NEON
+#include <arm_neon.h>
+#endif
 
-uint16_t
-ip_checksum(uint16_t *buffer, int size)
+/*
+ * All the checksums are computed with a 64 bit accumulator to which 32 bit
+ * words are added. Carries are only folded at the end (cksum_fold). Since
+ * 2^16 = 1 mod 2^16-1, the result is the same as adding 16 bit words
+ * (RFC 1071). The accumulation loop has a scalar version and vector versions
+ * selected at runtime according to the CPU.
+ */
+
+typedef uint64_t (*cksum_add_fct)(const void *buf, int len, uint64_t sum);
+
+static uint64_t cksum_add_resolve(const void *buf, int len, uint64_t sum);
+static cksum_add_fct cksum_add_impl = cksum_add_resolve;
+
+
+/* Add two partial sums with end around carry */
+static inline uint64_t
+cksum_add64(uint64_t sum, uint64_t val)
+{
+    sum += val;
+    return (sum + (sum < val));
+}
+
+static uint64_t
+cksum_add_scalar(const void *buf, int len, uint64_t sum)
+{
+    const uint8_t *p = buf;
+    uint64_t acc = 0;
+    uint32_t w[4];
+    uint16_t h = 0;
+
+    while (len >= 16) {
+        memcpy(w, p, 16);
+        acc += (uint64_t)w[0] + w[1] + w[2] + w[3];
+        p += 16;
+        len -= 16;
+    }
+    while (len >= 4) {
+        memcpy(w, p, 4);
+        acc += w[0];
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        memcpy(&h, p, 2);
+        acc += h;
+        p += 2;
+        len -= 2;
+    }
+    /* Add the padding if the length is odd */
+    if (len) {
+        h = 0;
+        memcpy(&h, p, 1);
+        acc += h;
+    }
+
+    return (cksum_add64(sum, acc));
+}
+
+#ifdef CKSUM_AVX2
+__attribute__((target("avx2")))
+static uint64_t
+cksum_add_avx2(const void *buf, int len, uint64_t sum)
 {
-    uint32_t cksum = 0;
+    const uint8_t *p = buf;
+    __m256i acc = _mm256_setzero_si256();
+    __m256i zero = _mm256_setzero_si256();
+    __m256i v;
+    uint64_t lanes[4];
+
+    /* Each 32 bit word is zero extended and added to a 64 bit lane */
+    while (len >= 32) {
+        v = _mm256_loadu_si256((const __m256i *)p);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero));
+        p += 32;
+        len -= 32;
+    }
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    sum = cksum_add64(sum, lanes[0]);
+    sum = cksum_add64(sum, lanes[1]);
+    sum = cksum_add64(sum, lanes[2]);
+    sum = cksum_add64(sum, lanes[3]);
+
+    return (cksum_add_scalar(p, len, sum));
+}
+#endif
 
-    while (size > 1) {
-        cksum += *buffer++;
-        size -= sizeof(uint16_t);
+#ifdef CKSUM_NEON
+static uint64_t
+cksum_add_neon(const void *buf, int len, uint64_t sum)
+{
+    const uint8_t *p = buf;
+    uint64x2_t acc = vdupq_n_u64(0);
+
+    /* Pairs of 32 bit words are added to 64 bit lanes */
+    while (len >= 16) {
+        acc = vpadalq_u32(acc, vreinterpretq_u32_u8(vld1q_u8(p)));
+        p += 16;
+        len -= 16;
     }
+    sum = cksum_add64(sum, vgetq_lane_u64(acc, 0));
+    sum = cksum_add64(sum, vgetq_lane_u64(acc, 1));
+
+    return (cksum_add_scalar(p, len, sum));
+}
+#endif
 
-    if (size) {
-        cksum += *(uint8_t *) buffer;
+/* Select the best implementation the first time a checksum is computed */
+static uint64_t
+cksum_add_resolve(const void *buf, int len, uint64_t sum)
+{
+    cksum_add_impl = cksum_add_scalar;
+#ifdef CKSUM_NEON
+    cksum_add_impl = cksum_add_neon;
+#endif
+#ifdef CKSUM_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        cksum_add_impl = cksum_add_avx2;
     }
+#endif
+    return (cksum_add_impl(buf, len, sum));
+}
+
+uint64_t
+cksum_partial(const void *buf, int len, uint64_t sum)
+{
+    /* Vectors don't pay off for headers */
+    if (len < 64) {
+        return (cksum_add_scalar(buf, len, sum));
+    }
+    return (cksum_add_impl(buf, len, sum));
+}
+
+uint16_t
+cksum_fold(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ((uint16_t) sum);
+}
+
+/*
+ * Copy len bytes from src to dst and add them to the partial sum in the same
+ * pass, so the data is only brought once to the cache.
+ */
+uint64_t
+cksum_copy_partial(void *dst, const void *src, int len, uint64_t sum)
+{
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+    uint64_t acc = 0;
+    uint32_t w[4];
+
+    while (len >= 16) {
+        memcpy(w, s, 16);
+        memcpy(d, w, 16);
+        acc += (uint64_t)w[0] + w[1] + w[2] + w[3];
+        s += 16;
+        d += 16;
+        len -= 16;
+    }
+    memcpy(d, s, len);
+
+    return (cksum_add_scalar(s, len, cksum_add64(sum, acc)));
+}
+
+/*
+ * Incremental update of a checksum when the 16 bit word old is replaced by
+ * new (RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m')). All the values are in
+ * network byte order
+ */
+uint16_t
+cksum_update16(uint16_t cksum, uint16_t old, uint16_t new)
+{
+    uint32_t sum;
+
+    sum = (uint16_t)~cksum + (uint16_t)~old + new;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ((uint16_t) ~sum);
+}
+
+uint16_t
+cksum_update32(uint16_t cksum, uint32_t old, uint32_t new)
+{
+    cksum = cksum_update16(cksum, old >> 16, new >> 16);
+    return (cksum_update16(cksum, old & 0xFFFF, new & 0xFFFF));
+}
+
+/* Incremental update when a field of len bytes (even) is rewritten, i.e. an
+ * IPv6 address of the pseudo header */
+uint16_t
+cksum_update_buf(uint16_t cksum, const void *old, const void *new, int len)
+{
+    uint64_t sum;
+
+    sum = (uint16_t)~cksum;
+    sum += (uint16_t)~cksum_fold(cksum_partial(old, len, 0));
+    sum = cksum_partial(new, len, sum);
+    return ((uint16_t) ~cksum_fold(sum));
+}
+
+uint16_t
+ip_checksum(uint16_t *buffer, int size)
+{
+    return ((uint16_t) ~cksum_fold(cksum_partial(buffer, size, 0)));
+}
 
-    cksum = (cksum >> 16) + (cksum & 0xffff);
-    cksum += (cksum >> 16);
+/* Sum of the IPv4 UDP pseudo header */
+static inline uint64_t
+udp_ipv4_pseudo_sum(in_addr_t src, in_addr_t dst, unsigned int len)
+{
+    uint64_t sum;
 
-    return ((uint16_t) (~cksum));
+    sum = (uint64_t)src + dst;
+    sum += htons(IPPROTO_UDP);
+    sum += htons(len);
+    return (sum);
+}
+
+/* Sum of the IPv6 UDP pseudo header */
+static inline uint64_t
+udp_ipv6_pseudo_sum(const struct ip6_hdr *ip6, unsigned int len)
+{
+    uint64_t sum;
+
+    sum = cksum_partial(&ip6->ip6_src, sizeof(struct in6_addr), 0);
+    sum = cksum_partial(&ip6->ip6_dst, sizeof(struct in6_addr), sum);
+    sum += htonl(len);
+    sum += htonl(IPPROTO_UDP);
+    return (sum);
 }
 
 /*
@@ -66,88 +292,23 @@ uint16_t
 udp_ipv4_checksum(const void *b, unsigned int len,
         in_addr_t src, in_addr_t dst)
 {
+    uint64_t sum;
 
-    const uint16_t *buf = b;
-    uint16_t *ip_src = (void *) &src;
-    uint16_t *ip_dst = (void *) &dst;
-    uint32_t length = len;
-    uint32_t sum = 0;
-
-    while (len > 1) {
-        sum += *buf++;
-        if (sum & 0x80000000)
-            sum = (sum & 0xFFFF) + (sum >> 16);
-        len -= 2;
-    }
-
-    /* Add the padding if the packet length is odd */
-
-    if (len & 1)
-        sum += *((uint8_t *) buf);
-
-    /* Add the pseudo-header */
-
-    sum += *(ip_src++);
-    sum += *ip_src;
-
-    sum += *(ip_dst++);
-    sum += *ip_dst;
-
-    sum += htons(IPPROTO_UDP);
-    sum += htons(length);
-
-    /* Add the carries */
-
-    while (sum >> 16)
-        sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = cksum_partial(b, len, udp_ipv4_pseudo_sum(src, dst, len));
 
     /* Return the one's complement of sum */
-
-    return ((uint16_t) (~sum));
+    return ((uint16_t) ~cksum_fold(sum));
 }
 
 uint16_t
 udp_ipv6_checksum(const struct ip6_hdr *ip6, const struct udphdr *up,
         unsigned int len)
 {
-    size_t i;
-    register const u_int16_t *sp;
-    uint32_t sum;
-    union {
-        struct {
-            struct in6_addr ph_src;
-            struct in6_addr ph_dst;
-            u_int32_t ph_len;
-            u_int8_t ph_zero[3];
-            u_int8_t ph_nxt;
-        } ph;
-        u_int16_t pa[20];
-    } phu;
-
-    /* pseudo-header */
-    memset(&phu, 0, sizeof(phu));
-    phu.ph.ph_src = ip6->ip6_src;
-    phu.ph.ph_dst = ip6->ip6_dst;
-    phu.ph.ph_len = htonl(len);
-    phu.ph.ph_nxt = IPPROTO_UDP;
-
-    sum = 0;
-    for (i = 0; i < sizeof(phu.pa) / sizeof(phu.pa[0]); i++)
-        sum += phu.pa[i];
-
-    sp = (const u_int16_t *) up;
-
-    for (i = 0; i < (len & ~1); i += 2)
-        sum += *sp++;
-
-    if (len & 1)
-        sum += htons((*(const u_int8_t *) sp) << 8);
-
-    while (sum > 0xffff)
-        sum = (sum & 0xffff) + (sum >> 16);
-    sum = ~sum & 0xffff;
+    uint64_t sum;
 
-    return (sum);
+    sum = cksum_partial(up, len, udp_ipv6_pseudo_sum(ip6, len));
+
+    return ((uint16_t) ~cksum_fold(sum));
 }
 
 /*
@@ -170,3 +331,69 @@ udp_checksum(struct udphdr *udph, int udp_len, void *iphdr, int afi)
     }
 }
 
+/*
+ *  udp_checksum_sg
+ *
+ *  Calculate the IPv4 or IPv6 UDP checksum of a datagram whose payload is
+ *  not contiguous to its headers. hdr_len is the length of the UDP header
+ *  plus any header following it in the same buffer and must be even */
+uint16_t
+udp_checksum_sg(struct udphdr *udph, int hdr_len, const void *payload,
+        int payload_len, void *iphdr, int afi)
+{
+    struct ip *iph;
+    uint64_t sum;
+
+    switch (afi) {
+    case AF_INET:
+        iph = iphdr;
+        sum = udp_ipv4_pseudo_sum(iph->ip_src.s_addr, iph->ip_dst.s_addr,
+                hdr_len + payload_len);
+        break;
+    case AF_INET6:
+        sum = udp_ipv6_pseudo_sum(iphdr, hdr_len + payload_len);
+        break;
+    default:
+        OOR_LOG(LDBG_2, "udp_checksum_sg: Unknown AFI");
+        return (~0);
+    }
+
+    sum = cksum_partial(udph, hdr_len, sum);
+    sum = cksum_partial(payload, payload_len, sum);
+
+    return ((uint16_t) ~cksum_fold(sum));
+}
+
+/*
+ *  udp_copy_and_checksum
+ *
+ *  Copy the payload after the UDP header and calculate the IPv4 or IPv6 UDP
+ *  checksum of the resulting datagram in the same pass */
+uint16_t
+udp_copy_and_checksum(struct udphdr *udph, const void *payload,
+        int payload_len, void *iphdr, int afi)
+{
+    struct ip *iph;
+    uint64_t sum;
+    int udp_len = sizeof(struct udphdr) + payload_len;
+
+    switch (afi) {
+    case AF_INET:
+        iph = iphdr;
+        sum = udp_ipv4_pseudo_sum(iph->ip_src.s_addr, iph->ip_dst.s_addr,
+                udp_len);
+        break;
+    case AF_INET6:
+        sum = udp_ipv6_pseudo_sum(iphdr, udp_len);
+        break;
+    default:
+        OOR_LOG(LDBG_2, "udp_copy_and_checksum: Unknown AFI");
+        return (~0);
+    }
+
+    sum = cksum_partial(udph, sizeof(struct udphdr), sum);
+    sum = cksum_copy_partial(CO(udph, sizeof(struct udphdr)), payload,
+            payload_len, sum);
+
+    return ((uint16_t) ~cksum_fold(sum));
+}
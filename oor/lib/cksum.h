@@ -24,10 +24,31 @@
 #include <netinet/udp.h>
 #include "../defs.h"
 
+/* Partial sums: add len bytes of buf to sum. Consecutive calls must start at
+ * even offsets of the checksummed data */
+uint64_t cksum_partial(const void *buf, int len, uint64_t sum);
+/* Fold a partial sum to 16 bits. The checksum is its one's complement */
+uint16_t cksum_fold(uint64_t sum);
+/* Copy and add to the partial sum in a single pass */
+uint64_t cksum_copy_partial(void *dst, const void *src, int len, uint64_t sum);
+
+/* Incremental updates (RFC 1624) of a checksum when a field is rewritten.
+ * Fields and checksum in network byte order */
+uint16_t cksum_update16(uint16_t cksum, uint16_t old, uint16_t new);
+uint16_t cksum_update32(uint16_t cksum, uint32_t old, uint32_t new);
+uint16_t cksum_update_buf(uint16_t cksum, const void *old, const void *new,
+        int len);
+
 uint16_t ip_checksum(uint16_t *buffer, int size);
 
 /* Calculate the IPv4 or IPv6 UDP checksum */
 uint16_t udp_checksum(struct udphdr *udph, int udp_len, void *iphdr, int afi);
+/* Calculate the UDP checksum when the payload is in a different buffer */
+uint16_t udp_checksum_sg(struct udphdr *udph, int hdr_len, const void *payload,
+        int payload_len, void *iphdr, int afi);
+/* Copy the payload after the UDP header while calculating the checksum */
+uint16_t udp_copy_and_checksum(struct udphdr *udph, const void *payload,
+        int payload_len, void *iphdr, int afi);
 
 
 #endif /* CKSUM_H_ */
@@ -0,0 +1,262 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+
+#include "echo_nonce.h"
+#include "mem_util.h"
+#include "oor_log.h"
+
+/* Maximum number of RLOCs in the table. When it is reached, the RLOCs
+ * without traffic for IDLE_TIMEOUT seconds are removed */
+#define MAX_SIZE 10000
+#define IDLE_TIMEOUT 300
+
+
+static void echo_nonce_expire(echo_nonce_table_t *tbl, echo_nonce_t *en,
+        time_t now);
+
+
+echo_nonce_table_t *
+echo_nonce_table_new(int window, int interval)
+{
+    echo_nonce_table_t *tbl;
+
+    tbl = xzalloc(sizeof(echo_nonce_table_t));
+    tbl->htable = kh_init(echo_nonce);
+    tbl->window = window;
+    tbl->interval = interval;
+    return (tbl);
+}
+
+void
+echo_nonce_table_del(echo_nonce_table_t *tbl)
+{
+    khiter_t k;
+
+    if (!tbl){
+        return;
+    }
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (kh_exist(tbl->htable, k)){
+            free(kh_value(tbl->htable, k));
+        }
+    }
+    kh_destroy(echo_nonce, tbl->htable);
+    free(tbl);
+}
+
+static void
+echo_nonce_table_purge(echo_nonce_table_t *tbl, time_t now)
+{
+    echo_nonce_t *en;
+    khiter_t k;
+
+    OOR_LOG(LDBG_1, "echo_nonce_lookup: Max size of echo-nonce table "
+            "reached. Removing idle RLOCs");
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (!kh_exist(tbl->htable, k)){
+            continue;
+        }
+        en = kh_value(tbl->htable, k);
+        if (now - MAX(en->last_rx, en->last_tx) > IDLE_TIMEOUT){
+            kh_del(echo_nonce, tbl->htable, k);
+            free(en);
+        }
+    }
+}
+
+/* Get the state of rloc. With create, it is added if it doesn't exist. NULL
+ * if it doesn't exist or there is no room for it */
+echo_nonce_t *
+echo_nonce_lookup(echo_nonce_table_t *tbl, ip_addr_t *rloc, uint8_t create)
+{
+    echo_nonce_t *en;
+    khiter_t k;
+    int ret;
+
+    k = kh_get(echo_nonce, tbl->htable, rloc);
+    if (k != kh_end(tbl->htable)){
+        return (kh_value(tbl->htable, k));
+    }
+    if (!create){
+        return (NULL);
+    }
+    if (kh_size(tbl->htable) >= MAX_SIZE){
+        echo_nonce_table_purge(tbl, time(NULL));
+        if (kh_size(tbl->htable) >= MAX_SIZE){
+            return (NULL);
+        }
+    }
+
+    en = xzalloc(sizeof(echo_nonce_t));
+    ip_addr_copy(&en->rloc, rloc);
+    k = kh_put(echo_nonce, tbl->htable, &en->rloc, &ret);
+    kh_value(tbl->htable, k) = en;
+    return (en);
+}
+
+/* The request of a nonce ended without echo. The RLOC is unreachable if we
+ * kept receiving its packets meanwhile: its ETR doesn't get ours. An RLOC
+ * that has never echoed a nonce may just not support echo-nonce, so it is
+ * left to RLOC probing */
+static void
+echo_nonce_expire(echo_nonce_table_t *tbl, echo_nonce_t *en, time_t now)
+{
+    if (en->req_nonce == 0 || now - en->req_time <= tbl->window){
+        return;
+    }
+    if (en->echoed && en->last_rx > en->req_time){
+        if (en->state != ECHO_NONCE_DOWN){
+            OOR_LOG(LDBG_1, "Echo-nonce: RLOC %s didn't echo the nonce "
+                    "%06x", ip_addr_to_char(&en->rloc), en->req_nonce);
+        }
+        en->state = ECHO_NONCE_DOWN;
+        tbl->stats.failed++;
+    }else{
+        en->state = ECHO_NONCE_UNKNOWN;
+    }
+    en->req_nonce = 0;
+    en->next_req = now + tbl->interval;
+}
+
+/* Set the nonce of a packet sent to the RLOC of en. A nonce asked by the
+ * RLOC is echoed first. Otherwise we ask for one every interval seconds,
+ * in all the packets until it is echoed or the window ends */
+void
+echo_nonce_output(echo_nonce_table_t *tbl, echo_nonce_t *en,
+        lisp_data_hdr_t *hdr, time_t now)
+{
+    en->last_tx = now;
+    if (en->echo_nonce != 0){
+        if (now - en->echo_time <= tbl->window){
+            lisp_data_hdr_set_nonce(hdr, en->echo_nonce, FALSE);
+            return;
+        }
+        en->echo_nonce = 0;
+    }
+
+    echo_nonce_expire(tbl, en, now);
+    if (en->req_nonce == 0){
+        if (now < en->next_req){
+            return;
+        }
+        do {
+            en->req_nonce = random() & 0xffffff;
+        } while (en->req_nonce == 0);
+        en->req_time = now;
+        tbl->stats.requested++;
+    }
+    lisp_data_hdr_set_nonce(hdr, en->req_nonce, TRUE);
+}
+
+/* Process the nonce of a packet received from rloc */
+void
+echo_nonce_input(echo_nonce_table_t *tbl, ip_addr_t *rloc,
+        lisp_data_hdr_t *hdr, time_t now)
+{
+    echo_nonce_t *en;
+    uint32_t nonce;
+
+    /* Only RLOCs asking for an echo are added: the others are added when
+     * we send them traffic */
+    en = echo_nonce_lookup(tbl, rloc, LDHDR_N_BIT(hdr) && LDHDR_E_BIT(hdr));
+    if (!en){
+        return;
+    }
+    en->last_rx = now;
+    if (!LDHDR_N_BIT(hdr)){
+        return;
+    }
+
+    nonce = lisp_data_hdr_get_nonce(hdr);
+    if (LDHDR_E_BIT(hdr)){
+        if (en->echo_nonce != nonce){
+            tbl->stats.echoed++;
+        }
+        en->echo_nonce = nonce;
+        en->echo_time = now;
+    }else if (en->req_nonce != 0 && nonce == en->req_nonce){
+        if (en->state != ECHO_NONCE_UP){
+            OOR_LOG(LDBG_1, "Echo-nonce: RLOC %s echoed the nonce %06x",
+                    ip_addr_to_char(&en->rloc), nonce);
+        }
+        en->state = ECHO_NONCE_UP;
+        en->echoed = TRUE;
+        en->last_echo = now;
+        en->req_nonce = 0;
+        en->next_req = now + tbl->interval;
+        tbl->stats.confirmed++;
+    }
+}
+
+/* Reachability of rloc: UP if it has echoed a nonce since 'since', DOWN if
+ * it echoed nonces before but failed to echo the last one while sending us
+ * traffic */
+echo_nonce_state_e
+echo_nonce_rloc_state(echo_nonce_table_t *tbl, ip_addr_t *rloc, time_t since)
+{
+    echo_nonce_t *en;
+
+    en = echo_nonce_lookup(tbl, rloc, FALSE);
+    if (!en){
+        return (ECHO_NONCE_UNKNOWN);
+    }
+    echo_nonce_expire(tbl, en, time(NULL));
+    if (en->state == ECHO_NONCE_UP && en->last_echo < since){
+        return (ECHO_NONCE_UNKNOWN);
+    }
+    return (en->state);
+}
+
+/* Forget what is known about rloc, for instance when another mechanism
+ * finds out it is reachable again */
+void
+echo_nonce_rloc_reset(echo_nonce_table_t *tbl, ip_addr_t *rloc)
+{
+    echo_nonce_t *en;
+
+    en = echo_nonce_lookup(tbl, rloc, FALSE);
+    if (en){
+        en->state = ECHO_NONCE_UNKNOWN;
+    }
+}
+
+void
+echo_nonce_stats_dump(echo_nonce_table_t *tbl, int log_level)
+{
+    if (is_loggable(log_level) == FALSE) {
+        return;
+    }
+
+    OOR_LOG(log_level, "Echo-nonce: %u RLOCs, %"PRIu64" nonces requested, %"
+            PRIu64" echoed to other RLOCs, %"PRIu64" confirmed, %"PRIu64
+            " failed", kh_size(tbl->htable), tbl->stats.requested,
+            tbl->stats.echoed, tbl->stats.confirmed, tbl->stats.failed);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
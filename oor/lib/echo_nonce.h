@@ -0,0 +1,96 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef ECHO_NONCE_H_
+#define ECHO_NONCE_H_
+
+#include <time.h>
+#include "../elibs/khash/khash.h"
+#include "../liblisp/lisp_ip.h"
+#include "../liblisp/lisp_data.h"
+
+/*
+ * Echo-nonce algorithm of RFC 6830, section 6.3.1. The data path asks each
+ * remote RLOC to echo a nonce (N and E bits) and echoes the nonces that the
+ * remote RLOCs ask for. An RLOC that echoes our nonce is reachable. One that
+ * has echoed nonces before and keeps sending packets to us without echoing
+ * the last one within the window is not. RLOCs that never echo may not
+ * implement the algorithm: nothing is known about them, as without traffic
+ * in both directions, and RLOC probing has to be used.
+ */
+
+typedef enum {
+    ECHO_NONCE_UNKNOWN,
+    ECHO_NONCE_UP,
+    ECHO_NONCE_DOWN
+} echo_nonce_state_e;
+
+typedef struct echo_nonce_ {
+    ip_addr_t rloc;
+    /* Nonce we asked the RLOC to echo, 0 if none */
+    uint32_t req_nonce;
+    time_t req_time;
+    time_t next_req;
+    /* Nonce the RLOC asked us to echo, 0 if none */
+    uint32_t echo_nonce;
+    time_t echo_time;
+    /* Last packets received from and sent to the RLOC */
+    time_t last_rx;
+    time_t last_tx;
+    /* Last time the RLOC echoed one of our nonces */
+    time_t last_echo;
+    /* The RLOC has echoed at least one of our nonces */
+    uint8_t echoed;
+    uint8_t state;
+} echo_nonce_t;
+
+typedef struct echo_nonce_stats_ {
+    uint64_t requested;
+    uint64_t echoed;
+    uint64_t confirmed;
+    uint64_t failed;
+} echo_nonce_stats_t;
+
+KHASH_INIT(echo_nonce, ip_addr_t *, echo_nonce_t *, 1, ip_addr_hash,
+        ip_addr_equal)
+
+typedef struct echo_nonce_table_ {
+    khash_t(echo_nonce) *htable;
+    /* Seconds to wait for the echo of a nonce */
+    int window;
+    /* Seconds between requests to the same RLOC */
+    int interval;
+    echo_nonce_stats_t stats;
+} echo_nonce_table_t;
+
+echo_nonce_table_t *echo_nonce_table_new(int window, int interval);
+void echo_nonce_table_del(echo_nonce_table_t *tbl);
+echo_nonce_t *echo_nonce_lookup(echo_nonce_table_t *tbl, ip_addr_t *rloc,
+        uint8_t create);
+void echo_nonce_output(echo_nonce_table_t *tbl, echo_nonce_t *en,
+        lisp_data_hdr_t *hdr, time_t now);
+void echo_nonce_input(echo_nonce_table_t *tbl, ip_addr_t *rloc,
+        lisp_data_hdr_t *hdr, time_t now);
+echo_nonce_state_e echo_nonce_rloc_state(echo_nonce_table_t *tbl,
+        ip_addr_t *rloc, time_t since);
+void echo_nonce_rloc_reset(echo_nonce_table_t *tbl, ip_addr_t *rloc);
+void echo_nonce_stats_dump(echo_nonce_table_t *tbl, int log_level);
+
+#endif /* ECHO_NONCE_H_ */
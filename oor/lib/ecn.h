@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ECN_H_
+#define ECN_H_
+
+#include <stdint.h>
+
+/*
+ * Explicit Congestion Notification in tunnels (RFC 6040). The encapsulation
+ * uses the normal mode: the ECN field of the outer header is a copy of the
+ * inner one. On decapsulation, the ECN field of the inner header is combined
+ * with the one of the outer header so that congestion experienced in the
+ * underlay is not lost.
+ */
+
+#define ECN_MASK        0x03
+#define ECN_NOT_ECT     0x00
+#define ECN_ECT1        0x01
+#define ECN_ECT0        0x02
+#define ECN_CE          0x03
+
+typedef struct ecn_stats_ {
+    /* CE marks of the outer header copied to the inner header */
+    uint64_t ce_propagated;
+    /* Packets dropped: CE outer header with a Not-ECT inner header */
+    uint64_t invalid_dropped;
+    /* Combinations that a normal mode encapsulation doesn't generate */
+    uint64_t unexpected;
+} ecn_stats_t;
+
+/*
+ * Decapsulation (RFC 6040 section 4.2). Returns the ECN field of the
+ * decapsulated packet or -1 if it should be dropped
+ *
+ *                       Arriving outer header
+ *   Arriving inner   Not-ECT   ECT(0)    ECT(1)    CE
+ *   Not-ECT          Not-ECT   Not-ECT*  Not-ECT*  drop
+ *   ECT(0)           ECT(0)    ECT(0)    ECT(1)    CE
+ *   ECT(1)           ECT(1)    ECT(1)    ECT(1)    CE
+ *   CE               CE        CE*       CE*       CE
+ *
+ *   * Unexpected combination
+ */
+static inline int
+ecn_decap(uint8_t inner, uint8_t outer, ecn_stats_t *stats)
+{
+    inner &= ECN_MASK;
+    outer &= ECN_MASK;
+
+    if (inner == outer || outer == ECN_NOT_ECT){
+        return (inner);
+    }
+    switch (inner){
+    case ECN_NOT_ECT:
+        if (outer == ECN_CE){
+            stats->invalid_dropped++;
+            return (-1);
+        }
+        stats->unexpected++;
+        return (ECN_NOT_ECT);
+    case ECN_CE:
+        stats->unexpected++;
+        return (ECN_CE);
+    default:
+        /* ECT(0) or ECT(1) */
+        if (outer == ECN_CE){
+            stats->ce_propagated++;
+            return (ECN_CE);
+        }
+        /* ECT(1) may carry a congestion signal: it prevails */
+        return (ECN_ECT1);
+    }
+}
+
+#endif /* ECN_H_ */
@@ -0,0 +1,187 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <math.h>
+#include <inttypes.h>
+
+#include "flowlet.h"
+#include "mem_util.h"
+#include "oor_log.h"
+
+/* Maximum number of RLOCs whose load is tracked. The load of the RLOCs
+ * beyond it is taken as 0 */
+#define MAX_SIZE 10000
+
+
+flowlet_table_t *
+flowlet_table_new(double gap)
+{
+    flowlet_table_t *tbl;
+
+    tbl = xzalloc(sizeof(flowlet_table_t));
+    tbl->htable = kh_init(rloc_load);
+    tbl->gap = gap;
+    return (tbl);
+}
+
+void
+flowlet_table_del(flowlet_table_t *tbl)
+{
+    khiter_t k;
+
+    if (!tbl){
+        return;
+    }
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (kh_exist(tbl->htable, k)){
+            free(kh_value(tbl->htable, k));
+        }
+    }
+    kh_destroy(rloc_load, tbl->htable);
+    free(tbl);
+}
+
+/* Account the bytes of a packet encapsulated to rloc */
+void
+flowlet_account(flowlet_table_t *tbl, ip_addr_t *rloc, int bytes)
+{
+    rloc_load_t *entry;
+    khiter_t k;
+    int ret;
+
+    k = kh_get(rloc_load, tbl->htable, rloc);
+    if (k != kh_end(tbl->htable)){
+        kh_value(tbl->htable, k)->bytes += bytes;
+        return;
+    }
+    if (kh_size(tbl->htable) >= MAX_SIZE){
+        return;
+    }
+    entry = xzalloc(sizeof(rloc_load_t));
+    ip_addr_copy(&entry->rloc, rloc);
+    entry->bytes = bytes;
+    clock_gettime(CLOCK_MONOTONIC, &entry->load_ts);
+    k = kh_put(rloc_load, tbl->htable, &entry->rloc, &ret);
+    kh_value(tbl->htable, k) = entry;
+}
+
+/* Current load of rloc. The bytes accounted since the last update are
+ * added to the decayed load */
+static double
+flowlet_rloc_load(flowlet_table_t *tbl, lisp_addr_t *rloc,
+        struct timespec *now)
+{
+    rloc_load_t *entry;
+    khiter_t k;
+    double dt;
+
+    k = kh_get(rloc_load, tbl->htable, lisp_addr_ip(rloc));
+    if (k == kh_end(tbl->htable)){
+        return (0);
+    }
+    entry = kh_value(tbl->htable, k);
+    dt = (now->tv_sec - entry->load_ts.tv_sec)
+            + 1.0e-9 * (now->tv_nsec - entry->load_ts.tv_nsec);
+    entry->load = entry->load * exp(-dt / FLOWLET_LOAD_TAU)
+            + (entry->bytes - entry->load_bytes);
+    entry->load_bytes = entry->bytes;
+    entry->load_ts = *now;
+    return (entry->load);
+}
+
+/*
+ * Select the destination RLOC of the flowlet that starts with the forwarding
+ * entry fe. prev_drloc is the RLOC of the flowlet if it is still active and
+ * fe was obtained again, or NULL for a new flowlet. An active flowlet keeps
+ * its RLOC while it is one of the RLOCs of fe. Otherwise the least loaded
+ * one is selected. The one chosen by the forwarding policy is kept if it is
+ * as good as any other.
+ */
+void
+flowlet_select(flowlet_table_t *tbl, fwd_entry_t *fe, lisp_addr_t *prev_drloc)
+{
+    struct timespec now;
+    double cost, best_cost = 0;
+    int i, best = -1;
+
+    if (fe->n_alt_drlocs < 2){
+        return;
+    }
+    if (prev_drloc){
+        for (i = 0; i < fe->n_alt_drlocs; i++){
+            if (lisp_addr_cmp(fe->alt_drlocs[i], prev_drloc) == 0){
+                lisp_addr_copy(fe->drloc, prev_drloc);
+                tbl->stats.kept++;
+                return;
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (i = 0; i < fe->n_alt_drlocs; i++){
+        cost = flowlet_rloc_load(tbl, fe->alt_drlocs[i], &now)
+                / fe->alt_weights[i];
+        if (best == -1 || cost < best_cost || (cost == best_cost
+                && lisp_addr_cmp(fe->alt_drlocs[i], fe->drloc) == 0)){
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    tbl->stats.flowlets++;
+    if (lisp_addr_cmp(fe->alt_drlocs[best], fe->drloc) != 0){
+        OOR_LOG(LDBG_3, "flowlet_select: Flowlet moved from %s to %s",
+                lisp_addr_to_char(fe->drloc),
+                lisp_addr_to_char(fe->alt_drlocs[best]));
+        lisp_addr_copy(fe->drloc, fe->alt_drlocs[best]);
+        tbl->stats.moved++;
+    }
+}
+
+void
+flowlet_stats_dump(flowlet_table_t *tbl, int log_level)
+{
+    khiter_t k;
+    rloc_load_t *entry;
+
+    if (is_loggable(log_level) == FALSE) {
+        return;
+    }
+
+    OOR_LOG(log_level, "Flowlets: %"PRIu64" balanced, %"PRIu64" moved from "
+            "the RLOC of the forwarding policy, %"PRIu64" kept their RLOC "
+            "when the forwarding info was renewed", tbl->stats.flowlets,
+            tbl->stats.moved, tbl->stats.kept);
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (!kh_exist(tbl->htable, k)){
+            continue;
+        }
+        entry = kh_value(tbl->htable, k);
+        OOR_LOG(log_level, "  %s: %"PRIu64" bytes",
+                ip_addr_to_char(&entry->rloc), entry->bytes);
+    }
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,73 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef FLOWLET_H_
+#define FLOWLET_H_
+
+#include <time.h>
+#include "../elibs/khash/khash.h"
+#include "../liblisp/lisp_ip.h"
+#include "sockets.h"
+
+/*
+ * Flowlet load balancing. A flowlet is a burst of packets of a flow separated
+ * from the previous one by more than gap seconds. Since the previous packets
+ * of the flow had time to arrive, the flowlet can use a different destination
+ * RLOC without reordering. Each new flowlet takes, among the RLOCs of the
+ * same priority of the mapping, the one with the lowest load relative to its
+ * weight. The load of an RLOC is the number of bytes encapsulated to it in
+ * the last FLOWLET_LOAD_TAU seconds, with exponential decay.
+ */
+
+#define FLOWLET_LOAD_TAU    0.5
+
+typedef struct rloc_load_ {
+    ip_addr_t rloc;
+    /* Bytes encapsulated to the RLOC */
+    uint64_t bytes;
+    /* Value of bytes and time when load was last updated */
+    uint64_t load_bytes;
+    struct timespec load_ts;
+    double load;
+} rloc_load_t;
+
+typedef struct flowlet_stats_ {
+    uint64_t flowlets;
+    uint64_t moved;
+    uint64_t kept;
+} flowlet_stats_t;
+
+KHASH_INIT(rloc_load, ip_addr_t *, rloc_load_t *, 1, ip_addr_hash,
+        ip_addr_equal)
+
+typedef struct flowlet_table_ {
+    khash_t(rloc_load) *htable;
+    /* Idle seconds that end a flowlet */
+    double gap;
+    flowlet_stats_t stats;
+} flowlet_table_t;
+
+flowlet_table_t *flowlet_table_new(double gap);
+void flowlet_table_del(flowlet_table_t *tbl);
+void flowlet_account(flowlet_table_t *tbl, ip_addr_t *rloc, int bytes);
+void flowlet_select(flowlet_table_t *tbl, fwd_entry_t *fe,
+        lisp_addr_t *prev_drloc);
+void flowlet_stats_dump(flowlet_table_t *tbl, int log_level);
+
+#endif /* FLOWLET_H_ */
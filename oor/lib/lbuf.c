@@ -207,7 +207,7 @@ lbuf_t *
 lbuf_clone(lbuf_t *b)
 {
     lbuf_t *new_buf = lbuf_new(b->size);
-    lbuf_put(new_buf->data, b->data, b->size);
+    lbuf_put(new_buf, b->data, b->size);
     new_buf->lisp = b->lisp;
     return new_buf;
 }
@@ -74,9 +74,64 @@ mcache_entry_del(mcache_entry_t *entry)
         entry->routing_inf_del(entry->routing_info);
     }
 
+    glist_destroy(entry->pending_pkts);
+    glist_destroy(entry->probed_rlocs);
+
     free(entry);
 }
 
+/* Approximate memory used by the entry and its mapping. The routing info is
+ * accounted by the forwarding policy and the packets waiting for the
+ * Map-Reply by the miss queue */
+uint32_t
+mcache_entry_mem_size(mcache_entry_t *mce)
+{
+    uint32_t size;
+
+    size = sizeof(mcache_entry_t) + sizeof(mapping_t) + sizeof(lisp_addr_t);
+    if (mce->mapping != NULL){
+        size += mapping_locator_count(mce->mapping)
+                * (sizeof(locator_t) + sizeof(lisp_addr_t) + sizeof(glist_entry_t));
+    }
+    return (size);
+}
+
+void
+mce_pending_pkt_del(mce_pending_pkt_t *pkt)
+{
+    lbuf_del(pkt->b);
+    free(pkt);
+}
+
+/* Queue a copy of b until the Map-Reply of the entry is received. Limits
+ * are checked by the caller */
+void
+mcache_entry_add_pending_pkt(mcache_entry_t *mce, lbuf_t *b, uint32_t iid)
+{
+    mce_pending_pkt_t *pkt;
+
+    if (mce->pending_pkts == NULL){
+        mce->pending_pkts = glist_new_managed((glist_del_fct)mce_pending_pkt_del);
+    }
+    pkt = xzalloc(sizeof(mce_pending_pkt_t));
+    pkt->b = lbuf_clone(b);
+    pkt->iid = iid;
+    glist_add_tail(pkt, mce->pending_pkts);
+    mce->pending_bytes += lbuf_size(b);
+}
+
+/* Return the list of pending packets of the entry, that is no longer the
+ * owner of them. NULL if there are no pending packets */
+glist_t *
+mcache_entry_detach_pending_pkts(mcache_entry_t *mce)
+{
+    glist_t *pending = mce->pending_pkts;
+
+    mce->pending_pkts = NULL;
+    mce->pending_bytes = 0;
+    return (pending);
+}
+
 void
 map_cache_entry_dump (mcache_entry_t *entry, int log_level)
 {
@@ -21,6 +21,9 @@
 #define MAP_CACHE_ENTRY_H_
 
 #include "timers.h"
+#include "lbuf.h"
+#include "generic_list.h"
+#include "../elibs/ovs/list.h"
 #include "../liblisp/lisp_mapping.h"
 
 /*
@@ -41,6 +44,12 @@ typedef enum mce_type {
 
 typedef void (*routing_info_del_fct)(void *);
 
+/* Packet waiting for the Map-Reply of a NOT_ACTIVE map cache entry */
+typedef struct mce_pending_pkt_ {
+    lbuf_t *b;
+    uint32_t iid;
+} mce_pending_pkt_t;
+
 typedef struct map_cache_entry_ {
     uint8_t how_learned;
 
@@ -59,6 +68,28 @@ typedef struct map_cache_entry_ {
 
     /* EID that requested the mapping. Helps with timers */
     lisp_addr_t *requester;
+
+    /* Packets received while the Map-Request is outstanding */
+    glist_t *pending_pkts; /* <mce_pending_pkt_t *> */
+    uint32_t pending_bytes;
+
+    /* Eviction of dynamic entries when the map cache is full */
+    struct ovs_list lru_elt;
+    time_t last_used;
+    time_t expires;     /* 0 while NOT_ACTIVE */
+    /* Next time the expiration of the entry is checked and its position
+     * in the expiry heap of the map cache (+1, 0 if not scheduled) */
+    time_t exp_due;
+    uint32_t exp_idx;
+    /* Waiting for the Map-Reply that confirms the mapping: restored from a
+     * snapshot or being refreshed */
+    uint8_t stale;
+    /* Learned from a received data packet and not confirmed yet */
+    uint8_t gleaned;
+    /* Probes of the RLOCs of its locators */
+    glist_t *probed_rlocs;
+    uint32_t hits;
+    uint32_t mem_size;
 } mcache_entry_t;
 
 mcache_entry_t *mcache_entry_new();
@@ -67,6 +98,10 @@ void mcache_entry_init_static(mcache_entry_t *, mapping_t *);
 
 
 void mcache_entry_del(mcache_entry_t *entry);
+void mcache_entry_add_pending_pkt(mcache_entry_t *mce, lbuf_t *b, uint32_t iid);
+glist_t *mcache_entry_detach_pending_pkts(mcache_entry_t *mce);
+void mce_pending_pkt_del(mce_pending_pkt_t *pkt);
+uint32_t mcache_entry_mem_size(mcache_entry_t *mce);
 void map_cache_entry_dump(mcache_entry_t *entry, int log_level);
 
 static inline mapping_t *mcache_entry_mapping(mcache_entry_t*);
@@ -74,6 +109,7 @@ static inline void mcache_entry_set_mapping(mcache_entry_t* , mapping_t *);
 static inline uint8_t mcache_entry_active(mcache_entry_t *);
 static inline void mcache_entry_set_active(mcache_entry_t *, int);
 static inline uint8_t mcache_has_locators(mcache_entry_t *m);
+static inline int mcache_entry_pending_pkts_count(mcache_entry_t *mce);
 static inline void *mcache_entry_routing_info(mcache_entry_t *);
 static inline void mcache_entry_set_routing_info(mcache_entry_t *, void *,
         routing_info_del_fct);
@@ -114,6 +150,11 @@ mcache_has_locators(mcache_entry_t *m)
     }
 }
 
+static inline int
+mcache_entry_pending_pkts_count(mcache_entry_t *mce)
+{
+    return (mce->pending_pkts ? glist_size(mce->pending_pkts) : 0);
+}
 
 static inline void *
 mcache_entry_routing_info(mcache_entry_t *m)
@@ -0,0 +1,133 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "mpsc_ring.h"
+#include "mem_util.h"
+#include "../defs.h"
+
+
+mpsc_ring_t *
+mpsc_ring_new(uint32_t size)
+{
+    mpsc_ring_t *r;
+    uint32_t i, sz = 1;
+
+    while (sz < size){
+        sz <<= 1;
+    }
+
+    r = xzalloc(sizeof(mpsc_ring_t));
+    r->size = sz;
+    r->mask = sz - 1;
+    r->slots = xzalloc(sz * sizeof(mpsc_ring_slot_t));
+    for (i = 0; i < sz; i++){
+        r->slots[i].seq = i;
+    }
+    return (r);
+}
+
+/* Free the ring. del_fct, if not NULL, is applied to the elements still
+ * in the ring. Producers must be stopped */
+void
+mpsc_ring_del(mpsc_ring_t *r, void (*del_fct)(void *))
+{
+    void *data;
+
+    if (!r){
+        return;
+    }
+    while ((data = mpsc_ring_dequeue(r)) != NULL){
+        if (del_fct){
+            del_fct(data);
+        }
+    }
+    free(r->slots);
+    free(r);
+}
+
+/* Add data to the ring. Safe to be called concurrently by several threads.
+ * Returns BAD if the ring is full */
+int
+mpsc_ring_enqueue(mpsc_ring_t *r, void *data)
+{
+    mpsc_ring_slot_t *slot;
+    uint32_t pos, seq;
+    int32_t diff;
+
+    pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    for (;;){
+        slot = &r->slots[pos & r->mask];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (int32_t)(seq - pos);
+        if (diff == 0){
+            /* Slot free: try to reserve it. On failure pos is updated */
+            if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, TRUE,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                break;
+            }
+        }else if (diff < 0){
+            /* Slot not consumed yet since the last lap */
+            return (BAD);
+        }else{
+            pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->data = data;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return (GOOD);
+}
+
+/* Get the oldest element of the ring or NULL if it is empty. Only one
+ * thread may consume */
+void *
+mpsc_ring_dequeue(mpsc_ring_t *r)
+{
+    mpsc_ring_slot_t *slot;
+    uint32_t pos, seq;
+    void *data;
+
+    pos = r->tail;
+    slot = &r->slots[pos & r->mask];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if ((int32_t)(seq - (pos + 1)) < 0){
+        return (NULL);
+    }
+
+    data = slot->data;
+    r->tail = pos + 1;
+    /* Free the slot for the producers of the next lap */
+    __atomic_store_n(&slot->seq, pos + r->size, __ATOMIC_RELEASE);
+    return (data);
+}
+
+/* Number of elements in the ring. Only exact when called by the consumer
+ * with no producer running */
+uint32_t
+mpsc_ring_count(mpsc_ring_t *r)
+{
+    return (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
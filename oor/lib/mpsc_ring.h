@@ -0,0 +1,55 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef MPSC_RING_H_
+#define MPSC_RING_H_
+
+#include <stdint.h>
+
+/*
+ * Bounded lock-free ring with several producers and a single consumer.
+ * Each slot has a sequence number that tells producers when the slot is
+ * free and the consumer when it has been written, so producers only
+ * compete for the head index and never for the same slot.
+ * Capacity is rounded up to a power of 2.
+ */
+
+#define MPSC_RING_CACHE_LINE    64
+
+typedef struct mpsc_ring_slot_ {
+    uint32_t seq;
+    void *data;
+} mpsc_ring_slot_t;
+
+typedef struct mpsc_ring_ {
+    uint32_t size;
+    uint32_t mask;
+    mpsc_ring_slot_t *slots;
+    /* Producers and consumer update their index on different cache lines */
+    uint32_t head __attribute__((aligned(MPSC_RING_CACHE_LINE)));
+    uint32_t tail __attribute__((aligned(MPSC_RING_CACHE_LINE)));
+} mpsc_ring_t;
+
+mpsc_ring_t *mpsc_ring_new(uint32_t size);
+void mpsc_ring_del(mpsc_ring_t *r, void (*del_fct)(void *));
+int mpsc_ring_enqueue(mpsc_ring_t *r, void *data);
+void *mpsc_ring_dequeue(mpsc_ring_t *r);
+uint32_t mpsc_ring_count(mpsc_ring_t *r);
+
+#endif /* MPSC_RING_H_ */
@@ -23,6 +23,8 @@
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/ip6.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
 
@@ -40,6 +42,12 @@
 
 uint16_t ip_id = 0;
 
+pkt_buf_conf_t pkt_buf_conf = {
+        .mtu = DEFAULT_EID_MTU,
+        .size = MAX_IP_PKT_LEN,
+        .headroom = 0
+};
+
 /* Returns IP ID for the packet */
 static inline uint16_t
 get_IP_ID()
@@ -87,13 +95,16 @@ pkt_pull_udp(lbuf_t *b)
     return(udph);
 }
 
-void *
-pkt_push_udp(lbuf_t *b, uint16_t sp, uint16_t dp)
+/* The pkt_push_*_len functions push a header in front of the data of b.
+ * ext_len is the length of the payload that follows the data of b in a
+ * different buffer (scatter-gather) */
+static void *
+pkt_push_udp_len(lbuf_t *b, uint16_t sp, uint16_t dp, int ext_len)
 {
     struct udphdr *uh;
     int udp_len;
 
-    udp_len = sizeof(struct udphdr) + lbuf_size(b);
+    udp_len = sizeof(struct udphdr) + lbuf_size(b) + ext_len;
     uh = lbuf_push_uninit(b, sizeof(struct udphdr));
 
     udpsport(uh) = htons(sp);
@@ -104,8 +115,15 @@ pkt_push_udp(lbuf_t *b, uint16_t sp, uint16_t dp)
     return(uh);
 }
 
-struct ip *
-pkt_push_ipv4(lbuf_t *b, struct in_addr *src, struct in_addr *dst, int proto)
+void *
+pkt_push_udp(lbuf_t *b, uint16_t sp, uint16_t dp)
+{
+    return (pkt_push_udp_len(b, sp, dp, 0));
+}
+
+static struct ip *
+pkt_push_ipv4_len(lbuf_t *b, struct in_addr *src, struct in_addr *dst,
+        int proto, int ext_len)
 {
     struct ip *iph;
     iph = lbuf_push_uninit(b, sizeof(struct ip));
@@ -114,7 +132,7 @@ pkt_push_ipv4(lbuf_t *b, struct in_addr *src, struct in_addr *dst, int proto)
     iph->ip_hl = 5;
     iph->ip_v = IPVERSION;
     iph->ip_tos = 0;
-    iph->ip_len = htons(lbuf_size(b));
+    iph->ip_len = htons(lbuf_size(b) + ext_len);
     iph->ip_id = htons(get_IP_ID());
     /* Do not fragment flag. See 5.4.1 in LISP RFC (6830)
      * TODO: decide if we allow fragments in case of control */
@@ -124,18 +142,38 @@ pkt_push_ipv4(lbuf_t *b, struct in_addr *src, struct in_addr *dst, int proto)
     iph->ip_src.s_addr = src->s_addr;
     iph->ip_dst.s_addr = dst->s_addr;
     /* FIXME: ip checksum could be offloaded to NIC*/
-    /* iph->ip_sum = 0; */
+    iph->ip_sum = 0;
     iph->ip_sum = ip_checksum((uint16_t *) iph, sizeof(struct ip));
     return(iph);
 }
 
-struct ip6_hdr *
-pkt_push_ipv6(lbuf_t *b, struct in6_addr *src, struct in6_addr *dst, int proto)
+struct ip *
+pkt_push_ipv4(lbuf_t *b, struct in_addr *src, struct in_addr *dst, int proto)
+{
+    return (pkt_push_ipv4_len(b, src, dst, proto, 0));
+}
+
+/* Set the IP ID and the flags of an existing IPv4 header as pkt_push_ipv4
+ * does. The checksum is updated */
+void
+pkt_ipv4_set_id_and_df(struct ip *iph)
+{
+    uint16_t old_id = iph->ip_id, old_off = iph->ip_off;
+
+    iph->ip_id = htons(get_IP_ID());
+    iph->ip_off = htons(IP_DF);
+    iph->ip_sum = cksum_update16(iph->ip_sum, old_id, iph->ip_id);
+    iph->ip_sum = cksum_update16(iph->ip_sum, old_off, iph->ip_off);
+}
+
+static struct ip6_hdr *
+pkt_push_ipv6_len(lbuf_t *b, struct in6_addr *src, struct in6_addr *dst,
+        int proto, int ext_len)
 {
     struct ip6_hdr *ip6h;
     int len;
 
-    len = lbuf_size(b);
+    len = lbuf_size(b) + ext_len;
     ip6h = lbuf_push_uninit(b, sizeof(struct ip6_hdr));
 
     ip6h->ip6_hops = 255;
@@ -147,8 +185,15 @@ pkt_push_ipv6(lbuf_t *b, struct in6_addr *src, struct in6_addr *dst, int proto)
     return(ip6h);
 }
 
-void *
-pkt_push_ip(lbuf_t *b, ip_addr_t *src, ip_addr_t *dst, int proto)
+struct ip6_hdr *
+pkt_push_ipv6(lbuf_t *b, struct in6_addr *src, struct in6_addr *dst, int proto)
+{
+    return (pkt_push_ipv6_len(b, src, dst, proto, 0));
+}
+
+static void *
+pkt_push_ip_len(lbuf_t *b, ip_addr_t *src, ip_addr_t *dst, int proto,
+        int ext_len)
 {
     void *iph = NULL;
     if (ip_addr_afi(src) != ip_addr_afi(dst)) {
@@ -159,18 +204,24 @@ pkt_push_ip(lbuf_t *b, ip_addr_t *src, ip_addr_t *dst, int proto)
 
     switch (ip_addr_afi(src)) {
     case AF_INET:
-        iph = pkt_push_ipv4(b, ip_addr_get_addr(src), ip_addr_get_addr(dst),
-                proto);
+        iph = pkt_push_ipv4_len(b, ip_addr_get_addr(src), ip_addr_get_addr(dst),
+                proto, ext_len);
         break;
     case AF_INET6:
-        iph = pkt_push_ipv6(b, ip_addr_get_addr(src), ip_addr_get_addr(dst),
-                proto);
+        iph = pkt_push_ipv6_len(b, ip_addr_get_addr(src), ip_addr_get_addr(dst),
+                proto, ext_len);
         break;
     }
 
     return(iph);
 }
 
+void *
+pkt_push_ip(lbuf_t *b, ip_addr_t *src, ip_addr_t *dst, int proto)
+{
+    return (pkt_push_ip_len(b, src, dst, proto, 0));
+}
+
 int
 pkt_push_udp_and_ip(lbuf_t *b, uint16_t sp, uint16_t dp, ip_addr_t *sip,
         ip_addr_t *dip)
@@ -202,6 +253,137 @@ pkt_push_udp_and_ip(lbuf_t *b, uint16_t sp, uint16_t dp, ip_addr_t *sip,
     return(GOOD);
 }
 
+/* Same as pkt_push_udp_and_ip but the UDP payload is split in two buffers:
+ * the headers already pushed in hdr and the payload. Outer UDP and IP headers
+ * are pushed in hdr and the payload is not modified */
+int
+pkt_push_udp_and_ip_sg(lbuf_t *hdr, lbuf_t *payload, uint16_t sp, uint16_t dp,
+        ip_addr_t *sip, ip_addr_t *dip)
+{
+    uint16_t udpsum;
+    struct udphdr *uh;
+    int udp_hdr_len;
+
+    if (pkt_push_udp_len(hdr, sp, dp, lbuf_size(payload)) == NULL) {
+        OOR_LOG(LDBG_1, "Failed to push UDP header! Discarding");
+        return(BAD);
+    }
+
+    lbuf_reset_udp(hdr);
+    udp_hdr_len = lbuf_size(hdr);
+
+    if (pkt_push_ip_len(hdr, sip, dip, IPPROTO_UDP, lbuf_size(payload)) == NULL) {
+        OOR_LOG(LDBG_1, "Failed to push IP header! Discarding");
+        return(BAD);
+    }
+
+    lbuf_reset_ip(hdr);
+
+    uh = lbuf_udp(hdr);
+    udpsum = udp_checksum_sg(uh, udp_hdr_len, lbuf_data(payload),
+            lbuf_size(payload), lbuf_ip(hdr), ip_addr_afi(sip));
+    if (udpsum == (uint16_t) ~ 0) {
+        OOR_LOG(LDBG_1, "Failed UDP checksum! Discarding");
+        return (BAD);
+    }
+    udpsum(uh) = udpsum;
+    return(GOOD);
+}
+
+/* ICMP errors are never sent in response to other ICMP errors (RFC 1122
+ * section 3.2.2, RFC 4443 section 2.4) */
+static inline int
+pkt_is_icmp_error(void *pkt, int len)
+{
+    struct ip *iph = pkt;
+    struct ip6_hdr *ip6h = pkt;
+    struct icmp *icmph;
+    struct icmp6_hdr *icmp6h;
+
+    if (iph->ip_v == IPVERSION){
+        if (iph->ip_p != IPPROTO_ICMP){
+            return (FALSE);
+        }
+        icmph = (struct icmp *)((uint8_t *)pkt + (iph->ip_hl << 2));
+        return ((uint8_t *)icmph + 1 > (uint8_t *)pkt + len
+                || !ICMP_INFOTYPE(icmph->icmp_type));
+    }
+    if (ip6h->ip6_nxt != IPPROTO_ICMPV6){
+        return (FALSE);
+    }
+    icmp6h = (struct icmp6_hdr *)(ip6h + 1);
+    return ((uint8_t *)icmp6h + 1 > (uint8_t *)pkt + len
+            || !(icmp6h->icmp6_type & ICMP6_INFOMSG_MASK));
+}
+
+/*
+ * Build in b the ICMP error for the source of the IP packet pkt, that doesn't
+ * fit in a link of the given MTU: Fragmentation Needed for IPv4 and Packet Too
+ * Big for IPv6. The error is sent on behalf of the destination of pkt. b
+ * should be empty and have room for PKT_ICMP_TOO_BIG_MAX bytes.
+ */
+int
+pkt_build_icmp_too_big(lbuf_t *b, void *pkt, int len, int mtu)
+{
+    struct ip *iph = pkt;
+    struct ip6_hdr *ip6h = pkt, *oip6h;
+    struct icmp *icmph;
+    struct icmp6_hdr *icmp6h;
+    ip_addr_t src, dst;
+    uint64_t sum;
+    int qlen;
+
+    if (pkt_is_icmp_error(pkt, len)){
+        return (BAD);
+    }
+
+    lbuf_reserve(b, sizeof(struct ip6_hdr));
+    switch (iph->ip_v){
+    case IPVERSION:
+        /* The error can't be longer than 576 bytes */
+        qlen = MIN(len, 576 - sizeof(struct ip) - ICMP_MINLEN);
+        icmph = lbuf_put_uninit(b, ICMP_MINLEN);
+        memset(icmph, 0, ICMP_MINLEN);
+        icmph->icmp_type = ICMP_UNREACH;
+        icmph->icmp_code = ICMP_UNREACH_NEEDFRAG;
+        icmph->icmp_nextmtu = htons(mtu);
+        lbuf_put(b, pkt, qlen);
+        icmph->icmp_cksum = ip_checksum((uint16_t *)icmph, ICMP_MINLEN + qlen);
+        ip_addr_init(&src, &iph->ip_dst, AF_INET);
+        ip_addr_init(&dst, &iph->ip_src, AF_INET);
+        if (pkt_push_ip(b, &src, &dst, IPPROTO_ICMP) == NULL){
+            return (BAD);
+        }
+        break;
+    case IP6VERSION:
+        /* Quote as much as possible without exceeding the minimum MTU */
+        qlen = MIN(len, 1280 - sizeof(struct ip6_hdr)
+                - sizeof(struct icmp6_hdr));
+        icmp6h = lbuf_put_uninit(b, sizeof(struct icmp6_hdr));
+        memset(icmp6h, 0, sizeof(struct icmp6_hdr));
+        icmp6h->icmp6_type = ICMP6_PACKET_TOO_BIG;
+        icmp6h->icmp6_mtu = htonl(mtu);
+        lbuf_put(b, pkt, qlen);
+        ip_addr_init(&src, &ip6h->ip6_dst, AF_INET6);
+        ip_addr_init(&dst, &ip6h->ip6_src, AF_INET6);
+        oip6h = pkt_push_ip(b, &src, &dst, IPPROTO_ICMPV6);
+        if (oip6h == NULL){
+            return (BAD);
+        }
+        /* Checksum with the pseudo header */
+        sum = cksum_partial(&oip6h->ip6_src, sizeof(struct in6_addr), 0);
+        sum = cksum_partial(&oip6h->ip6_dst, sizeof(struct in6_addr), sum);
+        sum += htonl(sizeof(struct icmp6_hdr) + qlen);
+        sum += htonl(IPPROTO_ICMPV6);
+        sum = cksum_partial(icmp6h, sizeof(struct icmp6_hdr) + qlen, sum);
+        icmp6h->icmp6_cksum = (uint16_t) ~cksum_fold(sum);
+        break;
+    default:
+        return (BAD);
+    }
+    return (GOOD);
+}
+
 /* Fill the tuple with the 5 tuples of a packet:
  * (SRC IP, DST IP, PROTOCOL, SRC PORT, DST PORT) */
 int
@@ -262,7 +444,7 @@ pkt_tuple_hash(packet_tuple_t *tuple)
     int hash = 0;
     int len = 0;
     int port = tuple->src_port;
-    uint32_t *tuples = NULL;
+    uint32_t tuples[11];
 
     port = port + ((int)tuple->dst_port << 16);
     switch (lisp_addr_ip_afi(&tuple->src_addr)){
@@ -273,7 +455,6 @@ pkt_tuple_hash(packet_tuple_t *tuple)
          * + 1 integer protocol
          * + 1 iid*/
         len = 5;
-        tuples = xmalloc(len * sizeof(uint32_t));
         lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
         lisp_addr_copy_to(&tuples[1], &tuple->dst_addr);
         tuples[2] = port;
@@ -287,7 +468,6 @@ pkt_tuple_hash(packet_tuple_t *tuple)
          * + 1 integer protocol
          * + 1 iid */
         len = 11;
-        tuples = xmalloc(len * sizeof(uint32_t));
         lisp_addr_copy_to(&tuples[0], &tuple->src_addr);
         lisp_addr_copy_to(&tuples[4], &tuple->dst_addr);
         tuples[8] = port;
@@ -298,7 +478,6 @@ pkt_tuple_hash(packet_tuple_t *tuple)
 
     /* XXX: why 2013 used as initial value? */
     hash = hashword(tuples, len, 2013);
-    free(tuples);
     return (hash);
 }
 
@@ -322,6 +501,7 @@ pkt_tuple_clone(packet_tuple_t *tpl)
     lisp_addr_copy(&cpy->src_addr, &tpl->src_addr);
     lisp_addr_copy(&cpy->dst_addr, &tpl->dst_addr);
     cpy->iid = tpl->iid;
+    cpy->hash = tpl->hash;
     return(cpy);
 }
 
@@ -376,8 +556,13 @@ int
 ip_hdr_set_ttl_and_tos(struct iphdr *iph, int ttl, int tos)
 {
     struct ip6_hdr *ip6h;
+    uint16_t *words, tos_word, ttl_word;
 
     if (iph->version == 4) {
+        words = (uint16_t *) iph;
+        tos_word = words[0];
+        ttl_word = words[4];
+
         /*XXX It seems that there is a bug in uClibc that causes ttl=0 in
          * OpenWRT. This is a quick workaround */
         if (ttl != 0) {
@@ -386,13 +571,10 @@ ip_hdr_set_ttl_and_tos(struct iphdr *iph, int ttl, int tos)
 
         iph->tos = tos;
 
-        /* We need to recompute the checksum since we have changed the TTL
-         * and TOS header fields.
-         *
-         * New checksum must be computed with the checksum header field
-         * with 0s */
-        iph->check = 0;
-        iph->check = ip_checksum((uint16_t*) iph, sizeof(struct iphdr));
+        /* Only the 16 bit words containing the TTL and the TOS have changed:
+         * update the checksum incrementally (RFC 1624) */
+        iph->check = cksum_update16(iph->check, tos_word, words[0]);
+        iph->check = cksum_update16(iph->check, ttl_word, words[4]);
 
     } else if (iph->version == 6) {
         ip6h = (struct ip6_hdr *) iph;
@@ -560,15 +742,10 @@ build_ip_udp_pcket(uint8_t *orig_pkt, int orig_pkt_len,lisp_addr_t *addr_from,
     udpsum(udph_ptr) = 0;
 
 
-    /* Copy original packet after the headers */
-    memcpy(CO(udph_ptr, udp_hdr_len), orig_pkt, orig_pkt_len);
-
-    /*
-     * Now compute the headers checksums
-     */
-
-    if ((udpsum = udp_checksum(udph_ptr, udp_hdr_and_payload_len, iph_ptr,
-            lisp_addr_ip_afi(addr_from))) == (uint16_t) ~ 0) {
+    /* Copy original packet after the headers computing the UDP checksum
+     * at the same time */
+    if ((udpsum = udp_copy_and_checksum(udph_ptr, orig_pkt, orig_pkt_len,
+            iph_ptr, lisp_addr_ip_afi(addr_from))) == (uint16_t) ~ 0) {
         free(encap_pkt);
         return (NULL);
     }
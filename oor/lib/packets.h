@@ -38,6 +38,48 @@
 #define MAX_IP_PKT_LEN          4096
 #define MAX_IP_HDR_LEN          40  /* without options or IPv6 hdr extensions */
 #define UDP_HDR_LEN             8
+/* Room for the outer headers of a data packet: IPv6 + UDP + LISP or
+ * VXLAN-GPE */
+#define MAX_DATA_ENCAP_LEN      64
+
+/*
+ * From section 5.4.1 of LISP RFC (6830)
+ *
+
+ 1 .  Define H to be the size, in* octets, of the outer header an ITR
+ prepends to a packet.  This includes the UDP and LISP header
+ lengths.
+
+ 2.  Define L to be the size, in octets, of the maximum-sized packet
+ an ITR can send to an ETR without the need for the ITR or any
+ intermediate routers to fragment the packet.
+
+ 3.  Define an architectural constant S for the maximum size of a
+ packet, in octets, an ITR must receive so the effective MTU can
+ be met.  That is, S = L - H.
+
+ [...]
+
+ This specification RECOMMENDS that L be defined as 1500.
+
+ */
+
+/* H = 40 (IPv6 header) + 8 (UDP header) + 8 (LISP header) + 4 (extra/safety) = 60 */
+
+#define DEFAULT_EID_MTU         1440 /* 1500 - 60 = 1440 */
+
+/* Sizes of the buffers that receive the data packets. Set from the
+ * configuration before the data plane is initialized */
+typedef struct pkt_buf_conf_ {
+    /* MTU of the interface of the EIDs: largest packet to encapsulate */
+    int mtu;
+    /* Largest packet that can be received, inner or encapsulated */
+    int size;
+    /* Room reserved in front of each received packet */
+    int headroom;
+} pkt_buf_conf_t;
+
+extern pkt_buf_conf_t pkt_buf_conf;
 
 #ifdef BSD
 #define udpsport(x) x->uh_sport
@@ -69,6 +111,9 @@ typedef struct packet_tuple {
     uint16_t                        dst_port;
     uint8_t                         protocol;
     uint32_t                        iid;
+    /* Cached result of pkt_tuple_hash. Only valid once set by the user of
+     * the tuple (ttable) */
+    uint32_t                        hash;
 } packet_tuple_t;
 
 
@@ -95,12 +140,18 @@ void *pkt_pull_ip(lbuf_t *);
 struct udphdr *pkt_pull_udp(lbuf_t *);
 
 struct ip *pkt_push_ipv4(lbuf_t *, struct in_addr *, struct in_addr *, int);
+void pkt_ipv4_set_id_and_df(struct ip *iph);
 struct ip6_hdr *pkt_push_ipv6(lbuf_t *, struct in6_addr *, struct in6_addr *,
         int);
 void *pkt_push_udp(lbuf_t *, uint16_t , uint16_t);
 void *pkt_push_ip(lbuf_t *, ip_addr_t *, ip_addr_t *, int proto);
 int pkt_push_udp_and_ip(lbuf_t *, uint16_t, uint16_t, ip_addr_t *,
         ip_addr_t *);
+int pkt_push_udp_and_ip_sg(lbuf_t *hdr, lbuf_t *payload, uint16_t sp,
+        uint16_t dp, ip_addr_t *sip, ip_addr_t *dip);
+/* Size of the largest ICMP error built by pkt_build_icmp_too_big */
+#define PKT_ICMP_TOO_BIG_MAX    1280
+int pkt_build_icmp_too_big(lbuf_t *b, void *pkt, int len, int mtu);
 int ip_hdr_set_ttl_and_tos(struct iphdr *, int ttl, int tos);
 int ip_hdr_ttl_and_tos(struct iphdr *, int *ttl, int *tos);
 
@@ -0,0 +1,304 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#include "pmtu.h"
+#include "mem_util.h"
+#include "oor_log.h"
+#include "../liblisp/liblisp.h"
+#include "../data-plane/encapsulations/vxlan-gpe.h"
+
+/* Maximum number of paths whose MTU is tracked. The rest use the default */
+#define MAX_SIZE 10000
+
+static int pmtu_kernel_mtu(ip_addr_t *src, ip_addr_t *dst);
+
+pmtu_table_t *
+pmtu_table_new(uint8_t stateless_frag)
+{
+    pmtu_table_t *tbl;
+
+    tbl = xzalloc(sizeof(pmtu_table_t));
+    tbl->htable = kh_init(pmtu);
+    tbl->stateless_frag = stateless_frag;
+    token_bucket_init(&tbl->icmp_rate, PMTU_ICMP_RATE, PMTU_ICMP_RATE);
+    return (tbl);
+}
+
+void
+pmtu_table_del(pmtu_table_t *tbl)
+{
+    khiter_t k;
+
+    if (!tbl){
+        return;
+    }
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (kh_exist(tbl->htable, k)){
+            free(kh_value(tbl->htable, k));
+        }
+    }
+    kh_destroy(pmtu, tbl->htable);
+    free(tbl);
+}
+
+/* MTU of the route from src to dst according to the kernel. It is obtained
+ * from a UDP socket connected to dst that is never used to send */
+static int
+pmtu_kernel_mtu(ip_addr_t *src, ip_addr_t *dst)
+{
+    struct sockaddr_storage ss;
+    struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+    socklen_t ss_len, len;
+    int afi = ip_addr_afi(dst);
+    int sock, mtu = PMTU_DEFAULT;
+
+    sock = socket(afi, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0){
+        return (mtu);
+    }
+    memset(&ss, 0, sizeof(ss));
+    if (afi == AF_INET){
+        sin->sin_family = AF_INET;
+        ss_len = sizeof(struct sockaddr_in);
+    }else{
+        sin6->sin6_family = AF_INET6;
+        ss_len = sizeof(struct sockaddr_in6);
+    }
+
+    /* Bind to the source RLOC so that the source routing rules apply. The
+     * RLOC may not be available yet: ignore errors */
+    if (src && ip_addr_afi(src) == afi){
+        ip_addr_copy_to(afi == AF_INET ? (void *)&sin->sin_addr
+                : (void *)&sin6->sin6_addr, src);
+        bind(sock, (struct sockaddr *)&ss, ss_len);
+    }
+    ip_addr_copy_to(afi == AF_INET ? (void *)&sin->sin_addr
+            : (void *)&sin6->sin6_addr, dst);
+    if (afi == AF_INET){
+        sin->sin_port = htons(LISP_DATA_PORT);
+    }else{
+        sin6->sin6_port = htons(LISP_DATA_PORT);
+    }
+    if (connect(sock, (struct sockaddr *)&ss, ss_len) == 0){
+        len = sizeof(mtu);
+        if ((afi == AF_INET
+                && getsockopt(sock, IPPROTO_IP, IP_MTU, &mtu, &len) < 0)
+                || (afi == AF_INET6
+                && getsockopt(sock, IPPROTO_IPV6, IPV6_MTU, &mtu, &len) < 0)){
+            mtu = PMTU_DEFAULT;
+        }
+    }else{
+        OOR_LOG(LDBG_2, "pmtu_kernel_mtu: No route to %s: %s",
+                ip_addr_to_char(dst), strerror(errno));
+    }
+    close(sock);
+    return (mtu);
+}
+
+/* Path MTU from the local RLOC src to the remote RLOC dst */
+int
+pmtu_get(pmtu_table_t *tbl, ip_addr_t *src, ip_addr_t *dst)
+{
+    pmtu_key_t key;
+    pmtu_t *entry;
+    time_t now = time(NULL);
+    khiter_t k;
+    int ret;
+
+    ip_addr_copy(&key.src, src);
+    ip_addr_copy(&key.dst, dst);
+    k = kh_get(pmtu, tbl->htable, &key);
+    if (k != kh_end(tbl->htable)){
+        entry = kh_value(tbl->htable, k);
+        if (now < entry->expires){
+            return (entry->mtu);
+        }
+    }else{
+        if (kh_size(tbl->htable) >= MAX_SIZE){
+            return (pmtu_kernel_mtu(src, dst));
+        }
+        entry = xzalloc(sizeof(pmtu_t));
+        entry->key = key;
+        k = kh_put(pmtu, tbl->htable, &entry->key, &ret);
+        kh_value(tbl->htable, k) = entry;
+    }
+    entry->mtu = pmtu_kernel_mtu(src, dst);
+    entry->expires = now + PMTU_EXPIRE;
+    OOR_LOG(LDBG_2, "pmtu_get: MTU of the path %s -> %s is %d",
+            ip_addr_to_char(src), ip_addr_to_char(dst), entry->mtu);
+    return (entry->mtu);
+}
+
+/* Lower the MTU of the path src -> dst to the one reported by an ICMP error.
+ * Only paths already in use are updated. Returns GOOD if the MTU changed */
+int
+pmtu_update(pmtu_table_t *tbl, ip_addr_t *src, ip_addr_t *dst, int mtu)
+{
+    pmtu_key_t key;
+    pmtu_t *entry;
+    khiter_t k;
+    int min;
+
+    ip_addr_copy(&key.src, src);
+    ip_addr_copy(&key.dst, dst);
+    k = kh_get(pmtu, tbl->htable, &key);
+    if (k == kh_end(tbl->htable)){
+        return (BAD);
+    }
+    entry = kh_value(tbl->htable, k);
+
+    min = (ip_addr_afi(dst) == AF_INET) ? PMTU_MIN_V4 : PMTU_MIN_V6;
+    if (mtu < min){
+        mtu = min;
+    }
+    if (mtu >= entry->mtu){
+        return (BAD);
+    }
+    OOR_LOG(LDBG_1, "pmtu_update: MTU of the path %s -> %s lowered from %d "
+            "to %d", ip_addr_to_char(src), ip_addr_to_char(dst), entry->mtu,
+            mtu);
+    entry->mtu = mtu;
+    entry->expires = time(NULL) + PMTU_EXPIRE;
+    tbl->stats.too_big_rcvd++;
+    return (GOOD);
+}
+
+static inline int
+pmtu_is_data_port(struct udphdr *udph)
+{
+    return (ntohs(udph->dest) == LISP_DATA_PORT
+            || ntohs(udph->dest) == VXLAN_GPE_DATA_PORT);
+}
+
+/*
+ * Check if an ICMP message, starting at its ICMP header, is a Fragmentation
+ * Needed (IPv4) or Packet Too Big (IPv6) error for an encapsulated data
+ * packet. On success, src and dst are the RLOCs of the packet and mtu the MTU
+ * reported.
+ */
+int
+pmtu_parse_icmp(void *icmp, int len, int afi, ip_addr_t *src,
+        ip_addr_t *dst, int *mtu)
+{
+    struct icmp *icmph;
+    struct icmp6_hdr *icmp6h;
+    struct ip *iph;
+    struct ip6_hdr *ip6h;
+    struct ip6_frag *fragh;
+    uint8_t *l4;
+    int nxt;
+
+    switch (afi){
+    case AF_INET:
+        if (len < ICMP_MINLEN + sizeof(struct ip)){
+            return (BAD);
+        }
+        icmph = icmp;
+        if (icmph->icmp_type != ICMP_UNREACH
+                || icmph->icmp_code != ICMP_UNREACH_NEEDFRAG){
+            return (BAD);
+        }
+        iph = (struct ip *)((uint8_t *)icmp + ICMP_MINLEN);
+        l4 = (uint8_t *)iph + (iph->ip_hl << 2);
+        if (iph->ip_v != IPVERSION || iph->ip_p != IPPROTO_UDP
+                || (ntohs(iph->ip_off) & IP_OFFMASK) != 0
+                || l4 + sizeof(struct udphdr) > (uint8_t *)icmp + len
+                || !pmtu_is_data_port((struct udphdr *)l4)){
+            return (BAD);
+        }
+        ip_addr_init(src, &iph->ip_src, AF_INET);
+        ip_addr_init(dst, &iph->ip_dst, AF_INET);
+        *mtu = ntohs(icmph->icmp_nextmtu);
+        return (GOOD);
+    case AF_INET6:
+        if (len < sizeof(struct icmp6_hdr) + sizeof(struct ip6_hdr)){
+            return (BAD);
+        }
+        icmp6h = icmp;
+        if (icmp6h->icmp6_type != ICMP6_PACKET_TOO_BIG){
+            return (BAD);
+        }
+        ip6h = (struct ip6_hdr *)(icmp6h + 1);
+        l4 = (uint8_t *)(ip6h + 1);
+        nxt = ip6h->ip6_nxt;
+        /* First fragment of a packet sent in fragments */
+        if (nxt == IPPROTO_FRAGMENT){
+            fragh = (struct ip6_frag *)l4;
+            if (l4 + sizeof(struct ip6_frag) > (uint8_t *)icmp + len
+                    || (fragh->ip6f_offlg & IP6F_OFF_MASK) != 0){
+                return (BAD);
+            }
+            nxt = fragh->ip6f_nxt;
+            l4 += sizeof(struct ip6_frag);
+        }
+        if (nxt != IPPROTO_UDP
+                || l4 + sizeof(struct udphdr) > (uint8_t *)icmp + len
+                || !pmtu_is_data_port((struct udphdr *)l4)){
+            return (BAD);
+        }
+        ip_addr_init(src, &ip6h->ip6_src, AF_INET6);
+        ip_addr_init(dst, &ip6h->ip6_dst, AF_INET6);
+        *mtu = ntohl(icmp6h->icmp6_mtu);
+        return (GOOD);
+    default:
+        return (BAD);
+    }
+}
+
+void
+pmtu_stats_dump(pmtu_table_t *tbl, int log_level)
+{
+    khiter_t k;
+    pmtu_t *entry;
+
+    if (is_loggable(log_level) == FALSE) {
+        return;
+    }
+
+    OOR_LOG(log_level, "Path MTU: %"PRIu64" lowered by ICMP errors, %"PRIu64
+            " ICMP errors sent, %"PRIu64" packets fragmented, %"PRIu64
+            " packets dropped", tbl->stats.too_big_rcvd, tbl->stats.icmp_sent,
+            tbl->stats.fragmented, tbl->stats.dropped);
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (!kh_exist(tbl->htable, k)){
+            continue;
+        }
+        entry = kh_value(tbl->htable, k);
+        OOR_LOG(log_level, "  %s -> %s: %d", ip_addr_to_char(&entry->key.src),
+                ip_addr_to_char(&entry->key.dst), entry->mtu);
+    }
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
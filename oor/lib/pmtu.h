@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef PMTU_H_
+#define PMTU_H_
+
+#include <time.h>
+#include "../elibs/khash/khash.h"
+#include "../liblisp/lisp_ip.h"
+#include "token_bucket.h"
+
+/*
+ * Path MTU between each local RLOC and each remote RLOC. The MTU of a new
+ * path is the one the kernel has for the route to the remote RLOC, and it is
+ * lowered with the ICMP Fragmentation Needed (IPv4) and Packet Too Big (IPv6)
+ * errors generated for the encapsulated packets. Values are refreshed after
+ * PMTU_EXPIRE seconds so that a path that recovers its MTU is used again
+ * (RFC 1191 section 6.3).
+ */
+
+#define PMTU_EXPIRE         600
+/* Used when the kernel doesn't know the MTU to a remote RLOC */
+#define PMTU_DEFAULT        1500
+/* Lowest MTUs accepted from an ICMP error */
+#define PMTU_MIN_V4         552
+#define PMTU_MIN_V6         1280
+/* ICMP errors per second sent to the sources of too big packets */
+#define PMTU_ICMP_RATE      100
+
+typedef struct pmtu_key_ {
+    ip_addr_t src;
+    ip_addr_t dst;
+} pmtu_key_t;
+
+typedef struct pmtu_ {
+    pmtu_key_t key;
+    int mtu;
+    time_t expires;
+} pmtu_t;
+
+typedef struct pmtu_stats_ {
+    /* ICMP errors that lowered the MTU of a path */
+    uint64_t too_big_rcvd;
+    /* ICMP errors sent to the sources of too big packets */
+    uint64_t icmp_sent;
+    /* Packets sent in fragments of the outer header */
+    uint64_t fragmented;
+    /* Too big packets dropped */
+    uint64_t dropped;
+} pmtu_stats_t;
+
+static inline uint32_t
+pmtu_key_hash(pmtu_key_t *key)
+{
+    return (ip_addr_hash(&key->src) * 31 + ip_addr_hash(&key->dst));
+}
+
+static inline int
+pmtu_key_equal(pmtu_key_t *a, pmtu_key_t *b)
+{
+    return (ip_addr_equal(&a->dst, &b->dst) && ip_addr_equal(&a->src, &b->src));
+}
+
+KHASH_INIT(pmtu, pmtu_key_t *, pmtu_t *, 1, pmtu_key_hash, pmtu_key_equal)
+
+typedef struct pmtu_table_ {
+    khash_t(pmtu) *htable;
+    /* Fragment the outer header of the packets that don't fit instead of
+     * asking their sources to reduce their size (RFC 6830 section 5.4.1) */
+    uint8_t stateless_frag;
+    token_bucket_t icmp_rate;
+    pmtu_stats_t stats;
+} pmtu_table_t;
+
+pmtu_table_t *pmtu_table_new(uint8_t stateless_frag);
+void pmtu_table_del(pmtu_table_t *tbl);
+int pmtu_get(pmtu_table_t *tbl, ip_addr_t *src, ip_addr_t *dst);
+int pmtu_update(pmtu_table_t *tbl, ip_addr_t *src, ip_addr_t *dst, int mtu);
+int pmtu_parse_icmp(void *icmp, int len, int afi, ip_addr_t *src,
+        ip_addr_t *dst, int *mtu);
+void pmtu_stats_dump(pmtu_table_t *tbl, int log_level);
+
+#endif /* PMTU_H_ */
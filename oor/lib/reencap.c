@@ -0,0 +1,178 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <inttypes.h>
+
+#include "reencap.h"
+#include "mem_util.h"
+#include "oor_log.h"
+#include "sockets.h"
+#include "../fwd_policies/fwd_policy.h"
+
+/* Maximum number of entries. Packets of the rest take the regular path */
+#define MAX_SIZE 10000
+
+static void reencap_remove_with_khiter(reencap_table_t *tbl, khiter_t k);
+
+reencap_table_t *
+reencap_table_new()
+{
+    reencap_table_t *tbl;
+
+    tbl = xzalloc(sizeof(reencap_table_t));
+    tbl->htable = kh_init(reencap);
+    return (tbl);
+}
+
+void
+reencap_table_del(reencap_table_t *tbl)
+{
+    khiter_t k;
+
+    if (!tbl){
+        return;
+    }
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (kh_exist(tbl->htable, k)){
+            free(kh_value(tbl->htable, k));
+        }
+    }
+    kh_destroy(reencap, tbl->htable);
+    free(tbl);
+}
+
+static void
+reencap_remove_with_khiter(reencap_table_t *tbl, khiter_t k)
+{
+    free(kh_value(tbl->htable, k));
+    kh_del(reencap, tbl->htable, k);
+}
+
+/* Entry of key or NULL if there is none or it has timed out */
+reencap_t *
+reencap_lookup(reencap_table_t *tbl, reencap_key_t *key)
+{
+    reencap_t *re;
+    khiter_t k;
+
+    k = kh_get(reencap, tbl->htable, key);
+    if (k == kh_end(tbl->htable)){
+        tbl->stats.misses++;
+        return (NULL);
+    }
+    re = kh_value(tbl->htable, k);
+    if (time(NULL) >= re->expires){
+        reencap_remove_with_khiter(tbl, k);
+        tbl->stats.misses++;
+        return (NULL);
+    }
+    tbl->stats.hits++;
+    return (re);
+}
+
+/* Add or refresh the entry of key with the forwarding info fi, that should
+ * have both RLOCs set */
+void
+reencap_insert(reencap_table_t *tbl, reencap_key_t *key, fwd_info_t *fi)
+{
+    fwd_entry_t *fe = fi->fwd_info;
+    reencap_t *re;
+    time_t now = time(NULL);
+    khiter_t k;
+    int ret;
+
+    k = kh_get(reencap, tbl->htable, key);
+    if (k != kh_end(tbl->htable)){
+        re = kh_value(tbl->htable, k);
+    }else{
+        if (kh_size(tbl->htable) >= MAX_SIZE){
+            for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+                if (kh_exist(tbl->htable, k)
+                        && now >= kh_value(tbl->htable, k)->expires){
+                    reencap_remove_with_khiter(tbl, k);
+                }
+            }
+            if (kh_size(tbl->htable) >= MAX_SIZE){
+                return;
+            }
+        }
+        re = xzalloc(sizeof(reencap_t));
+        re->key = *key;
+        k = kh_put(reencap, tbl->htable, &re->key, &ret);
+        kh_value(tbl->htable, k) = re;
+    }
+
+    lisp_addr_copy(&re->srloc, fe->srloc);
+    lisp_addr_copy(&re->drloc, fe->drloc);
+    re->out_sock = fe->out_sock;
+    re->encap = fi->encap;
+    re->iid = fe->iid;
+    re->lsb_set = fi->lsb_set;
+    re->lsb = fi->lsb;
+    re->mtu = fe->mtu;
+    re->expires = now + REENCAP_TIMEOUT;
+    OOR_LOG(LDBG_3, "reencap_insert: Packets from %s to %s (IID %u) "
+            "re-encapsulated to %s", ip_addr_to_char(&key->src_rloc),
+            ip_addr_to_char(&key->dst_eid), key->iid,
+            lisp_addr_to_char(&re->drloc));
+}
+
+/* Remove the entries that re-encapsulate from or to rloc. All the entries
+ * are removed if rloc is NULL. Returns the number of entries removed */
+int
+reencap_remove_with_rloc(reencap_table_t *tbl, lisp_addr_t *rloc)
+{
+    reencap_t *re;
+    khiter_t k;
+    int removed = 0;
+
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (!kh_exist(tbl->htable, k)){
+            continue;
+        }
+        re = kh_value(tbl->htable, k);
+        if (rloc && lisp_addr_cmp(&re->srloc, rloc) != 0
+                && lisp_addr_cmp(&re->drloc, rloc) != 0){
+            continue;
+        }
+        reencap_remove_with_khiter(tbl, k);
+        removed++;
+    }
+    return (removed);
+}
+
+void
+reencap_stats_dump(reencap_table_t *tbl, int log_level)
+{
+    if (is_loggable(log_level) == FALSE) {
+        return;
+    }
+
+    OOR_LOG(log_level, "Re-encapsulation cache: %d entries, %"PRIu64" hits, "
+            "%"PRIu64" misses", kh_size(tbl->htable), tbl->stats.hits,
+            tbl->stats.misses);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef REENCAP_H_
+#define REENCAP_H_
+
+#include <time.h>
+#include "../defs.h"
+#include "../elibs/khash/khash.h"
+#include "../liblisp/lisp_address.h"
+
+/*
+ * Re-encapsulation cache of the RTR. The outer headers used to re-encapsulate
+ * the packets received from a remote RLOC for an EID are kept, so that the
+ * following packets are re-encapsulated in place with a single lookup. All the
+ * flows of the same (source RLOC, IID, destination EID) use the remote RLOC
+ * selected for the first one. Entries are obtained again from the flow table
+ * after REENCAP_TIMEOUT seconds, as the flow table does with the control.
+ */
+
+#define REENCAP_TIMEOUT     3
+
+typedef struct reencap_key_ {
+    /* Outer source of the received packet */
+    ip_addr_t src_rloc;
+    uint32_t iid;
+    /* Inner destination */
+    ip_addr_t dst_eid;
+} reencap_key_t;
+
+typedef struct reencap_ {
+    reencap_key_t key;
+    /* Outer headers of the re-encapsulated packets */
+    lisp_addr_t srloc;
+    lisp_addr_t drloc;
+    int *out_sock;
+    oor_encap_t encap;
+    uint32_t iid;
+    uint8_t lsb_set;
+    uint32_t lsb;
+    /* Path MTU to drloc or 0 if unknown */
+    int mtu;
+    time_t expires;
+} reencap_t;
+
+typedef struct reencap_stats_ {
+    uint64_t hits;
+    uint64_t misses;
+} reencap_stats_t;
+
+/* The low order bits of the hash index the table. Those of an IPv4 address
+ * read as a word are the ones of its first byte, mostly the same for all the
+ * EIDs, so the bits are mixed (MurmurHash3 finalizer) */
+static inline uint32_t
+reencap_key_hash(reencap_key_t *key)
+{
+    uint32_t h;
+
+    h = (ip_addr_hash(&key->src_rloc) * 31 + ip_addr_hash(&key->dst_eid))
+            ^ key->iid;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return (h);
+}
+
+static inline int
+reencap_key_equal(reencap_key_t *a, reencap_key_t *b)
+{
+    return (a->iid == b->iid && ip_addr_equal(&a->dst_eid, &b->dst_eid)
+            && ip_addr_equal(&a->src_rloc, &b->src_rloc));
+}
+
+KHASH_INIT(reencap, reencap_key_t *, reencap_t *, 1, reencap_key_hash,
+        reencap_key_equal)
+
+typedef struct reencap_table_ {
+    khash_t(reencap) *htable;
+    reencap_stats_t stats;
+} reencap_table_t;
+
+reencap_table_t *reencap_table_new();
+void reencap_table_del(reencap_table_t *tbl);
+reencap_t *reencap_lookup(reencap_table_t *tbl, reencap_key_t *key);
+void reencap_insert(reencap_table_t *tbl, reencap_key_t *key, fwd_info_t *fi);
+int reencap_remove_with_rloc(reencap_table_t *tbl, lisp_addr_t *rloc);
+void reencap_stats_dump(reencap_table_t *tbl, int log_level);
+
+#endif /* REENCAP_H_ */
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdlib.h>
+
+#include "rloc_lsb.h"
+#include "mem_util.h"
+#include "oor_log.h"
+
+/* Maximum number of RLOCs in the table. When it is reached the table is
+ * emptied: the next packet of each RLOC is seen as a change */
+#define MAX_SIZE 10000
+
+
+rloc_lsb_table_t *
+rloc_lsb_table_new()
+{
+    rloc_lsb_table_t *tbl;
+
+    tbl = xzalloc(sizeof(rloc_lsb_table_t));
+    tbl->htable = kh_init(rloc_lsb);
+    return (tbl);
+}
+
+static void
+rloc_lsb_table_clear(rloc_lsb_table_t *tbl)
+{
+    khiter_t k;
+
+    for (k = kh_begin(tbl->htable); k != kh_end(tbl->htable); ++k){
+        if (kh_exist(tbl->htable, k)){
+            free(kh_value(tbl->htable, k));
+        }
+    }
+    kh_clear(rloc_lsb, tbl->htable);
+}
+
+void
+rloc_lsb_table_del(rloc_lsb_table_t *tbl)
+{
+    if (!tbl){
+        return;
+    }
+    rloc_lsb_table_clear(tbl);
+    kh_destroy(rloc_lsb, tbl->htable);
+    free(tbl);
+}
+
+/* Store lsb as the last bits received from rloc. TRUE if they are the first
+ * ones of rloc or they are different from the previous ones */
+int
+rloc_lsb_update(rloc_lsb_table_t *tbl, ip_addr_t *rloc, uint32_t lsb)
+{
+    rloc_lsb_t *entry;
+    khiter_t k;
+    int ret;
+
+    k = kh_get(rloc_lsb, tbl->htable, rloc);
+    if (k != kh_end(tbl->htable)){
+        entry = kh_value(tbl->htable, k);
+        if (entry->lsb == lsb){
+            return (FALSE);
+        }
+        entry->lsb = lsb;
+        return (TRUE);
+    }
+
+    if (kh_size(tbl->htable) >= MAX_SIZE){
+        OOR_LOG(LDBG_1, "rloc_lsb_update: Max size of the Locator-Status-Bits "
+                "table reached. Emptying it");
+        rloc_lsb_table_clear(tbl);
+    }
+    entry = xzalloc(sizeof(rloc_lsb_t));
+    ip_addr_copy(&entry->rloc, rloc);
+    entry->lsb = lsb;
+    k = kh_put(rloc_lsb, tbl->htable, &entry->rloc, &ret);
+    kh_value(tbl->htable, k) = entry;
+    return (TRUE);
+}
+
+/* The next bits received from rloc are processed as a change */
+void
+rloc_lsb_forget(rloc_lsb_table_t *tbl, ip_addr_t *rloc)
+{
+    khiter_t k;
+
+    k = kh_get(rloc_lsb, tbl->htable, rloc);
+    if (k == kh_end(tbl->htable)){
+        return;
+    }
+    free(kh_value(tbl->htable, k));
+    kh_del(rloc_lsb, tbl->htable, k);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
@@ -0,0 +1,49 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef RLOC_LSB_H_
+#define RLOC_LSB_H_
+
+#include "../elibs/khash/khash.h"
+#include "../liblisp/lisp_ip.h"
+
+/*
+ * Last Locator-Status-Bits received in the data packets of each remote RLOC.
+ * The data path only lets the control know when they change.
+ */
+
+typedef struct rloc_lsb_ {
+    ip_addr_t rloc;
+    uint32_t lsb;
+} rloc_lsb_t;
+
+KHASH_INIT(rloc_lsb, ip_addr_t *, rloc_lsb_t *, 1, ip_addr_hash,
+        ip_addr_equal)
+
+typedef struct rloc_lsb_table_ {
+    khash_t(rloc_lsb) *htable;
+} rloc_lsb_table_t;
+
+rloc_lsb_table_t *rloc_lsb_table_new();
+void rloc_lsb_table_del(rloc_lsb_table_t *tbl);
+int rloc_lsb_update(rloc_lsb_table_t *tbl, ip_addr_t *rloc, uint32_t lsb);
+void rloc_lsb_forget(rloc_lsb_table_t *tbl, ip_addr_t *rloc);
+
+#endif /* RLOC_LSB_H_ */
@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "rtt_stats.h"
+
+
+static double rtt_hist_bound(int bucket);
+
+
+void
+rtt_stats_init(rtt_stats_t *st)
+{
+    memset(st, 0, sizeof(rtt_stats_t));
+}
+
+/* Upper bound in ms of the samples of a histogram bucket */
+static double
+rtt_hist_bound(int bucket)
+{
+    double bound = (double)(1 << (bucket / 2));
+
+    return (bucket % 2 ? bound * 1.4142 : bound);
+}
+
+void
+rtt_stats_add_sample(rtt_stats_t *st, double rtt_ms)
+{
+    int i;
+
+    if (st->samples == 0){
+        st->srtt = rtt_ms;
+        st->rttvar = rtt_ms / 2;
+    }else{
+        st->rttvar = 0.75 * st->rttvar + 0.25 * (st->srtt > rtt_ms ?
+                st->srtt - rtt_ms : rtt_ms - st->srtt);
+        st->srtt = 0.875 * st->srtt + 0.125 * rtt_ms;
+    }
+    st->loss = 0.875 * st->loss;
+    st->samples++;
+
+    for (i = 0; i < RTT_HIST_BUCKETS - 1 && rtt_ms > rtt_hist_bound(i); i++);
+    st->hist[i]++;
+    if (++st->hist_count >= RTT_HIST_MAX){
+        st->hist_count = 0;
+        for (i = 0; i < RTT_HIST_BUCKETS; i++){
+            st->hist[i] /= 2;
+            st->hist_count += st->hist[i];
+        }
+    }
+}
+
+void
+rtt_stats_add_loss(rtt_stats_t *st)
+{
+    st->loss = 0.875 * st->loss + 0.125;
+    st->losses++;
+}
+
+/* Upper bound of the pct percentile of the RTT in ms. 0 without samples */
+double
+rtt_stats_percentile(rtt_stats_t *st, int pct)
+{
+    uint32_t target, acc = 0;
+    int i;
+
+    if (st->hist_count == 0){
+        return (0);
+    }
+    target = (st->hist_count * pct + 99) / 100;
+    for (i = 0; i < RTT_HIST_BUCKETS - 1; i++){
+        acc += st->hist[i];
+        if (acc >= target){
+            break;
+        }
+    }
+    return (rtt_hist_bound(i));
+}
+
+/* Milliseconds elapsed since a CLOCK_MONOTONIC timestamp */
+double
+rtt_elapsed_ms(struct timespec *since)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (1.0e3 * (now.tv_sec - since->tv_sec)
+            + 1.0e-6 * (now.tv_nsec - since->tv_nsec));
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
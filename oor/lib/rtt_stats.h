@@ -0,0 +1,53 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef RTT_STATS_H_
+#define RTT_STATS_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Round trip time and loss estimator of a peer. Smoothed RTT and variation
+ * follow RFC 6298 and the loss ratio is an EWMA with the same gain as the
+ * RTT. A histogram of exponential buckets (two per power of two of ms)
+ * provides percentiles. Its counters are halved when they reach
+ * RTT_HIST_MAX samples so it follows changes of the peer.
+ */
+
+#define RTT_HIST_BUCKETS    26
+#define RTT_HIST_MAX        256
+
+typedef struct rtt_stats_ {
+    double srtt;        /* ms */
+    double rttvar;      /* ms */
+    double loss;        /* 0 .. 1 */
+    uint32_t hist[RTT_HIST_BUCKETS];
+    uint32_t hist_count;
+    uint64_t samples;
+    uint64_t losses;
+} rtt_stats_t;
+
+void rtt_stats_init(rtt_stats_t *st);
+void rtt_stats_add_sample(rtt_stats_t *st, double rtt_ms);
+void rtt_stats_add_loss(rtt_stats_t *st);
+double rtt_stats_percentile(rtt_stats_t *st, int pct);
+double rtt_elapsed_ms(struct timespec *since);
+
+#endif /* RTT_STATS_H_ */
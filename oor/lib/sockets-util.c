@@ -17,15 +17,30 @@
  *
  */
 
+/* Define _GNU_SOURCE in order to use sendmmsg */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #include <errno.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 
 #include "oor_log.h"
 #include "sockets-util.h"
 
+/* From linux/icmp.h, that conflicts with net/if.h */
+#ifndef ICMP_FILTER
+#define ICMP_FILTER 1
+struct icmp_filter {
+    uint32_t data;
+};
+#endif
+
 int
 open_ip_raw_socket(int afi)
 {
@@ -91,6 +106,42 @@ open_udp_raw_socket(int afi)
     return (sock);
 }
 
+/* Raw socket that only receives the ICMP errors reporting the MTU of a path:
+ * Fragmentation Needed (Destination Unreachable) for IPv4 and Packet Too Big
+ * for IPv6 */
+int
+open_icmp_too_big_socket(int afi)
+{
+    struct icmp_filter filter;
+    struct icmp6_filter filter6;
+    int sock, ret;
+
+    sock = socket(afi, SOCK_RAW,
+            (afi == AF_INET) ? IPPROTO_ICMP : IPPROTO_ICMPV6);
+    if (sock < 0) {
+        OOR_LOG(LERR, "open_icmp_too_big_socket: socket: %s", strerror(errno));
+        return (ERR_SOCKET);
+    }
+
+    if (afi == AF_INET){
+        filter.data = ~(1U << ICMP_UNREACH);
+        ret = setsockopt(sock, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+    }else{
+        ICMP6_FILTER_SETBLOCKALL(&filter6);
+        ICMP6_FILTER_SETPASS(ICMP6_PACKET_TOO_BIG, &filter6);
+        ret = setsockopt(sock, IPPROTO_ICMPV6, ICMP6_FILTER, &filter6,
+                sizeof(filter6));
+    }
+    if (ret < 0){
+        OOR_LOG(LWRN, "open_icmp_too_big_socket: setsockopt ICMP filter: %s",
+                strerror(errno));
+        close(sock);
+        return (ERR_SOCKET);
+    }
+
+    return (sock);
+}
+
 int
 open_udp_datagram_socket(int afi)
 {
@@ -280,32 +331,58 @@ bind_socket(int sock, int afi, lisp_addr_t *src_addr, int src_port)
 int
 send_raw_packet(int socket, const void *pkt, int plen, ip_addr_t *dip)
 {
-    struct sockaddr *saddr = NULL;
-    int slen, nbytes;
+    struct iovec iov;
 
+    iov.iov_base = (void *)pkt;
+    iov.iov_len = plen;
+    return (send_raw_packet_iov(socket, &iov, 1, dip));
+}
+
+typedef union raw_sockaddr_ {
     struct sockaddr_in sa4;
     struct sockaddr_in6 sa6;
+} raw_sockaddr_t;
 
+static inline void
+raw_msghdr_init(struct msghdr *msg, raw_sockaddr_t *saddr, struct iovec *iov,
+        int iovcnt, ip_addr_t *dip)
+{
+    memset(msg, 0, sizeof(struct msghdr));
+    memset(saddr, 0, sizeof(raw_sockaddr_t));
 
     /* build sock addr */
     switch (ip_addr_afi(dip)) {
     case AF_INET:
-        memset(&sa4, 0, sizeof(sa4));
-        sa4.sin_family = AF_INET;
-        ip_addr_copy_to(&sa4.sin_addr, dip);
-        slen = sizeof(struct sockaddr_in);
-        saddr = (struct sockaddr *)&sa4;
+        saddr->sa4.sin_family = AF_INET;
+        ip_addr_copy_to(&saddr->sa4.sin_addr, dip);
+        msg->msg_namelen = sizeof(struct sockaddr_in);
         break;
     case AF_INET6:
-        memset(&sa6, 0, sizeof(sa6));
-        sa6.sin6_family = AF_INET6;
-        ip_addr_copy_to(&sa6.sin6_addr, dip);
-        slen = sizeof(struct sockaddr_in6);
-        saddr = (struct sockaddr *)&sa6;
+        saddr->sa6.sin6_family = AF_INET6;
+        ip_addr_copy_to(&saddr->sa6.sin6_addr, dip);
+        msg->msg_namelen = sizeof(struct sockaddr_in6);
         break;
     }
+    msg->msg_name = saddr;
+    msg->msg_iov = iov;
+    msg->msg_iovlen = iovcnt;
+}
+
+/* Sends a raw packet split in iovcnt buffers (i.e. encapsulation headers and
+ * payload) without copying them into a single buffer */
+int
+send_raw_packet_iov(int socket, struct iovec *iov, int iovcnt, ip_addr_t *dip)
+{
+    struct msghdr msg;
+    raw_sockaddr_t saddr;
+    int i, plen = 0, nbytes;
+
+    for (i = 0; i < iovcnt; i++){
+        plen += iov[i].iov_len;
+    }
+    raw_msghdr_init(&msg, &saddr, iov, iovcnt, dip);
 
-    nbytes = sendto(socket, pkt, plen, 0, saddr, slen);
+    nbytes = sendmsg(socket, &msg, 0);
     if (nbytes != plen) {
         OOR_LOG(LDBG_2, "send_raw_packet: send packet to %s using fail descriptor %d failed -> %s", ip_addr_to_char(dip),
                 socket, strerror(errno));
@@ -315,6 +392,47 @@ send_raw_packet(int socket, const void *pkt, int plen, ip_addr_t *dip)
     return (GOOD);
 }
 
+/*
+ * Send n packets through a raw socket with a single system call. Each packet
+ * is composed by iovcnt consecutive buffers of pkts and dips[i] is the
+ * destination of the packet i. A packet that can't be sent is skipped and
+ * the rest are still sent. Returns the number of packets sent and, in
+ * dropped, the number of packets that could not be sent
+ */
+int
+send_raw_packets(int socket, struct iovec *pkts, int iovcnt, ip_addr_t **dips,
+        int n, int *dropped)
+{
+    raw_sockaddr_t saddrs[SEND_RAW_BURST];
+    struct mmsghdr msgs[SEND_RAW_BURST];
+    int i, sent, total = 0, nsent = 0;
+
+    *dropped = 0;
+    while (total < n){
+        for (i = 0; i < n - total && i < SEND_RAW_BURST; i++){
+            raw_msghdr_init(&msgs[i].msg_hdr, &saddrs[i],
+                    &pkts[(total + i) * iovcnt], iovcnt, dips[total + i]);
+            msgs[i].msg_len = 0;
+        }
+
+        /* sendmmsg stops at the first message that fails: it is the first
+         * one of the next call */
+        sent = sendmmsg(socket, msgs, i, 0);
+        if (sent <= 0) {
+            OOR_LOG(LDBG_2, "send_raw_packets: send packet to %s using fail "
+                    "descriptor %d failed -> %s", ip_addr_to_char(dips[total]),
+                    socket, strerror(errno));
+            (*dropped)++;
+            total++;
+            continue;
+        }
+        total += sent;
+        nsent += sent;
+    }
+
+    return (nsent);
+}
+
 int
 send_datagram_packet (int sock, const void *packet, int packet_length,
         lisp_addr_t *addr_dest, int port_dest)
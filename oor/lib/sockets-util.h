@@ -21,10 +21,15 @@
 #ifndef SOCKETS_UTIL_H_
 #define SOCKETS_UTIL_H_
 
+#include <sys/uio.h>
 #include "../liblisp/lisp_address.h"
 
+/* Maximum number of packets handed to the kernel in one sendmmsg call */
+#define SEND_RAW_BURST      64
+
 int open_ip_raw_socket(int afi);
 int open_udp_raw_socket(int afi);
+int open_icmp_too_big_socket(int afi);
 int opent_netlink_socket();
 
 int open_udp_datagram_socket(int afi);
@@ -33,6 +38,9 @@ int socket_conf_req_ttl_tos(int sock, int afi);
 
 int bind_socket(int sock,int afi, lisp_addr_t *src_addr, int src_port);
 int send_raw_packet(int, const void *, int, ip_addr_t *);
+int send_raw_packet_iov(int socket, struct iovec *iov, int iovcnt, ip_addr_t *dip);
+int send_raw_packets(int socket, struct iovec *pkts, int iovcnt, ip_addr_t **dips,
+        int n, int *dropped);
 int send_datagram_packet (int sock, const void *packet, int packet_length,
         lisp_addr_t *addr_dest, int port_dest);
 
@@ -50,14 +50,36 @@ fwd_entry_new_init(lisp_addr_t *srloc, lisp_addr_t *drloc, uint32_t iid, int *ou
 inline void
 fwd_entry_del(fwd_entry_t *fwd_entry)
 {
+    int i;
+
     if (fwd_entry == NULL){
         return;
     }
     lisp_addr_del(fwd_entry->srloc);
     lisp_addr_del(fwd_entry->drloc);
+    for (i = 0; i < fwd_entry->n_alt_drlocs; i++){
+        lisp_addr_del(fwd_entry->alt_drlocs[i]);
+    }
+    free(fwd_entry->alt_drlocs);
+    free(fwd_entry->alt_weights);
     free(fwd_entry);
 }
 
+/* Add drloc to the destination RLOCs the flow could be moved to */
+void
+fwd_entry_add_alt_drloc(fwd_entry_t *fwd_entry, lisp_addr_t *drloc, int weight)
+{
+    int n = fwd_entry->n_alt_drlocs;
+
+    fwd_entry->alt_drlocs = xrealloc(fwd_entry->alt_drlocs,
+            (n + 1) * sizeof(lisp_addr_t *));
+    fwd_entry->alt_weights = xrealloc(fwd_entry->alt_weights,
+            (n + 1) * sizeof(int));
+    fwd_entry->alt_drlocs[n] = lisp_addr_clone(drloc);
+    fwd_entry->alt_weights[n] = weight;
+    fwd_entry->n_alt_drlocs = n + 1;
+}
+
 
 sockmstr_t *
 sockmstr_create()
@@ -449,20 +471,59 @@ sock_ctrl_recv(int sock, struct lbuf *buf, uconn_t *uc)
     return (GOOD);
 }
 
+/* Space for TTL and TOS data */
+union sock_data_cmsg {
+    struct cmsghdr cmsg;
+    u_char data[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(int))];
+};
+
+/* Extract the TTL and TOS of the outer header of a received data packet.
+ * Returns the AFI of the packet */
+static int
+sock_data_parse_cmsg(struct msghdr *msg, int family, uint8_t *ttl, uint8_t *tos)
+{
+    struct cmsghdr *cmsgptr = NULL;
+
+    if (family == AF_INET) {
+        for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr =
+                CMSG_NXTHDR(msg, cmsgptr)) {
+
+            if (cmsgptr->cmsg_level == IPPROTO_IP
+                    && cmsgptr->cmsg_type == IP_TTL) {
+                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
+            }
+
+            if (cmsgptr->cmsg_level == IPPROTO_IP
+                    && cmsgptr->cmsg_type == IP_TOS) {
+                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
+            }
+        }
+        return (AF_INET);
+    }
+
+    for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr =
+            CMSG_NXTHDR(msg, cmsgptr)) {
+
+        if (cmsgptr->cmsg_level == IPPROTO_IPV6
+                && cmsgptr->cmsg_type == IPV6_HOPLIMIT) {
+            *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
+        }
+
+        if (cmsgptr->cmsg_level == IPPROTO_IPV6
+                && cmsgptr->cmsg_type == IPV6_TCLASS) {
+            *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
+        }
+    }
+    return (AF_INET6);
+}
+
 int
 sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos)
 {
-    /* Space for TTL and TOS data */
-    union control_data {
-        struct cmsghdr cmsg;
-        u_char data[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(int))];
-    };
-
     union sockunion su;
     struct msghdr msg;
     struct iovec iov[1];
-    union control_data cmsg;
-    struct cmsghdr *cmsgptr = NULL;
+    union sock_data_cmsg cmsg;
     int nbytes = 0;
 
     iov[0].iov_base = lbuf_data(b);
@@ -484,39 +545,63 @@ sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos)
 
     lbuf_set_size(b, lbuf_size(b) + nbytes);
 
-    if (su.s4.sin_family == AF_INET) {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr =
-                CMSG_NXTHDR(&msg, cmsgptr)) {
+    *afi = sock_data_parse_cmsg(&msg, su.s4.sin_family, ttl, tos);
 
-            if (cmsgptr->cmsg_level == IPPROTO_IP
-                    && cmsgptr->cmsg_type == IP_TTL) {
-                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+    return (GOOD);
+}
 
-            if (cmsgptr->cmsg_level == IPPROTO_IP
-                    && cmsgptr->cmsg_type == IP_TOS) {
-                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
-        }
-        *afi = AF_INET;
-    } else {
-        for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr =
-                CMSG_NXTHDR(&msg, cmsgptr)) {
+/*
+ * Receive up to n data packets with a single system call. The socket should
+ * be non blocking. For each received packet, its buffer and the AFI, TTL and
+ * TOS of the outer header are filled. Returns the number of packets received
+ */
+int
+sock_data_recv_burst(int sock, lbuf_t *bufs, sock_data_info_t *info, int n)
+{
+    union sockunion su[SOCK_DATA_BURST];
+    union sock_data_cmsg cmsg[SOCK_DATA_BURST];
+    struct mmsghdr msgs[SOCK_DATA_BURST];
+    struct iovec iov[SOCK_DATA_BURST];
+    int i, nmsgs;
+
+    if (n > SOCK_DATA_BURST){
+        n = SOCK_DATA_BURST;
+    }
 
-            if (cmsgptr->cmsg_level == IPPROTO_IPV6
-                    && cmsgptr->cmsg_type == IPV6_HOPLIMIT) {
-                *ttl = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+    memset(msgs, 0, n * sizeof(struct mmsghdr));
+    for (i = 0; i < n; i++){
+        iov[i].iov_base = lbuf_data(&bufs[i]);
+        iov[i].iov_len = lbuf_tailroom(&bufs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = &cmsg[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(union sock_data_cmsg);
+        msgs[i].msg_hdr.msg_name = &su[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(union sockunion);
+    }
 
-            if (cmsgptr->cmsg_level == IPPROTO_IPV6
-                    && cmsgptr->cmsg_type == IPV6_TCLASS) {
-                *tos = *((uint8_t *) CMSG_DATA(cmsgptr));
-            }
+    nmsgs = recvmmsg(sock, msgs, n, MSG_DONTWAIT, NULL);
+    if (nmsgs == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK){
+            OOR_LOG(LWRN, "sock_data_recv_burst: recvmmsg error: %s", strerror(errno));
         }
-        *afi = AF_INET6;
+        return (0);
     }
 
-    return (GOOD);
+    for (i = 0; i < nmsgs; i++){
+        lbuf_set_size(&bufs[i], lbuf_size(&bufs[i]) + msgs[i].msg_len);
+        info[i].ttl = 0;
+        info[i].tos = 0;
+        info[i].afi = sock_data_parse_cmsg(&msgs[i].msg_hdr, su[i].s4.sin_family,
+                &info[i].ttl, &info[i].tos);
+        if (su[i].s4.sin_family == AF_INET){
+            lisp_addr_ip_init(&info[i].src, &su[i].s4.sin_addr, AF_INET);
+        }else{
+            lisp_addr_ip_init(&info[i].src, &su[i].s6.sin6_addr, AF_INET6);
+        }
+    }
+
+    return (nmsgs);
 }
 
 inline int
@@ -78,16 +78,36 @@ union sockunion {
 };
 
 
+/* Maximum number of packets read or written with a single system call */
+#define SOCK_DATA_BURST     64
+
+/* Outer header information of a received data packet */
+typedef struct sock_data_info_ {
+    int afi;
+    uint8_t ttl;
+    uint8_t tos;
+    lisp_addr_t src;
+} sock_data_info_t;
+
 typedef struct fwd_entry {
     lisp_addr_t *srloc;
     lisp_addr_t *drloc;
     int *out_sock;
     uint32_t iid;
+    /* Destination RLOCs, drloc among them, that the flow could use as well
+     * and their weight. Only set when flowlets are enabled */
+    lisp_addr_t **alt_drlocs;
+    int *alt_weights;
+    int n_alt_drlocs;
+    /* Path MTU from srloc to drloc or 0 if unknown */
+    int mtu;
 } fwd_entry_t;
 
 fwd_entry_t *fwd_entry_new_init(lisp_addr_t *srloc, lisp_addr_t *drloc,
         uint32_t iid, int *out_socket);
 void fwd_entry_del(fwd_entry_t *fwd_entry);
+void fwd_entry_add_alt_drloc(fwd_entry_t *fwd_entry, lisp_addr_t *drloc,
+        int weight);
 static inline void fwd_entry_set_srloc(fwd_entry_t *fwd_ent, lisp_addr_t * srloc);
 static inline void fwd_entry_set_drloc(fwd_entry_t *fwd_ent, lisp_addr_t * drloc);
 typedef struct iface iface_t;
@@ -110,6 +130,7 @@ int open_control_input_socket(int afi);
 int sock_recv(int, lbuf_t *);
 int sock_ctrl_recv(int, lbuf_t *, uconn_t *);
 int sock_data_recv(int sock, lbuf_t *b, int *afi, uint8_t *ttl, uint8_t *tos);
+int sock_data_recv_burst(int sock, lbuf_t *bufs, sock_data_info_t *info, int n);
 int uconn_init(uconn_t *uc, int lp, int rp, lisp_addr_t *la,
         lisp_addr_t *ra);
 
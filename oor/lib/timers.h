@@ -33,7 +33,10 @@ typedef enum {
     INFO_REQUEST_TIMER,
     RE_UPSTREAM_JOIN_TIMER,
     RE_ITR_RESOLUTION_TIMER,
-    REG_SITE_EXPRY_TIMER
+    REG_SITE_EXPRY_TIMER,
+    MAP_CACHE_MISS_TIMER,
+    MAP_CACHE_SNAPSHOT_TIMER,
+    MAP_REQUEST_BATCH_TIMER
 } timer_type;
 
 #define TIMER_NAME_LEN          64
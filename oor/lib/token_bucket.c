@@ -0,0 +1,79 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "token_bucket.h"
+#include "../defs.h"
+
+
+static void token_bucket_refill(token_bucket_t *tb);
+
+
+/* The bucket starts full */
+void
+token_bucket_init(token_bucket_t *tb, double rate, double burst)
+{
+    tb->rate = rate;
+    tb->burst = burst;
+    tb->tokens = burst;
+    clock_gettime(CLOCK_MONOTONIC, &tb->ts);
+}
+
+static void
+token_bucket_refill(token_bucket_t *tb)
+{
+    struct timespec now;
+    double elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (double)(now.tv_sec - tb->ts.tv_sec)
+            + 1.0e-9 * (now.tv_nsec - tb->ts.tv_nsec);
+    tb->ts = now;
+    tb->tokens += elapsed * tb->rate;
+    if (tb->tokens > tb->burst){
+        tb->tokens = tb->burst;
+    }
+}
+
+/* TRUE if an event would be allowed now. No token is consumed */
+int
+token_bucket_available(token_bucket_t *tb)
+{
+    token_bucket_refill(tb);
+    return (tb->tokens >= 1.0 ? TRUE : FALSE);
+}
+
+/* Consume a token. Returns FALSE if there is none and the event should be
+ * suppressed */
+int
+token_bucket_take(token_bucket_t *tb)
+{
+    token_bucket_refill(tb);
+    if (tb->tokens < 1.0){
+        return (FALSE);
+    }
+    tb->tokens -= 1.0;
+    return (TRUE);
+}
+
+/*
+ * Editor modelines
+ *
+ * vi: set shiftwidth=4 tabstop=4 expandtab:
+ * :indentSize=4:tabSize=4:noTabs=true:
+ */
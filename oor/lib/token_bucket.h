@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef TOKEN_BUCKET_H_
+#define TOKEN_BUCKET_H_
+
+#include <time.h>
+
+/*
+ * Token bucket rate limiter. Tokens are added at 'rate' per second up to
+ * 'burst' and each event consumes one.
+ */
+
+typedef struct token_bucket_ {
+    double rate;
+    double burst;
+    double tokens;
+    struct timespec ts;
+} token_bucket_t;
+
+void token_bucket_init(token_bucket_t *tb, double rate, double burst);
+int token_bucket_available(token_bucket_t *tb);
+int token_bucket_take(token_bucket_t *tb);
+
+#endif /* TOKEN_BUCKET_H_ */
@@ -60,11 +60,36 @@ time_elapsed(struct timespec *time_node)
     return(time_diff(time_node, &now));
 }
 
+/* Time after which the forwarding info of the node is obtained again */
+static inline double
+tnode_timeout(ttable_node_t *tn)
+{
+    return (tn->fi->temporal ? NEGATIVE_TIMEOUT : TIMEOUT);
+}
+
 static void
-ttable_node_del(ttable_node_t *tn)
+ttable_fi_del(void *fi)
+{
+    fwd_info_del((fwd_info_t *)fi,(fwd_info_data_del)fwd_entry_del);
+}
+
+/* Release the forwarding info fi of the table. While the table is held, it
+ * is kept until ttable_release, as it may still be in use */
+static void
+ttable_fi_release(ttable_t *tt, fwd_info_t *fi)
+{
+    if (tt->hold){
+        glist_add(fi, tt->held_fis);
+        return;
+    }
+    ttable_fi_del(fi);
+}
+
+static void
+ttable_node_del(ttable_t *tt, ttable_node_t *tn)
 {
     pkt_tuple_del(tn->tpl);
-    fwd_info_del(tn->fi,(fwd_info_data_del)fwd_entry_del);
+    ttable_fi_release(tt, tn->fi);
     free(tn);
 }
 
@@ -73,6 +98,8 @@ ttable_init(ttable_t *tt)
 {
     tt->htable =  kh_init(ttable);
     list_init(&tt->head_list);
+    tt->hold = 0;
+    tt->held_fis = glist_new_managed(ttable_fi_del);
 }
 
 void
@@ -80,12 +107,33 @@ ttable_uninit(ttable_t *tt)
 {
     khiter_t k;
 
+    tt->hold = 0;
     for (k = kh_begin(tt->htable); k != kh_end(tt->htable); ++k){
         if (kh_exist(tt->htable, k)){
-            ttable_node_del(kh_value(tt->htable,k));
+            ttable_node_del(tt, kh_value(tt->htable,k));
         }
     }
     kh_destroy(ttable, tt->htable);
+    glist_destroy(tt->held_fis);
+}
+
+/* Hold the table: the forwarding info returned by the lookups is not
+ * released, even if its entry is removed, until ttable_release is called.
+ * Used to process a burst of packets with the forwarding info obtained by
+ * previous lookups of the same burst */
+void
+ttable_hold(ttable_t *tt)
+{
+    tt->hold++;
+}
+
+void
+ttable_release(ttable_t *tt)
+{
+    if (--tt->hold > 0){
+        return;
+    }
+    glist_remove_all(tt->held_fis);
 }
 
 ttable_t *
@@ -146,10 +194,12 @@ ttable_insert(ttable_t *tt, packet_tuple_t *tpl, fwd_info_t *fi)
     node->fi = fi;
     node->tpl = tpl;
     clock_gettime(CLOCK_MONOTONIC, &node->ts);
+    node->last = node->ts;
 
     list_init(&node->list_elt);
     list_push_front(&tt->head_list, &node->list_elt);
 
+    ttable_tuple_set_hash(tpl);
     k = kh_put(ttable,tt->htable,tpl,&ret);
     kh_value(tt->htable, k) = node;
     OOR_LOG(LDBG_3,"ttable_insert: Inserted tupla: %s ", pkt_tuple_to_char(tpl));
@@ -161,6 +211,7 @@ ttable_remove(ttable_t *tt, packet_tuple_t *tpl)
     khiter_t k;
     ttable_node_t *tn;
 
+    ttable_tuple_set_hash(tpl);
     k = kh_get(ttable,tt->htable, tpl);
     if (k == kh_end(tt->htable)){
         return;
@@ -168,7 +219,7 @@ ttable_remove(ttable_t *tt, packet_tuple_t *tpl)
     tn = kh_value(tt->htable,k);
     OOR_LOG(LDBG_3,"ttable_remove: Remove tupla: %s ", pkt_tuple_to_char(tn->tpl));
     list_remove(&tn->list_elt);
-    ttable_node_del(tn);
+    ttable_node_del(tt, tn);
     kh_del(ttable,tt->htable,k);
 }
 
@@ -180,16 +231,55 @@ ttable_remove_with_khiter(ttable_t *tt, khiter_t k)
     node = kh_value(tt->htable,k);
     OOR_LOG(LDBG_3,"ttable_remove_with_khiter: Remove tupla: %s ", pkt_tuple_to_char(node->tpl));
     list_remove(&node->list_elt);
-    ttable_node_del(node);
+    ttable_node_del(tt, node);
     kh_del(ttable,tt->htable,k);
 }
 
+/* Remove the entries of the flows encapsulated from or to rloc. All the
+ * entries are removed if rloc is NULL. Returns the number of entries
+ * removed */
+int
+ttable_remove_with_rloc(ttable_t *tt, lisp_addr_t *rloc)
+{
+    khiter_t k;
+    fwd_entry_t *fe;
+    int removed = 0;
+
+    for (k = kh_begin(tt->htable); k != kh_end(tt->htable); ++k){
+        if (!kh_exist(tt->htable, k)){
+            continue;
+        }
+        if (rloc){
+            fe = kh_value(tt->htable,k)->fi->fwd_info;
+            if (!fe){
+                continue;
+            }
+            if ((!fe->srloc || lisp_addr_cmp(fe->srloc, rloc) != 0)
+                    && (!fe->drloc || lisp_addr_cmp(fe->drloc, rloc) != 0)){
+                continue;
+            }
+        }
+        ttable_remove_with_khiter(tt,k);
+        removed++;
+    }
+    return (removed);
+}
+
 fwd_info_t *
 ttable_lookup(ttable_t *tt, packet_tuple_t *tpl)
+{
+    ttable_tuple_set_hash(tpl);
+    return (ttable_lookup_hashed(tt, tpl));
+}
+
+/* Lookup of a tuple whose hash has already been set with
+ * ttable_tuple_set_hash */
+fwd_info_t *
+ttable_lookup_hashed(ttable_t *tt, packet_tuple_t *tpl)
 {
     ttable_node_t *tn;
     khiter_t k;
-    double elapsed;
+    struct timespec now;
 
     k = kh_get(ttable,tt->htable, tpl);
     if (k == kh_end(tt->htable)){
@@ -197,24 +287,80 @@ ttable_lookup(ttable_t *tt, packet_tuple_t *tpl)
     }
     tn = kh_value(tt->htable,k);
 
-    elapsed = time_elapsed(&tn->ts);
-    if (!tn->fi->temporal){
-        if (elapsed > TIMEOUT){
-            goto expired;
-        }
-    }else{
-        if (elapsed > NEGATIVE_TIMEOUT){
-            goto expired;
-        }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (time_diff(&tn->ts, &now) > tnode_timeout(tn)){
+        ttable_remove_with_khiter(tt, k);
+        return(NULL);
     }
 
+    tn->last = now;
     list_remove(&tn->list_elt);
     list_push_front(&tt->head_list, &tn->list_elt);
 
     return (tn->fi);
+}
 
-expired:
-    ttable_remove_with_khiter(tt, k);
-    return(NULL);
+/*
+ * Lookup of a tuple, whose hash has already been set, that takes into account
+ * the flowlets of the flow: bursts of packets separated by more than gap
+ * seconds. The entry of a flow idle for more than gap is removed, so the next
+ * flowlet may use a different RLOC. When the forwarding info of an active
+ * flowlet times out, the entry is kept and its forwarding info is returned
+ * in old_fi: the caller should obtain it again and replace it with
+ * ttable_renew. NULL is returned in both cases.
+ */
+fwd_info_t *
+ttable_lookup_flowlet(ttable_t *tt, packet_tuple_t *tpl, double gap,
+        fwd_info_t **old_fi)
+{
+    ttable_node_t *tn;
+    khiter_t k;
+    struct timespec now;
+
+    *old_fi = NULL;
+    k = kh_get(ttable,tt->htable, tpl);
+    if (k == kh_end(tt->htable)){
+        return (NULL);
+    }
+    tn = kh_value(tt->htable,k);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (time_diff(&tn->last, &now) > gap){
+        ttable_remove_with_khiter(tt, k);
+        return (NULL);
+    }
+    tn->last = now;
+    list_remove(&tn->list_elt);
+    list_push_front(&tt->head_list, &tn->list_elt);
+
+    if (time_diff(&tn->ts, &now) > tnode_timeout(tn)){
+        if (tn->fi->temporal){
+            ttable_remove_with_khiter(tt, k);
+        }else{
+            *old_fi = tn->fi;
+        }
+        return (NULL);
+    }
+
+    return (tn->fi);
+}
+
+/* Replace the forwarding info of the entry of the tuple, whose hash has
+ * already been set, with fi. The previous one is released */
+void
+ttable_renew(ttable_t *tt, packet_tuple_t *tpl, fwd_info_t *fi)
+{
+    ttable_node_t *tn;
+    khiter_t k;
+
+    k = kh_get(ttable,tt->htable, tpl);
+    if (k == kh_end(tt->htable)){
+        ttable_insert(tt, pkt_tuple_clone(tpl), fi);
+        return;
+    }
+    tn = kh_value(tt->htable,k);
+    ttable_fi_release(tt, tn->fi);
+    tn->fi = fi;
+    clock_gettime(CLOCK_MONOTONIC, &tn->ts);
 }
 
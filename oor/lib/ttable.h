@@ -21,6 +21,7 @@
 #define TTABLE_H_
 
 #include <time.h>
+#include "generic_list.h"
 #include "packets.h"
 #include "../elibs/khash/khash.h"
 #include "../elibs/ovs/list.h"
@@ -31,14 +32,21 @@ typedef struct ttable_node {
     struct ovs_list list_elt;
     packet_tuple_t *tpl;
     fwd_info_t *fi;
-    struct timespec ts;
+    struct timespec ts;     /* When fi was obtained */
+    struct timespec last;   /* Last packet of the flow */
 } ttable_node_t;
 
-KHASH_INIT(ttable, packet_tuple_t *, ttable_node_t *, 1, pkt_tuple_hash, pkt_tuple_cmp)
+/* The hash of the tuples is calculated once by the ttable functions and
+ * cached in the tuple, so it can be computed ahead of the lookup */
+#define ttable_tuple_hash(_tpl_) ((_tpl_)->hash)
+
+KHASH_INIT(ttable, packet_tuple_t *, ttable_node_t *, 1, ttable_tuple_hash, pkt_tuple_cmp)
 
 typedef struct ttable {
     khash_t(ttable) *htable;
     struct ovs_list head_list; /* To order flows */
+    int hold;               /* Keep the forwarding info of removed entries */
+    glist_t *held_fis;      /* Forwarding info kept until ttable_release */
 } ttable_t;
 
 void ttable_init(ttable_t *tt);
@@ -47,7 +55,37 @@ ttable_t *ttable_create();
 void ttable_destroy(ttable_t *tt);
 void ttable_insert(ttable_t *, packet_tuple_t *tpl, fwd_info_t *fe);
 void ttable_remove(ttable_t *tt, packet_tuple_t *tpl);
+int ttable_remove_with_rloc(ttable_t *tt, lisp_addr_t *rloc);
 fwd_info_t *ttable_lookup(ttable_t *tt, packet_tuple_t *tpl);
+fwd_info_t *ttable_lookup_hashed(ttable_t *tt, packet_tuple_t *tpl);
+fwd_info_t *ttable_lookup_flowlet(ttable_t *tt, packet_tuple_t *tpl,
+        double gap, fwd_info_t **old_fi);
+void ttable_renew(ttable_t *tt, packet_tuple_t *tpl, fwd_info_t *fi);
+void ttable_hold(ttable_t *tt);
+void ttable_release(ttable_t *tt);
+
+/* Set the hash of the tuple used to index the table */
+static inline void
+ttable_tuple_set_hash(packet_tuple_t *tpl)
+{
+    tpl->hash = pkt_tuple_hash(tpl);
+}
+
+/* Bring into the cache the bucket where a tuple with the given hash would
+ * be stored. Used to overlap the misses of a burst of lookups */
+static inline void
+ttable_prefetch(ttable_t *tt, uint32_t hash)
+{
+    khint_t i;
+
+    if (tt->htable->n_buckets == 0){
+        return;
+    }
+    i = hash & (tt->htable->n_buckets - 1);
+    prefetch(&tt->htable->flags[i >> 4]);
+    prefetch(&tt->htable->keys[i]);
+    prefetch(&tt->htable->vals[i]);
+}
 
 
 #endif /* TTABLE_H_ */
@@ -506,7 +506,8 @@ lisp_msg_create_buf()
 {
     lbuf_t* b;
 
-    b = lbuf_new_with_headroom(MAX_IP_PKT_LEN, MAX_LISP_MSG_ENCAP_LEN);
+    /* Control messages are received in these buffers as well */
+    b = lbuf_new_with_headroom(pkt_buf_conf.size, MAX_LISP_MSG_ENCAP_LEN);
     lbuf_reset_lisp(b);
     return(b);
 }
@@ -574,6 +575,35 @@ lisp_msg_mreq_create(lisp_addr_t *seid, glist_t *itr_rlocs, lisp_addr_t *deid)
     return(b);
 }
 
+/* Map-Request with one EID record for each address of deids */
+lbuf_t *
+lisp_msg_mreq_create_multi(lisp_addr_t *seid, glist_t *itr_rlocs, glist_t *deids)
+{
+    glist_entry_t *it;
+    lbuf_t *b;
+
+    if (glist_size(deids) == 0 || glist_size(deids) > MREQ_MAX_RECORDS) {
+        return(NULL);
+    }
+
+    b = lisp_msg_mreq_create(seid, itr_rlocs, glist_first_data(deids));
+    if (b == NULL) {
+        return(NULL);
+    }
+
+    glist_for_each_entry(it, deids) {
+        if (it == glist_first(deids)) {
+            continue;
+        }
+        if (lisp_msg_put_eid_rec(b, glist_entry_data(it)) == NULL) {
+            lbuf_del(b);
+            return(NULL);
+        }
+    }
+
+    return(b);
+}
+
 lbuf_t *
 lisp_msg_neg_mrep_create(lisp_addr_t *eid, int ttl, lisp_action_e ac,
         lisp_authoritative_e a, uint64_t nonce)
@@ -791,6 +821,32 @@ lisp_data_encap(lbuf_t *b, int lp, int rp, lisp_addr_t *la, lisp_addr_t *ra, uin
     return(lbuf_data(b));
 }
 
+/* Build in hdr the outer IP, UDP and LISP headers to encapsulate b. The
+ * packet to encapsulate is neither moved nor modified, so it doesn't need
+ * headroom. hdr should have room to push the headers */
+void *
+lisp_data_encap_hdr(lbuf_t *hdr, lbuf_t *b, int lp, int rp, lisp_addr_t *la,
+        lisp_addr_t *ra, uint32_t iid)
+{
+    int ttl = 0, tos = 0;
+
+    /* read ttl and tos */
+    ip_hdr_ttl_and_tos(lbuf_data(b), &ttl, &tos);
+
+    /* push lisp data hdr */
+    lisp_data_push_hdr(hdr, iid);
+
+    /* push outer UDP and IP */
+    if (pkt_push_udp_and_ip_sg(hdr, b, lp, rp, lisp_addr_ip(la),
+            lisp_addr_ip(ra)) != GOOD){
+        return (NULL);
+    }
+
+    ip_hdr_set_ttl_and_tos(lbuf_data(hdr), ttl, tos);
+
+    return(lbuf_data(hdr));
+}
+
 void *
 lisp_data_pull_hdr(lbuf_t *b)
 {
@@ -65,6 +65,7 @@ static inline void lisp_msg_destroy(lbuf_t *);
 static inline void *lisp_msg_hdr(lbuf_t *b);
 
 lbuf_t *lisp_msg_mreq_create(lisp_addr_t *, glist_t *, lisp_addr_t *);
+lbuf_t *lisp_msg_mreq_create_multi(lisp_addr_t *, glist_t *, glist_t *);
 lbuf_t *lisp_msg_neg_mrep_create(lisp_addr_t *, int, lisp_action_e,
         lisp_authoritative_e, uint64_t);
 lbuf_t *lisp_msg_inf_req_create(mapping_t *m, lisp_key_type_e keyid);
@@ -87,6 +88,8 @@ void *lisp_msg_pull_auth_field(lbuf_t *b);
 void *lisp_data_push_hdr(lbuf_t *b, uint32_t iid);
 void *lisp_data_pull_hdr(lbuf_t *b);
 void *lisp_data_encap(lbuf_t *, int, int, lisp_addr_t *, lisp_addr_t *, uint32_t);
+void *lisp_data_encap_hdr(lbuf_t *hdr, lbuf_t *b, int lp, int rp,
+        lisp_addr_t *la, lisp_addr_t *ra, uint32_t iid);
 
 static inline glist_t *laddr_list_new();
 static inline void laddr_list_init(glist_t *);
@@ -27,6 +27,43 @@ lisp_data_hdr_get_iid(lisp_data_hdr_t *hdr)
     return (pkt_get_uint32_from_3bytes(hdr->iid));
 }
 
+uint32_t
+lisp_data_hdr_get_nonce(lisp_data_hdr_t *hdr)
+{
+    return (pkt_get_uint32_from_3bytes(hdr->nonce));
+}
+
+/* Set the nonce of the header. With echo_req the remote end is asked to
+ * echo it (E bit) */
+void
+lisp_data_hdr_set_nonce(lisp_data_hdr_t *hdr, uint32_t nonce, uint8_t echo_req)
+{
+    hdr->nonce_present = 1;
+    hdr->echo_nonce = echo_req ? 1 : 0;
+    pkt_add_uint32_in_3bytes(hdr->nonce, nonce);
+}
+
+/* The Locator-Status-Bits use the last 8 bits of the header when it carries
+ * an instance ID and the last 32 bits otherwise */
+uint32_t
+lisp_data_hdr_get_lsb(lisp_data_hdr_t *hdr)
+{
+    if (hdr->instance_id){
+        return (hdr->lsb_bits);
+    }
+    return ((pkt_get_uint32_from_3bytes(hdr->iid) << 8) | hdr->lsb_bits);
+}
+
+void
+lisp_data_hdr_set_lsb(lisp_data_hdr_t *hdr, uint32_t lsb)
+{
+    hdr->lsb = 1;
+    if (!hdr->instance_id){
+        pkt_add_uint32_in_3bytes(hdr->iid, lsb >> 8);
+    }
+    hdr->lsb_bits = lsb & 0xff;
+}
+
 void
 lisp_data_hdr_init(lisp_data_hdr_t *lhdr, uint32_t iid)
 {
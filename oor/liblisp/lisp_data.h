@@ -47,10 +47,18 @@
  } lisp_data_hdr_t;
 
 uint32_t lisp_data_hdr_get_iid(lisp_data_hdr_t *hdr);
+uint32_t lisp_data_hdr_get_nonce(lisp_data_hdr_t *hdr);
+void lisp_data_hdr_set_nonce(lisp_data_hdr_t *hdr, uint32_t nonce,
+        uint8_t echo_req);
+uint32_t lisp_data_hdr_get_lsb(lisp_data_hdr_t *hdr);
+void lisp_data_hdr_set_lsb(lisp_data_hdr_t *hdr, uint32_t lsb);
 
 void lisp_data_hdr_init(lisp_data_hdr_t *lhdr, uint32_t iid);
 
 #define LISPDATA_HDR_CAST(h_) ((lisp_data_hdr_t *)(h_))
 #define LDHDR_LSB_BIT(h_) (LISPDATA_HDR_CAST((h_)))->instance_id
+#define LDHDR_N_BIT(h_) (LISPDATA_HDR_CAST((h_)))->nonce_present
+#define LDHDR_E_BIT(h_) (LISPDATA_HDR_CAST((h_)))->echo_nonce
+#define LDHDR_L_BIT(h_) (LISPDATA_HDR_CAST((h_)))->lsb
 
 #endif /* LISP_DATA_H_ */
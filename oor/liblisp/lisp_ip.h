@@ -27,6 +27,7 @@
 #include <netinet/ip6.h>
 #include <netinet/ip.h>
 #include <stdint.h>
+#include <string.h>
 
 /*
  * Maximum length (in bytes) of an IP address
@@ -79,6 +80,26 @@ int ip_addr_cmp(ip_addr_t *ip1, ip_addr_t *ip2);
 uint8_t ip_addr_afi_to_default_mask(ip_addr_t *ip);
 char *ip_addr_to_char (ip_addr_t *addr);
 
+/* Hash and equality of addresses for the tables indexed by RLOC */
+static inline uint32_t
+ip_addr_hash(ip_addr_t *ip)
+{
+    uint32_t *w = (uint32_t *)&ip->addr;
+
+    if (ip->afi == AF_INET){
+        return (w[0]);
+    }
+    return (w[0] ^ w[1] ^ w[2] ^ w[3]);
+}
+
+static inline int
+ip_addr_equal(ip_addr_t *a, ip_addr_t *b)
+{
+    return (a->afi == b->afi && memcmp(&a->addr, &b->addr,
+            (a->afi == AF_INET) ? sizeof(struct in_addr)
+                    : sizeof(struct in6_addr)) == 0);
+}
+
 /*
  * ip_prefix_t functions
  */
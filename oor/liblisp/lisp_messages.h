@@ -191,6 +191,9 @@ char *map_request_hdr_to_char(map_request_hdr_t *h);
 #define MREQ_SMR(h_) (MREQ_HDR_CAST(h_))->solicit_map_request
 #define MREQ_SMR_INVOKED(h_) (MREQ_HDR_CAST(h_))->smr_invoked
 
+/* Limited by the size of the record count field */
+#define MREQ_MAX_RECORDS    255
+
 
 
 
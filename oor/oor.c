@@ -42,8 +42,13 @@
 #include "control/lisp_ms.h"
 #include "data-plane/data-plane.h"
 #include "lib/oor_log.h"
+#include "lib/echo_nonce.h"
+#include "lib/flowlet.h"
 #include "lib/nonces_table.h"
 #include "lib/pointers_table.h"
+#include "lib/pmtu.h"
+#include "lib/reencap.h"
+#include "lib/rloc_lsb.h"
 #include "lib/sockets.h"
 #include "lib/timers.h"
 #include "lib/routing_tables_lib.h"
@@ -92,6 +97,11 @@ oor_api_connection_t oor_api_connection;
 
 htable_nonces_t *nonces_ht;
 htable_ptrs_t *ptrs_to_timers_ht;
+echo_nonce_table_t *echo_nonces;
+rloc_lsb_table_t *rloc_lsbs;
+flowlet_table_t *flowlets;
+pmtu_table_t *pmtus;
+reencap_table_t *reencaps;
 
 /**************************** FUNCTION DECLARATION ***************************/
 /* Check if oor is already running: /var/run/oor.pid */
@@ -274,6 +284,23 @@ exit_cleanup(void) {
 
     htable_ptrs_destroy(ptrs_to_timers_ht);
     htable_nonces_destroy(nonces_ht);
+    if (echo_nonces){
+        echo_nonce_stats_dump(echo_nonces, LDBG_1);
+        echo_nonce_table_del(echo_nonces);
+    }
+    rloc_lsb_table_del(rloc_lsbs);
+    if (flowlets){
+        flowlet_stats_dump(flowlets, LDBG_1);
+        flowlet_table_del(flowlets);
+    }
+    if (pmtus){
+        pmtu_stats_dump(pmtus, LDBG_1);
+        pmtu_table_del(pmtus);
+    }
+    if (reencaps){
+        reencap_stats_dump(reencaps, LDBG_1);
+        reencap_table_del(reencaps);
+    }
 
     close_log_file();
 #ifndef VPNAPI
@@ -432,6 +459,7 @@ initial_setup()
     /* Initialize hash table that control timers */
     nonces_ht = htable_nonces_new();
     ptrs_to_timers_ht = htable_ptrs_new();
+    rloc_lsbs = rloc_lsb_table_new();
 }
 
 #ifndef VPNAPI
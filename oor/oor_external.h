@@ -35,6 +35,15 @@ extern data_plane_struct_t *data_plane;
 extern void exit_cleanup();
 extern htable_nonces_t *nonces_ht;
 extern htable_ptrs_t *ptrs_to_timers_ht;
+/* NULL if the echo-nonce algorithm is not used */
+extern echo_nonce_table_t *echo_nonces;
+extern rloc_lsb_table_t *rloc_lsbs;
+/* NULL if flowlets are not used */
+extern flowlet_table_t *flowlets;
+/* NULL if the device doesn't encapsulate */
+extern pmtu_table_t *pmtus;
+/* NULL if the RTR doesn't use the re-encapsulation cache */
+extern reencap_table_t *reencaps;
 
 #endif /*OOR_EXTERNAL_H_*/
 
@@ -0,0 +1,416 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Check of the checksum routines of oor/lib/cksum.c against the 16 bit
+ * reference loops of RFC 1071 over random buffers, lengths and alignments.
+ * With -b, the routines are also benchmarked against the reference.
+ *
+ * The module is included to reach the scalar and vector implementations,
+ * which are static.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../oor/lib/cksum.c"
+
+#define MAX_LEN     9216
+#define ALIGNS      8
+#define ROUNDS      20000
+
+int debug_level = 0;
+
+void
+llog(int oor_log_level, const char *format, ...)
+{
+}
+
+typedef struct cksum_impl_ {
+    const char *name;
+    cksum_add_fct fct;
+} cksum_impl_t;
+
+static cksum_impl_t impls[] = {
+    { "scalar", cksum_add_scalar },
+#ifdef CKSUM_AVX2
+    { "avx2", cksum_add_avx2 },
+#endif
+#ifdef CKSUM_NEON
+    { "neon", cksum_add_neon },
+#endif
+};
+
+#define NIMPLS (int)(sizeof(impls) / sizeof(impls[0]))
+
+static int failures = 0;
+
+
+/* Reference implementations: 16 bit words added to a 32 bit accumulator */
+
+static uint32_t
+ref_add(const void *buf, int len, uint32_t sum)
+{
+    const uint8_t *p = buf;
+    uint16_t w;
+
+    while (len > 1) {
+        memcpy(&w, p, 2);
+        sum += w;
+        if (sum & 0x80000000)
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, p, 1);
+        sum += w;
+    }
+    return (sum);
+}
+
+static uint16_t
+ref_fold(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ((uint16_t) sum);
+}
+
+static uint16_t
+ref_ip_checksum(const void *buf, int len)
+{
+    return ((uint16_t) ~ref_fold(ref_add(buf, len, 0)));
+}
+
+static uint16_t
+ref_udp_checksum(struct udphdr *udph, int udp_len, void *iphdr, int afi)
+{
+    struct ip *iph = iphdr;
+    struct ip6_hdr *ip6h = iphdr;
+    uint32_t sum;
+
+    if (afi == AF_INET) {
+        sum = ref_add(&iph->ip_src, 2 * sizeof(struct in_addr), 0);
+        sum += htons(IPPROTO_UDP);
+        sum += htons(udp_len);
+    } else {
+        sum = ref_add(&ip6h->ip6_src, 2 * sizeof(struct in6_addr), 0);
+        sum += htons(udp_len >> 16) + htons(udp_len & 0xFFFF);
+        sum += htons(IPPROTO_UDP);
+    }
+    return ((uint16_t) ~ref_fold(ref_add(udph, udp_len, sum)));
+}
+
+
+static void
+fill_random(uint8_t *buf, int len)
+{
+    int i;
+
+    if (len <= 0) {
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        buf[i] = random();
+    }
+    /* Runs of 0xFF stress the carries */
+    if (random() % 4 == 0) {
+        memset(buf, 0xFF, len);
+    }
+}
+
+/* Random length biased towards short buffers and odd tails */
+static int
+random_len(void)
+{
+    switch (random() % 4) {
+    case 0:
+        return (random() % 64);
+    case 1:
+        return (random() % 1600);
+    case 2:
+        return ((random() % (MAX_LEN / 2)) * 2 + 1);
+    default:
+        return (random() % MAX_LEN);
+    }
+}
+
+static void
+check(int ok, const char *what, int len, int align)
+{
+    if (ok) {
+        return;
+    }
+    if (failures++ < 10) {
+        printf("FAIL: %s (len %d, align %d)\n", what, len, align);
+    }
+}
+
+static void
+check_partial(uint8_t *buf, int len, int align)
+{
+    uint16_t ref;
+    int i, split;
+
+    ref = ref_fold(ref_add(buf, len, 0));
+
+    for (i = 0; i < NIMPLS; i++) {
+        check(cksum_fold(impls[i].fct(buf, len, 0)) == ref, impls[i].name,
+                len, align);
+    }
+    check(cksum_fold(cksum_partial(buf, len, 0)) == ref, "cksum_partial", len,
+            align);
+
+    /* Consecutive partial sums must start at even offsets */
+    split = len ? (random() % len) & ~1 : 0;
+    check(cksum_fold(cksum_partial(buf + split, len - split,
+            cksum_partial(buf, split, 0))) == ref, "split cksum_partial", len,
+            align);
+
+    check(ip_checksum((uint16_t *)buf, len) == ref_ip_checksum(buf, len),
+            "ip_checksum", len, align);
+}
+
+static void
+check_copy(uint8_t *buf, int len, int align)
+{
+    static uint8_t dst[MAX_LEN + ALIGNS];
+    uint8_t *d = dst + random() % ALIGNS;
+    uint16_t ref;
+
+    ref = ref_fold(ref_add(buf, len, 0));
+    memset(d, 0, len);
+    check(cksum_fold(cksum_copy_partial(d, buf, len, 0)) == ref,
+            "cksum_copy_partial sum", len, align);
+    check(memcmp(d, buf, len) == 0, "cksum_copy_partial copy", len, align);
+}
+
+static void
+check_update(uint8_t *buf, int len, int align)
+{
+    uint8_t old[16];
+    uint16_t cksum, old16, new16;
+    uint32_t old32, new32;
+    int off, flen;
+
+    if (len < 16) {
+        return;
+    }
+    cksum = ref_ip_checksum(buf, len);
+
+    /* Rewrite an even aligned field of 2, 4 or 16 bytes */
+    off = (random() % (len - 15)) & ~1;
+    switch (random() % 3) {
+    case 0:
+        flen = 2;
+        memcpy(&old16, buf + off, 2);
+        new16 = random();
+        memcpy(buf + off, &new16, 2);
+        cksum = cksum_update16(cksum, old16, new16);
+        break;
+    case 1:
+        flen = 4;
+        memcpy(&old32, buf + off, 4);
+        new32 = random();
+        memcpy(buf + off, &new32, 4);
+        cksum = cksum_update32(cksum, old32, new32);
+        break;
+    default:
+        flen = 16;
+        memcpy(old, buf + off, 16);
+        fill_random(buf + off, 16);
+        cksum = cksum_update_buf(cksum, old, buf + off, 16);
+        break;
+    }
+
+    /* The data plus its checksum adds up to ~0 */
+    check(ref_fold(ref_add(buf, len, cksum)) == 0xFFFF,
+            flen == 2 ? "cksum_update16" : flen == 4 ? "cksum_update32"
+                    : "cksum_update_buf", len, align);
+}
+
+static void
+check_udp(uint8_t *buf, int len, int align)
+{
+    static uint8_t pay[MAX_LEN + ALIGNS];
+    uint8_t hdr[sizeof(struct ip6_hdr)];
+    struct udphdr *udph = (struct udphdr *)buf;
+    int afi, hlen, plen;
+    uint16_t ref;
+
+    if (len < sizeof(struct udphdr)) {
+        return;
+    }
+    afi = random() % 2 ? AF_INET : AF_INET6;
+    fill_random(hdr, sizeof(hdr));
+    ((struct ip *)hdr)->ip_v = afi == AF_INET ? IPVERSION : 6;
+    ref = ref_udp_checksum(udph, len, hdr, afi);
+
+    check(udp_checksum(udph, len, hdr, afi) == ref, "udp_checksum", len,
+            align);
+
+    /* Headers of even length in buf and the rest in another buffer */
+    hlen = sizeof(struct udphdr)
+            + ((random() % (len - sizeof(struct udphdr) + 1)) & ~1);
+    plen = len - hlen;
+    check(udp_checksum_sg(udph, hlen, buf + hlen, plen, hdr, afi) == ref,
+            "udp_checksum_sg", len, align);
+
+    plen = len - sizeof(struct udphdr);
+    memcpy(pay, buf + sizeof(struct udphdr), plen);
+    memset(buf + sizeof(struct udphdr), 0, plen);
+    check(udp_copy_and_checksum(udph, pay, plen, hdr, afi) == ref,
+            "udp_copy_and_checksum", len, align);
+}
+
+static void
+run_checks(int rounds)
+{
+    static uint8_t mem[MAX_LEN + ALIGNS];
+    uint8_t *buf;
+    int r, len, align;
+
+    for (r = 0; r < rounds; r++) {
+        len = random_len();
+        align = random() % ALIGNS;
+        buf = mem + align;
+        fill_random(buf, len);
+
+        check_partial(buf, len, align);
+        check_copy(buf, len, align);
+        check_update(buf, len, align);
+        check_udp(buf, len, align);
+    }
+}
+
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+static void
+bench_result(const char *name, int len, long iters, double t)
+{
+    printf("  %-20s %8.1f ns %8.2f GB/s\n", name, t * 1e9 / iters,
+            (double)len * iters / t / 1e9);
+}
+
+static void
+run_bench(void)
+{
+    static uint8_t src[MAX_LEN], dst[MAX_LEN];
+    static const int lens[] = { 20, 64, 256, 576, 1500, 9000 };
+    volatile uint64_t sink = 0;
+    long i, iters;
+    double t;
+    int l, m, len;
+
+    fill_random(src, sizeof(src));
+    for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        len = lens[l];
+        iters = 200000000L / (len + 32);
+        printf("%d bytes:\n", len);
+
+        t = now();
+        for (i = 0; i < iters; i++) {
+            sink += ref_add(src, len, 0);
+        }
+        bench_result("reference", len, iters, now() - t);
+
+        for (m = 0; m < NIMPLS; m++) {
+            t = now();
+            for (i = 0; i < iters; i++) {
+                sink += impls[m].fct(src, len, 0);
+            }
+            bench_result(impls[m].name, len, iters, now() - t);
+        }
+
+        t = now();
+        for (i = 0; i < iters; i++) {
+            sink += cksum_partial(src, len, 0);
+        }
+        bench_result("cksum_partial", len, iters, now() - t);
+
+        t = now();
+        for (i = 0; i < iters; i++) {
+            memcpy(dst, src, len);
+            sink += ref_add(dst, len, 0);
+        }
+        bench_result("memcpy + reference", len, iters, now() - t);
+
+        t = now();
+        for (i = 0; i < iters; i++) {
+            sink += cksum_copy_partial(dst, src, len, 0);
+        }
+        bench_result("cksum_copy_partial", len, iters, now() - t);
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+    unsigned int seed = time(NULL);
+    int rounds = ROUNDS, bench = 0, opt;
+
+    while ((opt = getopt(argc, argv, "bn:s:")) != -1) {
+        switch (opt) {
+        case 'b':
+            bench = 1;
+            break;
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            printf("Usage: %s [-b] [-n rounds] [-s seed]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    srandom(seed);
+    run_checks(rounds);
+    printf("%d rounds with seed %u, implementations:", rounds, seed);
+    for (opt = 0; opt < NIMPLS; opt++) {
+        printf(" %s", impls[opt].name);
+    }
+    printf(" -> %d failures\n", failures);
+    if (failures) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (bench) {
+        run_bench();
+    }
+    return (0);
+}
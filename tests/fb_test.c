@@ -0,0 +1,176 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Flow disruption of the Maglev lookup tables of flow balancing
+ * (oor/fwd_policies/flow_balancing). For each change of a set of locators,
+ * the slots of the table, i.e. the flows, that move to another locator are
+ * counted and reported. Only the flows of the locator that goes down, or
+ * the share of the one that comes up, should move: 1/N of them.
+ *
+ * The old table is compared after its locators are released, as it
+ * happens when a map cache entry is refreshed.
+ *
+ * The module is included to reach the lookup table functions, which are
+ * static.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../oor/fwd_policies/flow_balancing/flow_balancing.c"
+
+#define MAX_N       16
+/* Slots of the locators that don't change that may move, in % */
+#define MAX_STRAY   4
+
+static int failures = 0;
+
+
+static void
+test_addr(int i, lisp_addr_t *addr)
+{
+    char str[32];
+
+    sprintf(str, "192.0.2.%d", i + 1);
+    lisp_addr_ip_from_char(str, addr);
+}
+
+static locator_t *
+test_locator(int i, int weight)
+{
+    lisp_addr_t addr;
+
+    test_addr(i, &addr);
+    return (locator_new_init(&addr, UP, 1, 1, 1, weight, 255, 0));
+}
+
+static void
+test_locators_del(locator_t **locators)
+{
+    int i;
+
+    for (i = 0; locators[i] != NULL; i++) {
+        locator_del(locators[i]);
+    }
+}
+
+/* Count the slots of old whose locator changes in new: the ones of changed,
+ * the locator that goes down or comes up, and the rest */
+static void
+test_compare(fb_lookup_table *old, fb_lookup_table *new,
+        lisp_addr_t *changed, const char *what, int n)
+{
+    int i, own = 0, stray = 0, pct;
+
+    for (i = 0; i < new->size; i++) {
+        if (lisp_addr_cmp(old->addrs[old->table[i]],
+                new->addrs[new->table[i]]) == 0) {
+            continue;
+        }
+        if (lisp_addr_cmp(old->addrs[old->table[i]], changed) == 0
+                || lisp_addr_cmp(new->addrs[new->table[i]], changed) == 0) {
+            own++;
+        } else {
+            stray++;
+        }
+    }
+    pct = fb_lookup_table_moved(old, new);
+
+    printf("%-28s N=%2d: %5.1f%% of the flows moved (ideal %5.1f%%), "
+            "%d of %d slots of other locators\n", what, n,
+            (own + stray) * 100.0 / new->size, 100.0 / n, stray, new->size);
+    if (pct != (own + stray) * 100 / new->size) {
+        printf("FAIL: fb_lookup_table_moved reports %d%%\n", pct);
+        failures++;
+    }
+    if (stray * 100 > MAX_STRAY * new->size) {
+        printf("FAIL: too many flows of other locators moved\n");
+        failures++;
+    }
+}
+
+/* Build the table of n locators and the one after changing the locator k,
+ * releasing the locators in between. Locators with weight 0 are down */
+static void
+test_change(fb_dev_parm *dev_parm, int n, int k, int *old_w, int *new_w,
+        const char *what)
+{
+    locator_t *locators[MAX_N + 1];
+    fb_lookup_table *old, *new;
+    lisp_addr_t changed;
+    int i, j;
+
+    for (i = 0, j = 0; i < n; i++) {
+        if (old_w[i]) {
+            locators[j++] = test_locator(i, old_w[i]);
+        }
+    }
+    locators[j] = NULL;
+    old = fb_lookup_table_new(dev_parm, locators, n, TRUE);
+    test_locators_del(locators);
+
+    for (i = 0, j = 0; i < n; i++) {
+        if (new_w[i]) {
+            locators[j++] = test_locator(i, new_w[i]);
+        }
+    }
+    locators[j] = NULL;
+    new = fb_lookup_table_new(dev_parm, locators, n, TRUE);
+    test_locators_del(locators);
+
+    test_addr(k, &changed);
+    test_compare(old, new, &changed, what, n);
+
+    fb_lookup_table_del(old);
+    fb_lookup_table_del(new);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    fb_dev_parm *dev_parm;
+    int old_w[MAX_N], new_w[MAX_N];
+    int n, i, k;
+
+    dev_parm = fb_dev_parm_new();
+    dev_parm->loc_loct = glist_new();
+
+    for (n = 2; n <= MAX_N; n++) {
+        k = n / 2;
+        for (i = 0; i < n; i++) {
+            old_w[i] = new_w[i] = 1;
+        }
+
+        new_w[k] = 0;
+        test_change(dev_parm, n, k, old_w, new_w, "Locator goes down");
+        test_change(dev_parm, n, k, new_w, old_w, "Locator comes up");
+
+        new_w[k] = 2;
+        test_change(dev_parm, n, k, old_w, new_w, "Locator doubles its weight");
+    }
+
+    glist_destroy(dev_parm->loc_loct);
+    fb_dev_parm_del(dev_parm);
+
+    printf("%d failures\n", failures);
+    return (failures ? EXIT_FAILURE : 0);
+}
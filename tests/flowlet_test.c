@@ -0,0 +1,212 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Balance of the bytes sent to each RLOC with flowlets
+ * (oor/lib/flowlet.c) against per-flow hashing. A few elephant flows and
+ * many mice are interleaved. With hashing, each flow stays on the RLOC of
+ * its hash. With flowlets, each burst of a flow is placed by
+ * flowlet_select and its packets are accounted with flowlet_account.
+ *
+ * The imbalance is the largest deviation of the share of bytes of an RLOC
+ * from its share of the weights. The traffic is sent in a few ms, so the
+ * decay of the load of the RLOCs doesn't play a role.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../oor/lib/flowlet.h"
+#include "../oor/liblisp/lisp_address.h"
+
+#define MAX_RLOCS       4
+#define ELEPHANTS       4
+#define MICE            400
+#define ROUNDS          200
+/* Largest imbalance accepted with flowlets, in % */
+#define MAX_IMBALANCE   2.0
+
+typedef struct test_flow_ {
+    uint32_t hash;
+    /* Packets and packet size of each flowlet */
+    int pkts;
+    int size;
+    /* Flowlets left */
+    int flowlets;
+} test_flow_t;
+
+static int failures = 0;
+
+
+static double
+test_imbalance(uint64_t *bytes, int *weights, int n)
+{
+    uint64_t total = 0;
+    double dev, max_dev = 0;
+    int i, wtotal = 0;
+
+    for (i = 0; i < n; i++) {
+        total += bytes[i];
+        wtotal += weights[i];
+    }
+    for (i = 0; i < n; i++) {
+        dev = 100.0 * bytes[i] / total - 100.0 * weights[i] / wtotal;
+        if (dev < 0) {
+            dev = -dev;
+        }
+        if (dev > max_dev) {
+            max_dev = dev;
+        }
+    }
+    return (max_dev);
+}
+
+/* RLOC of a flow with per-flow hashing: buckets in proportion to the
+ * weights */
+static int
+test_hash_rloc(uint32_t hash, int *weights, int n)
+{
+    int i, wtotal = 0, bucket;
+
+    for (i = 0; i < n; i++) {
+        wtotal += weights[i];
+    }
+    bucket = hash % wtotal;
+    for (i = 0; i < n; i++) {
+        if (bucket < weights[i]) {
+            return (i);
+        }
+        bucket -= weights[i];
+    }
+    return (n - 1);
+}
+
+static void
+test_flows_init(test_flow_t *flows)
+{
+    int i;
+
+    for (i = 0; i < ELEPHANTS + MICE; i++) {
+        flows[i].hash = random();
+        if (i < ELEPHANTS) {
+            flows[i].pkts = 20 + random() % 80;
+            flows[i].size = 1500;
+            flows[i].flowlets = ROUNDS;
+        } else {
+            flows[i].pkts = 1 + random() % 10;
+            flows[i].size = 64 + random() % 1400;
+            flows[i].flowlets = 1 + random() % 3;
+        }
+    }
+}
+
+static void
+test_run(const char *name, int *weights, int n, unsigned int seed)
+{
+    test_flow_t flows[ELEPHANTS + MICE];
+    uint64_t hash_bytes[MAX_RLOCS] = { 0 }, fl_bytes[MAX_RLOCS] = { 0 };
+    lisp_addr_t rlocs[MAX_RLOCS], srloc;
+    flowlet_table_t *tbl;
+    fwd_entry_t *fe;
+    double hash_imb, fl_imb;
+    char str[32];
+    int i, j, f, r, active;
+
+    for (i = 0; i < n; i++) {
+        sprintf(str, "192.0.2.%d", i + 1);
+        lisp_addr_ip_from_char(str, &rlocs[i]);
+    }
+    lisp_addr_ip_from_char("198.51.100.1", &srloc);
+    tbl = flowlet_table_new(0.05);
+
+    srandom(seed);
+    test_flows_init(flows);
+    do {
+        active = 0;
+        for (f = 0; f < ELEPHANTS + MICE; f++) {
+            if (flows[f].flowlets == 0) {
+                continue;
+            }
+            active++;
+            flows[f].flowlets--;
+
+            /* The forwarding policy hashes the flow, flowlets may move it */
+            r = test_hash_rloc(flows[f].hash, weights, n);
+            hash_bytes[r] += (uint64_t)flows[f].pkts * flows[f].size;
+
+            fe = fwd_entry_new_init(&srloc, &rlocs[r], 0, NULL);
+            for (i = 0; i < n; i++) {
+                fwd_entry_add_alt_drloc(fe, &rlocs[i], weights[i]);
+            }
+            flowlet_select(tbl, fe, NULL);
+            for (i = 0; i < n; i++) {
+                if (lisp_addr_cmp(fe->drloc, &rlocs[i]) == 0) {
+                    break;
+                }
+            }
+            for (j = 0; j < flows[f].pkts; j++) {
+                flowlet_account(tbl, lisp_addr_ip(fe->drloc), flows[f].size);
+                fl_bytes[i] += flows[f].size;
+            }
+            fwd_entry_del(fe);
+        }
+    } while (active > 0);
+
+    hash_imb = test_imbalance(hash_bytes, weights, n);
+    fl_imb = test_imbalance(fl_bytes, weights, n);
+    printf("%-24s bytes per RLOC (hashing / flowlets):", name);
+    for (i = 0; i < n; i++) {
+        printf(" %.1f/%.1f MB", hash_bytes[i] / 1e6, fl_bytes[i] / 1e6);
+    }
+    printf("\n%-24s imbalance: hashing %.1f%%, flowlets %.1f%% "
+            "(%"PRIu64" flowlets, %"PRIu64" moved)\n", "", hash_imb, fl_imb,
+            tbl->stats.flowlets, tbl->stats.moved);
+
+    if (fl_imb > MAX_IMBALANCE) {
+        printf("FAIL: imbalance with flowlets above %.1f%%\n", MAX_IMBALANCE);
+        failures++;
+    }
+    if (fl_imb > hash_imb) {
+        printf("FAIL: flowlets balance worse than hashing\n");
+        failures++;
+    }
+    flowlet_table_del(tbl);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int equal[] = { 1, 1, 1, 1 };
+    int weighted[] = { 1, 1, 2 };
+    unsigned int seed = 1;
+
+    if (argc > 1) {
+        seed = strtoul(argv[1], NULL, 0);
+    }
+
+    test_run("2 RLOCs", equal, 2, seed);
+    test_run("4 RLOCs", equal, 4, seed);
+    test_run("3 RLOCs, weights 1 1 2", weighted, 3, seed);
+
+    printf("%d failures\n", failures);
+    return (failures ? EXIT_FAILURE : 0);
+}
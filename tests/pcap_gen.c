@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Synthetic capture for the benchmark of the output path with the pcap data
+ * plane. Writes IPv4/UDP packets from the EIDs 10.0.1.0/24 to the EIDs
+ * 10.0.2.0/24 (raw IP link type), 1 us apart, spread round robin over a
+ * number of flows.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#define LINKTYPE_RAW    101
+#define MAX_SIZE        1500
+
+typedef struct pcap_hdr_ {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+} pcap_hdr_t;
+
+typedef struct pcap_rec_ {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_rec_t;
+
+
+static uint16_t
+ip_cksum(void *buf, int len)
+{
+    uint16_t *p = buf;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2) {
+        sum += *p++;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ((uint16_t) ~sum);
+}
+
+int
+main(int argc, char **argv)
+{
+    static uint8_t pkt[MAX_SIZE];
+    struct ip *iph = (struct ip *)pkt;
+    struct udphdr *udph = (struct udphdr *)(pkt + sizeof(struct ip));
+    pcap_hdr_t hdr;
+    pcap_rec_t rec;
+    FILE *fp;
+    long i, npkts = 100000;
+    int flows = 1000, size = 512, flow, opt;
+
+    while ((opt = getopt(argc, argv, "n:f:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            npkts = atol(optarg);
+            break;
+        case 'f':
+            flows = atoi(optarg);
+            break;
+        case 's':
+            size = atoi(optarg);
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || flows <= 0
+            || size < (int)(sizeof(struct ip) + sizeof(struct udphdr))
+            || size > MAX_SIZE) {
+        printf("Usage: %s [-n packets] [-f flows] [-s size] file\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if ((fp = fopen(argv[optind], "w")) == NULL) {
+        perror(argv[optind]);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = 0xa1b2c3d4;
+    hdr.version_major = 2;
+    hdr.version_minor = 4;
+    hdr.snaplen = 65535;
+    hdr.network = LINKTYPE_RAW;
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+
+    for (i = 0; i < npkts; i++) {
+        flow = i % flows;
+        memset(pkt, 0, size);
+        iph->ip_v = IPVERSION;
+        iph->ip_hl = sizeof(struct ip) >> 2;
+        iph->ip_len = htons(size);
+        iph->ip_id = htons(i);
+        iph->ip_ttl = 64;
+        iph->ip_p = IPPROTO_UDP;
+        iph->ip_src.s_addr = htonl(0x0A000100 | (1 + flow % 250));
+        iph->ip_dst.s_addr = htonl(0x0A000200 | (1 + (flow / 250) % 250));
+        iph->ip_sum = ip_cksum(iph, sizeof(struct ip));
+        udph->uh_sport = htons(1024 + flow);
+        udph->uh_dport = htons(9);
+        udph->uh_ulen = htons(size - sizeof(struct ip));
+
+        rec.ts_sec = 1000000 + i / 1000000;
+        rec.ts_usec = i % 1000000;
+        rec.incl_len = rec.orig_len = size;
+        fwrite(&rec, sizeof(rec), 1, fp);
+        fwrite(pkt, size, 1, fp);
+    }
+    fclose(fp);
+    return (0);
+}
@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Global state of oor.c for the test programs linked with liboor.a, which
+ * contains everything but oor.c. The tests set the parts they use.
+ */
+
+
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "../oor/oor_external.h"
+#include "../oor/oor.h"
+
+char *config_file = NULL;
+int debug_level = -1;
+int default_rloc_afi = AF_UNSPEC;
+int daemonize = FALSE;
+
+int ipv4_data_input_fd = -1;
+int ipv6_data_input_fd = -1;
+int netlink_fd = -1;
+
+sockmstr_t *smaster = NULL;
+oor_ctrl_dev_t *ctrl_dev;
+oor_ctrl_t *lctrl;
+
+htable_nonces_t *nonces_ht;
+htable_ptrs_t *ptrs_to_timers_ht;
+echo_nonce_table_t *echo_nonces;
+rloc_lsb_table_t *rloc_lsbs;
+flowlet_table_t *flowlets;
+pmtu_table_t *pmtus;
+reencap_table_t *reencaps;
+
+void
+exit_cleanup(void)
+{
+    exit(EXIT_FAILURE);
+}
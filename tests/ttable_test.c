@@ -0,0 +1,225 @@
+/*
+ *
+ * Copyright (C) 2011, 2015 Cisco Systems, Inc.
+ * Copyright (C) 2015 CBA research group, Technical University of Catalonia.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Flows evicted from the flow table of the data plane when an RLOC goes
+ * down. ttable_remove_with_rloc is checked on its own table, and the
+ * datap_flush_flows callback of the pcap data plane on the flow table of
+ * the output path, as called by the xTR when a locator changes state.
+ * Only the flows encapsulated from or to the RLOC must be removed.
+ *
+ * The locator state change itself (RLOC probing, interface down) and a
+ * link flap of a real interface are not covered.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include "../oor/data-plane/data-plane.h"
+#include "../oor/data-plane/tun/tun_output.h"
+#include "../oor/fwd_policies/fwd_policy.h"
+#include "../oor/lib/ttable.h"
+#include "../oor/oor_external.h"
+
+#define FLOWS       1000
+#define LOCAL       2
+#define REMOTE      4
+
+extern ttable_t ttable;
+
+static lisp_addr_t lrlocs[LOCAL], rrlocs[REMOTE];
+static int failures = 0;
+
+
+static void
+test_addr(lisp_addr_t *addr, const char *fmt, int i)
+{
+    char str[32];
+
+    sprintf(str, fmt, i);
+    lisp_addr_ip_from_char(str, addr);
+}
+
+static void
+test_tuple(packet_tuple_t *tpl, int i)
+{
+    memset(tpl, 0, sizeof(packet_tuple_t));
+    test_addr(&tpl->src_addr, "10.0.1.%d", i % 200);
+    test_addr(&tpl->dst_addr, "10.0.2.%d", i % 250);
+    tpl->src_port = 1024 + i;
+    tpl->dst_port = 80;
+    tpl->protocol = IPPROTO_TCP;
+}
+
+/* Flow i is encapsulated from lrlocs[i % LOCAL] to rrlocs[i % REMOTE].
+ * One of every 10 flows has a negative entry, without RLOCs. A NULL RLOC
+ * flushes all the flows, negative ones included */
+static int
+test_flow_flushed(int i, lisp_addr_t **down, int ndown)
+{
+    int j;
+
+    for (j = 0; j < ndown; j++) {
+        if (down[j] == NULL) {
+            return (TRUE);
+        }
+        if (i % 10 != 0 && (lisp_addr_cmp(&lrlocs[i % LOCAL], down[j]) == 0
+                || lisp_addr_cmp(&rrlocs[i % REMOTE], down[j]) == 0)) {
+            return (TRUE);
+        }
+    }
+    return (FALSE);
+}
+
+static void
+test_fill(ttable_t *tt)
+{
+    packet_tuple_t tpl;
+    fwd_info_t *fi;
+    int i;
+
+    for (i = 0; i < FLOWS; i++) {
+        test_tuple(&tpl, i);
+        fi = fwd_info_new();
+        if (i % 10 == 0) {
+            fi->neg_map_reply_act = ACT_NATIVE_FWD;
+        } else {
+            fi->fwd_info = fwd_entry_new_init(&lrlocs[i % LOCAL],
+                    &rrlocs[i % REMOTE], 0, NULL);
+        }
+        ttable_insert(tt, pkt_tuple_clone(&tpl), fi);
+    }
+}
+
+/* The flows that used the RLOCs down, and only them, are gone from tt.
+ * removed is the number of flows removed so far, or -1 if it is unknown */
+static void
+test_check(ttable_t *tt, const char *what, lisp_addr_t **down, int ndown,
+        int removed)
+{
+    packet_tuple_t tpl;
+    int i, expected = 0, wrong = 0, found;
+
+    for (i = 0; i < FLOWS; i++) {
+        test_tuple(&tpl, i);
+        found = ttable_lookup(tt, &tpl) != NULL;
+        if (test_flow_flushed(i, down, ndown)) {
+            expected++;
+            wrong += found;
+        } else {
+            wrong += !found;
+        }
+    }
+    printf("%-40s %4d flows removed, %d flows wrong\n", what, expected,
+            wrong);
+    if (removed >= 0 && removed != expected) {
+        printf("FAIL: %s: %d flows reported as removed\n", what, removed);
+        failures++;
+    }
+    if (wrong > 0) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void
+test_ttable(void)
+{
+    ttable_t tt;
+    lisp_addr_t unused;
+    lisp_addr_t *down[2];
+    int removed;
+
+    ttable_init(&tt);
+    test_fill(&tt);
+    down[0] = &rrlocs[1];
+    test_check(&tt, "Remote RLOC down", down, 1,
+            ttable_remove_with_rloc(&tt, down[0]));
+    ttable_uninit(&tt);
+
+    ttable_init(&tt);
+    test_fill(&tt);
+    down[0] = &lrlocs[0];
+    removed = ttable_remove_with_rloc(&tt, down[0]);
+    test_check(&tt, "Local RLOC down", down, 1, removed);
+    test_addr(&unused, "192.0.2.%d", 99);
+    removed += ttable_remove_with_rloc(&tt, &unused);
+    test_check(&tt, "Then RLOC not used by any flow down", down, 1, removed);
+    ttable_uninit(&tt);
+}
+
+/* As the xTR does when a locator goes down. The forwarding info looked up
+ * before, while the table is held by a burst, must still be usable */
+static void
+test_flush_flows(void)
+{
+    packet_tuple_t tpl;
+    fwd_info_t *fi;
+    fwd_entry_t *fe;
+    lisp_addr_t *down[3];
+
+    data_plane = &dplane_pcap;
+    tun_output_init();
+    test_fill(&ttable);
+
+    test_tuple(&tpl, 1);
+    ttable_hold(&ttable);
+    fi = ttable_lookup(&ttable, &tpl);
+    data_plane->datap_flush_flows(&rrlocs[1]);
+    fe = fi->fwd_info;
+    if (lisp_addr_cmp(fe->drloc, &rrlocs[1]) != 0) {
+        printf("FAIL: forwarding info of a held table released\n");
+        failures++;
+    }
+    ttable_release(&ttable);
+    down[0] = &rrlocs[1];
+    test_check(&ttable, "datap_flush_flows, remote RLOC down", down, 1, -1);
+
+    down[1] = &lrlocs[0];
+    data_plane->datap_flush_flows(down[1]);
+    test_check(&ttable, "Then local RLOC down", down, 2, -1);
+
+    down[2] = NULL;
+    data_plane->datap_flush_flows(down[2]);
+    test_check(&ttable, "Then all RLOCs", down, 3, -1);
+    tun_output_uninit();
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < LOCAL; i++) {
+        test_addr(&lrlocs[i], "198.51.100.%d", i + 1);
+    }
+    for (i = 0; i < REMOTE; i++) {
+        test_addr(&rrlocs[i], "192.0.2.%d", i + 1);
+    }
+
+    test_ttable();
+    test_flush_flows();
+
+    printf("%d failures\n", failures);
+    return (failures ? EXIT_FAILURE : 0);
+}